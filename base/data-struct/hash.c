@@ -19,75 +19,87 @@
 
 struct dm_hash_node {
 	struct dm_hash_node *next;
+	struct dm_list list;	/* in insertion order, for iteration */
 	void *data;
 	unsigned data_len;
 	unsigned keylen;
+	unsigned hash;
 	char key[];
 };
 
+/*
+ * The table grows when the number of entries exceeds the number of
+ * slots.  Entries are then moved to the new, larger, slot array a few
+ * old slots at a time by each subsequent insertion, so no single
+ * insertion pays for rehashing the whole table.  While this is in
+ * progress, old slots below rehash_pos have been moved and all their
+ * entries live in the new slots.
+ */
+#define REHASH_SLOTS_PER_INSERT 4
+
 struct dm_hash_table {
 	unsigned num_nodes;
 	unsigned num_slots;
 	struct dm_hash_node **slots;
+	unsigned old_num_slots;
+	struct dm_hash_node **old_slots;	/* set while rehashing */
+	unsigned rehash_pos;
+	struct dm_list nodes;			/* all nodes in insertion order */
 };
 
-/* Permutation of the Integers 0 through 255 */
-static unsigned char _nums[] = {
-	1, 14, 110, 25, 97, 174, 132, 119, 138, 170, 125, 118, 27, 233, 140, 51,
-	87, 197, 177, 107, 234, 169, 56, 68, 30, 7, 173, 73, 188, 40, 36, 65,
-	49, 213, 104, 190, 57, 211, 148, 223, 48, 115, 15, 2, 67, 186, 210, 28,
-	12, 181, 103, 70, 22, 58, 75, 78, 183, 167, 238, 157, 124, 147, 172,
-	144,
-	176, 161, 141, 86, 60, 66, 128, 83, 156, 241, 79, 46, 168, 198, 41, 254,
-	178, 85, 253, 237, 250, 154, 133, 88, 35, 206, 95, 116, 252, 192, 54,
-	221,
-	102, 218, 255, 240, 82, 106, 158, 201, 61, 3, 89, 9, 42, 155, 159, 93,
-	166, 80, 50, 34, 175, 195, 100, 99, 26, 150, 16, 145, 4, 33, 8, 189,
-	121, 64, 77, 72, 208, 245, 130, 122, 143, 55, 105, 134, 29, 164, 185,
-	194,
-	193, 239, 101, 242, 5, 171, 126, 11, 74, 59, 137, 228, 108, 191, 232,
-	139,
-	6, 24, 81, 20, 127, 17, 91, 92, 251, 151, 225, 207, 21, 98, 113, 112,
-	84, 226, 18, 214, 199, 187, 13, 32, 94, 220, 224, 212, 247, 204, 196,
-	43,
-	249, 236, 45, 244, 111, 182, 153, 136, 129, 90, 217, 202, 19, 165, 231,
-	71,
-	230, 142, 96, 227, 62, 179, 246, 114, 162, 53, 160, 215, 205, 180, 47,
-	109,
-	44, 38, 31, 149, 135, 0, 216, 52, 63, 23, 37, 69, 39, 117, 146, 184,
-	163, 200, 222, 235, 248, 243, 219, 10, 152, 131, 123, 229, 203, 76, 120,
-	209
-};
-
-static struct dm_hash_node *_create_node(const void *key, unsigned len)
+static struct dm_hash_node *_create_node(const void *key, unsigned len,
+					 unsigned hash)
 {
 	struct dm_hash_node *n = malloc(sizeof(*n) + len);
 
 	if (n) {
 		memcpy(n->key, key, len);
 		n->keylen = len;
+		n->hash = hash;
 	}
 
 	return n;
 }
 
-static unsigned long _hash(const void *key, unsigned len)
+#define HASH_MUL 0xc6a4a7935bd1e995ULL
+#define HASH_SHIFT 47
+
+static uint64_t _mix(uint64_t k)
+{
+	k *= HASH_MUL;
+	k ^= k >> HASH_SHIFT;
+	k *= HASH_MUL;
+
+	return k;
+}
+
+/*
+ * 64-bit multiply-mix hash (MurmurHash64A), consuming 8 bytes per round.
+ */
+static unsigned _hash(const void *key, unsigned len)
 {
 	const unsigned char *str = key;
-	unsigned long h = 0, g;
-	unsigned i;
-
-	for (i = 0; i < len; i++) {
-		h <<= 4;
-		h += _nums[*str++];
-		g = h & ((unsigned long) 0xf << 16u);
-		if (g) {
-			h ^= g >> 16u;
-			h ^= g >> 5u;
-		}
+	uint64_t h = len * HASH_MUL;
+	uint64_t k;
+
+	for (; len >= sizeof(k); len -= sizeof(k), str += sizeof(k)) {
+		memcpy(&k, str, sizeof(k));
+		h ^= _mix(k);
+		h *= HASH_MUL;
 	}
 
-	return h;
+	if (len) {
+		k = 0;
+		memcpy(&k, str, len);
+		h ^= k;
+		h *= HASH_MUL;
+	}
+
+	h ^= h >> HASH_SHIFT;
+	h *= HASH_MUL;
+	h ^= h >> HASH_SHIFT;
+
+	return (unsigned) h;
 }
 
 struct dm_hash_table *dm_hash_create(unsigned size_hint)
@@ -108,6 +120,8 @@ struct dm_hash_table *dm_hash_create(unsigned size_hint)
 	if (!(hc->slots = zalloc(len)))
 		goto_bad;
 
+	dm_list_init(&hc->nodes);
+
 	return hc;
 
       bad:
@@ -119,30 +133,113 @@ struct dm_hash_table *dm_hash_create(unsigned size_hint)
 static void _free_nodes(struct dm_hash_table *t)
 {
 	struct dm_hash_node *c, *n;
-	unsigned i;
 
-	for (i = 0; i < t->num_slots; i++)
-		for (c = t->slots[i]; c; c = n) {
-			n = c->next;
-			free(c);
-		}
+	dm_list_iterate_items_safe(c, n, &t->nodes)
+		free(c);
+
+	dm_list_init(&t->nodes);
 }
 
 void dm_hash_destroy(struct dm_hash_table *t)
 {
 	_free_nodes(t);
+	free(t->old_slots);
 	free(t->slots);
 	free(t);
 }
 
+/*
+ * Return the slot chain holding entries with the given hash value.
+ */
+static struct dm_hash_node **_slot(struct dm_hash_table *t, unsigned hash)
+{
+	unsigned h;
+
+	if (t->old_slots) {
+		h = hash & (t->old_num_slots - 1);
+		if (h >= t->rehash_pos)
+			return &t->old_slots[h];
+	}
+
+	return &t->slots[hash & (t->num_slots - 1)];
+}
+
+/*
+ * Move the entries of the next n old slots into the new slots,
+ * keeping their order within each chain.
+ */
+static void _rehash_step(struct dm_hash_table *t, unsigned n)
+{
+	struct dm_hash_node *c, *next, **tail[2];
+	unsigned h;
+
+	for (; n && t->rehash_pos < t->old_num_slots; n--, t->rehash_pos++) {
+		/*
+		 * The new table is twice the size of the old one, so the
+		 * entries of old slot h go to new slot h or h + old size.
+		 */
+		h = t->rehash_pos;
+		tail[0] = &t->slots[h];
+		tail[1] = &t->slots[h + t->old_num_slots];
+
+		for (c = t->old_slots[h]; c; c = next) {
+			next = c->next;
+			c->next = NULL;
+			if (c->hash & t->old_num_slots) {
+				*tail[1] = c;
+				tail[1] = &c->next;
+			} else {
+				*tail[0] = c;
+				tail[0] = &c->next;
+			}
+		}
+		t->old_slots[h] = NULL;
+	}
+
+	if (t->rehash_pos == t->old_num_slots) {
+		free(t->old_slots);
+		t->old_slots = NULL;
+		t->old_num_slots = 0;
+		t->rehash_pos = 0;
+	}
+}
+
+/*
+ * Called before adding an entry: continue any rehash in progress,
+ * and start a new one once the load factor exceeds 1.
+ */
+static void _grow(struct dm_hash_table *t)
+{
+	struct dm_hash_node **slots;
+	unsigned num_slots;
+
+	if (t->old_slots)
+		_rehash_step(t, REHASH_SLOTS_PER_INSERT);
+
+	if ((t->num_nodes < t->num_slots) || t->old_slots)
+		return;
+
+	num_slots = t->num_slots << 1;
+	if (num_slots < t->num_slots)
+		return; /* Cannot grow any more */
+
+	if (!(slots = zalloc(sizeof(*slots) * num_slots)))
+		return; /* Keep using the current, longer, chains */
+
+	t->old_slots = t->slots;
+	t->old_num_slots = t->num_slots;
+	t->rehash_pos = 0;
+	t->slots = slots;
+	t->num_slots = num_slots;
+}
+
 static struct dm_hash_node **_find(struct dm_hash_table *t, const void *key,
-				   uint32_t len)
+				   uint32_t len, unsigned hash)
 {
-	unsigned h = _hash(key, len) & (t->num_slots - 1);
 	struct dm_hash_node **c;
 
-	for (c = &t->slots[h]; *c; c = &((*c)->next)) {
-		if ((*c)->keylen != len)
+	for (c = _slot(t, hash); *c; c = &((*c)->next)) {
+		if ((*c)->hash != hash || (*c)->keylen != len)
 			continue;
 
 		if (!memcmp(key, (*c)->key, len))
@@ -152,10 +249,20 @@ static struct dm_hash_node **_find(struct dm_hash_table *t, const void *key,
 	return c;
 }
 
+static void _unlink_node(struct dm_hash_table *t, struct dm_hash_node **c)
+{
+	struct dm_hash_node *old = *c;
+
+	*c = old->next;
+	dm_list_del(&old->list);
+	free(old);
+	t->num_nodes--;
+}
+
 void *dm_hash_lookup_binary(struct dm_hash_table *t, const void *key,
 			    uint32_t len)
 {
-	struct dm_hash_node **c = _find(t, key, len);
+	struct dm_hash_node **c = _find(t, key, len, _hash(key, len));
 
 	return *c ? (*c)->data : 0;
 }
@@ -163,18 +270,23 @@ void *dm_hash_lookup_binary(struct dm_hash_table *t, const void *key,
 int dm_hash_insert_binary(struct dm_hash_table *t, const void *key,
 			  uint32_t len, void *data)
 {
-	struct dm_hash_node **c = _find(t, key, len);
+	unsigned hash = _hash(key, len);
+	struct dm_hash_node **c = _find(t, key, len, hash);
 
 	if (*c)
 		(*c)->data = data;
 	else {
-		struct dm_hash_node *n = _create_node(key, len);
+		struct dm_hash_node *n = _create_node(key, len, hash);
 
 		if (!n)
 			return 0;
 
 		n->data = data;
 		n->next = 0;
+		dm_list_add(&t->nodes, &n->list);
+		_grow(t);
+		/* The chain may have moved */
+		c = _find(t, key, len, hash);
 		*c = n;
 		t->num_nodes++;
 	}
@@ -185,14 +297,10 @@ int dm_hash_insert_binary(struct dm_hash_table *t, const void *key,
 void dm_hash_remove_binary(struct dm_hash_table *t, const void *key,
 			uint32_t len)
 {
-	struct dm_hash_node **c = _find(t, key, len);
+	struct dm_hash_node **c = _find(t, key, len, _hash(key, len));
 
-	if (*c) {
-		struct dm_hash_node *old = *c;
-		*c = (*c)->next;
-		free(old);
-		t->num_nodes--;
-	}
+	if (*c)
+		_unlink_node(t, c);
 }
 
 void *dm_hash_lookup(struct dm_hash_table *t, const char *key)
@@ -215,12 +323,10 @@ static struct dm_hash_node **_find_str_with_val(struct dm_hash_table *t,
 					        uint32_t len, uint32_t val_len)
 {
 	struct dm_hash_node **c;
-	unsigned h;
-       
-	h = _hash(key, len) & (t->num_slots - 1);
+	unsigned hash = _hash(key, len);
 
-	for (c = &t->slots[h]; *c; c = &((*c)->next)) {
-		if ((*c)->keylen != len)
+	for (c = _slot(t, hash); *c; c = &((*c)->next)) {
+		if ((*c)->hash != hash || (*c)->keylen != len)
 			continue;
 
 		if (!memcmp(key, (*c)->key, len) && (*c)->data) {
@@ -237,26 +343,23 @@ int dm_hash_insert_allow_multiple(struct dm_hash_table *t, const char *key,
 				  const void *val, uint32_t val_len)
 {
 	struct dm_hash_node *n;
-	struct dm_hash_node *first;
+	struct dm_hash_node **first;
 	int len = strlen(key) + 1;
-	unsigned h;
+	unsigned hash = _hash(key, len);
 
-	n = _create_node(key, len);
+	n = _create_node(key, len, hash);
 	if (!n)
 		return 0;
 
 	n->data = (void *)val;
 	n->data_len = val_len;
 
-	h = _hash(key, len) & (t->num_slots - 1);
+	dm_list_add(&t->nodes, &n->list);
+	_grow(t);
 
-	first = t->slots[h];
-
-	if (first)
-		n->next = first;
-	else
-		n->next = 0;
-	t->slots[h] = n;
+	first = _slot(t, hash);
+	n->next = *first;
+	*first = n;
 
 	t->num_nodes++;
 	return 1;
@@ -287,12 +390,8 @@ void dm_hash_remove_with_val(struct dm_hash_table *t, const char *key,
 
 	c = _find_str_with_val(t, key, val, strlen(key) + 1, val_len);
 
-	if (c && *c) {
-		struct dm_hash_node *old = *c;
-		*c = (*c)->next;
-		free(old);
-		t->num_nodes--;
-	}
+	if (c && *c)
+		_unlink_node(t, c);
 }
 
 /*
@@ -312,14 +411,12 @@ void *dm_hash_lookup_with_count(struct dm_hash_table *t, const char *key, int *c
 	struct dm_hash_node **c;
 	struct dm_hash_node **c1 = NULL;
 	uint32_t len = strlen(key) + 1;
-	unsigned h;
+	unsigned hash = _hash(key, len);
 
 	*count = 0;
 
-	h = _hash(key, len) & (t->num_slots - 1);
-
-	for (c = &t->slots[h]; *c; c = &((*c)->next)) {
-		if ((*c)->keylen != len)
+	for (c = _slot(t, hash); *c; c = &((*c)->next)) {
+		if ((*c)->hash != hash || (*c)->keylen != len)
 			continue;
 
 		if (!memcmp(key, (*c)->key, len)) {
@@ -343,19 +440,19 @@ unsigned dm_hash_get_num_entries(struct dm_hash_table *t)
 void dm_hash_iter(struct dm_hash_table *t, dm_hash_iterate_fn f)
 {
 	struct dm_hash_node *c, *n;
-	unsigned i;
 
-	for (i = 0; i < t->num_slots; i++)
-		for (c = t->slots[i]; c; c = n) {
-			n = c->next;
-			f(c->data);
-		}
+	dm_list_iterate_items_safe(c, n, &t->nodes)
+		f(c->data);
 }
 
 void dm_hash_wipe(struct dm_hash_table *t)
 {
 	_free_nodes(t);
 	memset(t->slots, 0, sizeof(struct dm_hash_node *) * t->num_slots);
+	free(t->old_slots);
+	t->old_slots = NULL;
+	t->old_num_slots = 0;
+	t->rehash_pos = 0;
 	t->num_nodes = 0u;
 }
 
@@ -371,25 +468,20 @@ void *dm_hash_get_data(struct dm_hash_table *t __attribute__((unused)),
 	return n->data;
 }
 
-static struct dm_hash_node *_next_slot(struct dm_hash_table *t, unsigned s)
-{
-	struct dm_hash_node *c = NULL;
-	unsigned i;
-
-	for (i = s; i < t->num_slots && !c; i++)
-		c = t->slots[i];
-
-	return c;
-}
-
+/*
+ * Iteration follows insertion order and is not affected by the table
+ * growing, so entries may be added while iterating.
+ */
 struct dm_hash_node *dm_hash_get_first(struct dm_hash_table *t)
 {
-	return _next_slot(t, 0);
+	struct dm_list *l = dm_list_first(&t->nodes);
+
+	return l ? dm_list_item(l, struct dm_hash_node) : NULL;
 }
 
 struct dm_hash_node *dm_hash_get_next(struct dm_hash_table *t, struct dm_hash_node *n)
 {
-	unsigned h = _hash(n->key, n->keylen) & (t->num_slots - 1);
+	struct dm_list *l = dm_list_next(&t->nodes, &n->list);
 
-	return n->next ? n->next : _next_slot(t, h + 1);
+	return l ? dm_list_item(l, struct dm_hash_node) : NULL;
 }
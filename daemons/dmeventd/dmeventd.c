@@ -21,11 +21,14 @@
 #include "dmeventd.h"
 
 #include "libdm/misc/dm-logging.h"
+#include "libdm/misc/dm-ioctl.h"
+#include "libdm/misc/kdev_t.h"
 #include "base/memory/zalloc.h"
 
 #include <dlfcn.h>
 #include <pthread.h>
 #include <sys/file.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/time.h>
@@ -33,6 +36,7 @@
 #include <signal.h>
 #include <arpa/inet.h>		/* for htonl, ntohl */
 #include <fcntl.h>		/* for musl libc */
+#include <poll.h>
 #include <unistd.h>
 #include <syslog.h>
 
@@ -246,6 +250,12 @@ struct thread_status {
 	struct dm_list timeout_list;
 	void *dso_private; /* dso per-thread status variable */
 	/* TODO per-thread mutex */
+
+	/* Event loop mode only */
+	struct dm_list work_list;	/* on _event_work */
+	int queued;		/* Set while queued or worked on by a worker */
+	uint32_t event_nr;	/* Last seen device event number */
+	unsigned seen;		/* _event_generation device was last listed in */
 };
 
 static DM_LIST_INIT(_thread_registry);
@@ -256,6 +266,36 @@ static DM_LIST_INIT(_timeout_registry);
 static pthread_mutex_t _timeout_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t _timeout_cond = PTHREAD_COND_INITIALIZER;
 
+/*
+ * Event loop mode (-e).
+ *
+ * Instead of one thread per device sleeping in DM_DEVICE_WAITEVENT,
+ * a single event thread polls its own fd of the dm control device.
+ * The fd becomes readable once any device raised an event after
+ * DM_DEV_ARM_POLL.  The thread then lists all devices together with
+ * their event numbers and queues each monitored device whose event
+ * number changed to a small pool of worker threads calling the DSO.
+ * Timeouts are kept in a timer wheel served by the same thread.
+ *
+ * Needs dm driver 4.37 (DM_DEV_ARM_POLL and event numbers in
+ * DM_LIST_DEVICES), otherwise a thread per device is used.
+ *
+ * _event_devices, _event_work and the work fields of thread_status
+ * are protected by _global_mutex, _timer_wheel by _timeout_mutex.
+ */
+#define EVENT_WORKERS		4
+#define TIMER_WHEEL_SLOTS	64	/* One slot per second */
+
+static int _event_loop = 0;		/* Event loop mode requested/used */
+static int _event_loop_running = 0;
+static int _event_control_fd = -1;
+static unsigned _event_generation = 0;
+static struct dm_hash_table *_event_devices;	/* Running threads by major:minor */
+static DM_LIST_INIT(_event_work);		/* Threads queued for workers */
+static pthread_cond_t _event_work_cond = PTHREAD_COND_INITIALIZER;
+static struct dm_list _timer_wheel[TIMER_WHEEL_SLOTS];
+static time_t _timer_wheel_time;	/* Slots up to this time have fired */
+
 
 /**********
  *   DSO
@@ -437,6 +477,7 @@ static struct thread_status *_alloc_thread_status(const struct message_data *dat
 	thread->pending = DM_EVENT_REGISTRATION_PENDING;
 	thread->timeout = data->timeout_secs;
 	dm_list_init(&thread->timeout_list);
+	dm_list_init(&thread->work_list);
 
 	return thread;
 
@@ -617,6 +658,7 @@ static int _fill_device_data(struct thread_status *ts)
 
 	ts->device.major = dmi.major;
 	ts->device.minor = dmi.minor;
+	ts->event_nr = dmi.event_nr;
 	dm_task_set_event_nr(ts->wait_task, dmi.event_nr);
 
 	ret = 1;
@@ -807,6 +849,67 @@ static void *_timeout_thread(void *unused __attribute__((unused)))
 	return NULL;
 }
 
+/* Pass thread to an event worker, mutex must be held. */
+static void _queue_thread(struct thread_status *thread)
+{
+	if (thread->queued)
+		return; /* Worker checks the thread again when done with it */
+
+	thread->queued = 1;
+	dm_list_add(&_event_work, &thread->work_list);
+	pthread_cond_signal(&_event_work_cond);
+}
+
+/* _timeout_mutex must be held. */
+static void _timer_wheel_add(struct thread_status *thread)
+{
+	dm_list_add(&_timer_wheel[thread->next_time % TIMER_WHEEL_SLOTS],
+		    &thread->timeout_list);
+}
+
+/*
+ * Fire timeouts of all slots passed since the last call.
+ * A slot keeps the entries due in a later round of the wheel.
+ */
+static void _timer_wheel_run(time_t now)
+{
+	struct thread_status *thread, *tmp;
+	struct dm_list *slot;
+	time_t t;
+
+	pthread_mutex_lock(&_timeout_mutex);
+
+	/* Clock change or first run: go round the wheel once */
+	if ((now < _timer_wheel_time) || (now - _timer_wheel_time > TIMER_WHEEL_SLOTS))
+		_timer_wheel_time = now - TIMER_WHEEL_SLOTS;
+
+	for (t = _timer_wheel_time + 1; t <= now; t++) {
+		slot = &_timer_wheel[t % TIMER_WHEEL_SLOTS];
+		dm_list_iterate_items_gen_safe(thread, tmp, slot, timeout_list) {
+			if (thread->next_time > now)
+				continue;
+
+			dm_list_del(&thread->timeout_list);
+			thread->next_time = now + thread->timeout;
+			_timer_wheel_add(thread);
+
+			_lock_mutex();
+			if (thread->queued || (thread->status != DM_THREAD_RUNNING))
+				log_debug("Skipping timeout for busy %s.", thread->device.name);
+			else {
+				DEBUGLOG("Queuing timeout for %s.", thread->device.name);
+				thread->current_events |= DM_EVENT_TIMEOUT;
+				_queue_thread(thread);
+			}
+			_unlock_mutex();
+		}
+	}
+
+	_timer_wheel_time = now;
+
+	pthread_mutex_unlock(&_timeout_mutex);
+}
+
 static int _register_for_timeout(struct thread_status *thread)
 {
 	int ret = 0;
@@ -815,12 +918,16 @@ static int _register_for_timeout(struct thread_status *thread)
 
 	if (dm_list_empty(&thread->timeout_list)) {
 		thread->next_time = time(NULL) + thread->timeout;
-		dm_list_add(&_timeout_registry, &thread->timeout_list);
-		if (_timeout_running)
-			pthread_cond_signal(&_timeout_cond);
+		if (_event_loop)
+			_timer_wheel_add(thread);
+		else {
+			dm_list_add(&_timeout_registry, &thread->timeout_list);
+			if (_timeout_running)
+				pthread_cond_signal(&_timeout_cond);
+		}
 	}
 
-	if (!_timeout_running &&
+	if (!_event_loop && !_timeout_running &&
 	    !(ret = _pthread_create_smallstack(NULL, _timeout_thread, NULL)))
 		_timeout_running = 1;
 
@@ -940,18 +1047,18 @@ static int _do_unregister_device(struct thread_status *thread)
 }
 
 /* Process an event in the DSO. */
-static void _do_process_event(struct thread_status *thread)
+static void _do_process_event(struct thread_status *thread, int events)
 {
 	struct dm_task *task;
 
-	/* NOTE: timeout event gets status */
-	task = (thread->current_events & DM_EVENT_TIMEOUT)
+	/* NOTE: timeout event and event loop get status */
+	task = ((events & DM_EVENT_TIMEOUT) || _event_loop)
 		? _get_device_status(thread) : thread->wait_task;
 
 	if (!task)
 		log_error("Lost event in Thr %x.", (int)thread->thread);
 	else {
-		thread->dso_data->process_event(task, thread->current_events, &(thread->dso_private));
+		thread->dso_data->process_event(task, events, &(thread->dso_private));
 		if (task != thread->wait_task)
 			dm_task_destroy(task);
 	}
@@ -1039,7 +1146,7 @@ static void *_monitor_thread(void *arg)
 			thread->processing = 1;  /* Cannot be removed/signaled */
 			_unlock_mutex();
 
-			_do_process_event(thread);
+			_do_process_event(thread, thread->current_events);
 			thread->current_events = 0; /* Current events processed */
 
 			_lock_mutex();
@@ -1083,6 +1190,313 @@ static int _create_thread(struct thread_status *thread)
 	return _pthread_create_smallstack(&thread->thread, _monitor_thread, thread);
 }
 
+/*
+ * Event loop mode.
+ */
+
+static void _event_device_key(const struct thread_status *thread, uint32_t key[2])
+{
+	key[0] = (uint32_t) thread->device.major;
+	key[1] = (uint32_t) thread->device.minor;
+}
+
+/* Move thread without events to unused, mutex must be held. */
+static void _event_thread_unused(struct thread_status *thread)
+{
+	struct thread_status *thread_iter;
+
+	thread->events = 0;
+
+	dm_list_iterate_items(thread_iter, &_thread_registry)
+		if (thread_iter == thread) {
+			_thread_unused(thread);
+			break;
+		}
+}
+
+/*
+ * A DSO asks to be unregistered by sending SIGALRM to its own thread,
+ * which stays pending in a worker with blocked signals.
+ */
+static int _event_unregister_requested(void)
+{
+	struct timespec zero = { 0 };
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGALRM);
+
+	return (sigtimedwait(&set, NULL, &zero) == SIGALRM);
+}
+
+/*
+ * Register the device, process its events and unregister it
+ * once there are no events left.  Mutex must be held.
+ */
+static void _event_work_thread(struct thread_status *thread)
+{
+	uint32_t key[2];
+	int events, ok;
+
+	if (thread->status == DM_THREAD_REGISTERING) {
+		_unlock_mutex();
+
+		if (!(ok = _fill_device_data(thread)))
+			log_error("Failed to fill device data for %s.", thread->device.uuid);
+		else if (!(ok = _do_register_device(thread)))
+			log_error("Failed to register device %s.", thread->device.name);
+
+		_lock_mutex();
+
+		if (!ok)
+			_event_thread_unused(thread);
+		else {
+			_event_device_key(thread, key);
+			if (!dm_hash_insert_binary(_event_devices, key, sizeof(key), thread)) {
+				log_error("Failed to add %s to monitored devices.", thread->device.name);
+				_event_thread_unused(thread);
+			}
+			thread->seen = _event_generation;
+			thread->status = DM_THREAD_RUNNING;
+			thread->processing = 0;
+		}
+	}
+
+	while (thread->events) {
+		thread->pending = 0; /* Event is no longer pending...  */
+
+		if (!(thread->events & thread->current_events)) {
+			thread->current_events = 0;
+			thread->queued = 0;
+			return;
+		}
+
+		events = thread->current_events;
+		thread->current_events = 0;
+		thread->processing = 1;  /* Cannot be removed */
+		_unlock_mutex();
+
+		_do_process_event(thread, events);
+		ok = !_event_unregister_requested();
+
+		_lock_mutex();
+		thread->processing = 0;
+
+		if (!ok)
+			_event_thread_unused(thread);
+	}
+
+	DEBUGLOG("Unregistering monitor for %s.", thread->device.name);
+
+	thread->pending = 0;
+	thread->processing = 1;	/* Process unregistering */
+
+	if (thread->status == DM_THREAD_RUNNING) {
+		_event_device_key(thread, key);
+		if (dm_hash_lookup_binary(_event_devices, key, sizeof(key)) == thread)
+			dm_hash_remove_binary(_event_devices, key, sizeof(key));
+	}
+
+	_unlock_mutex();
+
+	_unregister_for_timeout(thread);
+
+	if ((thread->status != DM_THREAD_REGISTERING) &&
+	    !_do_unregister_device(thread))
+		log_error("%s: %s unregister failed.", __func__,
+			  thread->device.name);
+
+	_lock_mutex();
+	thread->status = DM_THREAD_DONE; /* Stays queued, freed by cleanup */
+}
+
+static void *_event_worker(void *unused __attribute__((unused)))
+{
+	struct thread_status *thread;
+
+	_lock_mutex();
+
+	for (;;) {
+		while (dm_list_empty(&_event_work))
+			pthread_cond_wait(&_event_work_cond, &_global_mutex);
+
+		thread = dm_list_struct_base(dm_list_first(&_event_work),
+					     struct thread_status, work_list);
+		dm_list_del(&thread->work_list);
+
+		_event_work_thread(thread);
+	}
+
+	return NULL;
+}
+
+static int _event_arm_poll(void)
+{
+	struct dm_ioctl dmi = {
+		.version = { DM_VERSION_MAJOR, 0, 0 },
+		.data_size = sizeof(dmi),
+	};
+
+	if (ioctl(_event_control_fd, DM_DEV_ARM_POLL, &dmi) < 0) {
+		log_sys_error("ioctl", "DM_DEV_ARM_POLL");
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * List all devices and queue the monitored ones with a new event number.
+ * Since 4.37 the event number follows the name aligned to 8 bytes.
+ */
+static void _event_check_devices(void)
+{
+	struct thread_status *thread, *tmp;
+	struct dm_task *dmt;
+	struct dm_names *names;
+	unsigned generation;
+	unsigned next = 0;
+	uint32_t key[2];
+	uint32_t event_nr;
+	uintptr_t p;
+
+	_lock_mutex();
+	generation = ++_event_generation;
+	_unlock_mutex();
+
+	if (!(dmt = dm_task_create(DM_DEVICE_LIST)))
+		return;
+
+	if (!dm_task_run(dmt) || !(names = dm_task_get_names(dmt))) {
+		log_error("Failed to list devices.");
+		goto out;
+	}
+
+	_lock_mutex();
+
+	if (names->dev)
+		do {
+			names = (struct dm_names *)((char *) names + next);
+			key[0] = (uint32_t) MAJOR(names->dev);
+			key[1] = (uint32_t) MINOR(names->dev);
+
+			if ((thread = dm_hash_lookup_binary(_event_devices, key, sizeof(key)))) {
+				thread->seen = generation;
+				p = (uintptr_t) (names->name + strlen(names->name) + 1);
+				event_nr = *(uint32_t *) ((p + 7) & ~(uintptr_t) 7);
+
+				if (event_nr != thread->event_nr) {
+					DEBUGLOG("Queuing event %u for %s.", event_nr, thread->device.name);
+					thread->event_nr = event_nr;
+					thread->current_events |= DM_EVENT_DEVICE_ERROR;
+					_queue_thread(thread);
+				}
+			}
+			next = names->next;
+		} while (next);
+
+	/* Running threads not listed: device is gone */
+	dm_list_iterate_items_safe(thread, tmp, &_thread_registry)
+		if ((thread->status == DM_THREAD_RUNNING) &&
+		    (thread->seen != generation)) {
+			log_error("%s disappeared, detaching.", thread->device.name);
+			_event_thread_unused(thread);
+			_queue_thread(thread);
+		}
+
+	_unlock_mutex();
+out:
+	dm_task_destroy(dmt);
+}
+
+static void *_event_loop_thread(void *unused __attribute__((unused)))
+{
+	struct pollfd pfd = { .fd = _event_control_fd, .events = POLLIN };
+	int check = 1;
+
+	DEBUGLOG("Event loop thread starting.");
+
+	for (;;) {
+		if (check && _event_arm_poll())
+			_event_check_devices();
+
+		_timer_wheel_run(time(NULL));
+
+		/* Wake up every second to serve the timer wheel */
+		check = 0;
+		if ((poll(&pfd, 1, 1000) < 0) && (errno != EINTR)) {
+			log_sys_error("poll", "dm control");
+			sleep(1);
+			check = 1;
+		} else if (pfd.revents & POLLIN)
+			check = 1;
+	}
+
+	return NULL;
+}
+
+/*
+ * Start event loop threads with the first registration.
+ * Returns 0 when thread per device must be used instead.
+ */
+static int _start_event_loop(void)
+{
+	char path[PATH_MAX];
+	char version[64];
+	unsigned major = 0, minor = 0;
+	int i, workers = 0;
+
+	if (_event_loop_running)
+		return 1;
+
+	if (!dm_driver_version(version, sizeof(version)) ||
+	    (sscanf(version, "%u.%u", &major, &minor) != 2) ||
+	    (major < 4) || ((major == 4) && (minor < 37))) {
+		log_warn("WARNING: Kernel dm driver %s does not support event polling.", version);
+		return 0;
+	}
+
+	if (dm_snprintf(path, sizeof(path), "%s/%s", dm_dir(), DM_CONTROL_NODE) < 0)
+		return_0;
+
+	if ((_event_control_fd = open(path, O_RDWR | O_CLOEXEC)) < 0) {
+		log_sys_error("open", path);
+		return 0;
+	}
+
+	if (!(_event_devices = dm_hash_create(1024)))
+		goto_bad;
+
+	for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+		dm_list_init(&_timer_wheel[i]);
+	_timer_wheel_time = time(NULL);
+
+	for (i = 0; i < EVENT_WORKERS; i++)
+		if (!_pthread_create_smallstack(NULL, _event_worker, NULL))
+			workers++;
+
+	if (!workers)
+		goto_bad;
+
+	if (_pthread_create_smallstack(NULL, _event_loop_thread, NULL))
+		goto_bad; /* Workers just stay idle */
+
+	log_notice("Monitoring devices with event loop and %d workers.", workers);
+	_event_loop_running = 1;
+
+	return 1;
+bad:
+	if (_event_devices) {
+		dm_hash_destroy(_event_devices);
+		_event_devices = NULL;
+	}
+	if (close(_event_control_fd))
+		log_sys_debug("close", path);
+	_event_control_fd = -1;
+
+	return 0;
+}
+
 /* Update events - needs to be locked */
 static int _update_events(struct thread_status *thread, int events)
 {
@@ -1094,8 +1508,14 @@ static int _update_events(struct thread_status *thread, int events)
 	thread->events = events;
 	thread->pending = DM_EVENT_REGISTRATION_PENDING;
 
-	/* Only non-processing threads can be notified */
-	if (!thread->processing) {
+	if (_event_loop) {
+		/* Worker notices the change, only unregistering needs one */
+		if (!thread->queued && (thread->status == DM_THREAD_RUNNING))
+			thread->pending = 0;
+		if (!thread->events)
+			_queue_thread(thread);
+	} else if (!thread->processing) {
+		/* Only non-processing threads can be notified */
 		DEBUGLOG("Sending SIGALRM to wakeup Thr %x.", (int)thread->thread);
 
 		/* Notify thread waiting in ioctl (to speed-up) */
@@ -1195,7 +1615,12 @@ static int _register_for_event(struct message_data *message_data)
 			return -ENOMEM;
 		}
 
-		if ((ret = _create_thread(thread))) {
+		if (_event_loop && !_start_event_loop()) {
+			log_warn("WARNING: Using a thread for each monitored device.");
+			_event_loop = 0;
+		}
+
+		if (!_event_loop && (ret = _create_thread(thread))) {
 			stack;
 			_free_thread_status(thread);
 			return -ret;
@@ -1204,6 +1629,10 @@ static int _register_for_event(struct message_data *message_data)
 		_lock_mutex();
 		/* Note: same uuid can't be added in parallel */
 		LINK_THREAD(thread);
+
+		/* Remaining initialization happens within event worker */
+		if (_event_loop)
+			_queue_thread(thread);
 	}
 
 	_unlock_mutex();
@@ -1705,7 +2134,7 @@ static void _cleanup_unused_threads(void)
 	while ((l = dm_list_first(&_thread_registry_unused))) {
 		thread = dm_list_item(l, struct thread_status);
 		if (thread->status != DM_THREAD_DONE) {
-			if (thread->processing)
+			if (thread->processing || _event_loop)
 				break; /* cleanup on the next round */
 
 			/* Signal possibly sleeping thread */
@@ -1721,7 +2150,7 @@ static void _cleanup_unused_threads(void)
 
 		DEBUGLOG("Destroying Thr %x.", (int)thread->thread);
 
-		if (pthread_join(thread->thread, NULL))
+		if (!_event_loop && pthread_join(thread->thread, NULL))
 			log_sys_error("pthread_join", "");
 
 		_free_thread_status(thread);
@@ -2145,8 +2574,9 @@ bad:
 static void _usage(char *prog, FILE *file)
 {
 	fprintf(file, "Usage:\n"
-		"%s [-d [-d [-d]]] [-f] [-h] [-l] [-R] [-V] [-?]\n\n"
+		"%s [-d [-d [-d]]] [-e] [-f] [-h] [-l] [-R] [-V] [-?]\n\n"
 		"   -d       Log debug messages to syslog (-d, -dd, -ddd)\n"
+		"   -e       Monitor devices with an event loop, not thread per device\n"
 		"   -f       Don't fork, run in the foreground\n"
 		"   -h       Show this help information\n"
 		"   -l       Log to stdout,stderr instead of syslog\n"
@@ -2168,7 +2598,7 @@ int main(int argc, char *argv[])
 	opterr = 0;
 	optind = 0;
 
-	while ((opt = getopt(argc, argv, "?fhVdlR")) != EOF) {
+	while ((opt = getopt(argc, argv, "?efhVdlR")) != EOF) {
 		switch (opt) {
 		case 'h':
 			_usage(argv[0], stdout);
@@ -2179,6 +2609,9 @@ int main(int argc, char *argv[])
 		case 'R':
 			_restart++;
 			break;
+		case 'e':
+			_event_loop = 1;
+			break;
 		case 'f':
 			_foreground++;
 			break;
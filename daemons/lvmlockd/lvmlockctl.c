@@ -73,12 +73,12 @@ static void save_client_info(char *line)
 {
 	uint32_t pid = 0;
 	int fd = 0;
-	int pi = 0;
+	int ct = 0;
 	uint32_t client_id = 0;
 	char name[MAX_NAME+1] = { 0 };
 
-	(void) sscanf(line, "info=client pid=%u fd=%d pi=%d id=%u name=%s",
-	       &pid, &fd, &pi, &client_id, name);
+	(void) sscanf(line, "info=client pid=%u fd=%d ct=%d id=%u name=%s",
+	       &pid, &fd, &ct, &client_id, name);
 
 	clients[num_clients].client_id = client_id;
 	clients[num_clients].pid = pid;
@@ -20,13 +20,13 @@
 #include <errno.h>
 #include <pthread.h>
 #include <stddef.h>
-#include <poll.h>
 #include <signal.h>
 #include <getopt.h>
 #include <syslog.h>
 #include <dirent.h>
 #include <time.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/utsname.h>
 #include <sys/un.h>
@@ -43,25 +43,27 @@ static int str_to_mode(const char *str);
 /*
  * Basic operation of lvmlockd
  *
- * lvmlockd main process runs main_loop() which uses poll().
- * poll listens for new connections from lvm commands and for
+ * lvmlockd main process runs main_loop() which uses epoll.
+ * epoll listens for new connections from lvm commands and for
  * messages from existing connected lvm commands.
  *
  * lvm command starts and connects to lvmlockd.
  *
  * lvmlockd receives a connection request from command and adds a
  * 'struct client' to keep track of the connection to the command.
- * The client's fd is added to the set of fd's in poll().
+ * The client's fd is added to the set of fd's in epoll.  Each client
+ * is assigned to one of the client threads (by client id), so all
+ * requests and results of one client are handled in order.
  *
  * lvm command sends a lock request to lvmlockd.  The lock request
  * can be for the global lock, a vg lock, or an lv lock.
  *
- * lvmlockd main_loop/poll sees a message from an existing client.
- * It sets client.recv = 1, then wakes up client_thread_main.
+ * lvmlockd main_loop/epoll sees a message from an existing client.
+ * It sets client.recv = 1, queues the client on the work list of
+ * its client thread, and wakes up that client_thread_main.
  *
- * client_thread_main iterates through client structs (cl), looking
- * for any that need processing, finds the one with cl->recv set,
- * and calls client_recv_action(cl).
+ * client_thread_main takes client structs (cl) off its work list,
+ * and for one with cl->recv set, calls client_recv_action(cl).
  *
  * client_recv_action(cl) reads the message/request from the client,
  * allocates a new 'struct action' (act) to represent the request,
@@ -89,16 +91,16 @@ static int str_to_mode(const char *str);
  * how these ops are processed by these threads.  When the
  * given thread is done processing the action, the result is
  * set in act->result, and the act struct for the completed action
- * is passed back to the client_thread (client_results list).
+ * is passed back to the client_thread of the client (ct->results list).
  *
- * The client_thread takes completed actions (from client_results
+ * The client_thread takes completed actions (from ct->results
  * list), and sends the result back to the client that sent the
  * request represented by the action.  The act struct is then freed.
  *
  * This completes the cycle of work between lvm commands (clients)
  * and lvmlockd.  In summary:
  *
- * - main process polls for new client connections and new requests
+ * - main process waits for new client connections and new requests
  *   from lvm commands
  * - client_thread reads requests from clients
  * - client_thread creates an action struct for each request
@@ -128,8 +130,11 @@ static int str_to_mode(const char *str);
  * list of actions: r->actions, i.e. outstanding lock requests on the
  * resource.
  *
- * The lockspace thread then iterates through each resource in the
- * lockspace, processing any outstanding actions on each: res_process(ls, r).
+ * The lockspace thread then iterates through each resource that has been
+ * given new actions (ls->dirty_resources), processing the outstanding
+ * actions on each: res_process(ls, r).  A client exit releases the
+ * locks of the client, so the resources the client requested locks on
+ * (ls->client_hash) are processed then as well.
  *
  * res_process() compares the outstanding actions/requests in r->actions
  * against any existing locks on the resource in r->locks.  If the
@@ -161,24 +166,20 @@ static struct sockaddr_un dump_addr;
 static socklen_t dump_addrlen;
 
 /*
- * Main program polls client connections, adds new clients,
- * adds work for client thread.
+ * Main program waits on client connections with epoll, adds new clients,
+ * adds work for client threads.
  *
- * pollfd_mutex is used for adding vs removing entries,
- * and for resume vs realloc.
+ * Client fds are added with EPOLLONESHOT, so no further events are
+ * reported for a client until the client thread has processed its
+ * request and re-armed the fd in client_resume().  The epoll data
+ * of a client fd is the client id; listen_fd uses an id that no
+ * client can have.
  */
-#define POLL_FD_UNUSED -1		/* slot if free */
-#define POLL_FD_IGNORE -2		/* slot is used but ignore in poll */
-#define ADD_POLL_SIZE 16		/* increment slots by this amount */
-
-static pthread_mutex_t pollfd_mutex;
-static struct pollfd *pollfd;
-static int pollfd_size;
-static int pollfd_maxi;
-static int listen_pi;
+#define EPOLL_MAX_EVENTS 64
+#define EPOLL_LISTEN_ID ((uint64_t)1 << 32)
+
+static int epoll_fd;
 static int listen_fd;
-static int restart_pi;
-static int restart_fds[2];
 
 /*
  * Each lockspace has its own thread to do locking.
@@ -189,16 +190,31 @@ static pthread_mutex_t lockspaces_mutex;
 static struct list_head lockspaces;
 
 /*
- * Client thread reads client requests and writes client results.
+ * Client threads read client requests and write client results.
+ * A client is handled by client_threads[cl->id % client_thread_count].
+ *
+ * client_mutex protects client_list and client_hash, ct->mutex
+ * protects the work and results lists of a client thread.
  */
-static pthread_t client_thread;
+#define DEFAULT_CLIENT_THREADS 4
+#define MAX_CLIENT_THREADS 64
+
+struct client_thread {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct list_head work;          /* clients with recv or dead set */
+	struct list_head results;       /* actions to send back to clients */
+	int stop;                       /* stop the thread */
+};
+
+static struct client_thread *client_threads;
+static int client_thread_count = DEFAULT_CLIENT_THREADS;
 static pthread_mutex_t client_mutex;
-static pthread_cond_t client_cond;
 static struct list_head client_list;    /* connected clients */
-static struct list_head client_results; /* actions to send back to clients */
+static struct dm_hash_table *client_hash; /* connected clients by id */
 static uint32_t client_ids;             /* 0 and INTERNAL_CLIENT_ID are skipped */
-static int client_stop;                 /* stop the thread */
-static int client_work;                 /* a client on client_list has work to do */
+static pthread_mutex_t adopt_file_mutex; /* client threads writing adopt_file */
 
 #define INTERNAL_CLIENT_ID 0xFFFFFFFF   /* special client_id for internal actions */
 static struct list_head adopt_results;  /* special start actions from adopt_locks() */
@@ -416,6 +432,7 @@ struct lockspace *alloc_lockspace(void)
 
 	INIT_LIST_HEAD(&ls->actions);
 	INIT_LIST_HEAD(&ls->resources);
+	INIT_LIST_HEAD(&ls->dirty_resources);
 	pthread_mutex_init(&ls->mutex, NULL);
 	pthread_cond_init(&ls->cond, NULL);
 	return ls;
@@ -478,6 +495,7 @@ static struct resource *alloc_resource(void)
 		memset(r, 0, sizeof(struct resource) + resource_lm_data_size);
 		INIT_LIST_HEAD(&r->locks);
 		INIT_LIST_HEAD(&r->actions);
+		INIT_LIST_HEAD(&r->dirty_list);
 	} else {
 		log_error("out of memory for resource");
 	}
@@ -612,68 +630,6 @@ fail:
 	return -ENOMEM;
 }
 
-static int add_pollfd(int fd)
-{
-	int i, new_size;
-	struct pollfd *tmp_pollfd;
-
-	pthread_mutex_lock(&pollfd_mutex);
-	for (i = 0; i < pollfd_size; i++) {
-		if (pollfd[i].fd != POLL_FD_UNUSED)
-			continue;
-
-		pollfd[i].fd = fd;
-		pollfd[i].events = POLLIN;
-		pollfd[i].revents = 0;
-
-		if (i > pollfd_maxi)
-			pollfd_maxi = i;
-
-		pthread_mutex_unlock(&pollfd_mutex);
-		return i;
-	}
-
-	new_size = pollfd_size + ADD_POLL_SIZE;
-
-	tmp_pollfd = realloc(pollfd, new_size * sizeof(struct pollfd));
-	if (!tmp_pollfd) {
-		log_error("can't alloc new size %d for pollfd", new_size);
-		pthread_mutex_unlock(&pollfd_mutex);
-		return -ENOMEM;
-	}
-	pollfd = tmp_pollfd;
-
-	for (i = pollfd_size; i < new_size; i++) {
-		pollfd[i].fd = POLL_FD_UNUSED;
-		pollfd[i].events = 0;
-		pollfd[i].revents = 0;
-	}
-
-	i = pollfd_size;
-	pollfd[i].fd = fd;
-	pollfd[i].events = POLLIN;
-	pollfd[i].revents = 0;
-	pollfd_maxi = i;
-
-	pollfd_size = new_size;
-
-	pthread_mutex_unlock(&pollfd_mutex);
-	return i;
-}
-
-static void rem_pollfd(int pi)
-{
-	if (pi < 0) {
-		log_error("rem_pollfd %d", pi);
-		return;
-	}
-	pthread_mutex_lock(&pollfd_mutex);
-	pollfd[pi].fd = POLL_FD_UNUSED;
-	pollfd[pi].events = 0;
-	pollfd[pi].revents = 0;
-	pthread_mutex_unlock(&pollfd_mutex);
-}
-
 static const char *lm_str(int x)
 {
 	switch (x) {
@@ -834,8 +790,12 @@ static void write_adopt_file(void)
 	time_t t;
 	FILE *fp;
 
-	if (!(fp = fopen(adopt_file, "w")))
+	pthread_mutex_lock(&adopt_file_mutex);
+
+	if (!(fp = fopen(adopt_file, "w"))) {
+		pthread_mutex_unlock(&adopt_file_mutex);
 		return;
+	}
 
 	adopt_update_count++;
 
@@ -864,6 +824,8 @@ static void write_adopt_file(void)
 
 	fflush(fp);
 	fclose(fp);
+
+	pthread_mutex_unlock(&adopt_file_mutex);
 }
 
 static int read_adopt_file(struct list_head *vg_lockd)
@@ -1091,6 +1053,21 @@ static int lm_find_free_lock(struct lockspace *ls, uint64_t *free_offset, int *s
  * client_list/client_thread.
  */
 
+static struct client_thread *client_thread_for_id(uint32_t client_id)
+{
+	return &client_threads[client_id % client_thread_count];
+}
+
+static void queue_client_result(struct action *act)
+{
+	struct client_thread *ct = client_thread_for_id(act->client_id);
+
+	pthread_mutex_lock(&ct->mutex);
+	list_add_tail(&act->list, &ct->results);
+	pthread_cond_signal(&ct->cond);
+	pthread_mutex_unlock(&ct->mutex);
+}
+
 static void add_client_result(struct action *act)
 {
 	if (act->flags & LD_AF_NO_CLIENT) {
@@ -1100,13 +1077,14 @@ static void add_client_result(struct action *act)
 		return;
 	}
 
-	pthread_mutex_lock(&client_mutex);
-	if (act->flags & LD_AF_ADOPT)
+	if (act->flags & LD_AF_ADOPT) {
+		pthread_mutex_lock(&client_mutex);
 		list_add_tail(&act->list, &adopt_results);
-	else
-		list_add_tail(&act->list, &client_results);
-	pthread_cond_signal(&client_cond);
-	pthread_mutex_unlock(&client_mutex);
+		pthread_mutex_unlock(&client_mutex);
+		return;
+	}
+
+	queue_client_result(act);
 }
 
 static struct lock *find_lock_client(struct resource *r, uint32_t client_id)
@@ -1749,6 +1727,220 @@ out:
 	return rv;
 }
 
+/*
+ * ls->resource_hash finds a resource by its type and, for LV resources,
+ * its name.  There is a single gl and vg resource per lockspace, so
+ * their names are not part of the key.  The hash is created and used
+ * by the lockspace thread only; resources added before the thread
+ * starts are indexed when it does.
+ */
+
+#define RES_KEY_LEN (MAX_NAME + 1)
+
+static int res_key(int type, const char *name, char *key)
+{
+	int len = 1;
+
+	key[0] = (char)type;
+
+	if (type == LD_RT_LV) {
+		len = strnlen(name, MAX_NAME);
+		memcpy(key + 1, name, len);
+		len++;
+	}
+
+	return len;
+}
+
+static void index_resource(struct lockspace *ls, struct resource *r)
+{
+	char key[RES_KEY_LEN];
+	int len;
+
+	if (!ls->resource_hash)
+		return;
+
+	len = res_key(r->type, r->name, key);
+
+	if (!dm_hash_insert_binary(ls->resource_hash, key, len, r))
+		log_error("S %s R %s no memory to index resource", ls->name, r->name);
+}
+
+static void add_resource(struct lockspace *ls, struct resource *r)
+{
+	list_add_tail(&r->list, &ls->resources);
+	index_resource(ls, r);
+}
+
+/* A resource with new actions to be processed by res_process(). */
+
+static void dirty_resource(struct lockspace *ls, struct resource *r)
+{
+	if (r->dirty)
+		return;
+
+	list_add_tail(&r->dirty_list, &ls->dirty_resources);
+	r->dirty = 1;
+}
+
+static void undirty_resource(struct resource *r)
+{
+	if (!r->dirty)
+		return;
+
+	list_del(&r->dirty_list);
+	r->dirty = 0;
+}
+
+static void rem_resource(struct lockspace *ls, struct resource *r)
+{
+	char key[RES_KEY_LEN];
+	int len;
+
+	if (ls->resource_hash) {
+		len = res_key(r->type, r->name, key);
+		if (dm_hash_lookup_binary(ls->resource_hash, key, len) == r)
+			dm_hash_remove_binary(ls->resource_hash, key, len);
+	}
+
+	undirty_resource(r);
+	list_del(&r->list);
+}
+
+/*
+ * ls->client_hash records the resources each client has requested locks
+ * on, so a client exit only processes those resources, and only in the
+ * lockspaces the client used.  The client id alone is the key of the
+ * client's list of resources, the client id followed by the resource key
+ * is the key of each entry on that list.  Entries may outlive the lock
+ * or the resource, they are dropped when the client exits.  The hash is
+ * used with ls->mutex held, since client_purge() checks it.
+ */
+
+struct client_res {
+	struct list_head list;		/* client_resources.resources */
+	int len;
+	char key[sizeof(uint32_t) + RES_KEY_LEN];
+};
+
+struct client_resources {
+	struct list_head resources;	/* client_res */
+};
+
+static void track_client_resource(struct lockspace *ls, uint32_t client_id,
+				  struct resource *r)
+{
+	struct client_resources *cr;
+	struct client_res *ent;
+	char key[sizeof(uint32_t) + RES_KEY_LEN];
+	int len;
+
+	if (!client_id || ls->client_untracked)
+		return;
+
+	memcpy(key, &client_id, sizeof(client_id));
+	len = sizeof(client_id) + res_key(r->type, r->name, key + sizeof(client_id));
+
+	if (!ls->client_hash && !(ls->client_hash = dm_hash_create(32)))
+		goto fail;
+
+	if (dm_hash_lookup_binary(ls->client_hash, key, len))
+		return;
+
+	if (!(cr = dm_hash_lookup_binary(ls->client_hash, key, sizeof(client_id)))) {
+		if (!(cr = malloc(sizeof(*cr))))
+			goto fail;
+
+		INIT_LIST_HEAD(&cr->resources);
+
+		if (!dm_hash_insert_binary(ls->client_hash, key, sizeof(client_id), cr)) {
+			free(cr);
+			goto fail;
+		}
+	}
+
+	if (!(ent = malloc(sizeof(*ent))))
+		goto fail;
+
+	memcpy(ent->key, key, len);
+	ent->len = len;
+
+	if (!dm_hash_insert_binary(ls->client_hash, key, len, ent)) {
+		free(ent);
+		goto fail;
+	}
+
+	list_add_tail(&ent->list, &cr->resources);
+	return;
+
+fail:
+	/* Every resource is processed on client exit from now on. */
+	log_error("S %s R %s no memory to track client %u", ls->name, r->name, client_id);
+	ls->client_untracked = 1;
+}
+
+/* The client has exited, process the resources it requested locks on. */
+
+static void dirty_client_resources(struct lockspace *ls, uint32_t client_id)
+{
+	struct client_resources *cr;
+	struct client_res *ent, *safe;
+	struct resource *r;
+
+	if (ls->client_untracked)
+		list_for_each_entry(r, &ls->resources, list)
+			dirty_resource(ls, r);
+
+	if (!ls->client_hash ||
+	    !(cr = dm_hash_lookup_binary(ls->client_hash, &client_id, sizeof(client_id))))
+		return;
+
+	list_for_each_entry_safe(ent, safe, &cr->resources, list) {
+		if ((r = dm_hash_lookup_binary(ls->resource_hash, ent->key + sizeof(client_id),
+					       ent->len - sizeof(client_id))))
+			dirty_resource(ls, r);
+
+		dm_hash_remove_binary(ls->client_hash, ent->key, ent->len);
+		list_del(&ent->list);
+		free(ent);
+	}
+
+	dm_hash_remove_binary(ls->client_hash, &client_id, sizeof(client_id));
+	free(cr);
+}
+
+/* Has the client requested locks in the lockspace? */
+
+static int ls_has_client(struct lockspace *ls, uint32_t client_id)
+{
+	struct action *act;
+
+	if (ls->client_untracked)
+		return 1;
+
+	if (ls->client_hash &&
+	    dm_hash_lookup_binary(ls->client_hash, &client_id, sizeof(client_id)))
+		return 1;
+
+	/* Actions not yet taken by the lockspace thread */
+	list_for_each_entry(act, &ls->actions, list)
+		if (act->client_id == client_id)
+			return 1;
+
+	return 0;
+}
+
+static void free_client_hash(struct lockspace *ls)
+{
+	if (!ls->client_hash)
+		return;
+
+	/* Values are client_resources and client_res structs. */
+	dm_hash_iter(ls->client_hash, free);
+	dm_hash_destroy(ls->client_hash);
+	ls->client_hash = NULL;
+}
+
 /*
  * Go through queued actions, and make lock/unlock calls on the resource
  * based on the actions and the existing lock state.
@@ -2078,6 +2270,7 @@ static void res_process(struct lockspace *ls, struct resource *r,
 				log_debug("S %s R %s res_lock EAGAIN retry", ls->name, r->name);
 				act->retries++;
 				*retry_out = 1;
+				dirty_resource(ls, r);
 			} else {
 				act->result = rv;
 				list_del(&act->list);
@@ -2111,6 +2304,7 @@ static void res_process(struct lockspace *ls, struct resource *r,
 				log_debug("S %s R %s res_lock EAGAIN retry", ls->name, r->name);
 				act->retries++;
 				*retry_out = 1;
+				dirty_resource(ls, r);
 			} else {
 				act->result = rv;
 				list_del(&act->list);
@@ -2135,7 +2329,7 @@ r_free:
 	}
 	log_debug("S %s R %s res_process free", ls->name, r->name);
 	lm_rem_resource(ls, r);
-	list_del(&r->list);
+	rem_resource(ls, r);
 	free_resource(r);
 }
 
@@ -2238,7 +2432,7 @@ static int clear_locks(struct lockspace *ls, int free_vg, int drop_vg)
  r_free:
 		log_debug("S %s R %s free", ls->name, r->name);
 		lm_rem_resource(ls, r);
-		list_del(&r->list);
+		rem_resource(ls, r);
 		free_resource(r);
 	}
 
@@ -2257,21 +2451,13 @@ static struct resource *find_resource_act(struct lockspace *ls,
 					  int nocreate)
 {
 	struct resource *r;
+	char key[RES_KEY_LEN];
+	int len;
 
-	list_for_each_entry(r, &ls->resources, list) {
-		if (r->type != act->rt)
-			continue;
-
-		if (r->type == LD_RT_GL && act->rt == LD_RT_GL)
-			return r;
+	len = res_key(act->rt, act->lv_uuid, key);
 
-		if (r->type == LD_RT_VG && act->rt == LD_RT_VG)
-			return r;
-
-		if (r->type == LD_RT_LV && act->rt == LD_RT_LV &&
-		    !strcmp(r->name, act->lv_uuid))
-			return r;
-	}
+	if ((r = dm_hash_lookup_binary(ls->resource_hash, key, len)))
+		return r;
 
 	if (nocreate)
 		return NULL;
@@ -2293,7 +2479,7 @@ static struct resource *find_resource_act(struct lockspace *ls,
 		r->use_vb = 0;
 	}
 
-	list_add_tail(&r->list, &ls->resources);
+	add_resource(ls, r);
 
 	return r;
 }
@@ -2304,7 +2490,7 @@ static void free_ls_resources(struct lockspace *ls)
 
 	list_for_each_entry_safe(r, r_safe, &ls->resources, list) {
 		lm_rem_resource(ls, r);
-		list_del(&r->list);
+		rem_resource(ls, r);
 		free_resource(r);
 	}
 }
@@ -2371,6 +2557,7 @@ static void *lockspace_thread_main(void *arg_in)
 	struct action *add_act, *act, *safe;
 	struct action *act_op_free = NULL;
 	struct list_head tmp_act;
+	struct list_head tmp_res;
 	struct list_head act_close;
 	char tmp_name[MAX_NAME+5];
 	int free_vg = 0;
@@ -2404,11 +2591,24 @@ static void *lockspace_thread_main(void *arg_in)
 	log_debug("S %s lm_add_lockspace %s wait %d adopt %d",
 		  ls->name, lm_str(ls->lm_type), wait_flag, adopt_flag);
 
+	/*
+	 * Index the resources added before the thread started,
+	 * e.g. the vg resource and any adopted lv resources.
+	 */
+	if (!(ls->resource_hash = dm_hash_create(32))) {
+		log_error("S %s no memory for resource hash", ls->name);
+		error = -ENOMEM;
+	} else {
+		list_for_each_entry(r, &ls->resources, list)
+			index_resource(ls, r);
+	}
+
 	/*
 	 * The prepare step does not wait for anything and is quick;
 	 * it tells us if the parameters are valid and the lm is running.
 	 */
-	error = lm_prepare_lockspace(ls, add_act);
+	if (!error)
+		error = lm_prepare_lockspace(ls, add_act);
 
 	if (add_act && (!wait_flag || error)) {
 		/* send initial join result back to client */
@@ -2572,7 +2772,7 @@ static void *lockspace_thread_main(void *arg_in)
 			}
 
 			if (act->op == LD_OP_QUERY_LOCK) {
-				r = find_resource_act(ls, act, 0);
+				r = find_resource_act(ls, act, 1);
 				if (!r)
 					act->result = -ENOENT;
 				else {
@@ -2604,9 +2804,10 @@ static void *lockspace_thread_main(void *arg_in)
 
 			list_del(&act->list);
 
-			/* applies to all resources */
+			/* applies to the resources the client requested locks on */
 			if (act->op == LD_OP_CLOSE) {
 				list_add(&act->list, &act_close);
+				dirty_client_resources(ls, act->client_id);
 				continue;
 			}
 
@@ -2627,6 +2828,10 @@ static void *lockspace_thread_main(void *arg_in)
 			}
 
 			list_add_tail(&act->list, &r->actions);
+			dirty_resource(ls, r);
+
+			if (act->op == LD_OP_LOCK && act->mode != LD_LK_UN)
+				track_client_resource(ls, act->client_id, r);
 
 			log_debug("S %s R %s action %s %s", ls->name, r->name,
 				  op_str(act->op), mode_str(act->mode));
@@ -2635,13 +2840,25 @@ static void *lockspace_thread_main(void *arg_in)
 
 		/*
 		 * Process the lock operations that have been queued for each
-		 * resource.
+		 * resource.  Only resources given new actions, waiting to
+		 * retry, or requested by a client that has exited need
+		 * processing.
 		 */
 
 		retry = 0;
 
-		list_for_each_entry_safe(r, r2, &ls->resources, list)
+		/* res_process() puts a resource needing a retry back on the list. */
+		INIT_LIST_HEAD(&tmp_res);
+		list_for_each_entry_safe(r, r2, &ls->dirty_resources, dirty_list) {
+			list_del(&r->dirty_list);
+			list_add_tail(&r->dirty_list, &tmp_res);
+		}
+
+		list_for_each_entry_safe(r, r2, &tmp_res, dirty_list) {
+			list_del(&r->dirty_list);
+			r->dirty = 0;
 			res_process(ls, r, &act_close, &retry);
+		}
 
 		list_for_each_entry_safe(act, safe, &act_close, list) {
 			list_del(&act->list);
@@ -2705,6 +2922,15 @@ out_rem:
 	log_debug("S %s rem_lockspace done %d", ls->name, rv);
 
 out_act:
+	if (ls->resource_hash) {
+		dm_hash_destroy(ls->resource_hash);
+		ls->resource_hash = NULL;
+	}
+
+	pthread_mutex_lock(&ls->mutex);
+	free_client_hash(ls);
+	pthread_mutex_unlock(&ls->mutex);
+
 	/*
 	 * Move remaining actions to results; this will usually (always?)
 	 * be only the stop action.
@@ -2744,13 +2970,10 @@ out_act:
 		pthread_mutex_unlock(&lockspaces_mutex);
 	}
 
-	pthread_mutex_lock(&client_mutex);
 	list_for_each_entry_safe(act, safe, &tmp_act, list) {
 		list_del(&act->list);
-		list_add_tail(&act->list, &client_results);
+		queue_client_result(act);
 	}
-	pthread_cond_signal(&client_cond);
-	pthread_mutex_unlock(&client_mutex);
 
 	pthread_mutex_lock(&lockspaces_mutex);
 	ls->thread_done = 1;
@@ -3688,77 +3911,59 @@ static void close_worker_thread(void)
 }
 
 /* client_mutex is locked */
-static struct client *find_client_work(void)
+static struct client *find_client_id(uint32_t id)
 {
-	struct client *cl;
-
-	list_for_each_entry(cl, &client_list, list) {
-		if (cl->recv || cl->dead)
-			return cl;
-	}
-	return NULL;
+	return dm_hash_lookup_binary(client_hash, &id, sizeof(id));
 }
 
 /* client_mutex is locked */
-static struct client *find_client_id(uint32_t id)
+static int add_client(struct client *cl)
 {
-	struct client *cl;
+	if (!dm_hash_insert_binary(client_hash, &cl->id, sizeof(cl->id), cl))
+		return -ENOMEM;
 
-	list_for_each_entry(cl, &client_list, list) {
-		if (cl->id == id)
-			return cl;
-	}
-	return NULL;
+	list_add_tail(&cl->list, &client_list);
+	return 0;
 }
 
 /* client_mutex is locked */
-static struct client *find_client_pi(int pi)
+static void rem_client(struct client *cl)
 {
-	struct client *cl;
-
-	list_for_each_entry(cl, &client_list, list) {
-		if (cl->pi == pi)
-			return cl;
-	}
-	return NULL;
+	dm_hash_remove_binary(client_hash, &cl->id, sizeof(cl->id));
+	list_del(&cl->list);
 }
 
-/*
- * wake up poll() because we have added an fd
- * back into pollfd and poll() needs to be restarted
- * to recognize it.
- */
-static void restart_poll(void)
+/* client_mutex is locked, pass a client with recv or dead set to its thread */
+static void add_client_work(struct client *cl)
 {
-	int rv;
-	rv = write(restart_fds[1], "w", 1);
-	if (!rv || rv < 0)
-		log_debug("restart_poll write %d", errno);
+	struct client_thread *ct = client_thread_for_id(cl->id);
+
+	pthread_mutex_lock(&ct->mutex);
+	list_add_tail(&cl->work_list, &ct->work);
+	pthread_cond_signal(&ct->cond);
+	pthread_mutex_unlock(&ct->mutex);
 }
 
-/* poll will take requests from client again, cl->mutex must be held */
+/* epoll will take requests from client again, cl->mutex must be held */
 static void client_resume(struct client *cl)
 {
+	struct epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT };
+
 	if (cl->dead)
 		return;
 
-	if (!cl->poll_ignore || cl->fd == -1 || cl->pi == -1) {
+	if (!cl->poll_ignore || cl->fd == -1) {
 		/* shouldn't happen */
-		log_error("client_resume %u bad state ig %d fd %d pi %d",
-			  cl->id, cl->poll_ignore, cl->fd, cl->pi);
+		log_error("client_resume %u bad state ig %d fd %d",
+			  cl->id, cl->poll_ignore, cl->fd);
 		return;
 	}
 
-	pthread_mutex_lock(&pollfd_mutex);
-	if (pollfd[cl->pi].fd != POLL_FD_IGNORE) {
-		log_error("client_resume %u pi %d fd %d not IGNORE",
-			  cl->id, cl->pi, cl->fd);
-	}
-	pollfd[cl->pi].fd = cl->fd;
-	pollfd[cl->pi].events = POLLIN;
-	pthread_mutex_unlock(&pollfd_mutex);
+	ev.data.u64 = cl->id;
 
-	restart_poll();
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, cl->fd, &ev) < 0)
+		log_error("client_resume %u fd %d epoll error %d",
+			  cl->id, cl->fd, errno);
 }
 
 /* called from client_thread, cl->mutex is held */
@@ -3966,7 +4171,7 @@ static void client_purge(struct client *cl)
 		act->client_id = cl->id;
 
 		pthread_mutex_lock(&ls->mutex);
-		if (!ls->thread_stop) {
+		if (!ls->thread_stop && ls_has_client(ls, cl->id)) {
 			list_add_tail(&act->list, &ls->actions);
 			ls->thread_work = 1;
 			pthread_cond_signal(&ls->cond);
@@ -4381,13 +4586,13 @@ static int print_client(struct client *cl, const char *prefix, int pos, int len)
 			"info=%s "
 			"pid=%d "
 			"fd=%d "
-			"pi=%d "
+			"ct=%d "
 			"id=%u "
 			"name=%s\n",
 			prefix,
 			cl->pid,
 			cl->fd,
-			cl->pi,
+			(int)(cl->id % client_thread_count),
 			cl->id,
 			cl->name[0] ? cl->name : ".");
 }
@@ -4828,6 +5033,7 @@ out:
 
 static void *client_thread_main(void *arg_in)
 {
+	struct client_thread *ct = arg_in;
 	struct client *cl;
 	struct action *act;
 	struct action *act_un;
@@ -4835,22 +5041,26 @@ static void *client_thread_main(void *arg_in)
 	int rv;
 
 	while (1) {
-		pthread_mutex_lock(&client_mutex);
-		while (!client_work && list_empty(&client_results)) {
-			if (client_stop) {
-				pthread_mutex_unlock(&client_mutex);
+		pthread_mutex_lock(&ct->mutex);
+		while (list_empty(&ct->work) && list_empty(&ct->results)) {
+			if (ct->stop) {
+				pthread_mutex_unlock(&ct->mutex);
 				goto out;
 			}
-			pthread_cond_wait(&client_cond, &client_mutex);
+			pthread_cond_wait(&ct->cond, &ct->mutex);
 		}
 
 		/*
 		 * Send outgoing results back to clients
 		 */
 
-		if (!list_empty(&client_results)) {
-			act = list_first_entry(&client_results, struct action, list);
+		if (!list_empty(&ct->results)) {
+			act = list_first_entry(&ct->results, struct action, list);
 			list_del(&act->list);
+			pthread_mutex_unlock(&ct->mutex);
+
+			/* Only this thread frees the clients it handles. */
+			pthread_mutex_lock(&client_mutex);
 			cl = find_client_id(act->client_id);
 			pthread_mutex_unlock(&client_mutex);
 
@@ -4896,14 +5106,10 @@ static void *client_thread_main(void *arg_in)
 		 * Queue incoming actions for lockspace threads
 		 */
 
-		if (client_work) {
-			cl = find_client_work();
-			if (!cl)
-				client_work = 0;
-			pthread_mutex_unlock(&client_mutex);
-
-			if (!cl)
-				continue;
+		if (!list_empty(&ct->work)) {
+			cl = list_first_entry(&ct->work, struct client, work_list);
+			list_del(&cl->work_list);
+			pthread_mutex_unlock(&ct->mutex);
 
 			pthread_mutex_lock(&cl->mutex);
 
@@ -4914,45 +5120,42 @@ static void *client_thread_main(void *arg_in)
 
 			if (cl->dead) {
 				/*
-				log_debug("client rem %d pi %d fd %d ig %d",
-					  cl->id, cl->pi, cl->fd, cl->poll_ignore);
+				log_debug("client rem %d fd %d ig %d",
+					  cl->id, cl->fd, cl->poll_ignore);
 				*/
 
 				/*
 				 * If cl->dead was set in main_loop, then the
-				 * fd has already been closed and the pollfd
-				 * entry is already unused.
-				 * main_loop set dead=1, ignore=0, pi=-1, fd=-1
+				 * fd has already been closed, which removed
+				 * it from epoll.
+				 * main_loop set dead=1, ignore=0, fd=-1
 				 *
 				 * if cl->dead was not set in main_loop, but
-				 * set in client_recv_action, then the main_loop
-				 * should be ignoring this client fd.
+				 * set in client_recv_action, then epoll is
+				 * not reporting events for this client fd.
 				 * main_loop set ignore=1
 				 */
 
 				if (cl->poll_ignore) {
-					log_debug("client close %d pi %d fd %d",
-						  cl->id, cl->pi, cl->fd);
-					/* assert cl->pi != -1 */
-					/* assert pollfd[pi].fd == FD_IGNORE */
+					log_debug("client close %d fd %d",
+						  cl->id, cl->fd);
+					/* assert cl->fd != -1 */
 					if (close(cl->fd))
-						log_error("client close %d pi %d fd %d failed",
-							  cl->id, cl->pi, cl->fd);
-					rem_pollfd(cl->pi);
-					cl->pi = -1;
+						log_error("client close %d fd %d failed",
+							  cl->id, cl->fd);
 					cl->fd = -1;
 					cl->poll_ignore = 0;
 				} else {
 					/* main thread should have closed */
-					if (cl->pi != -1 || cl->fd != -1) {
-						log_error("client %d bad state pi %d fd %d",
-							  cl->id, cl->pi, cl->fd);
+					if (cl->fd != -1) {
+						log_error("client %d bad state fd %d",
+							  cl->id, cl->fd);
 					}
 				}
 				pthread_mutex_unlock(&cl->mutex);
 
 				pthread_mutex_lock(&client_mutex);
-				list_del(&cl->list);
+				rem_client(cl);
 				pthread_mutex_unlock(&client_mutex);
 
 				client_purge(cl);
@@ -4962,7 +5165,7 @@ static void *client_thread_main(void *arg_in)
 				pthread_mutex_unlock(&cl->mutex);
 			}
 		} else
-			pthread_mutex_unlock(&client_mutex);
+			pthread_mutex_unlock(&ct->mutex);
 	}
 out:
 	if (adopt_opt && lock_acquire_written)
@@ -4970,33 +5173,63 @@ out:
 	return NULL;
 }
 
-static int setup_client_thread(void)
+static int setup_client_threads(void)
 {
-	int rv;
+	struct client_thread *ct;
+	int i, rv;
 
 	INIT_LIST_HEAD(&client_list);
-	INIT_LIST_HEAD(&client_results);
 
 	pthread_mutex_init(&client_mutex, NULL);
-	pthread_cond_init(&client_cond, NULL);
+	pthread_mutex_init(&adopt_file_mutex, NULL);
 
-	rv = pthread_create(&client_thread, NULL, client_thread_main, NULL);
-	if (rv)
+	if (!(client_hash = dm_hash_create(64)))
+		return -ENOMEM;
+
+	if (!(client_threads = calloc(client_thread_count, sizeof(struct client_thread))))
+		return -ENOMEM;
+
+	for (i = 0; i < client_thread_count; i++) {
+		ct = &client_threads[i];
+
+		INIT_LIST_HEAD(&ct->work);
+		INIT_LIST_HEAD(&ct->results);
+		pthread_mutex_init(&ct->mutex, NULL);
+		pthread_cond_init(&ct->cond, NULL);
+
+		rv = pthread_create(&ct->thread, NULL, client_thread_main, ct);
+		if (rv) {
+			log_error("can't create client thread %d error %d", i, rv);
+			client_thread_count = i;
+			break;
+		}
+	}
+
+	if (!client_thread_count)
 		return -1;
+
+	log_debug("started %d client threads", client_thread_count);
 	return 0;
 }
 
-static void close_client_thread(void)
+static void close_client_threads(void)
 {
-	int perrno;
+	struct client_thread *ct;
+	int i, perrno;
 
-	pthread_mutex_lock(&client_mutex);
-	client_stop = 1;
-	pthread_cond_signal(&client_cond);
-	pthread_mutex_unlock(&client_mutex);
+	for (i = 0; i < client_thread_count; i++) {
+		ct = &client_threads[i];
 
-	if ((perrno = pthread_join(client_thread, NULL)))
-		log_error("pthread_join client_thread error %d", perrno);
+		pthread_mutex_lock(&ct->mutex);
+		ct->stop = 1;
+		pthread_cond_signal(&ct->cond);
+		pthread_mutex_unlock(&ct->mutex);
+	}
+
+	for (i = 0; i < client_thread_count; i++) {
+		if ((perrno = pthread_join(client_threads[i].thread, NULL)))
+			log_error("pthread_join client_thread %d error %d", i, perrno);
+	}
 }
 
 static char _dm_uuid[DM_UUID_LEN];
@@ -5759,83 +5992,83 @@ static int get_peer_pid(int fd)
 	return cred.pid;
 }
 
-static void process_listener(int poll_fd)
+static void process_listener(void)
 {
+	struct epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT };
 	struct client *cl;
-	int fd, pi;
-
-	/* assert poll_fd == listen_fd */
+	int fd, rv;
 
 	fd = accept(listen_fd, NULL, NULL);
 	if (fd < 0)
 		return;
 
 	if (!(cl = alloc_client())) {
-		if (!close(fd))
+		if (close(fd))
 			log_error("failed to close lockd poll fd");
 		return;
 	}
 
-	pi = add_pollfd(fd);
-	if (pi < 0) {
-		log_error("process_listener add_pollfd error %d", pi);
-		free_client(cl);
-		return;
-	}
-
-	cl->pi = pi;
 	cl->fd = fd;
 	cl->pid = get_peer_pid(fd);
 
 	pthread_mutex_init(&cl->mutex, NULL);
 
 	pthread_mutex_lock(&client_mutex);
-	client_ids++;
-
-	if (client_ids == INTERNAL_CLIENT_ID)
-		client_ids++;
-	if (!client_ids)
+	do {
 		client_ids++;
 
+		if (client_ids == INTERNAL_CLIENT_ID)
+			client_ids++;
+		if (!client_ids)
+			client_ids++;
+	} while (find_client_id(client_ids));
+
 	cl->id = client_ids;
-	list_add_tail(&cl->list, &client_list);
-	pthread_mutex_unlock(&client_mutex);
 
-	log_debug("new cl %u pi %d fd %d", cl->id, cl->pi, cl->fd);
-}
+	if ((rv = add_client(cl)) < 0) {
+		pthread_mutex_unlock(&client_mutex);
+		log_error("process_listener add_client error %d", rv);
+		goto fail;
+	}
 
-/*
- * main loop polls on pipe[0] so that a thread can
- * restart the poll by writing to pipe[1].
- */
-static int setup_restart(void)
-{
-	if (pipe(restart_fds)) {
-		log_error("setup_restart pipe error %d", errno);
-		return -1;
+	/* The client must be findable by id before its first event. */
+	ev.data.u64 = cl->id;
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		rv = -errno;
+		rem_client(cl);
+		pthread_mutex_unlock(&client_mutex);
+		log_error("process_listener epoll error %d", rv);
+		goto fail;
 	}
+	pthread_mutex_unlock(&client_mutex);
 
-	restart_pi = add_pollfd(restart_fds[0]);
-	if (restart_pi < 0)
-		return restart_pi;
+	log_debug("new cl %u fd %d", cl->id, cl->fd);
+	return;
 
-	return 0;
+fail:
+	if (close(fd))
+		log_error("failed to close lockd poll fd");
+	free_client(cl);
 }
 
-/*
- * thread wrote 'w' to restart_fds[1] to restart poll()
- * after adding an fd back into pollfd.
- */
-static void process_restart(int fd)
+static int setup_epoll(void)
 {
-	char wake[1];
-	int rv;
+	struct epoll_event ev = { .events = EPOLLIN };
+
+	if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		log_error("setup_epoll create error %d", errno);
+		return -1;
+	}
 
-	/* assert fd == restart_fds[0] */
+	ev.data.u64 = EPOLL_LISTEN_ID;
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+		log_error("setup_epoll listen fd %d error %d", listen_fd, errno);
+		return -1;
+	}
 
-	rv = read(restart_fds[0], wake, 1);
-	if (!rv || rv < 0)
-		log_debug("process_restart error %d", errno);
+	return 0;
 }
 
 static void sigterm_handler(int sig __attribute__((unused)))
@@ -5845,8 +6078,10 @@ static void sigterm_handler(int sig __attribute__((unused)))
 
 static int main_loop(daemon_state *ds_arg)
 {
+	struct epoll_event events[EPOLL_MAX_EVENTS];
 	struct client *cl;
-	int i, rv, is_recv, is_dead;
+	uint32_t id;
+	int i, rv, is_recv, is_dead, is_work;
 
 	signal(SIGTERM, &sigterm_handler);
 
@@ -5860,18 +6095,22 @@ static int main_loop(daemon_state *ds_arg)
 
 	INIT_LIST_HEAD(&lockspaces);
 	pthread_mutex_init(&lockspaces_mutex, NULL);
-	pthread_mutex_init(&pollfd_mutex, NULL);
 	pthread_mutex_init(&log_mutex, NULL);
 
 	openlog("lvmlockd", LOG_CONS | LOG_PID, LOG_DAEMON);
 	log_warn("lvmlockd started");
 
 	listen_fd = ds_arg->socket_fd;
-	listen_pi = add_pollfd(listen_fd);
 
-	setup_client_thread();
+	if (setup_epoll() < 0)
+		return -1;
+
+	if (setup_client_threads() < 0) {
+		log_error("Can't start client threads");
+		return -1;
+	}
+
 	setup_worker_thread();
-	setup_restart();
 
 #ifdef USE_SD_NOTIFY
 	sd_notify(0, "READY=1");
@@ -5885,7 +6124,7 @@ static int main_loop(daemon_state *ds_arg)
 		adopt_locks();
 
 	while (1) {
-		rv = poll(pollfd, pollfd_maxi + 1, -1);
+		rv = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, -1);
 		if ((rv == -1 && errno == EINTR) || daemon_quit) {
 			if (daemon_quit) {
 				int count;
@@ -5900,42 +6139,36 @@ static int main_loop(daemon_state *ds_arg)
 			continue;
 		}
 		if (rv < 0) {
-			log_error("poll errno %d", errno);
+			log_error("epoll_wait errno %d", errno);
 			break;
 		}
 
-		for (i = 0; i <= pollfd_maxi; i++) {
-			if (pollfd[i].fd < 0)
-				continue;
-
+		for (i = 0; i < rv; i++) {
 			is_recv = 0;
 			is_dead = 0;
+			is_work = 0;
 
-			if (pollfd[i].revents & POLLIN)
+			if (events[i].events & EPOLLIN)
 				is_recv = 1;
-			if (pollfd[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
 				is_dead = 1;
 
 			if (!is_recv && !is_dead)
 				continue;
 
-			if (i == listen_pi) {
-				process_listener(pollfd[i].fd);
+			if (events[i].data.u64 == EPOLL_LISTEN_ID) {
+				process_listener();
 				continue;
 			}
 
-			if (i == restart_pi) {
-				process_restart(pollfd[i].fd);
-				continue;
-			}
+			id = (uint32_t) events[i].data.u64;
 
 			/*
-			log_debug("poll pi %d fd %d revents %x",
-				  i, pollfd[i].fd, pollfd[i].revents);
+			log_debug("epoll cl %u events %x", id, events[i].events);
 			*/
 
 			pthread_mutex_lock(&client_mutex);
-			cl = find_client_pi(i);
+			cl = find_client_id(id);
 			if (cl) {
 				pthread_mutex_lock(&cl->mutex);
 
@@ -5951,52 +6184,42 @@ static int main_loop(daemon_state *ds_arg)
 					log_debug("close %s[%d] cl %u fd %d",
 						  cl->name[0] ? cl->name : "client",
 						  cl->pid, cl->id, cl->fd);
+					/* closing the fd removes it from epoll */
+					if (close(cl->fd))
+						log_error("close fd %d failed", cl->fd);
 					cl->dead = 1;
-					cl->pi = -1;
 					cl->fd = -1;
 					cl->poll_ignore = 0;
-					if (close(pollfd[i].fd))
-						log_error("close fd %d failed", pollfd[i].fd);
-					pollfd[i].fd = POLL_FD_UNUSED;
-					pollfd[i].events = 0;
-					pollfd[i].revents = 0;
+					is_work = 1;
 
 				} else if (is_recv) {
+					/* EPOLLONESHOT disabled the fd until client_resume */
 					cl->recv = 1;
 					cl->poll_ignore = 1;
-					pollfd[i].fd = POLL_FD_IGNORE;
-					pollfd[i].events = 0;
-					pollfd[i].revents = 0;
+					is_work = 1;
 				}
 
 				pthread_mutex_unlock(&cl->mutex);
 
-				client_work = 1;
-				pthread_cond_signal(&client_cond);
-
-				/* client_thread will pick up and work on any
-				   client with cl->recv or cl->dead set */
+				/* the client thread will pick up and work on
+				   the client with cl->recv or cl->dead set */
+				if (is_work)
+					add_client_work(cl);
 
 			} else {
-				/* don't think this can happen */
-				log_error("no client for index %d fd %d",
-					  i, pollfd[i].fd);
-				if (close(pollfd[i].fd))
-					log_error("close fd %d failed", pollfd[i].fd);
-				pollfd[i].fd = POLL_FD_UNUSED;
-				pollfd[i].events = 0;
-				pollfd[i].revents = 0;
+				/* an event from before the client was removed */
+				log_debug("no client %u for event %x",
+					  id, events[i].events);
 			}
 			pthread_mutex_unlock(&client_mutex);
-
-			/* After set_dead, should we scan pollfd for
-			   last unused slot and reduce pollfd_maxi? */
 		}
 	}
 
 	for_each_lockspace_retry(DO_STOP, DO_FREE, DO_FORCE);
 	close_worker_thread();
-	close_client_thread();
+	close_client_threads();
+	if (close(epoll_fd))
+		log_debug("close epoll fd error %d", errno);
 	closelog();
 	return 1; /* libdaemon uses 1 for success */
 }
@@ -6033,6 +6256,8 @@ static void usage(char *prog, FILE *file)
 	fprintf(file, "        Set the sanlock lockspace I/O timeout.\n");
 	fprintf(file, "  --adopt | -A 0|1\n");
 	fprintf(file, "        Adopt locks from a previous instance of lvmlockd.\n");
+	fprintf(file, "  --client-threads | -c <num>\n");
+	fprintf(file, "        Set the number of threads handling client requests. [%d]\n", DEFAULT_CLIENT_THREADS);
 }
 
 int main(int argc, char *argv[])
@@ -6063,6 +6288,7 @@ int main(int argc, char *argv[])
 		{"adopt",           required_argument, 0, 'A' },
 		{"syslog-priority", required_argument, 0, 'S' },
 		{"sanlock-timeout", required_argument, 0, 'o' },
+		{"client-threads",  required_argument, 0, 'c' },
 		{0, 0, 0, 0 }
 	};
 
@@ -6071,7 +6297,7 @@ int main(int argc, char *argv[])
 		int lm;
 		int option_index = 0;
 
-		c = getopt_long(argc, argv, "hVTfDp:s:l:g:S:I:A:o:",
+		c = getopt_long(argc, argv, "hVTfDp:s:l:g:S:I:A:o:c:",
 				long_options, &option_index);
 		if (c == -1)
 			break;
@@ -6127,6 +6353,14 @@ int main(int argc, char *argv[])
 		case 'A':
 			adopt_opt = atoi(optarg);
 			break;
+		case 'c':
+			client_thread_count = atoi(optarg);
+			if (client_thread_count < 1 || client_thread_count > MAX_CLIENT_THREADS) {
+				fprintf(stderr, "invalid client-threads option, use 1-%d\n",
+					MAX_CLIENT_THREADS);
+				exit(EXIT_FAILURE);
+			}
+			break;
 		case 'S':
 			syslog_priority = _syslog_name_to_num(optarg);
 			break;
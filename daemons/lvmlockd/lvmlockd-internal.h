@@ -81,10 +81,10 @@ struct list_head {
 
 struct client {
 	struct list_head list;
+	struct list_head work_list;	/* client_thread.work */
 	pthread_mutex_t mutex;
 	int pid;
 	int fd;
-	int pi;
 	uint32_t id;
 	unsigned int recv : 1;
 	unsigned int dead : 1;
@@ -144,6 +144,7 @@ struct action {
 
 struct resource {
 	struct list_head list;		/* lockspace.resources */
+	struct list_head dirty_list;	/* lockspace.dirty_resources */
 	char name[MAX_NAME+1];		/* vg name or lv name */
 	int8_t type;			/* resource type LD_RT_ */
 	int8_t mode;
@@ -155,6 +156,7 @@ struct resource {
 	unsigned int adopt : 1;		/* temp flag in remove_inactive_lvs */
 	unsigned int version_zero_valid : 1;
 	unsigned int use_vb : 1;
+	unsigned int dirty : 1;		/* on lockspace.dirty_resources */
 	struct list_head locks;
 	struct list_head actions;
 	char lv_args[MAX_ARGS+1];
@@ -199,9 +201,13 @@ struct lockspace {
 	unsigned int free_vg: 1;
 	unsigned int kill_vg: 1;
 	unsigned int drop_vg: 1;
+	unsigned int client_untracked: 1; /* client_hash is incomplete */
 
 	struct list_head actions;	/* new client actions */
 	struct list_head resources;	/* resource/lock state for gl/vg/lv */
+	struct list_head dirty_resources; /* resources with actions to process */
+	struct dm_hash_table *resource_hash; /* resources by type and name */
+	struct dm_hash_table *client_hash; /* resources requested by each client */
 };
 
 /* val_blk version */
@@ -21,6 +21,7 @@
 #include "tools/tool.h"
 
 #include "lvmpolld-cmd-utils.h"
+#include "lvmpolld-dm-utils.h"
 #include "daemons/lvmpolld/lvmpolld-protocol.h"
 
 #include <assert.h>
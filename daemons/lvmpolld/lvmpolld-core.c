@@ -46,10 +46,20 @@ struct lvmpolld_state {
 
 	struct lvmpolld_store *id_to_pdlv_abort;
 	struct lvmpolld_store *id_to_pdlv_poll;
+
+	/* polling engine */
+	pthread_t engine_tid;
+	pthread_mutex_t engine_lock;
+	pthread_cond_t engine_cond;
+	struct dm_list engine_pdlvs; /* LVs waiting for next status check */
+	unsigned engine_running:1;
+	unsigned engine_stop:1;
 };
 
 static pthread_key_t key;
 
+static void *_engine_thread(void *args);
+
 static const char *_strerror_r(int errnum, struct lvmpolld_thread_data *data)
 {
 #ifdef _GNU_SOURCE
@@ -115,9 +125,34 @@ static int _init(struct daemon_state *s)
 	if (ls->idle)
 		ls->idle->is_idle = 1;
 
+	dm_list_init(&ls->engine_pdlvs);
+
+	if (pthread_mutex_init(&ls->engine_lock, NULL) ||
+	    pthread_cond_init(&ls->engine_cond, NULL) ||
+	    pthread_create(&ls->engine_tid, NULL, _engine_thread, ls))
+		WARN(ls, "%s: %s", PD_LOG_PREFIX, "Failed to start polling engine, using lvm cmd for whole polling");
+	else
+		ls->engine_running = 1;
+
 	return 1;
 }
 
+static void _stop_engine(struct lvmpolld_state *ls)
+{
+	if (!ls->engine_running)
+		return;
+
+	pthread_mutex_lock(&ls->engine_lock);
+	ls->engine_stop = 1;
+	pthread_cond_signal(&ls->engine_cond);
+	pthread_mutex_unlock(&ls->engine_lock);
+
+	if (pthread_join(ls->engine_tid, NULL))
+		WARN(ls, "%s: %s", PD_LOG_PREFIX, "Failed to join polling engine thread");
+
+	ls->engine_running = 0;
+}
+
 static void _lvmpolld_stores_lock(struct lvmpolld_state *ls)
 {
 	pdst_lock(ls->id_to_pdlv_poll);
@@ -154,6 +189,10 @@ static int _fini(struct daemon_state *s)
 
 	DEBUGLOG(s, "fini");
 
+	DEBUGLOG(s, "stopping polling engine");
+
+	_stop_engine(ls);
+
 	DEBUGLOG(s, "sending cancel requests");
 
 	_lvmpolld_global_lock(ls);
@@ -185,6 +224,9 @@ static int _fini(struct daemon_state *s)
 
 	pthread_key_delete(key);
 
+	pthread_cond_destroy(&ls->engine_cond);
+	pthread_mutex_destroy(&ls->engine_lock);
+
 	return 1;
 }
 
@@ -609,6 +651,139 @@ static int spawn_detached_thread(struct lvmpolld_lv *pdlv)
 	return !r;
 }
 
+/*
+ * Polling engine
+ *
+ * Instead of running an lvm command for the whole duration of polling,
+ * a single thread checks device-mapper status of all polled LVs at
+ * their polling interval.  The lvm command is spawned only once the
+ * operation has finished in kernel (to update metadata), or whenever
+ * the progress can't be judged from status alone.
+ */
+
+/* Hand pdlv over to lvm cmd, no engine lock may be held */
+static void _engine_release(struct lvmpolld_lv *pdlv)
+{
+	struct lvmpolld_state *ls = pdlv->ls;
+	int failed = 0;
+
+	pdst_lock(pdlv->pdst);
+
+	pdlv->engine = 0;
+
+	if (!spawn_detached_thread(pdlv)) {
+		ERROR(ls, "%s: %s %s", PD_LOG_PREFIX,
+		      "failed to spawn detached monitoring thread for", pdlv->lvname);
+		pdlv_set_error(pdlv, 1);
+		pdlv_set_polling_finished(pdlv, 1);
+		pdst_locked_dec(pdlv->pdst);
+		failed = 1;
+	}
+
+	pdst_unlock(pdlv->pdst);
+
+	/* pdlv must not be dereferenced from now on */
+
+	if (failed)
+		update_idle_state(ls);
+}
+
+/* Drop pdlv from engine on shutdown, no engine lock may be held */
+static void _engine_abandon(struct lvmpolld_lv *pdlv)
+{
+	pdst_lock(pdlv->pdst);
+
+	pdlv->engine = 0;
+	pdlv_set_error(pdlv, 1);
+	pdlv_set_polling_finished(pdlv, 1);
+	pdst_locked_dec(pdlv->pdst);
+
+	pdst_unlock(pdlv->pdst);
+}
+
+static void *_engine_thread(void *args)
+{
+	struct lvmpolld_state *ls = (struct lvmpolld_state *) args;
+	struct lvmpolld_lv *pdlv, *tmp;
+	struct dm_list due;
+	struct timespec ts = { 0 };
+	enum pdlv_dm_progress progress;
+	time_t now, next;
+
+	dm_list_init(&due);
+
+	pthread_mutex_lock(&ls->engine_lock);
+
+	while (!ls->engine_stop) {
+		now = time(NULL);
+		next = now + MIN_POLLING_TIMEOUT;
+
+		dm_list_iterate_items_gen_safe(pdlv, tmp, &ls->engine_pdlvs, engine_list)
+			if (pdlv->next_check <= now)
+				dm_list_move(&due, &pdlv->engine_list);
+			else if (pdlv->next_check < next)
+				next = pdlv->next_check;
+
+		if (dm_list_empty(&due)) {
+			ts.tv_sec = next;
+			pthread_cond_timedwait(&ls->engine_cond, &ls->engine_lock, &ts);
+			continue;
+		}
+
+		pthread_mutex_unlock(&ls->engine_lock);
+
+		dm_list_iterate_items_gen_safe(pdlv, tmp, &due, engine_list) {
+			dm_list_del(&pdlv->engine_list);
+
+			progress = pdlv_dm_check_progress(pdlv);
+
+			if (progress == PDLV_DM_IN_PROGRESS) {
+				DEBUGLOG(ls, "%s: %s %s", PD_LOG_PREFIX,
+					 "kernel still in progress for", pdlv->lvname);
+				pdlv->next_check = now + pdlv->interval;
+				pthread_mutex_lock(&ls->engine_lock);
+				dm_list_add(&ls->engine_pdlvs, &pdlv->engine_list);
+				pthread_mutex_unlock(&ls->engine_lock);
+				continue;
+			}
+
+			INFO(ls, "%s: %s %s", PD_LOG_PREFIX,
+			     (progress == PDLV_DM_FINISHED) ? "kernel finished, running lvm cmd for" :
+			     "unknown kernel progress, running lvm cmd for", pdlv->lvname);
+			_engine_release(pdlv);
+		}
+
+		pthread_mutex_lock(&ls->engine_lock);
+	}
+
+	dm_list_splice(&due, &ls->engine_pdlvs);
+
+	pthread_mutex_unlock(&ls->engine_lock);
+
+	dm_list_iterate_items_gen_safe(pdlv, tmp, &due, engine_list) {
+		dm_list_del(&pdlv->engine_list);
+		_engine_abandon(pdlv);
+	}
+
+	update_idle_state(ls);
+
+	return NULL;
+}
+
+/* only call with appropriate struct lvmpolld_store lock held */
+static void _engine_locked_add(struct lvmpolld_state *ls, struct lvmpolld_lv *pdlv,
+			       unsigned uinterval)
+{
+	pdlv->interval = uinterval ?: 1;
+	pdlv->next_check = 0; /* check right away */
+	pdlv->engine = 1;
+
+	pthread_mutex_lock(&ls->engine_lock);
+	dm_list_add(&ls->engine_pdlvs, &pdlv->engine_list);
+	pthread_cond_signal(&ls->engine_cond);
+	pthread_mutex_unlock(&ls->engine_lock);
+}
+
 static response poll_init(client_handle h, struct lvmpolld_state *ls, request req, enum poll_type type)
 {
 	char *id;
@@ -693,7 +868,9 @@ static response poll_init(client_handle h, struct lvmpolld_state *ls, request re
 			free(id);
 			return reply(LVMPD_RESP_FAILED, REASON_ENOMEM);
 		}
-		if (!spawn_detached_thread(pdlv)) {
+		if (ls->engine_running && !abort_polling && type != MERGE_THIN)
+			_engine_locked_add(ls, pdlv, uinterval);
+		else if (!spawn_detached_thread(pdlv)) {
 			ERROR(ls, "%s: %s", PD_LOG_PREFIX, "failed to spawn detached monitoring thread");
 			pdst_locked_remove(pdst, id);
 			pdlv_destroy(pdlv);
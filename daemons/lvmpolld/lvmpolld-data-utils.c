@@ -272,6 +272,8 @@ static void _pdlv_locked_dump(struct buffer *buff, const struct lvmpolld_lv *pdl
 		buffer_append(buff, tmp);
 	if (dm_snprintf(tmp, sizeof(tmp), "\t\tinit_requests_count=%d\n", pdlv->init_rq_count) > 0)
 		buffer_append(buff, tmp);
+	if (dm_snprintf(tmp, sizeof(tmp), "\t\tpolled_by_engine=%d\n", pdlv->engine) > 0)
+		buffer_append(buff, tmp);
 
 	/* lvm_commmand-section { */
 	buffer_append(buff, "\t\tlvm_command {\n");
@@ -306,7 +308,7 @@ void pdst_locked_send_cancel(const struct lvmpolld_store *pdst)
 
 	dm_hash_iterate(n, pdst->store) {
 		pdlv = dm_hash_get_data(pdst->store, n);
-		if (!pdlv_locked_polling_finished(pdlv))
+		if (!pdlv_locked_polling_finished(pdlv) && !pdlv->engine)
 			pthread_cancel(pdlv->tid);
 	}
 }
@@ -61,6 +61,11 @@ struct lvmpolld_lv {
 	pid_t cmd_pid;
 	pthread_t tid;
 
+	/* only used by polling engine */
+	struct dm_list engine_list;
+	time_t next_check;
+	unsigned interval; /* in seconds */
+
 	pthread_mutex_t lock;
 
 	/* block of shared variables protected by lock */
@@ -68,6 +73,7 @@ struct lvmpolld_lv {
 	unsigned init_rq_count; /* for debuging purposes only */
 	unsigned polling_finished:1; /* no more updates */
 	unsigned error:1; /* unrecoverable error occured in lvmpolld */
+	unsigned engine:1; /* polled by engine, no lvm cmd running yet */
 };
 
 typedef void (*lvmpolld_parse_output_fn_t) (struct lvmpolld_lv *pdlv, const char *line);
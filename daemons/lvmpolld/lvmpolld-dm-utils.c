@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU Lesser General Public License v.2.1.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "lvmpolld-common.h"
+
+#include "device_mapper/misc/dm-ioctl.h"
+#include "lib/misc/lvm-string.h"
+
+/*
+ * Read progress of polled LV from its device-mapper table status.
+ *
+ * Every mirror (pvmove, mirror convert), raid (raid convert) and
+ * snapshot-merge (merge) target of the device has to be in sync.
+ * Anything lvmpolld can't judge on its own (missing device, thin merge,
+ * failed merge, unknown targets) is reported as PDLV_DM_UNKNOWN and left
+ * for the lvm command.
+ */
+enum pdlv_dm_progress pdlv_dm_check_progress(const struct lvmpolld_lv *pdlv)
+{
+	char uuid[DM_UUID_LEN];
+	struct dm_task *dmt;
+	struct dm_info info;
+	struct dm_pool *mem = NULL;
+	struct dm_status_mirror *ms;
+	struct dm_status_raid *rs;
+	struct dm_status_snapshot *ss;
+	uint64_t start, length;
+	char *type = NULL;
+	char *params = NULL;
+	void *next = NULL;
+	int known = 0, in_progress = 0, failed = 0;
+	enum pdlv_dm_progress r = PDLV_DM_UNKNOWN;
+
+	if (pdlv->type == MERGE_THIN)
+		return r;
+
+	if (dm_snprintf(uuid, sizeof(uuid), UUID_PREFIX "%s", pdlv->lvid) < 0)
+		return r;
+
+	if (!(dmt = dm_task_create(DM_DEVICE_STATUS)))
+		return r;
+
+	if (!dm_task_set_uuid(dmt, uuid) ||
+	    !dm_task_no_open_count(dmt) ||
+	    !dm_task_run(dmt) ||
+	    !dm_task_get_info(dmt, &info) ||
+	    !info.exists)
+		goto out;
+
+	if (!(mem = dm_pool_create("lvmpolld_status", 1024)))
+		goto out;
+
+	do {
+		next = dm_get_next_target(dmt, next, &start, &length, &type, &params);
+		if (!type || !params)
+			continue;
+
+		if (!strcmp(type, "mirror")) {
+			if (!dm_get_status_mirror(mem, params, &ms))
+				failed = 1;
+			else if (ms->insync_regions < ms->total_regions)
+				in_progress = 1;
+		} else if (!strcmp(type, "raid")) {
+			if (!dm_get_status_raid(mem, params, &rs))
+				failed = 1;
+			else if ((rs->insync_regions < rs->total_regions) ||
+				 (rs->sync_action && strcmp(rs->sync_action, "idle")))
+				in_progress = 1;
+		} else if (!strcmp(type, "snapshot-merge")) {
+			if (!dm_get_status_snapshot(mem, params, &ss) ||
+			    ss->invalid || ss->merge_failed)
+				failed = 1;
+			else if (ss->used_sectors != ss->metadata_sectors)
+				in_progress = 1;
+		} else
+			continue;
+
+		known = 1;
+	} while (next);
+
+	if (known && !failed)
+		r = in_progress ? PDLV_DM_IN_PROGRESS : PDLV_DM_FINISHED;
+out:
+	if (mem)
+		dm_pool_destroy(mem);
+	dm_task_destroy(dmt);
+
+	return r;
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU Lesser General Public License v.2.1.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _LVM_LVMPOLLD_DM_UTILS_H
+#define _LVM_LVMPOLLD_DM_UTILS_H
+
+#include "lvmpolld-data-utils.h"
+
+enum pdlv_dm_progress {
+	PDLV_DM_UNKNOWN = 0,	/* lvm command has to find out */
+	PDLV_DM_IN_PROGRESS,
+	PDLV_DM_FINISHED
+};
+
+enum pdlv_dm_progress pdlv_dm_check_progress(const struct lvmpolld_lv *pdlv);
+
+#endif /* _LVM_LVMPOLLD_DM_UTILS_H */
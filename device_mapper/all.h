@@ -211,6 +211,30 @@ const char *dm_task_get_message_response(struct dm_task *dmt);
 const char *dm_task_get_name(const struct dm_task *dmt);
 struct dm_names *dm_task_get_names(struct dm_task *dmt);
 
+/*
+ * Device listed by DM_DEVICE_LIST task.
+ */
+struct dm_active_device {
+	struct dm_list list;
+	dev_t devno;
+	const char *name;	/* device name */
+	uint32_t event_nr;	/* valid with DM_DEVICE_LIST_HAS_EVENT_NR */
+	const char *uuid;	/* valid with DM_DEVICE_LIST_HAS_UUID, NULL if device has none */
+};
+
+#define DM_DEVICE_LIST_HAS_EVENT_NR	0x00000001
+#define DM_DEVICE_LIST_HAS_UUID		0x00000002
+
+/*
+ * Return list of dm_active_device from the DM_DEVICE_LIST task
+ * that has been run. 'devs_features' tells which members are valid
+ * as older kernels do not return event numbers and uuids.
+ * Free the list with dm_device_list_destroy().
+ */
+int dm_task_get_device_list(struct dm_task *dmt, struct dm_list **devs_list,
+			    unsigned *devs_features);
+void dm_device_list_destroy(struct dm_list **devs_list);
+
 int dm_task_set_ro(struct dm_task *dmt);
 int dm_task_set_newname(struct dm_task *dmt, const char *newname);
 int dm_task_set_newuuid(struct dm_task *dmt, const char *newuuid);
@@ -1861,6 +1885,22 @@ int dm_report_object(struct dm_report *rh, void *object);
  */
 int dm_report_object_is_selected(struct dm_report *rh, void *object, int do_output, int *selected);
 
+/*
+ * Check selection for an object before all its data is gathered.
+ * Only fields used in selection are evaluated and fields of any type
+ * in 'lazy_types' are skipped. 'selected' is set to 0 only if the
+ * object can not pass the selection whatever the skipped fields are,
+ * otherwise it is set to 1 and the object is reported as usual with
+ * dm_report_object once the rest of its data is available.
+ * The values of the evaluated fields are reused by that next
+ * dm_report_object or dm_report_object_is_selected call, which must
+ * be for the same object. If the object is not reported after all,
+ * call dm_report_object_preselect_discard instead.
+ */
+int dm_report_object_preselect(struct dm_report *rh, void *object,
+			       uint32_t lazy_types, int *selected);
+void dm_report_object_preselect_discard(struct dm_report *rh);
+
 /*
  * Compact report output so that if field value is empty for all rows in
  * the report, drop the field from output completely (including headers).
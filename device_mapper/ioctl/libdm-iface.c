@@ -755,6 +755,104 @@ struct dm_names *dm_task_get_names(struct dm_task *dmt)
 				    dmt->dmi.v4->data_start);
 }
 
+static unsigned _device_list_features(void)
+{
+	unsigned features = 0;
+
+	if (dm_check_version() && _dm_version >= 4) {
+		if (_dm_version_minor >= 37)
+			features |= DM_DEVICE_LIST_HAS_EVENT_NR;
+		if (_dm_version_minor >= 46)
+			features |= DM_DEVICE_LIST_HAS_UUID;
+	}
+
+	return features;
+}
+
+int dm_task_get_device_list(struct dm_task *dmt, struct dm_list **devs_list,
+			    unsigned *devs_features)
+{
+	struct dm_names *names, *n;
+	struct dm_active_device *dev;
+	struct dm_list *devs;
+	const uint32_t *event_nr;
+	const char *uuid;
+	unsigned features = _device_list_features();
+	unsigned next = 0;
+	size_t size = sizeof(*devs);
+	char *str;
+
+	*devs_list = NULL;
+	*devs_features = features;
+
+	if (dmt->type != DM_DEVICE_LIST) {
+		log_error(INTERNAL_ERROR "dm_task_get_device_list called for wrong task.");
+		return 0;
+	}
+
+	n = names = dm_task_get_names(dmt);
+
+	/* Count the memory for the list and its strings with alignment */
+	if (names->dev)
+		do {
+			n = (struct dm_names *)((char *) n + next);
+			size += sizeof(*dev) + strlen(n->name) + 1 + 8;
+			if (features & DM_DEVICE_LIST_HAS_UUID) {
+				event_nr = (const uint32_t *) _align(n->name + strlen(n->name) + 1, 8);
+				if (event_nr[1] & DM_NAME_LIST_FLAG_HAS_UUID)
+					size += strlen((const char *)(event_nr + 2)) + 1;
+			}
+			next = n->next;
+		} while (next);
+
+	if (!(devs = malloc(size))) {
+		log_error("Failed to allocate device list.");
+		return 0;
+	}
+
+	dm_list_init(devs);
+
+	if (names->dev) {
+		dev = (struct dm_active_device *)(devs + 1);
+		n = names;
+		next = 0;
+		do {
+			n = (struct dm_names *)((char *) n + next);
+			str = (char *)(dev + 1);
+
+			dev->devno = (dev_t) n->dev;
+			dev->name = strcpy(str, n->name);
+			str += strlen(n->name) + 1;
+			dev->event_nr = 0;
+			dev->uuid = NULL;
+
+			event_nr = (const uint32_t *) _align(n->name + strlen(n->name) + 1, 8);
+			if (features & DM_DEVICE_LIST_HAS_EVENT_NR)
+				dev->event_nr = event_nr[0];
+			if ((features & DM_DEVICE_LIST_HAS_UUID) &&
+			    (event_nr[1] & DM_NAME_LIST_FLAG_HAS_UUID)) {
+				uuid = (const char *)(event_nr + 2);
+				dev->uuid = strcpy(str, uuid);
+				str += strlen(uuid) + 1;
+			}
+
+			dm_list_add(devs, &dev->list);
+			dev = (struct dm_active_device *) _align(str, 8);
+			next = n->next;
+		} while (next);
+	}
+
+	*devs_list = devs;
+
+	return 1;
+}
+
+void dm_device_list_destroy(struct dm_list **devs_list)
+{
+	free(*devs_list);
+	*devs_list = NULL;
+}
+
 struct dm_versions *dm_task_get_versions(struct dm_task *dmt)
 {
 	return (struct dm_versions *) (((char *) dmt->dmi.v4) +
@@ -1273,6 +1371,9 @@ static struct dm_ioctl *_flatten(struct dm_task *dmt, unsigned repeat_count)
 		}
 		dmi->flags |= DM_UUID_FLAG;
 	}
+	/* List uuids of devices too */
+	if ((dmt->type == DM_DEVICE_LIST) && (_dm_version_minor >= 46))
+		dmi->flags |= DM_UUID_FLAG;
 
 	dmi->target_count = count;
 	dmi->event_nr = dmt->event_nr;
@@ -53,6 +53,15 @@ struct parser {
 	int no_dup_node_check;	/* whether to disable dup node checking */
 	const char *key;        /* last obtained key */
 	unsigned ignored_creation_time;
+
+	/*
+	 * Index of (parent, key) -> node, built on demand while parsing
+	 * with duplicate node checking, so each new section is found or
+	 * created without walking all of its siblings.
+	 */
+	struct dm_hash_table *index;
+	char *index_key;	/* scratch buffer for index keys */
+	size_t index_key_size;
 };
 
 struct config_output {
@@ -76,6 +85,9 @@ static char *_dup_token(struct dm_pool *mem, const char *b, const char *e);
 
 static const int _sep = '/';
 
+/* Rough estimate of input bytes per config node, used to size the index */
+#define INDEX_BYTES_PER_NODE 32
+
 #define MAX_INDENT 32
 
 #define match(t) do {\
@@ -189,7 +201,13 @@ static int _do_dm_config_parse(struct dm_config_tree *cft, const char *start, co
 	p->no_dup_node_check = no_dup_node_check;
 
 	_get_token(p, TOK_SECTION_E);
-	if (!(cft->root = _file(p)))
+	cft->root = _file(p);
+
+	if (p->index)
+		dm_hash_destroy(p->index);
+	free(p->index_key);
+
+	if (!cft->root)
 		return_0;
 
 	cft->root = _config_reverse(cft->root);
@@ -520,16 +538,85 @@ static struct dm_config_node *_make_node(struct dm_pool *mem,
 	return n;
 }
 
-/* when mem is not NULL, we create the path if it doesn't exist yet */
+/*
+ * Build the index key for 'parent' and the key segment [b, e) in the
+ * parser's scratch buffer.  Returns the key length or 0 on failure.
+ */
+static size_t _index_key(struct parser *p, const struct dm_config_node *parent,
+			 const char *b, const char *e)
+{
+	size_t len = sizeof(parent) + (e - b);
+	char *buf;
+
+	if (len > p->index_key_size) {
+		if (!(buf = realloc(p->index_key, len * 2))) {
+			log_error("Failed to allocate config index key.");
+			return 0;
+		}
+		p->index_key = buf;
+		p->index_key_size = len * 2;
+	}
+
+	memcpy(p->index_key, &parent, sizeof(parent));
+	memcpy(p->index_key + sizeof(parent), b, e - b);
+
+	return len;
+}
+
+static int _index_lookup(struct parser *p, const struct dm_config_node *parent,
+			 const char *b, const char *e,
+			 struct dm_config_node **cn_found)
+{
+	size_t len;
+
+	if (!p->index &&
+	    !(p->index = dm_hash_create((p->fe - p->fb) / INDEX_BYTES_PER_NODE))) {
+		log_error("Failed to allocate config index.");
+		return 0;
+	}
+
+	if (!(len = _index_key(p, parent, b, e)))
+		return_0;
+
+	*cn_found = dm_hash_lookup_binary(p->index, p->index_key, len);
+
+	return 1;
+}
+
+static int _index_insert(struct parser *p, struct dm_config_node *cn,
+			 const char *b, const char *e)
+{
+	size_t len;
+
+	if (!(len = _index_key(p, cn->parent, b, e)))
+		return_0;
+
+	if (!dm_hash_insert_binary(p->index, p->index_key, len, cn)) {
+		log_error("Failed to insert config node %s into index.", cn->key);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * When mem is not NULL, we create the path if it doesn't exist yet.
+ * When p is not NULL, nodes are created in p->mem and siblings are
+ * found through the parser's index instead of being walked.
+ */
 static struct dm_config_node *_find_or_make_node(struct dm_pool *mem,
 						 struct dm_config_node *parent,
 						 const char *path,
-						 int no_dup_node_check)
+						 int no_dup_node_check,
+						 struct parser *p)
 {
 	const char *e;
 	struct dm_config_node *cn = parent ? parent->child : NULL;
 	struct dm_config_node *cn_found = NULL;
 
+	if (p)
+		mem = p->mem;
+
 	while (cn || mem) {
 		/* trim any leading slashes */
 		while (*path && (*path == _sep))
@@ -541,7 +628,16 @@ static struct dm_config_node *_find_or_make_node(struct dm_pool *mem,
 		/* hunt for the node */
 		cn_found = NULL;
 
-		if (!no_dup_node_check) {
+		if (no_dup_node_check)
+			;
+		else if (p) {
+			/*
+			 * The parser always merges sections with the same key,
+			 * so the index holds the only node with this key.
+			 */
+			if (!_index_lookup(p, parent, path, e, &cn_found))
+				return_NULL;
+		} else {
 			while (cn) {
 				if (_tok_match(cn->key, path, e)) {
 					/* Inefficient */
@@ -560,6 +656,9 @@ static struct dm_config_node *_find_or_make_node(struct dm_pool *mem,
 		if (!cn_found && mem) {
 			if (!(cn_found = _make_node(mem, path, e, parent)))
 				return_NULL;
+			if (p && !no_dup_node_check &&
+			    !_index_insert(p, cn_found, path, e))
+				return_NULL;
 		}
 
 		if (cn_found && *e) {
@@ -605,7 +704,7 @@ static struct dm_config_node *_section(struct parser *p, struct dm_config_node *
 		return NULL;
 	}
 
-	if (!(root = _find_or_make_node(p->mem, parent, str, p->no_dup_node_check)))
+	if (!(root = _find_or_make_node(NULL, parent, str, p->no_dup_node_check, p)))
 		return_NULL;
 
 	if (p->t == TOK_SECTION_B) {
@@ -949,7 +1048,7 @@ typedef const struct dm_config_node *node_lookup_fn(const void *start, const cha
 
 static const struct dm_config_node *_find_config_node(const void *start, const char *path) {
 	struct dm_config_node dummy = { .child = (void *) start };
-	return _find_or_make_node(NULL, &dummy, path, 0);
+	return _find_or_make_node(NULL, &dummy, path, 0, NULL);
 }
 
 static const struct dm_config_node *_find_first_config_node(const void *start, const char *path)
@@ -1432,7 +1531,7 @@ static int _override_path(const char *path, struct dm_config_node *node, void *b
 	struct dm_config_tree *cft = baton;
 	struct dm_config_node dummy, *target;
 	dummy.child = cft->root;
-	if (!(target = _find_or_make_node(cft->mem, &dummy, path, 0)))
+	if (!(target = _find_or_make_node(cft->mem, &dummy, path, 0, NULL)))
 		return_0;
 	if (!(target->v = _clone_config_value(cft->mem, node->v)))
 		return_0;
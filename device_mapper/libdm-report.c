@@ -78,6 +78,10 @@ struct dm_report {
 	struct dm_hash_table *value_cache;
 
 	struct report_group_item *group_item;
+
+	/* Row with the fields evaluated by dm_report_object_preselect() */
+	struct row *preselected_row;
+	uint32_t preselected_lazy_types;
 };
 
 struct dm_report_group {
@@ -110,6 +114,7 @@ struct report_group_item {
 #define FLD_DESCENDING	0x00008000
 #define FLD_COMPACTED	0x00010000
 #define FLD_COMPACT_ONE 0x00020000
+#define FLD_SELECTION	0x00040000
 
 struct field_properties {
 	struct dm_list list;
@@ -1872,15 +1877,31 @@ static int _compare_selection_field(struct dm_report *rh,
 	return r;
 }
 
+/*
+ * Fields of any type in 'lazy_types' are not evaluated yet
+ * and selection items using them are considered unknown.
+ */
+static int _is_lazy_field(struct dm_report *rh, struct field_properties *fp,
+			  uint32_t lazy_types)
+{
+	return lazy_types && (fp->implicit || (rh->fields[fp->field_num].type & lazy_types));
+}
+
+/*
+ * Returns 1 if selected, 0 if not selected and -1 if the result
+ * depends on lazy fields which are not evaluated.
+ */
 static int _check_selection(struct dm_report *rh, struct selection_node *sn,
-			    struct dm_list *fields)
+			    struct dm_list *fields, uint32_t lazy_types)
 {
-	int r;
+	int r, r1;
 	struct selection_node *iter_n;
 	struct dm_report_field *f;
 
 	switch (sn->type & SEL_MASK) {
 		case SEL_ITEM:
+			if (_is_lazy_field(rh, sn->selection.item->fp, lazy_types))
+				return -1;
 			r = 1;
 			dm_list_iterate_items(f, fields) {
 				if (sn->selection.item->fp != f->props)
@@ -1891,21 +1912,34 @@ static int _check_selection(struct dm_report *rh, struct selection_node *sn,
 			break;
 		case SEL_OR:
 			r = 0;
-			dm_list_iterate_items(iter_n, &sn->selection.set)
-				if ((r |= _check_selection(rh, iter_n, fields)))
+			dm_list_iterate_items(iter_n, &sn->selection.set) {
+				if ((r1 = _check_selection(rh, iter_n, fields, lazy_types)) > 0) {
+					r = 1;
 					break;
+				}
+				if (r1 < 0)
+					r = -1;
+			}
 			break;
 		case SEL_AND:
 			r = 1;
-			dm_list_iterate_items(iter_n, &sn->selection.set)
-				if (!(r &= _check_selection(rh, iter_n, fields)))
+			dm_list_iterate_items(iter_n, &sn->selection.set) {
+				if (!(r1 = _check_selection(rh, iter_n, fields, lazy_types))) {
+					r = 0;
 					break;
+				}
+				if (r1 < 0)
+					r = -1;
+			}
 			break;
 		default:
 			log_error("Unsupported selection type");
 			return 0;
 	}
 
+	if (r < 0)
+		return r;
+
 	return (sn->type & SEL_MODIFIER_NOT) ? !r : r;
 }
 
@@ -1914,40 +1948,81 @@ static int _check_report_selection(struct dm_report *rh, struct dm_list *fields)
 	if (!rh->selection || !rh->selection->selection_root)
 		return 1;
 
-	return _check_selection(rh, rh->selection->selection_root, fields);
+	return _check_selection(rh, rh->selection->selection_root, fields, 0);
 }
 
-static int _do_report_object(struct dm_report *rh, void *object, int do_output, int *selected)
+/*
+ * Fields used in selection are evaluated before the others
+ * so that rows which do not pass are dropped without evaluating
+ * the rest of their fields.
+ */
+static int _is_selection_field(struct dm_report *rh, struct field_properties *fp)
+{
+	return !rh->selection || !rh->selection->selection_root ||
+		fp->implicit || (fp->flags & FLD_SELECTION);
+}
+
+static struct dm_report_field *_alloc_report_field(struct dm_report *rh, struct row *row,
+						   struct field_properties *fp)
 {
-	const struct dm_report_field_type *fields;
-	struct field_properties *fp;
-	struct row *row = NULL;
 	struct dm_report_field *field;
-	void *data = NULL;
-	int r = 0;
 
-	if (!rh) {
-		log_error(INTERNAL_ERROR "_do_report_object: dm_report handler is NULL.");
+	if (!(field = dm_pool_zalloc(rh->mem, sizeof(*field)))) {
+		log_error("_do_report_object: "
+			  "struct dm_report_field allocation failed");
+		return NULL;
+	}
+
+	field->props = fp;
+	dm_list_add(&row->fields, &field->list);
+
+	return field;
+}
+
+static int _do_report_field(struct dm_report *rh, struct row *row,
+			    struct dm_report_field *field, void *object)
+{
+	struct field_properties *fp = field->props;
+	const struct dm_report_field_type *fields = fp->implicit ? _implicit_report_fields
+								 : rh->fields;
+	void *data;
+
+	data = fp->implicit ? _report_get_implicit_field_data(rh, fp, row)
+			    : _report_get_field_data(rh, fp, object);
+	if (!data) {
+		log_error("_do_report_object: "
+			  "no data assigned to field %s",
+			  fields[fp->field_num].id);
 		return 0;
 	}
 
-	if (!do_output && !selected) {
-		log_error(INTERNAL_ERROR "_do_report_object: output not requested and "
-					 "selected output variable is NULL too.");
+	if (!fields[fp->field_num].report_fn(rh, rh->mem,
+						 field, data,
+						 rh->private)) {
+		log_error("_do_report_object: "
+			  "report function failed for field %s",
+			  fields[fp->field_num].id);
 		return 0;
 	}
 
-	if (rh->flags & RH_ALREADY_REPORTED)
-		return 1;
+	return 1;
+}
+
+/*
+ * Allocate a row with its fields in display order.
+ * Their report_fn is called later, as needed.
+ */
+static struct row *_alloc_row(struct dm_report *rh)
+{
+	struct field_properties *fp;
+	struct row *row;
+	struct dm_report_field *field;
 
 	if (!(row = dm_pool_zalloc(rh->mem, sizeof(*row)))) {
 		log_error("_do_report_object: struct row allocation failed");
-		return 0;
+		return NULL;
 	}
 
-	if (!rh->first_row)
-		rh->first_row = row;
-
 	row->rh = rh;
 
 	if ((rh->flags & RH_SORT_REQUIRED) &&
@@ -1956,48 +2031,74 @@ static int _do_report_object(struct dm_report *rh, void *object, int do_output,
 			       rh->keys_count))) {
 		log_error("_do_report_object: "
 			  "row sort value structure allocation failed");
-		goto out;
+		goto bad;
 	}
 
 	dm_list_init(&row->fields);
 	row->selected = 1;
 
-	/* For each field to be displayed, call its report_fn */
 	dm_list_iterate_items(fp, &rh->field_props) {
-		if (!(field = dm_pool_zalloc(rh->mem, sizeof(*field)))) {
-			log_error("_do_report_object: "
-				  "struct dm_report_field allocation failed");
-			goto out;
-		}
+		if (!(field = _alloc_report_field(rh, row, fp)))
+			goto bad;
 
-		if (fp->implicit) {
-			fields = _implicit_report_fields;
-			if (!strcmp(fields[fp->field_num].id, SPECIAL_FIELD_SELECTED_ID))
-				row->field_sel_status = field;
-		} else
-			fields = rh->fields;
+		if (fp->implicit &&
+		    !strcmp(_implicit_report_fields[fp->field_num].id, SPECIAL_FIELD_SELECTED_ID))
+			row->field_sel_status = field;
+	}
 
-		field->props = fp;
+	return row;
+bad:
+	dm_pool_free(rh->mem, row);
+	return NULL;
+}
 
-		data = fp->implicit ? _report_get_implicit_field_data(rh, fp, row)
-				    : _report_get_field_data(rh, fp, object);
-		if (!data) {
-			log_error("_do_report_object: "
-				  "no data assigned to field %s",
-				  fields[fp->field_num].id);
-			goto out;
-		}
+/* Fields already evaluated by dm_report_object_preselect() */
+static int _is_preselected_field(struct dm_report *rh, struct field_properties *fp)
+{
+	return (fp->flags & FLD_SELECTION) &&
+		!_is_lazy_field(rh, fp, rh->preselected_lazy_types);
+}
 
-		if (!fields[fp->field_num].report_fn(rh, rh->mem,
-							 field, data,
-							 rh->private)) {
-			log_error("_do_report_object: "
-				  "report function failed for field %s",
-				  fields[fp->field_num].id);
-			goto out;
-		}
+static int _do_report_object(struct dm_report *rh, void *object, int do_output, int *selected)
+{
+	struct row *row = NULL;
+	struct dm_report_field *field;
+	int preselected = 0;
+	int r = 0;
+
+	if (!rh) {
+		log_error(INTERNAL_ERROR "_do_report_object: dm_report handler is NULL.");
+		return 0;
+	}
+
+	if (!do_output && !selected) {
+		log_error(INTERNAL_ERROR "_do_report_object: output not requested and "
+					 "selected output variable is NULL too.");
+		return 0;
+	}
+
+	if (rh->flags & RH_ALREADY_REPORTED)
+		return 1;
+
+	/* Reuse the values of the fields the selection was checked with. */
+	if ((row = rh->preselected_row)) {
+		rh->preselected_row = NULL;
+		preselected = 1;
+	} else if (!(row = _alloc_row(rh)))
+		return_0;
+
+	/* Rows not for output are always freed below. */
+	if (!rh->first_row && do_output)
+		rh->first_row = row;
+
+	/* Call report_fn only for the fields needed to check the selection now. */
+	dm_list_iterate_items(field, &row->fields) {
+		if (preselected && _is_preselected_field(rh, field->props))
+			continue;
 
-		dm_list_add(&row->fields, &field->list);
+		if (_is_selection_field(rh, field->props) &&
+		    !_do_report_field(rh, row, field, object))
+			goto out;
 	}
 
 	r = 1;
@@ -2039,6 +2140,14 @@ static int _do_report_object(struct dm_report *rh, void *object, int do_output,
 	if (!do_output)
 		goto out;
 
+	/* Now evaluate the rest of the fields for the row we keep. */
+	dm_list_iterate_items(field, &row->fields)
+		if (!_is_selection_field(rh, field->props) &&
+		    !_do_report_field(rh, row, field, object)) {
+			r = 0;
+			goto out;
+		}
+
 	dm_list_add(&rh->rows, &row->list);
 
 	if (!(rh->flags & DM_REPORT_OUTPUT_BUFFERED))
@@ -2051,6 +2160,63 @@ out:
 	return r;
 }
 
+void dm_report_object_preselect_discard(struct dm_report *rh)
+{
+	if (!rh->preselected_row)
+		return;
+
+	dm_pool_free(rh->mem, rh->preselected_row);
+	rh->preselected_row = NULL;
+}
+
+int dm_report_object_preselect(struct dm_report *rh, void *object,
+			       uint32_t lazy_types, int *selected)
+{
+	struct field_properties *fp;
+	struct row *row;
+	struct dm_report_field *field;
+
+	*selected = 1;
+
+	dm_report_object_preselect_discard(rh);
+
+	if (!rh->selection || !rh->selection->selection_root ||
+	    (rh->flags & (RH_ALREADY_REPORTED | DM_REPORT_OUTPUT_MULTIPLE_TIMES)))
+		return 1;
+
+	/* Rows not passing the selection are displayed with "selected" field. */
+	dm_list_iterate_items(fp, &rh->field_props)
+		if (fp->implicit && !(fp->flags & FLD_HIDDEN) &&
+		    !strcmp(_implicit_report_fields[fp->field_num].id, SPECIAL_FIELD_SELECTED_ID))
+			return 1;
+
+	if (!(row = _alloc_row(rh)))
+		return_0;
+
+	dm_list_iterate_items(field, &row->fields) {
+		if (!(field->props->flags & FLD_SELECTION) ||
+		    _is_lazy_field(rh, field->props, lazy_types))
+			continue;
+
+		if (!_do_report_field(rh, row, field, object)) {
+			dm_pool_free(rh->mem, row);
+			return 0;
+		}
+	}
+
+	if (!_check_selection(rh, rh->selection->selection_root, &row->fields, lazy_types)) {
+		*selected = 0;
+		dm_pool_free(rh->mem, row);
+		return 1;
+	}
+
+	/* Kept for the dm_report_object() call that follows. */
+	rh->preselected_row = row;
+	rh->preselected_lazy_types = lazy_types;
+
+	return 1;
+}
+
 static int _do_report_compact_fields(struct dm_report *rh, int global)
 {
 	struct dm_report_field *field;
@@ -3475,6 +3641,7 @@ static struct field_selection *_create_field_selection(struct dm_report *rh,
 		}
 	}
 
+	found->flags |= FLD_SELECTION;
 	field_id = fields[found->field_num].id;
 
 	if (!(found->flags & flags & DM_REPORT_FIELD_TYPE_MASK)) {
@@ -4031,8 +4198,12 @@ static int _alloc_rh_selection(struct dm_report *rh)
 static int _report_set_selection(struct dm_report *rh, const char *selection, int add_new_fields)
 {
 	struct selection_node *root = NULL;
+	struct field_properties *fp;
 	const char *fin, *next;
 
+	dm_list_iterate_items(fp, &rh->field_props)
+		fp->flags &= ~FLD_SELECTION;
+
 	if (rh->selection) {
 		if (rh->selection->selection_root)
 			/* Trash any previous selection. */
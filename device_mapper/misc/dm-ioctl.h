@@ -194,8 +194,22 @@ struct dm_name_list {
 	uint32_t next;		/* offset to the next record from
 				   the _start_ of this */
 	char name[];
+
+	/*
+	 * The following members can be accessed by taking a pointer that
+	 * points immediately after the terminating zero character in "name"
+	 * and aligning this pointer to next 8-byte boundary.
+	 * Uuid is present if the flag DM_NAME_LIST_FLAG_HAS_UUID is set.
+	 *
+	 * uint32_t event_nr;
+	 * uint32_t flags;
+	 * char uuid[0];
+	 */
 };
 
+#define DM_NAME_LIST_FLAG_HAS_UUID		1
+#define DM_NAME_LIST_FLAG_DOESNT_HAVE_UUID	2
+
 /*
  * Used to retrieve the target versions
  */
@@ -334,6 +348,7 @@ enum {
 /*
  * If set, rename changes the uuid not the name.  Only permitted
  * if no uuid was previously supplied: an existing uuid cannot be changed.
+ * If set with list devices, uuids are returned with device names.
  */
 #define DM_UUID_FLAG			(1 << 14) /* In */
 
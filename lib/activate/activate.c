@@ -346,6 +346,22 @@ int lv_mknodes(struct cmd_context *cmd, const struct logical_volume *lv)
 {
 	return 1;
 }
+int activation_batch_begin(struct cmd_context *cmd, const struct volume_group *vg)
+{
+	return 1;
+}
+unsigned activation_batch_size(void)
+{
+	return 0;
+}
+int activation_batch_end(struct cmd_context *cmd, unsigned *activated)
+{
+	*activated = 0;
+	return 1;
+}
+void activation_batch_discard(void)
+{
+}
 int lv_deactivate_any_missing_subdevs(const struct logical_volume *lv)
 {
 	return 1;
@@ -621,6 +637,7 @@ static int _lv_info(struct cmd_context *cmd, const struct logical_volume *lv,
 		    int with_open_count, int with_read_ahead, int with_name_check)
 {
 	struct dm_info dminfo;
+	int exists;
 
 	/*
 	 * If open_count info is requested and we have to be sure our own udev
@@ -636,12 +653,19 @@ static int _lv_info(struct cmd_context *cmd, const struct logical_volume *lv,
 	/* New thin-pool has no layer, but -tpool suffix needs to be queried */
 	if (!use_layer && lv_is_new_thin_pool(lv)) {
 		/* Check if there isn't existing old thin pool mapping in the table */
-		if (!dev_manager_info(cmd, lv, NULL, 0, 0, 0, &dminfo, NULL, NULL))
+		if (!dev_manager_exists(cmd, lv, NULL, &exists))
 			return_0;
-		if (!dminfo.exists)
+		if (!exists)
 			use_layer = 1;
 	}
 
+	/* Only existence is needed */
+	if (!info && !seg_status && !with_name_check) {
+		if (!dev_manager_exists(cmd, lv, (use_layer) ? lv_layer(lv) : NULL, &exists))
+			return_0;
+		return exists;
+	}
+
 	if (seg_status) {
 		/* TODO: for now it's mess with seg_status */
 		seg_status->seg = seg;
@@ -1365,16 +1389,13 @@ int lv_vdo_pool_percent(const struct logical_volume *lv, dm_percent_t *percent)
 
 static int _lv_active(struct cmd_context *cmd, const struct logical_volume *lv)
 {
-	struct lvinfo info;
-
-	if (!lv_info(cmd, lv, 0, &info, 0, 0)) {
-		log_debug("Cannot determine activation status of %s%s.",
-			  display_lvname(lv),
-			  activation() ? "" : " (no device driver)");
+	if (!activation()) {
+		log_debug("Cannot determine activation status of %s (no device driver).",
+			  display_lvname(lv));
 		return 0;
 	}
 
-	return info.exists;
+	return _lv_info(cmd, lv, 0, NULL, NULL, NULL, 0, 0, 0);
 }
 
 static int _lv_open_count(struct cmd_context *cmd, const struct logical_volume *lv)
@@ -2490,6 +2511,158 @@ int lv_activation_filter(struct cmd_context *cmd, const char *lvid_s,
 	return 1;
 }
 
+/*
+ * LVs queued for activation between activation_batch_begin()
+ * and activation_batch_end().
+ */
+static struct dm_pool *_batch_mem = NULL;
+static const struct volume_group *_batch_vg = NULL;
+static struct dm_list _batch_lvs;
+
+/*
+ * Only LVs mapped directly to PVs are activated in the shared tree.
+ * Stacked LVs keep their own trees with all their special handling.
+ */
+static int _lv_is_batchable(const struct logical_volume *lv,
+			    const struct lv_activate_opts *laopts)
+{
+	const struct lv_segment *seg;
+	uint32_t s;
+
+	if (!_batch_mem || (lv->vg != _batch_vg) ||
+	    laopts->origin_only || laopts->temporary || laopts->component_lv)
+		return 0;
+
+	if (!lv_is_visible(lv) || lv_is_partial(lv) ||
+	    lv_is_origin(lv) || lv_is_external_origin(lv) ||
+	    lv_is_locked(lv) || lv_is_pvmove(lv))
+		return 0;
+
+	dm_list_iterate_items(seg, &lv->segments) {
+		if (!seg_is_striped(seg))
+			return 0;
+		for (s = 0; s < seg->area_count; s++)
+			if (seg_type(seg, s) != AREA_PV)
+				return 0;
+	}
+
+	return 1;
+}
+
+static int _batch_lv(const struct logical_volume *lv,
+		     const struct lv_activate_opts *laopts)
+{
+	struct activate_lv_list *all;
+
+	if (!(all = dm_pool_zalloc(_batch_mem, sizeof(*all)))) {
+		log_error("Failed to queue activation of %s.", display_lvname(lv));
+		return 0;
+	}
+
+	all->lv = lv;
+	all->laopts = *laopts;
+	dm_list_add(&_batch_lvs, &all->list);
+
+	log_debug_activation("Queued %s for activation with VG %s.",
+			     display_lvname(lv), lv->vg->name);
+
+	return 1;
+}
+
+int activation_batch_begin(struct cmd_context *cmd, const struct volume_group *vg)
+{
+	if (!activation() || test_mode())
+		return 1;
+
+	if (_batch_mem) {
+		log_error(INTERNAL_ERROR "Activation batch for VG %s already started.",
+			  _batch_vg->name);
+		return 0;
+	}
+
+	if (!(_batch_mem = dm_pool_create("activation_batch", 1024)))
+		return_0;
+
+	_batch_vg = vg;
+	dm_list_init(&_batch_lvs);
+
+	return 1;
+}
+
+unsigned activation_batch_size(void)
+{
+	return _batch_mem ? dm_list_size(&_batch_lvs) : 0;
+}
+
+void activation_batch_discard(void)
+{
+	if (!_batch_mem)
+		return;
+
+	if (!dm_list_empty(&_batch_lvs))
+		log_debug_activation("Discarding %u queued activations in VG %s.",
+				     dm_list_size(&_batch_lvs), _batch_vg->name);
+
+	dm_pool_destroy(_batch_mem);
+	_batch_mem = NULL;
+	_batch_vg = NULL;
+}
+
+int activation_batch_end(struct cmd_context *cmd, unsigned *activated)
+{
+	struct activate_lv_list *all;
+	struct dev_manager *dm;
+	int r = 0, failed = 0, lv_activated;
+
+	*activated = 0;
+
+	if (!_batch_mem)
+		return 1;
+
+	if (dm_list_empty(&_batch_lvs)) {
+		r = 1;
+		goto out;
+	}
+
+	critical_section_inc(cmd, "activating");
+	if ((dm = dev_manager_create(cmd, _batch_vg->name, 1))) {
+		if (!(r = dev_manager_activate_lvs(dm, &_batch_lvs)))
+			stack;
+		dev_manager_destroy(dm);
+	}
+	critical_section_dec(cmd, "activated");
+
+	if (!r)
+		log_warn("WARNING: Activating LVs in VG %s one by one.", _batch_vg->name);
+
+	/* Whatever failed in the shared tree is retried per LV */
+	dm_list_iterate_items(all, &_batch_lvs) {
+		lv_activated = r;
+		if (!lv_activated) {
+			critical_section_inc(cmd, "activating");
+			if (!(lv_activated = _lv_activate_lv(all->lv, &all->laopts))) {
+				log_error("Failed to activate %s.", display_lvname(all->lv));
+				failed++;
+			}
+			critical_section_dec(cmd, "activated");
+		}
+
+		if (!lv_activated)
+			continue;
+
+		(*activated)++;
+
+		if (!monitor_dev_for_events(cmd, all->lv, &all->laopts, 1))
+			stack;
+	}
+
+	r = !failed;
+out:
+	activation_batch_discard();
+
+	return r;
+}
+
 static int _lv_activate(struct cmd_context *cmd, const char *lvid_s,
 			struct lv_activate_opts *laopts, int filter,
 	                const struct logical_volume *lv)
@@ -2585,6 +2758,11 @@ static int _lv_activate(struct cmd_context *cmd, const char *lvid_s,
 
 	lv_calculate_readahead(lv, NULL);
 
+	if (_lv_is_batchable(lv, laopts)) {
+		r = _batch_lv(lv, laopts);
+		goto out;
+	}
+
 	critical_section_inc(cmd, "activating");
 	if (!(r = _lv_activate_lv(lv, laopts)))
 		stack;
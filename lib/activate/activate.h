@@ -92,6 +92,13 @@ struct lv_activate_opts {
 	const struct logical_volume *component_lv;
 };
 
+/* LV queued for activation together with others from its VG */
+struct activate_lv_list {
+	struct dm_list list;
+	const struct logical_volume *lv;
+	struct lv_activate_opts laopts;
+};
+
 void set_activation(int activation, int silent);
 int activation(void);
 
@@ -128,6 +135,18 @@ int lv_activate_with_filter(struct cmd_context *cmd, const char *lvid_s, int exc
 			    int noscan, int temporary, const struct logical_volume *lv);
 int lv_deactivate(struct cmd_context *cmd, const char *lvid_s, const struct logical_volume *lv);
 
+/*
+ * Between these calls simple LVs of the VG are not activated one by one,
+ * but queued and activated together in one dependency tree by
+ * activation_batch_end(), which returns 0 if any queued LV failed and
+ * sets activated to the number of queued LVs it activated.
+ * activation_batch_discard() drops the queue without activating it.
+ */
+int activation_batch_begin(struct cmd_context *cmd, const struct volume_group *vg);
+unsigned activation_batch_size(void);
+int activation_batch_end(struct cmd_context *cmd, unsigned *activated);
+void activation_batch_discard(void);
+
 int lv_mknodes(struct cmd_context *cmd, const struct logical_volume *lv);
 
 int lv_deactivate_any_missing_subdevs(const struct logical_volume *lv);
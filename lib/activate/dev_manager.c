@@ -26,6 +26,8 @@
 #include "lib/activate/activate.h"
 #include "lib/misc/lvm-exec.h"
 #include "lib/datastruct/str_list.h"
+#include "lib/misc/crc.h"
+#include "lib/mm/xlate.h"
 
 #include <limits.h>
 #include <dirent.h>
@@ -803,6 +805,113 @@ static int _original_uuid_format_check_required(struct cmd_context *cmd)
 	return (_kernel_major == -1);
 }
 
+/*
+ * Snapshot of dm devices present in kernel taken with a single
+ * DM_DEVICE_LIST ioctl. It answers whether an LV device exists
+ * without DM_DEVICE_INFO for every LV and layer. It is dropped
+ * with dev_manager_release() and whenever this command changes
+ * dm devices itself.
+ */
+static struct dm_list *_dm_devs;
+static struct dm_hash_table *_dm_devs_by_uuid;
+static int _dm_devs_unsupported;
+
+static void _dm_devs_destroy(void)
+{
+	if (_dm_devs_by_uuid) {
+		dm_hash_destroy(_dm_devs_by_uuid);
+		_dm_devs_by_uuid = NULL;
+	}
+
+	if (_dm_devs)
+		dm_device_list_destroy(&_dm_devs);
+}
+
+static int _dm_devs_update(void)
+{
+	struct dm_task *dmt;
+	struct dm_active_device *dev;
+	unsigned features;
+	int r = 0;
+
+	if (_dm_devs || _dm_devs_unsupported)
+		return 1;
+
+	if (!(dmt = _setup_task_run(DM_DEVICE_LIST, NULL, NULL, NULL, NULL, 0, 0, 0, 1, 0))) {
+		/* Fall back to per device queries */
+		_dm_devs_unsupported = 1;
+		return_0;
+	}
+
+	if (!dm_task_get_device_list(dmt, &_dm_devs, &features))
+		goto_out;
+
+	if (!(features & DM_DEVICE_LIST_HAS_UUID)) {
+		log_debug_activation("Kernel does not list dm device uuids, "
+				     "querying devices one by one.");
+		_dm_devs_unsupported = 1;
+		dm_device_list_destroy(&_dm_devs);
+		r = 1;
+		goto out;
+	}
+
+	if (!(_dm_devs_by_uuid = dm_hash_create(dm_list_size(_dm_devs) * 2 + 16))) {
+		log_error("Failed to create dm device uuid hash.");
+		goto out;
+	}
+
+	dm_list_iterate_items(dev, _dm_devs)
+		if (dev->uuid && *dev->uuid &&
+		    !dm_hash_insert(_dm_devs_by_uuid, dev->uuid, dev)) {
+			log_error("Failed to hash dm device uuid %s.", dev->uuid);
+			goto out;
+		}
+
+	log_debug_activation("Listed %u dm devices.", dm_list_size(_dm_devs));
+	r = 1;
+out:
+	if (!r)
+		_dm_devs_destroy();
+	dm_task_destroy(dmt);
+
+	return r;
+}
+
+/*
+ * Look up dlid and its older formats, as checked by _info(), in the
+ * snapshot of dm devices. Returns 0 if there is no usable snapshot.
+ */
+static int _dm_devs_find(struct cmd_context *cmd, const char *dlid,
+			 const struct dm_active_device **dev)
+{
+	char old_style_dlid[sizeof(UUID_PREFIX) + 2 * ID_LEN];
+	const char *suffix, *suffix_position;
+	unsigned i = 0;
+
+	if (!_dm_devs_update() || !_dm_devs)
+		return 0;
+
+	if ((*dev = dm_hash_lookup(_dm_devs_by_uuid, dlid)))
+		return 1;
+
+	if ((suffix_position = rindex(dlid, '-'))) {
+		while ((suffix = uuid_suffix_list[i++])) {
+			if (strcmp(suffix_position + 1, suffix))
+				continue;
+
+			(void) strncpy(old_style_dlid, dlid, sizeof(old_style_dlid));
+			old_style_dlid[sizeof(old_style_dlid) - 1] = '\0';
+			if ((*dev = dm_hash_lookup(_dm_devs_by_uuid, old_style_dlid)))
+				return 1;
+		}
+	}
+
+	if (_original_uuid_format_check_required(cmd))
+		*dev = dm_hash_lookup(_dm_devs_by_uuid, dlid + sizeof(UUID_PREFIX) - 1);
+
+	return 1;
+}
+
 static int _info(struct cmd_context *cmd,
 		 const char *name, const char *dlid,
 		 int with_open_count, int with_read_ahead, int with_name_check,
@@ -812,8 +921,17 @@ static int _info(struct cmd_context *cmd,
 	char old_style_dlid[sizeof(UUID_PREFIX) + 2 * ID_LEN];
 	const char *suffix, *suffix_position;
 	const char *name_check = (with_name_check) ? name : NULL;
+	const struct dm_active_device *dev;
 	unsigned i = 0;
 
+	/* Device missing in the list of all dm devices needs no more queries */
+	if (_dm_devs_find(cmd, dlid, &dev) && !dev) {
+		memset(dminfo, 0, sizeof(*dminfo));
+		if (read_ahead)
+			*read_ahead = DM_READ_AHEAD_NONE;
+		return 1;
+	}
+
 	log_debug_activation("Getting device info for %s [%s].", name, dlid);
 
 	/* Check for dlid */
@@ -860,6 +978,8 @@ int dev_manager_remove_dm_major_minor(uint32_t major, uint32_t minor)
 
 	log_verbose("Removing dm dev %u:%u", major, minor);
 
+	_dm_devs_destroy();
+
 	if (!(dmt = dm_task_create(DM_DEVICE_REMOVE)))
 		return_0;
 
@@ -922,6 +1042,37 @@ out:
 	return r;
 }
 
+/*
+ * Check only whether LV device exists.
+ */
+int dev_manager_exists(struct cmd_context *cmd,
+		       const struct logical_volume *lv, const char *layer,
+		       int *exists)
+{
+	const struct dm_active_device *dev;
+	struct dm_info dminfo;
+	char *dlid;
+	int r;
+
+	if (!(dlid = build_dm_uuid(cmd->mem, lv, layer)))
+		return_0;
+
+	r = _dm_devs_find(cmd, dlid, &dev);
+	dm_pool_free(cmd->mem, dlid);
+
+	if (r) {
+		*exists = dev ? 1 : 0;
+		return 1;
+	}
+
+	if (!dev_manager_info(cmd, lv, layer, 0, 0, 0, &dminfo, NULL, NULL))
+		return_0;
+
+	*exists = dminfo.exists;
+
+	return 1;
+}
+
 static const struct dm_info *_cached_dm_info(struct dm_pool *mem,
 					     struct dm_tree *dtree,
 					     const struct logical_volume *lv,
@@ -1340,11 +1491,13 @@ void dev_manager_destroy(struct dev_manager *dm)
 
 void dev_manager_release(void)
 {
+	_dm_devs_destroy();
 	dm_lib_release();
 }
 
 void dev_manager_exit(void)
 {
+	_dm_devs_destroy();
 	dm_lib_exit();
 }
 
@@ -2217,6 +2370,8 @@ struct pool_cb_data {
 		unsigned patch;
 	} version;
 	const char *global;
+	uint32_t needs_check_flag;	/* superblock flag requesting a check */
+	uint32_t clean_flag;		/* superblock flag of clean shutdown */
 };
 
 /*
@@ -2261,16 +2416,169 @@ static int _check_tool_version(struct cmd_context *cmd, const char *tool,
 	return ret;
 }
 
+/*
+ * Fingerprint of pool metadata that passed the check tool.
+ * Kept in the run dir, so it only lives until the next boot.
+ */
+#define POOL_CHECK_DIR DEFAULT_RUN_DIR "/pool_check"
+/* Thin and cache pool metadata both start with a 4KiB superblock */
+#define POOL_SUPERBLOCK_SIZE 4096
+
+struct pool_fingerprint {
+	uint64_t size;		/* metadata LV size */
+	uint32_t csum;		/* superblock checksum */
+	uint32_t flags;		/* superblock flags */
+	uint32_t crc;		/* crc of the whole superblock block */
+};
+
+/*
+ * Read the superblock with O_DIRECT, as the kernel writes the metadata
+ * past the page cache of the device.  Returns 1 with *zero set when
+ * the first 64 bytes are all zeros.
+ */
+static int _pool_read_fingerprint(const char *mpath, const struct logical_volume *mlv,
+				  struct pool_fingerprint *fp, int *zero)
+{
+	void *buf;
+	int fd, i, r = 0;
+
+	if (posix_memalign(&buf, POOL_SUPERBLOCK_SIZE, POOL_SUPERBLOCK_SIZE)) {
+		log_error("Failed to allocate buffer for %s.", mpath);
+		return 0;
+	}
+
+	if ((fd = open(mpath, O_RDONLY | O_DIRECT)) < 0) {
+		log_sys_debug("open", mpath);
+		goto out;
+	}
+
+	if (read(fd, buf, POOL_SUPERBLOCK_SIZE) < POOL_SUPERBLOCK_SIZE)
+		log_sys_debug("read", mpath);
+	else
+		r = 1;
+
+	if (close(fd))
+		log_sys_debug("close", mpath);
+
+	if (!r)
+		goto out;
+
+	for (i = 0, *zero = 1; i < 64; ++i)
+		if (((const uint8_t *) buf)[i]) {
+			*zero = 0;
+			break;
+		}
+
+	fp->size = mlv->size;
+	fp->csum = xlate32(((const uint32_t *) buf)[0]);
+	fp->flags = xlate32(((const uint32_t *) buf)[1]);
+	fp->crc = calc_crc(INITIAL_CRC, buf, POOL_SUPERBLOCK_SIZE);
+out:
+	free(buf);
+
+	return r;
+}
+
+static int _pool_fingerprint_path(char *path, size_t size, const struct logical_volume *mlv)
+{
+	if (dm_snprintf(path, size, POOL_CHECK_DIR "/%s", mlv->lvid.s) < 0) {
+		log_error("Pool check file path for %s is too long.", display_lvname(mlv));
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Metadata is unchanged since it passed the check, and was left clean. */
+static int _pool_check_unchanged(const struct pool_cb_data *data,
+				 const struct logical_volume *mlv,
+				 const struct pool_fingerprint *fp)
+{
+	char path[PATH_MAX];
+	struct pool_fingerprint saved;
+	unsigned long long size;
+	FILE *f;
+	int r;
+
+	if (!find_config_tree_bool(mlv->vg->cmd, global_pool_check_skip_unchanged_CFG, NULL))
+		return 0;
+
+	if ((fp->flags & data->needs_check_flag) ||
+	    ((fp->flags & data->clean_flag) != data->clean_flag))
+		return 0;
+
+	if (!_pool_fingerprint_path(path, sizeof(path), mlv))
+		return 0;
+
+	if (!(f = fopen(path, "r")))
+		return 0;
+
+	r = (fscanf(f, "%llu %x %x %x", &size, &saved.csum, &saved.flags, &saved.crc) == 4) &&
+		(size == fp->size) && (saved.csum == fp->csum) &&
+		(saved.flags == fp->flags) && (saved.crc == fp->crc);
+
+	if (fclose(f))
+		log_sys_debug("fclose", path);
+
+	return r;
+}
+
+static void _pool_check_save(const struct logical_volume *mlv,
+			     const struct pool_fingerprint *fp)
+{
+	char path[PATH_MAX], tmp[PATH_MAX + 8];
+	FILE *f;
+
+	if (!_pool_fingerprint_path(path, sizeof(path), mlv) ||
+	    (dm_snprintf(tmp, sizeof(tmp), "%s.tmp", path) < 0))
+		return;
+
+	if (!dm_create_dir(POOL_CHECK_DIR))
+		return;
+
+	if (!(f = fopen(tmp, "w"))) {
+		log_sys_debug("fopen", tmp);
+		return;
+	}
+
+	fprintf(f, "%llu %x %x %x\n", (unsigned long long) fp->size,
+		fp->csum, fp->flags, fp->crc);
+
+	if (fclose(f)) {
+		log_sys_debug("fclose", tmp);
+		goto bad;
+	}
+
+	if (rename(tmp, path)) {
+		log_sys_debug("rename", path);
+		goto bad;
+	}
+
+	return;
+bad:
+	if (unlink(tmp))
+		log_sys_debug("unlink", tmp);
+}
+
+static void _pool_check_forget(const struct logical_volume *mlv)
+{
+	char path[PATH_MAX];
+
+	if (_pool_fingerprint_path(path, sizeof(path), mlv) &&
+	    unlink(path) && (errno != ENOENT))
+		log_sys_debug("unlink", path);
+}
+
 static int _pool_callback(struct dm_tree_node *node,
 			  dm_node_callback_t type, void *cb_data)
 {
-	int ret, status = 0, fd;
+	int ret, status = 0, zero = 0;
 	const struct dm_config_node *cn;
 	const struct dm_config_value *cv;
 	const struct pool_cb_data *data = cb_data;
 	const struct logical_volume *pool_lv = data->pool_lv;
 	const struct logical_volume *mlv = first_seg(pool_lv)->metadata_lv;
-	long buf[64 / sizeof(long)]; /* buffer for short disk header (64B) */
+	struct pool_fingerprint fp;
 	int args = 0;
 	char *mpath;
 	const char *argv[19] = { /* Max supported 15 args */
@@ -2286,30 +2594,18 @@ static int _pool_callback(struct dm_tree_node *node,
 		return 0;
 	}
 
-	if (data->skip_zero) {
-		if ((fd = open(mpath, O_RDONLY)) < 0) {
-			log_sys_error("open", mpath);
-			return 0;
-		}
-		/* let's assume there is no problem to read 64 bytes */
-		if (read(fd, buf, sizeof(buf)) < (int)sizeof(buf)) {
-			log_sys_error("read", mpath);
-			if (close(fd))
-				log_sys_error("close", mpath);
-			return 0;
-		}
-		for (ret = 0; ret < (int) DM_ARRAY_SIZE(buf); ++ret)
-			if (buf[ret])
-				break;
-
-		if (close(fd))
-			log_sys_error("close", mpath);
-
-		if (ret == (int) DM_ARRAY_SIZE(buf)) {
-			log_debug_activation("Metadata checking skipped, detected empty disk header on %s.",
-					     mpath);
-			return 1;
-		}
+	/* Without the superblock the check tool decides on its own */
+	if (!_pool_read_fingerprint(mpath, mlv, &fp, &zero))
+		log_debug_activation("Cannot read superblock of %s, running metadata check.",
+				     mpath);
+	else if (data->skip_zero && zero) {
+		log_debug_activation("Metadata checking skipped, detected empty disk header on %s.",
+				     mpath);
+		return 1;
+	} else if (_pool_check_unchanged(data, mlv, &fp)) {
+		log_debug_activation("Metadata checking skipped, %s is unchanged since last check.",
+				     mpath);
+		return 1;
 	}
 
 	if (!(cn = find_config_tree_array(mlv->vg->cmd, data->opts, NULL))) {
@@ -2334,8 +2630,14 @@ static int _pool_callback(struct dm_tree_node *node,
 
 	argv[++args] = mpath;
 
-	if (!(ret = exec_cmd(pool_lv->vg->cmd, (const char * const *)argv,
-			     &status, 0))) {
+	if ((ret = exec_cmd(pool_lv->vg->cmd, (const char * const *)argv,
+			    &status, 0))) {
+		/* The tool may have cleared the needs_check flag */
+		if (_pool_read_fingerprint(mpath, mlv, &fp, &zero))
+			_pool_check_save(mlv, &fp);
+	} else {
+		_pool_check_forget(mlv);
+
 		if (status == ENOENT) {
 			log_warn("WARNING: Check is skipped, please install recommended missing binary %s!",
 				 argv[0]);
@@ -2404,12 +2706,15 @@ static int _pool_register_callback(struct dev_manager *dm,
 		data->exec = global_thin_check_executable_CFG;
 		data->opts = global_thin_check_options_CFG;
 		data->global = "thin";
+		data->needs_check_flag = 1;	/* THIN_METADATA_NEEDS_CHECK_FLAG */
 	} else if (lv_is_cache(lv)) { /* cache pool */
 		data->pool_lv = first_seg(lv)->pool_lv;
 		data->skip_zero = 1; /* cheap read-error detection */
 		data->exec = global_cache_check_executable_CFG;
 		data->opts = global_cache_check_options_CFG;
 		data->global = "cache";
+		data->clean_flag = 1;		/* CLEAN_SHUTDOWN */
+		data->needs_check_flag = 2;	/* NEEDS_CHECK */
 		if (first_seg(first_seg(lv)->pool_lv)->cache_metadata_format > 1) {
 			data->version.maj = 0;
 			data->version.min = 7;
@@ -3775,6 +4080,9 @@ out:
 out_no_root:
 	dm_tree_free(dtree);
 
+	/* Devices may have changed */
+	_dm_devs_destroy();
+
 	return r;
 }
 
@@ -3791,6 +4099,102 @@ int dev_manager_activate(struct dev_manager *dm, const struct logical_volume *lv
 	return 1;
 }
 
+/*
+ * Activate all listed LVs of one VG through a single dependency tree,
+ * so the devices are preloaded and resumed with one udev cookie.
+ */
+int dev_manager_activate_lvs(struct dev_manager *dm, struct dm_list *lvs)
+{
+	const size_t DLID_SIZE = ID_LEN + sizeof(UUID_PREFIX) - 1;
+	struct activate_lv_list *all, *first;
+	struct dm_tree *dtree;
+	struct dm_tree_node *root;
+	uint64_t start, tree_ns, preload_ns, resume_ns;
+	unsigned count = 0;
+	char *dlid;
+	int r = 0;
+
+	if (dm_list_empty(lvs))
+		return 1;
+
+	first = dm_list_item(dm_list_first(lvs), struct activate_lv_list);
+
+	dm->activation = 1;
+	dm->suspend = 0;
+	dm->track_external_lv_deps = 1;
+
+	start = lvm_monotonic_ns();
+
+	if (!(dtree = dm_tree_create())) {
+		log_debug_activation("Dtree creation failed for VG %s.",
+				     first->lv->vg->name);
+		return 0;
+	}
+
+	dm_tree_set_optional_uuid_suffixes(dtree, &uuid_suffix_list[0]);
+
+	dm_list_iterate_items(all, lvs)
+		if (!_add_lv_to_dtree(dm, dtree, all->lv, 0)) {
+			stack;
+			goto out_no_root;
+		}
+
+	if (!(root = dm_tree_find_node(dtree, 0, 0))) {
+		log_error("Lost dependency tree root node.");
+		goto out_no_root;
+	}
+
+	/* Restore fs cookie */
+	dm_tree_set_cookie(root, fs_get_cookie());
+
+	dm_list_iterate_items(all, lvs) {
+		if (!_add_new_lv_to_dtree(dm, dtree, all->lv, &all->laopts, NULL))
+			goto_out;
+		count++;
+	}
+
+	/* All LVs share the "LVM-" plus VG id prefix */
+	if (!(dlid = build_dm_uuid(dm->mem, first->lv, NULL)))
+		goto_out;
+
+	tree_ns = lvm_monotonic_ns() - start;
+	start = lvm_monotonic_ns();
+
+	if (!dm_tree_preload_children(root, dlid, DLID_SIZE))
+		goto_out;
+
+	preload_ns = lvm_monotonic_ns() - start;
+	start = lvm_monotonic_ns();
+
+	if (!dm_tree_activate_children(root, dlid, DLID_SIZE))
+		goto_out;
+
+	resume_ns = lvm_monotonic_ns() - start;
+
+	if (!_create_lv_symlinks(dm, root))
+		log_warn("Failed to create symlinks for LVs in VG %s.",
+			 first->lv->vg->name);
+
+	log_verbose("Activated %u LVs in VG %s: tree %.3fs preload %.3fs resume %.3fs.",
+		    count, first->lv->vg->name,
+		    tree_ns / 1e9, preload_ns / 1e9, resume_ns / 1e9);
+	r = 1;
+out:
+	/* Save fs cookie for udev settle, do not wait here */
+	fs_set_cookie(dm_tree_get_cookie(root));
+out_no_root:
+	dm_tree_free(dtree);
+
+	/* Devices may have changed */
+	_dm_devs_destroy();
+
+	/* Remove unused non-toplevel nodes once for the whole VG */
+	if (r && !_tree_action(dm, first->lv, &first->laopts, CLEAN))
+		return_0;
+
+	return r;
+}
+
 /* origin_only may only be set if we are resuming (not activating) an origin LV */
 int dev_manager_preload(struct dev_manager *dm, const struct logical_volume *lv,
 			struct lv_activate_opts *laopts, int *flush_required)
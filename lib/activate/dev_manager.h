@@ -50,6 +50,8 @@ int dev_manager_info(struct cmd_context *cmd, const struct logical_volume *lv,
 		     int with_open_count, int with_read_ahead, int with_name_check,
 		     struct dm_info *dminfo, uint32_t *read_ahead,
 		     struct lv_seg_status *seg_status);
+int dev_manager_exists(struct cmd_context *cmd, const struct logical_volume *lv,
+		       const char *layer, int *exists);
 
 int dev_manager_snapshot_percent(struct dev_manager *dm,
 				 const struct logical_volume *lv,
@@ -86,6 +88,7 @@ int dev_manager_suspend(struct dev_manager *dm, const struct logical_volume *lv,
 			struct lv_activate_opts *laopts, int lockfs, int flush_required);
 int dev_manager_activate(struct dev_manager *dm, const struct logical_volume *lv,
 			 struct lv_activate_opts *laopts);
+int dev_manager_activate_lvs(struct dev_manager *dm, struct dm_list *lvs);
 int dev_manager_preload(struct dev_manager *dm, const struct logical_volume *lv,
 			struct lv_activate_opts *laopts, int *flush_required);
 int dev_manager_deactivate(struct dev_manager *dm, const struct logical_volume *lv);
@@ -16,6 +16,7 @@
 #include "lib/misc/lib.h"
 #include "fs.h"
 #include "lib/activate/activate.h"
+#include "lib/activate/dev_manager.h"
 #include "lib/commands/toolcontext.h"
 #include "lib/misc/lvm-string.h"
 #include "lib/misc/lvm-file.h"
@@ -494,7 +495,7 @@ void fs_unlock(void)
 		if (!dm_udev_wait(_fs_cookie))
 			stack;
 		_fs_cookie = DM_COOKIE_AUTO_CREATE; /* Reset cookie */
-		dm_lib_release();
+		dev_manager_release();
 		_pop_fs_ops();
 	}
 }
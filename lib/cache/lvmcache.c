@@ -24,6 +24,10 @@
 #include "lib/format_text/format-text.h"
 #include "lib/config/config.h"
 #include "lib/filters/filter.h"
+#include "lib/label/hints.h"
+#include "lib/misc/crc.h"
+
+#include <sys/stat.h>
 
 /* One per device */
 struct lvmcache_info {
@@ -87,6 +91,19 @@ static int _vgs_locked = 0;
 static int _found_duplicate_vgnames = 0;
 static int _outdated_warning = 0;
 
+/*
+ * State of the system when lvmcache content was created by a label scan,
+ * used to keep that content for following commands in the same process
+ * (devices/session_scan_cache).
+ */
+static struct {
+	struct stat hint_file;	/* stat of the hint file before the scan */
+	uint32_t devs_hash;	/* hash of devices in dev-cache seen by the scan */
+	unsigned devs_count;
+	unsigned scanned:1;	/* lvmcache content matches the state above */
+	unsigned kept:1;	/* lvmcache content is kept from a previous command */
+} _kept_scan;
+
 int lvmcache_init(struct cmd_context *cmd)
 {
 	/*
@@ -1138,6 +1155,136 @@ int lvmcache_label_scan(struct cmd_context *cmd)
 	return r;
 }
 
+static void _kept_scan_devs_hash(struct cmd_context *cmd, uint32_t *hash, unsigned *count)
+{
+	struct dev_iter *iter;
+	struct device *dev;
+
+	*hash = 0;
+	*count = 0;
+
+	if (!(iter = dev_iter_create(NULL, 0)))
+		return;
+
+	while ((dev = dev_iter_get(cmd, iter))) {
+		*hash = calc_crc(*hash, (const uint8_t *)&dev->dev, sizeof(dev->dev));
+		*hash = calc_crc(*hash, (const uint8_t *)dev_name(dev), strlen(dev_name(dev)));
+		(*count)++;
+	}
+
+	dev_iter_destroy(iter);
+}
+
+static int _kept_scan_dev_present(struct lvmcache_info *info)
+{
+	struct stat buf;
+
+	if (stat(dev_name(info->dev), &buf) || (buf.st_rdev != info->dev->dev)) {
+		log_debug_cache("Kept scan not used, %s is gone.", dev_name(info->dev));
+		return 0;
+	}
+
+	return 1;
+}
+
+static int _kept_scan_unchanged(struct cmd_context *cmd, struct stat *hint_file,
+				uint32_t devs_hash, unsigned devs_count)
+{
+	struct dm_hash_node *n;
+
+	if ((hint_file->st_ino != _kept_scan.hint_file.st_ino) ||
+	    (hint_file->st_size != _kept_scan.hint_file.st_size) ||
+	    (hint_file->st_mtim.tv_sec != _kept_scan.hint_file.st_mtim.tv_sec) ||
+	    (hint_file->st_mtim.tv_nsec != _kept_scan.hint_file.st_mtim.tv_nsec)) {
+		log_debug_cache("Kept scan not used, hint file changed.");
+		return 0;
+	}
+
+	if ((devs_hash != _kept_scan.devs_hash) || (devs_count != _kept_scan.devs_count)) {
+		log_debug_cache("Kept scan not used, devices changed.");
+		return 0;
+	}
+
+	dm_hash_iterate(n, _pvid_hash)
+		if (!_kept_scan_dev_present(dm_hash_get_data(_pvid_hash, n)))
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Called by label_scan after dev_cache_scan.  Returns 1 if the lvmcache
+ * content kept from the previous command is still valid, so that this
+ * command need not scan devices.  Otherwise any kept content is dropped
+ * and the state of the system is recorded for the scan that follows.
+ *
+ * The kept content is only used by commands that can use hints; others
+ * want a complete scan.  Metadata changes in a VG need not be detected
+ * here because vg_read checks mda headers before using lvmcache.
+ */
+int lvmcache_use_kept_scan(struct cmd_context *cmd)
+{
+	struct stat hint_file;
+	uint32_t devs_hash;
+	unsigned devs_count;
+	int kept = _kept_scan.kept;
+
+	_kept_scan.kept = 0;
+	_kept_scan.scanned = 0;
+
+	if (!find_config_tree_bool(cmd, devices_session_scan_cache_CFG, NULL) ||
+	    !get_hint_file_stat(cmd, &hint_file)) {
+		if (kept)
+			lvmcache_destroy(cmd, 1, 0);
+		return 0;
+	}
+
+	_kept_scan_devs_hash(cmd, &devs_hash, &devs_count);
+
+	if (kept) {
+		if (cmd->use_hints && _kept_scan_unchanged(cmd, &hint_file, devs_hash, devs_count)) {
+			log_debug_cache("Using scan kept from previous command.");
+			_kept_scan.scanned = 1;
+			return 1;
+		}
+		lvmcache_destroy(cmd, 1, 0);
+	}
+
+	_kept_scan.hint_file = hint_file;
+	_kept_scan.devs_hash = devs_hash;
+	_kept_scan.devs_count = devs_count;
+	_kept_scan.scanned = 1;
+
+	return 0;
+}
+
+/*
+ * Called at the end of a command.  Returns 1 if lvmcache content is kept
+ * for the next command, in which case it must not be destroyed.
+ */
+int lvmcache_keep_scan(struct cmd_context *cmd)
+{
+	struct lvmcache_vginfo *vginfo;
+
+	if (!_kept_scan.scanned)
+		return 0;
+
+	_kept_scan.scanned = 0;
+
+	if (_vgs_locked || _found_duplicate_vgnames ||
+	    !dm_list_empty(&_initial_duplicates) || !dm_list_empty(&_unused_duplicates))
+		return 0;
+
+	dm_list_iterate_items(vginfo, &_vginfos)
+		if (vginfo->scan_summary_mismatch)
+			return 0;
+
+	log_debug_cache("Keeping scan for next command.");
+	_kept_scan.kept = 1;
+
+	return 1;
+}
+
 int lvmcache_get_vgnameids(struct cmd_context *cmd,
 			   struct dm_list *vgnameids,
 			   const char *only_this_vgname,
@@ -2090,6 +2237,9 @@ void lvmcache_destroy(struct cmd_context *cmd, int retain_orphans, int reset)
 
 	log_debug_cache("Destroy lvmcache content");
 
+	_kept_scan.scanned = 0;
+	_kept_scan.kept = 0;
+
 	if (_vgid_hash) {
 		dm_hash_destroy(_vgid_hash);
 		_vgid_hash = NULL;
@@ -846,6 +846,8 @@ static int _load_config_file(struct cmd_context *cmd, const char *tag, int local
 		/* Use temporary copy of lvm.conf while loading other files */
 		cmd->cft = cfl->cft;
 
+	config_values_invalidate(cmd);
+
 	return 1;
 }
 
@@ -860,6 +862,7 @@ static int _init_lvm_conf(struct cmd_context *cmd)
 			log_error("Failed to create config tree");
 			return 0;
 		}
+		config_values_invalidate(cmd);
 		return 1;
 	}
 
@@ -997,6 +1000,8 @@ static void _destroy_config(struct cmd_context *cmd)
 	if (cmd->cft)
 		log_error(INTERNAL_ERROR "_destroy_config: "
 			  "cmd config tree not destroyed fully");
+
+	config_values_invalidate(cmd);
 }
 
 static int _init_dev_cache(struct cmd_context *cmd)
@@ -1553,6 +1558,8 @@ struct cmd_context *create_config_context(void)
 	if (!(cmd->cft = _merge_config_files(cmd, cmd->cft)))
 		goto_out;
 
+	config_values_invalidate(cmd);
+
 	return cmd;
 out:
 	if (cmd)
@@ -1560,6 +1567,25 @@ out:
 	return NULL;
 }
 
+static int _init_io_engine(struct cmd_context *cmd)
+{
+	const char *io_engine = find_config_tree_str(cmd, devices_io_engine_CFG, NULL);
+
+	init_use_aio(find_config_tree_bool(cmd, global_use_aio_CFG, NULL));
+	init_use_io_uring(0);
+
+	if (io_engine && !strcmp(io_engine, "sync"))
+		init_use_aio(0);
+	else if (io_engine && !strcmp(io_engine, "io_uring"))
+		init_use_io_uring(1);
+	else if (!io_engine || strcmp(io_engine, "aio")) {
+		log_error("Invalid io_engine specification.");
+		return 0;
+	}
+
+	return 1;
+}
+
 /* Entry point */
 struct cmd_context *create_toolcontext(unsigned is_clvmd,
 				       const char *system_dir,
@@ -1702,6 +1728,8 @@ struct cmd_context *create_toolcontext(unsigned is_clvmd,
 	if (!(cmd->cft = _merge_config_files(cmd, cmd->cft)))
 		goto_out;
 
+	config_values_invalidate(cmd);
+
 	if (!_process_config(cmd))
 		goto_out;
 
@@ -1712,7 +1740,8 @@ struct cmd_context *create_toolcontext(unsigned is_clvmd,
 						find_config_tree_array(cmd, devices_types_CFG, NULL))))
 		goto_out;
 
-	init_use_aio(find_config_tree_bool(cmd, global_use_aio_CFG, NULL));
+	if (!_init_io_engine(cmd))
+		goto_out;
 
 	if (!_init_dev_cache(cmd))
 		goto_out;
@@ -1872,6 +1901,8 @@ int refresh_toolcontext(struct cmd_context *cmd)
 	if (cft_cmdline)
 		cmd->cft = dm_config_insert_cascaded_tree(cft_cmdline, cft_tmp);
 
+	config_values_invalidate(cmd);
+
 	/* Reload the global profile. */
 	if (profile_command_name) {
 		if (!(profile = add_profile(cmd, profile_command_name, CONFIG_PROFILE_COMMAND)) ||
@@ -1908,6 +1939,8 @@ int refresh_toolcontext(struct cmd_context *cmd)
 	if (cft_cmdline)
 		cmd->cft = dm_config_insert_cascaded_tree(cft_cmdline, cmd->cft);
 
+	config_values_invalidate(cmd);
+
 	if (!_process_config(cmd))
 		return_0;
 
@@ -51,6 +51,7 @@ struct config_info {
 
 struct dm_config_tree;
 struct profile_params;
+struct config_value;
 struct archive_params;
 struct backup_params;
 struct arg_values;
@@ -197,6 +198,9 @@ struct cmd_context {
 	struct dm_list config_files; 		/* master lvm config + any existing tag configs */
 	struct profile_params *profile_params;	/* profile handling params including loaded profile configs */
 	struct dm_config_tree *cft;		/* the whole cascade: CONFIG_STRING -> CONFIG_PROFILE -> CONFIG_FILE/CONFIG_MERGED_FILES */
+	struct config_value *config_values;	/* resolved values of cft indexed by config id */
+	unsigned config_generation;		/* changed with cft, config_values of other generations are stale */
+	unsigned config_profile_applied;	/* nesting of local profiles applied to cft during lookup */
 	struct dm_hash_table *cft_def_hash;	/* config definition hash used for validity check (item type + item recognized) */
 	struct config_info default_settings;	/* selected settings with original default/configured value which can be changed during cmd processing */
 	struct config_info current_settings; 	/* may contain changed values compared to default_settings */
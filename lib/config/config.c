@@ -308,11 +308,8 @@ struct dm_config_tree *get_config_tree_by_source(struct cmd_context *cmd,
 	return NULL;
 }
 
-/*
- * Returns config tree if it was removed.
- */
-struct dm_config_tree *remove_config_tree_by_source(struct cmd_context *cmd,
-						    config_source_t source)
+static struct dm_config_tree *_remove_config_tree_by_source(struct cmd_context *cmd,
+							    config_source_t source)
 {
 	struct dm_config_tree *previous_cft = NULL;
 	struct dm_config_tree *cft = cmd->cft;
@@ -336,6 +333,17 @@ struct dm_config_tree *remove_config_tree_by_source(struct cmd_context *cmd,
 	return cft;
 }
 
+/*
+ * Returns config tree if it was removed.
+ */
+struct dm_config_tree *remove_config_tree_by_source(struct cmd_context *cmd,
+						    config_source_t source)
+{
+	config_values_invalidate(cmd);
+
+	return _remove_config_tree_by_source(cmd, source);
+}
+
 struct cft_check_handle *get_config_tree_check_handle(struct cmd_context *cmd,
 						      struct dm_config_tree *cft)
 {
@@ -404,6 +412,7 @@ int override_config_tree_from_string(struct cmd_context *cmd,
 	dm_config_set_custom(cft_new, cs);
 
 	cmd->cft = dm_config_insert_cascaded_tree(cft_new, cmd->cft);
+	config_values_invalidate(cmd);
 
 	return 1;
 }
@@ -470,8 +479,8 @@ static int _override_config_tree_from_metadata_profile(struct cmd_context *cmd,
 	return 1;
 }
 
-int override_config_tree_from_profile(struct cmd_context *cmd,
-				      struct profile *profile)
+static int _override_config_tree_from_profile(struct cmd_context *cmd,
+					      struct profile *profile)
 {
 	/*
 	 * Follow this sequence:
@@ -491,6 +500,14 @@ int override_config_tree_from_profile(struct cmd_context *cmd,
 	return 0;
 }
 
+int override_config_tree_from_profile(struct cmd_context *cmd,
+				      struct profile *profile)
+{
+	config_values_invalidate(cmd);
+
+	return _override_config_tree_from_profile(cmd, profile);
+}
+
 /*
  * When checksum_only is set, the checksum of buffer is only matched
  * and function avoids parsing of mda into config tree which
@@ -1216,7 +1233,87 @@ static int _apply_local_profile(struct cmd_context *cmd, struct profile *profile
 	     cmd->profile_params->global_metadata_profile)
 		return 0;
 
-	return override_config_tree_from_profile(cmd, profile);
+	if (!_override_config_tree_from_profile(cmd, profile))
+		return 0;
+
+	cmd->config_profile_applied++;
+
+	return 1;
+}
+
+static void _unapply_local_profile(struct cmd_context *cmd, struct profile *profile)
+{
+	_remove_config_tree_by_source(cmd, profile->source);
+	cmd->config_profile_applied--;
+}
+
+/*
+ * Resolved values of int, float, bool and string settings are kept in
+ * an array indexed by config id, one for the plain cascade and one for
+ * each local profile. An entry is valid while its generation matches
+ * cmd->config_generation, which changes with any change to cmd->cft
+ * other than the temporary application of a local profile.
+ */
+enum {
+	CFG_VALUE_NONE,
+	CFG_VALUE_INT,
+	CFG_VALUE_INT64,
+	CFG_VALUE_FLOAT,
+	CFG_VALUE_BOOL,
+	CFG_VALUE_STR,
+	CFG_VALUE_STR_ALLOW_EMPTY,
+};
+
+struct config_value {
+	unsigned generation;
+	unsigned kind;
+	union {
+		int i;
+		int64_t i64;
+		float f;
+		const char *str;
+	} v;
+};
+
+void config_values_invalidate(struct cmd_context *cmd)
+{
+	/* Generation 0 is never valid so zeroed entries are empty. */
+	if (!++cmd->config_generation)
+		cmd->config_generation = 1;
+}
+
+static struct config_value *_config_value(struct cmd_context *cmd, cfg_def_item_t *item,
+					  struct profile *profile)
+{
+	struct config_value **values = profile ? &profile->values : &cmd->config_values;
+
+	/*
+	 * Run-time defaults may be allocated from per-command memory and
+	 * lookups nested in another one see its local profile, so neither
+	 * is cached.
+	 */
+	if ((item->flags & CFG_DEFAULT_RUN_TIME) || cmd->config_profile_applied || !cmd->libmem)
+		return NULL;
+
+	if (!*values &&
+	    !(*values = dm_pool_zalloc(cmd->libmem, sizeof(**values) * CFG_COUNT)))
+		return NULL;
+
+	if (!cmd->config_generation)
+		config_values_invalidate(cmd);
+
+	return *values + item->id;
+}
+
+static int _config_value_cached(struct cmd_context *cmd, struct config_value *cv, unsigned kind)
+{
+	return cv && (cv->generation == cmd->config_generation) && (cv->kind == kind);
+}
+
+static void _config_value_store(struct cmd_context *cmd, struct config_value *cv, unsigned kind)
+{
+	cv->generation = cmd->config_generation;
+	cv->kind = kind;
 }
 
 static int _config_disabled(struct cmd_context *cmd, cfg_def_item_t *item, const char *path)
@@ -1255,7 +1352,7 @@ const struct dm_config_node *find_config_tree_node(struct cmd_context *cmd, int
 	cn = dm_config_tree_find_node(cmd->cft, path);
 
 	if (profile_applied && profile)
-		remove_config_tree_by_source(cmd, profile->source);
+		_unapply_local_profile(cmd, profile);
 
 	return cn;
 }
@@ -1264,9 +1361,13 @@ const char *find_config_tree_str(struct cmd_context *cmd, int id, struct profile
 {
 	cfg_def_item_t *item = cfg_def_get_item_p(id);
 	char path[CFG_PATH_MAX_LEN];
+	struct config_value *cv;
 	int profile_applied;
 	const char *str;
 
+	if (_config_value_cached(cmd, (cv = _config_value(cmd, item, profile)), CFG_VALUE_STR))
+		return cv->v.str;
+
 	profile_applied = _apply_local_profile(cmd, profile);
 	_cfg_def_make_path(path, sizeof(path), item->id, item, 0);
 
@@ -1277,7 +1378,12 @@ const char *find_config_tree_str(struct cmd_context *cmd, int id, struct profile
 						: dm_config_tree_find_str(cmd->cft, path, cfg_def_get_default_value(cmd, item, CFG_TYPE_STRING, profile));
 
 	if (profile_applied && profile)
-		remove_config_tree_by_source(cmd, profile->source);
+		_unapply_local_profile(cmd, profile);
+
+	if (cv) {
+		cv->v.str = str;
+		_config_value_store(cmd, cv, CFG_VALUE_STR);
+	}
 
 	return str;
 }
@@ -1286,9 +1392,13 @@ const char *find_config_tree_str_allow_empty(struct cmd_context *cmd, int id, st
 {
 	cfg_def_item_t *item = cfg_def_get_item_p(id);
 	char path[CFG_PATH_MAX_LEN];
+	struct config_value *cv;
 	int profile_applied;
 	const char *str;
 
+	if (_config_value_cached(cmd, (cv = _config_value(cmd, item, profile)), CFG_VALUE_STR_ALLOW_EMPTY))
+		return cv->v.str;
+
 	profile_applied = _apply_local_profile(cmd, profile);
 	_cfg_def_make_path(path, sizeof(path), item->id, item, 0);
 
@@ -1301,7 +1411,12 @@ const char *find_config_tree_str_allow_empty(struct cmd_context *cmd, int id, st
 						: dm_config_tree_find_str_allow_empty(cmd->cft, path, cfg_def_get_default_value(cmd, item, CFG_TYPE_STRING, profile));
 
 	if (profile_applied && profile)
-		remove_config_tree_by_source(cmd, profile->source);
+		_unapply_local_profile(cmd, profile);
+
+	if (cv) {
+		cv->v.str = str;
+		_config_value_store(cmd, cv, CFG_VALUE_STR_ALLOW_EMPTY);
+	}
 
 	return str;
 }
@@ -1310,9 +1425,13 @@ int find_config_tree_int(struct cmd_context *cmd, int id, struct profile *profil
 {
 	cfg_def_item_t *item = cfg_def_get_item_p(id);
 	char path[CFG_PATH_MAX_LEN];
+	struct config_value *cv;
 	int profile_applied;
 	int i;
 
+	if (_config_value_cached(cmd, (cv = _config_value(cmd, item, profile)), CFG_VALUE_INT))
+		return cv->v.i;
+
 	profile_applied = _apply_local_profile(cmd, profile);
 	_cfg_def_make_path(path, sizeof(path), item->id, item, 0);
 
@@ -1323,7 +1442,12 @@ int find_config_tree_int(struct cmd_context *cmd, int id, struct profile *profil
 					      : dm_config_tree_find_int(cmd->cft, path, cfg_def_get_default_value(cmd, item, CFG_TYPE_INT, profile));
 
 	if (profile_applied && profile)
-		remove_config_tree_by_source(cmd, profile->source);
+		_unapply_local_profile(cmd, profile);
+
+	if (cv) {
+		cv->v.i = i;
+		_config_value_store(cmd, cv, CFG_VALUE_INT);
+	}
 
 	return i;
 }
@@ -1332,9 +1456,13 @@ int64_t find_config_tree_int64(struct cmd_context *cmd, int id, struct profile *
 {
 	cfg_def_item_t *item = cfg_def_get_item_p(id);
 	char path[CFG_PATH_MAX_LEN];
+	struct config_value *cv;
 	int profile_applied;
 	int i64;
 
+	if (_config_value_cached(cmd, (cv = _config_value(cmd, item, profile)), CFG_VALUE_INT64))
+		return cv->v.i64;
+
 	profile_applied = _apply_local_profile(cmd, profile);
 	_cfg_def_make_path(path, sizeof(path), item->id, item, 0);
 
@@ -1345,7 +1473,12 @@ int64_t find_config_tree_int64(struct cmd_context *cmd, int id, struct profile *
 						: dm_config_tree_find_int64(cmd->cft, path, cfg_def_get_default_value(cmd, item, CFG_TYPE_INT, profile));
 
 	if (profile_applied && profile)
-		remove_config_tree_by_source(cmd, profile->source);
+		_unapply_local_profile(cmd, profile);
+
+	if (cv) {
+		cv->v.i64 = i64;
+		_config_value_store(cmd, cv, CFG_VALUE_INT64);
+	}
 
 	return i64;
 }
@@ -1354,9 +1487,13 @@ float find_config_tree_float(struct cmd_context *cmd, int id, struct profile *pr
 {
 	cfg_def_item_t *item = cfg_def_get_item_p(id);
 	char path[CFG_PATH_MAX_LEN];
+	struct config_value *cv;
 	int profile_applied;
 	float f;
 
+	if (_config_value_cached(cmd, (cv = _config_value(cmd, item, profile)), CFG_VALUE_FLOAT))
+		return cv->v.f;
+
 	profile_applied = _apply_local_profile(cmd, profile);
 	_cfg_def_make_path(path, sizeof(path), item->id, item, 0);
 
@@ -1367,7 +1504,12 @@ float find_config_tree_float(struct cmd_context *cmd, int id, struct profile *pr
 					      : dm_config_tree_find_float(cmd->cft, path, cfg_def_get_default_value(cmd, item, CFG_TYPE_FLOAT, profile));
 
 	if (profile_applied && profile)
-		remove_config_tree_by_source(cmd, profile->source);
+		_unapply_local_profile(cmd, profile);
+
+	if (cv) {
+		cv->v.f = f;
+		_config_value_store(cmd, cv, CFG_VALUE_FLOAT);
+	}
 
 	return f;
 }
@@ -1393,9 +1535,13 @@ int find_config_tree_bool(struct cmd_context *cmd, int id, struct profile *profi
 {
 	cfg_def_item_t *item = cfg_def_get_item_p(id);
 	char path[CFG_PATH_MAX_LEN];
+	struct config_value *cv;
 	int profile_applied;
 	int b;
 
+	if (_config_value_cached(cmd, (cv = _config_value(cmd, item, profile)), CFG_VALUE_BOOL))
+		return cv->v.i;
+
 	profile_applied = _apply_local_profile(cmd, profile);
 	_cfg_def_make_path(path, sizeof(path), item->id, item, 0);
 
@@ -1406,7 +1552,12 @@ int find_config_tree_bool(struct cmd_context *cmd, int id, struct profile *profi
 					      : dm_config_tree_find_bool(cmd->cft, path, cfg_def_get_default_value(cmd, item, CFG_TYPE_BOOL, profile));
 
 	if (profile_applied && profile)
-		remove_config_tree_by_source(cmd, profile->source);
+		_unapply_local_profile(cmd, profile);
+
+	if (cv) {
+		cv->v.i = b;
+		_config_value_store(cmd, cv, CFG_VALUE_BOOL);
+	}
 
 	return b;
 }
@@ -1506,7 +1657,7 @@ const struct dm_config_node *find_config_tree_array(struct cmd_context *cmd, int
 	}
 
 	if (profile_applied && profile)
-		remove_config_tree_by_source(cmd, profile->source);
+		_unapply_local_profile(cmd, profile);
 
 	return cn;
 }
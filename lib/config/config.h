@@ -35,11 +35,14 @@ typedef enum {
 	CONFIG_FILE_SPECIAL	/* special purpose file config (e.g. metadata, persistent filter...) */
 } config_source_t;
 
+struct config_value;
+
 struct profile {
 	struct dm_list list;
 	config_source_t source; /* either CONFIG_PROFILE_COMMAND or CONFIG_PROFILE_METADATA */
 	const char *name;
 	struct dm_config_tree *cft;
+	struct config_value *values; /* resolved values with this profile applied */
 };
 
 struct profile_params {
@@ -233,6 +236,7 @@ int override_config_tree_from_string(struct cmd_context *cmd, const char *config
 int override_config_tree_from_profile(struct cmd_context *cmd, struct profile *profile);
 struct dm_config_tree *get_config_tree_by_source(struct cmd_context *, config_source_t source);
 struct dm_config_tree *remove_config_tree_by_source(struct cmd_context *cmd, config_source_t source);
+void config_values_invalidate(struct cmd_context *cmd);
 struct cft_check_handle *get_config_tree_check_handle(struct cmd_context *cmd, struct dm_config_tree *cft);
 config_source_t config_get_source_type(struct dm_config_tree *cft);
 
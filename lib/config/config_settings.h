@@ -255,6 +255,24 @@ cfg(devices_external_device_info_source_CFG, "external_device_info_source", devi
 	"    compiled with udev support.\n"
 	"#\n")
 
+cfg(devices_io_engine_CFG, "io_engine", devices_CFG_SECTION, CFG_DEFAULT_COMMENTED, CFG_TYPE_STRING, DEFAULT_IO_ENGINE, vsn(2, 3, 11), NULL, 0, NULL,
+	"The kernel interface used to read and write devices.\n"
+	"An engine that cannot be set up falls back to the next one\n"
+	"in the order io_uring, aio, sync. When global/use_aio is\n"
+	"disabled, sync is always used.\n"
+	"#\n"
+	"Accepted values:\n"
+	"  sync\n"
+	"    Read and write one block at a time.\n"
+	"  aio\n"
+	"    Use Linux native async I/O (libaio).\n"
+	"  io_uring\n"
+	"    Use io_uring, submitting I/O in batches with the cache\n"
+	"    memory and device file descriptors registered with the\n"
+	"    kernel. Applicable only if LVM is compiled with io_uring\n"
+	"    support and the kernel provides it.\n"
+	"#\n")
+
 cfg(devices_hints_CFG, "hints", devices_CFG_SECTION, CFG_DEFAULT_COMMENTED, CFG_TYPE_STRING, DEFAULT_HINTS, vsn(2, 3, 2), NULL, 0, NULL,
 	"Use a local file to remember which devices have PVs on them.\n"
 	"Some commands will use this as an optimization to reduce device\n"
@@ -269,6 +287,24 @@ cfg(devices_hints_CFG, "hints", devices_CFG_SECTION, CFG_DEFAULT_COMMENTED, CFG_
 	"    Use no hints.\n"
 	"#\n")
 
+cfg(devices_session_scan_cache_CFG, "session_scan_cache", devices_CFG_SECTION, CFG_DEFAULT_COMMENTED, CFG_TYPE_BOOL, DEFAULT_SESSION_SCAN_CACHE, vsn(2, 3, 11), NULL, 0, NULL,
+	"Keep the result of a device scan for the following commands.\n"
+	"This applies when one process runs a series of commands, i.e. the\n"
+	"lvm shell or a program using the lvm2cmd library. A command that\n"
+	"can use hints will not scan devices again while the hint file and\n"
+	"the list of devices are unchanged and all PVs are still present.\n"
+	"VG metadata is still checked for changes whenever it is read.\n"
+	"This setting has no effect if hints are disabled.\n")
+
+cfg(devices_filter_cache_CFG, "filter_cache", devices_CFG_SECTION, CFG_DEFAULT_COMMENTED, CFG_TYPE_BOOL, DEFAULT_FILTER_CACHE, vsn(2, 3, 11), NULL, 0, NULL,
+	"Remember device filter results in a file under the run directory.\n"
+	"Later commands reuse a saved result while the device keeps the same\n"
+	"size, names, holders and udev database entry, and the devices\n"
+	"configuration is unchanged. Other devices are filtered again.\n"
+	"Results are not saved for device-mapper and md devices, or for\n"
+	"devices when udev is not running. Disable this if devices will be\n"
+	"changed by a program that does not generate udev events.\n")
+
 cfg_array(devices_preferred_names_CFG, "preferred_names", devices_CFG_SECTION, CFG_ALLOW_EMPTY | CFG_DEFAULT_UNDEFINED , CFG_TYPE_STRING, NULL, vsn(1, 2, 19), NULL, 0, NULL,
 	"Select which path name to display for a block device.\n"
 	"If multiple path names exist for a block device, and LVM needs to\n"
@@ -1148,6 +1184,14 @@ cfg_array(global_thin_check_options_CFG, "thin_check_options", global_CFG_SECTIO
 	"and fix them later. With thin_check version 3.2 or newer you should\n"
 	"include the option --clear-needs-check-flag.\n")
 
+cfg(global_pool_check_skip_unchanged_CFG, "pool_check_skip_unchanged", global_CFG_SECTION, CFG_DEFAULT_COMMENTED, CFG_TYPE_BOOL, DEFAULT_POOL_CHECK_SKIP_UNCHANGED, vsn(2, 3, 11), NULL, 0, NULL,
+	"Do not run thin_check or cache_check on unchanged pool metadata.\n"
+	"After pool metadata passes the check, its superblock is remembered\n"
+	"until the next reboot. The check is skipped while the superblock, the\n"
+	"size of the metadata LV and its clean shutdown flag stay the same.\n"
+	"Only the superblock is compared, damage to other metadata blocks is\n"
+	"not found while the check is skipped.\n")
+
 cfg_array(global_thin_repair_options_CFG, "thin_repair_options", global_CFG_SECTION, CFG_ALLOW_EMPTY | CFG_DEFAULT_COMMENTED, CFG_TYPE_STRING, DEFAULT_THIN_REPAIR_OPTIONS_CONFIG, vsn(2, 2, 100), NULL, 0, NULL,
 	"List of options passed to the thin_repair command.\n")
 
@@ -71,6 +71,7 @@
 #define DEFAULT_LVDISPLAY_SHOWS_FULL_DEVICE_PATH 0
 #define DEFAULT_UNKNOWN_DEVICE_NAME "[unknown]"
 #define DEFAULT_USE_AIO 1
+#define DEFAULT_IO_ENGINE "aio"
 
 #define DEFAULT_SANLOCK_LV_EXTEND_MB 256
 
@@ -130,6 +131,7 @@
 #define DEFAULT_THIN_POOL_ZERO 1
 #define DEFAULT_POOL_METADATA_SPARE 1 /* thin + cache */
 #define DEFAULT_ZERO_METADATA 1		/* thin + cache */
+#define DEFAULT_POOL_CHECK_SKIP_UNCHANGED 0	/* thin + cache */
 
 #ifdef CACHE_CHECK_NEEDS_CHECK
 #  define DEFAULT_CACHE_CHECK_OPTION1 "-q"
@@ -316,6 +318,8 @@
 #define DEFAULT_SCAN_LVS 0
 
 #define DEFAULT_HINTS "all"
+#define DEFAULT_SESSION_SCAN_CACHE 0
+#define DEFAULT_FILTER_CACHE 0
 
 #define DEFAULT_IO_MEMORY_SIZE_KB 8192
 
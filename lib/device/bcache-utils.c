@@ -44,10 +44,8 @@ void bcache_prefetch_bytes(struct bcache *cache, int di, uint64_t start, size_t
 	block_address bb, be;
 
 	byte_range_to_block_range(cache, start, len, &bb, &be);
-	while (bb < be) {
-		bcache_prefetch(cache, di, bb);
-		bb++;
-	}
+	if (bb < be)
+		bcache_prefetch_blocks(cache, di, bb, be - bb);
 }
 
 //----------------------------------------------------------------
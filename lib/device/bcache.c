@@ -15,6 +15,7 @@
 #include "lib/device/bcache.h"
 
 #include "base/data-struct/radix-tree.h"
+#include "base/memory/zalloc.h"
 #include "lib/log/lvm-logging.h"
 #include "lib/log/log.h"
 
@@ -30,6 +31,12 @@
 #include <unistd.h>
 #include <linux/fs.h>
 #include <sys/user.h>
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
 
 #define SECTOR_SHIFT 9L
 
@@ -37,6 +44,17 @@
 static int _fd_table_size;
 static int *_fd_table;
 
+/*
+ * Last byte lvm intends to write on each di.  Blocks dirtied while it is
+ * set remember it, so they are still clamped when written back later by
+ * a flush shared with other devices.
+ */
+struct last_byte {
+	uint64_t offset;
+	int sector_size;
+};
+static struct last_byte *_last_byte_table;
+
 
 //----------------------------------------------------------------
 
@@ -153,10 +171,6 @@ static void _async_destroy(struct io_engine *ioe)
 	free(e);
 }
 
-static int _last_byte_di;
-static uint64_t _last_byte_offset;
-static int _last_byte_sector_size;
-
 static bool _async_issue(struct io_engine *ioe, enum dir d, int di,
 			 sector_t sb, sector_t se, void *data, void *context)
 {
@@ -166,9 +180,6 @@ static bool _async_issue(struct io_engine *ioe, enum dir d, int di,
 	struct async_engine *e = _to_async(ioe);
 	sector_t offset;
 	sector_t nbytes;
-	sector_t limit_nbytes;
-	sector_t orig_nbytes;
-	sector_t extra_nbytes = 0;
 
 	if (((uintptr_t) data) & e->page_mask) {
 		log_warn("misaligned data buffer");
@@ -178,86 +189,6 @@ static bool _async_issue(struct io_engine *ioe, enum dir d, int di,
 	offset = sb << SECTOR_SHIFT;
 	nbytes = (se - sb) << SECTOR_SHIFT;
 
-	/*
-	 * If bcache block goes past where lvm wants to write, then clamp it.
-	 */
-	if ((d == DIR_WRITE) && _last_byte_offset && (di == _last_byte_di)) {
-		if (offset > _last_byte_offset) {
-			log_error("Limit write at %llu len %llu beyond last byte %llu",
-				  (unsigned long long)offset,
-				  (unsigned long long)nbytes,
-				  (unsigned long long)_last_byte_offset);
-			return false;
-		}
-
-		/*
-		 * If the bcache block offset+len goes beyond where lvm is
-		 * intending to write, then reduce the len being written
-		 * (which is the bcache block size) so we don't write past
-		 * the limit set by lvm.  If after applying the limit, the
-		 * resulting size is not a multiple of the sector size (512
-		 * or 4096) then extend the reduced size to be a multiple of
-		 * the sector size (we don't want to write partial sectors.)
-		 */
-		if (offset + nbytes > _last_byte_offset) {
-			limit_nbytes = _last_byte_offset - offset;
-
-			if (limit_nbytes % _last_byte_sector_size) {
-				extra_nbytes = _last_byte_sector_size - (limit_nbytes % _last_byte_sector_size);
-
-				/*
-				 * adding extra_nbytes to the reduced nbytes (limit_nbytes)
-				 * should make the final write size a multiple of the
-				 * sector size.  This should never result in a final size
-				 * larger than the bcache block size (as long as the bcache
-				 * block size is a multiple of the sector size).
-				 */
-				if (limit_nbytes + extra_nbytes > nbytes) {
-					log_warn("Skip extending write at %llu len %llu limit %llu extra %llu sector_size %llu",
-						 (unsigned long long)offset,
-						 (unsigned long long)nbytes,
-						 (unsigned long long)limit_nbytes,
-						 (unsigned long long)extra_nbytes,
-						 (unsigned long long)_last_byte_sector_size);
-					extra_nbytes = 0;
-				}
-			}
-
-			orig_nbytes = nbytes;
-
-			if (extra_nbytes) {
-				log_debug("Limit write at %llu len %llu to len %llu rounded to %llu",
-					  (unsigned long long)offset,
-					  (unsigned long long)nbytes,
-					  (unsigned long long)limit_nbytes,
-					  (unsigned long long)(limit_nbytes + extra_nbytes));
-				nbytes = limit_nbytes + extra_nbytes;
-			} else {
-				log_debug("Limit write at %llu len %llu to len %llu",
-					  (unsigned long long)offset,
-					  (unsigned long long)nbytes,
-					  (unsigned long long)limit_nbytes);
-				nbytes = limit_nbytes;
-			}
-
-			/*
-			 * This shouldn't happen, the reduced+extended
-			 * nbytes value should never be larger than the
-			 * bcache block size.
-			 */
-			if (nbytes > orig_nbytes) {
-				log_error("Invalid adjusted write at %llu len %llu adjusted %llu limit %llu extra %llu sector_size %llu",
-					  (unsigned long long)offset,
-					  (unsigned long long)orig_nbytes,
-					  (unsigned long long)nbytes,
-					  (unsigned long long)limit_nbytes,
-					  (unsigned long long)extra_nbytes,
-					  (unsigned long long)_last_byte_sector_size);
-				return false;
-			}
-		}
-	}
-
 	cb = _cb_alloc(e->cbs, context);
 	if (!cb) {
 		log_warn("couldn't allocate control block");
@@ -331,18 +262,18 @@ static bool _async_wait(struct io_engine *ioe, io_complete_fn fn)
 		cb = _iocb_to_cb((struct iocb *) ev->obj);
 
 		if (ev->res == cb->cb.u.c.nbytes)
-			fn((void *) cb->context, 0);
+			fn((void *) cb->context, 0, ev->res);
 
 		else if ((int) ev->res < 0)
-			fn(cb->context, (int) ev->res);
+			fn(cb->context, (int) ev->res, 0);
 
 		// FIXME: dct added this. a short read is ok?!
 		else if (ev->res >= (1 << SECTOR_SHIFT)) {
 			/* minimum acceptable read is 1 sector */
-			fn((void *) cb->context, 0);
+			fn((void *) cb->context, 0, ev->res);
 
 		} else {
-			fn(cb->context, -ENODATA);
+			fn(cb->context, -ENODATA, 0);
 		}
 
 		_cb_free(e->cbs, cb);
@@ -368,6 +299,7 @@ struct io_engine *create_async_io_engine(void)
 	e->e.issue = _async_issue;
 	e->e.wait = _async_wait;
 	e->e.max_io = _async_max_io;
+	e->e.register_buffers = NULL;
 
 	e->aio_context = 0;
 	r = io_setup(MAX_IO, &e->aio_context);
@@ -391,9 +323,424 @@ struct io_engine *create_async_io_engine(void)
 
 //----------------------------------------------------------------
 
+#ifdef HAVE_LINUX_IO_URING_H
+
+/*
+ * io_uring engine, driven through the raw syscalls.
+ *
+ * Issued io is queued on the submission ring and only submitted in
+ * batches (or when waiting), so a prefetch of many blocks costs a
+ * single syscall.  The cache's block memory is registered with the
+ * ring, as are the fds handed out by bcache_set_fd(), which avoids
+ * mapping the pages and looking up the file for every io.
+ */
+
+#define URING_SUBMIT_BATCH 32
+#define URING_REGISTERED_FILES FD_TABLE_INC
+
+struct uring_io {
+	struct dm_list list;
+	void *context;
+	size_t nbytes;
+	struct iovec iov;
+};
+
+struct uring_engine {
+	struct io_engine e;
+	struct dm_list list;		/* on _uring_engines */
+	int ring_fd;
+
+	void *sq_ring;
+	size_t sq_ring_len;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+
+	void *cq_ring;
+	size_t cq_ring_len;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	unsigned nr_queued;		/* sqes not yet submitted */
+	unsigned nr_in_flight;
+
+	void *buffers;			/* registered block memory */
+	size_t buffers_len;
+
+	int files[URING_REGISTERED_FILES];	/* fd registered for each di */
+	bool files_registered;
+
+	unsigned page_mask;
+	struct dm_list free_ios;
+	struct uring_io ios[MAX_IO];
+};
+
+/* Engines to notify when bcache_set_fd() and friends change the fd table */
+static DM_LIST_INIT(_uring_engines);
+
+static struct uring_engine *_to_uring(struct io_engine *e)
+{
+	return container_of(e, struct uring_engine, e);
+}
+
+static int _io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int _io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int _io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void _uring_update_file(struct uring_engine *e, int di, int fd)
+{
+	struct io_uring_files_update up = {
+		.offset = di,
+		.fds = (uintptr_t) &fd,
+	};
+
+	if (!e->files_registered || (di < 0) || (di >= URING_REGISTERED_FILES) ||
+	    (e->files[di] == fd))
+		return;
+
+	/* On failure the io for this di uses the plain fd */
+	if (_io_uring_register(e->ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1) != 1) {
+		log_debug("io_uring failed to register fd %d for di %d: %s",
+			  fd, di, strerror(errno));
+		fd = -1;
+		(void) _io_uring_register(e->ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1);
+	}
+
+	e->files[di] = fd;
+}
+
+static void _uring_fd_changed(int di, int fd)
+{
+	struct uring_engine *e;
+
+	dm_list_iterate_items(e, &_uring_engines)
+		_uring_update_file(e, di, fd);
+}
+
+static bool _uring_submit(struct uring_engine *e, unsigned min_complete)
+{
+	int r;
+	unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+
+	while (e->nr_queued || min_complete) {
+		r = _io_uring_enter(e->ring_fd, e->nr_queued, min_complete, flags);
+		if (r < 0) {
+			if (errno == EINTR && !min_complete)
+				continue;
+			log_sys_warn("io_uring_enter");
+			return false;
+		}
+
+		e->nr_queued -= r;
+		if (min_complete)
+			break;
+	}
+
+	return true;
+}
+
+static void _uring_destroy(struct io_engine *ioe)
+{
+	struct uring_engine *e = _to_uring(ioe);
+
+	if (e->nr_in_flight)
+		log_error("io_uring io still in flight");
+
+	dm_list_del(&e->list);
+
+	munmap(e->sqes, e->sqes_len);
+	if (e->cq_ring != e->sq_ring)
+		munmap(e->cq_ring, e->cq_ring_len);
+	munmap(e->sq_ring, e->sq_ring_len);
+
+	/* Also drops the registered buffers and files */
+	if (close(e->ring_fd))
+		log_sys_warn("close");
+
+	free(e);
+}
+
+static bool _uring_register_buffers(struct io_engine *ioe, void *data, size_t len)
+{
+	struct uring_engine *e = _to_uring(ioe);
+	struct iovec iov = { .iov_base = data, .iov_len = len };
+
+	if (e->buffers) {
+		(void) _io_uring_register(e->ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+		e->buffers = NULL;
+		e->buffers_len = 0;
+	}
+
+	/* May fail with RLIMIT_MEMLOCK, io then uses unregistered buffers */
+	if (_io_uring_register(e->ring_fd, IORING_REGISTER_BUFFERS, &iov, 1)) {
+		log_debug("io_uring failed to register %llu bytes of buffers: %s",
+			  (unsigned long long) len, strerror(errno));
+		return false;
+	}
+
+	e->buffers = data;
+	e->buffers_len = len;
+
+	return true;
+}
+
+static bool _uring_issue(struct io_engine *ioe, enum dir d, int di,
+			 sector_t sb, sector_t se, void *data, void *context)
+{
+	struct uring_engine *e = _to_uring(ioe);
+	struct io_uring_sqe *sqe;
+	struct uring_io *io;
+	unsigned tail;
+	sector_t offset;
+	sector_t nbytes;
+
+	if (((uintptr_t) data) & e->page_mask) {
+		log_warn("misaligned data buffer");
+		return false;
+	}
+
+	offset = sb << SECTOR_SHIFT;
+	nbytes = (se - sb) << SECTOR_SHIFT;
+
+	if (dm_list_empty(&e->free_ios)) {
+		log_warn("couldn't allocate io_uring io");
+		return false;
+	}
+
+	io = dm_list_item(_list_pop(&e->free_ios), struct uring_io);
+	io->context = context;
+	io->nbytes = nbytes;
+
+	tail = *e->sq_tail;
+	sqe = e->sqes + (tail & *e->sq_mask);
+	memset(sqe, 0, sizeof(*sqe));
+
+	sqe->off = offset;
+	sqe->user_data = (uintptr_t) io;
+
+	if (e->buffers && ((char *) data >= (char *) e->buffers) &&
+	    ((char *) data + nbytes <= (char *) e->buffers + e->buffers_len)) {
+		sqe->opcode = (d == DIR_READ) ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+		sqe->addr = (uintptr_t) data;
+		sqe->len = nbytes;
+		sqe->buf_index = 0;
+	} else {
+		io->iov.iov_base = data;
+		io->iov.iov_len = nbytes;
+		sqe->opcode = (d == DIR_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+		sqe->addr = (uintptr_t) &io->iov;
+		sqe->len = 1;
+	}
+
+	if (di < URING_REGISTERED_FILES && e->files[di] >= 0 && e->files[di] == _fd_table[di]) {
+		sqe->fd = di;
+		sqe->flags = IOSQE_FIXED_FILE;
+	} else
+		sqe->fd = _fd_table[di];
+
+	e->sq_array[tail & *e->sq_mask] = tail & *e->sq_mask;
+	__atomic_store_n(e->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	e->nr_queued++;
+	e->nr_in_flight++;
+
+	if ((e->nr_queued >= URING_SUBMIT_BATCH) && !_uring_submit(e, 0)) {
+		/* The sqe stays queued and is submitted by the next wait */
+		stack;
+	}
+
+	return true;
+}
+
+static bool _uring_wait(struct io_engine *ioe, io_complete_fn fn)
+{
+	struct uring_engine *e = _to_uring(ioe);
+	struct io_uring_cqe *cqe;
+	struct uring_io *io;
+	unsigned head, tail;
+
+	if (!e->nr_in_flight)
+		return true;
+
+	head = *e->cq_head;
+	tail = __atomic_load_n(e->cq_tail, __ATOMIC_ACQUIRE);
+
+	/* Submit anything queued and block for a completion if none are ready */
+	if (!_uring_submit(e, (head == tail) ? 1 : 0))
+		return false;
+
+	tail = __atomic_load_n(e->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++) {
+		cqe = e->cqes + (head & *e->cq_mask);
+		io = (struct uring_io *) (uintptr_t) cqe->user_data;
+
+		if (cqe->res == io->nbytes)
+			fn(io->context, 0, cqe->res);
+
+		else if (cqe->res < 0)
+			fn(io->context, cqe->res, 0);
+
+		/* minimum acceptable read is 1 sector, as with async io */
+		else if (cqe->res >= (1 << SECTOR_SHIFT))
+			fn(io->context, 0, cqe->res);
+
+		else
+			fn(io->context, -ENODATA, 0);
+
+		dm_list_add_h(&e->free_ios, &io->list);
+		e->nr_in_flight--;
+	}
+
+	__atomic_store_n(e->cq_head, head, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static unsigned _uring_max_io(struct io_engine *e)
+{
+	return MAX_IO;
+}
+
+static bool _uring_map_rings(struct uring_engine *e, struct io_uring_params *p)
+{
+	e->sq_ring_len = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	e->cq_ring_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (e->cq_ring_len > e->sq_ring_len)
+			e->sq_ring_len = e->cq_ring_len;
+		e->cq_ring_len = e->sq_ring_len;
+	}
+
+	e->sq_ring = mmap(NULL, e->sq_ring_len, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, e->ring_fd, IORING_OFF_SQ_RING);
+	if (e->sq_ring == MAP_FAILED) {
+		log_sys_warn("mmap");
+		return false;
+	}
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP)
+		e->cq_ring = e->sq_ring;
+	else {
+		e->cq_ring = mmap(NULL, e->cq_ring_len, PROT_READ | PROT_WRITE,
+				  MAP_SHARED | MAP_POPULATE, e->ring_fd, IORING_OFF_CQ_RING);
+		if (e->cq_ring == MAP_FAILED) {
+			log_sys_warn("mmap");
+			munmap(e->sq_ring, e->sq_ring_len);
+			return false;
+		}
+	}
+
+	e->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+	e->sqes = mmap(NULL, e->sqes_len, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, e->ring_fd, IORING_OFF_SQES);
+	if (e->sqes == MAP_FAILED) {
+		log_sys_warn("mmap");
+		if (e->cq_ring != e->sq_ring)
+			munmap(e->cq_ring, e->cq_ring_len);
+		munmap(e->sq_ring, e->sq_ring_len);
+		return false;
+	}
+
+	e->sq_head = (unsigned *) ((char *) e->sq_ring + p->sq_off.head);
+	e->sq_tail = (unsigned *) ((char *) e->sq_ring + p->sq_off.tail);
+	e->sq_mask = (unsigned *) ((char *) e->sq_ring + p->sq_off.ring_mask);
+	e->sq_array = (unsigned *) ((char *) e->sq_ring + p->sq_off.array);
+
+	e->cq_head = (unsigned *) ((char *) e->cq_ring + p->cq_off.head);
+	e->cq_tail = (unsigned *) ((char *) e->cq_ring + p->cq_off.tail);
+	e->cq_mask = (unsigned *) ((char *) e->cq_ring + p->cq_off.ring_mask);
+	e->cqes = (struct io_uring_cqe *) ((char *) e->cq_ring + p->cq_off.cqes);
+
+	return true;
+}
+
+struct io_engine *create_io_uring_engine(void)
+{
+	struct io_uring_params p = { 0 };
+	struct uring_engine *e = zalloc(sizeof(*e));
+	unsigned i;
+
+	if (!e)
+		return NULL;
+
+	e->e.destroy = _uring_destroy;
+	e->e.issue = _uring_issue;
+	e->e.wait = _uring_wait;
+	e->e.max_io = _uring_max_io;
+	e->e.register_buffers = _uring_register_buffers;
+
+	if ((e->ring_fd = _io_uring_setup(MAX_IO, &p)) < 0) {
+		log_debug("io_uring_setup failed: %s", strerror(errno));
+		free(e);
+		return NULL;
+	}
+
+	if (!_uring_map_rings(e, &p)) {
+		(void) close(e->ring_fd);
+		free(e);
+		return NULL;
+	}
+
+	dm_list_init(&e->free_ios);
+	for (i = 0; i < MAX_IO; i++)
+		dm_list_add(&e->free_ios, &e->ios[i].list);
+
+	/*
+	 * Start with an empty (sparse) file table, and register the
+	 * fds already known to bcache.
+	 */
+	for (i = 0; i < URING_REGISTERED_FILES; i++)
+		e->files[i] = -1;
+
+	if (!_io_uring_register(e->ring_fd, IORING_REGISTER_FILES, e->files, URING_REGISTERED_FILES))
+		e->files_registered = true;
+	else
+		log_debug("io_uring failed to register files: %s", strerror(errno));
+
+	for (i = 0; _fd_table && i < (unsigned) _fd_table_size; i++)
+		if (_fd_table[i] >= 0)
+			_uring_update_file(e, i, _fd_table[i]);
+
+	dm_list_add(&_uring_engines, &e->list);
+
+	e->page_mask = sysconf(_SC_PAGESIZE) - 1;
+
+	return &e->e;
+}
+
+#else
+
+struct io_engine *create_io_uring_engine(void)
+{
+	log_debug("io_uring engine is not supported by this build.");
+	return NULL;
+}
+
+static void _uring_fd_changed(int di, int fd)
+{
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
+
+//----------------------------------------------------------------
+
 struct sync_io {
         struct dm_list list;
 	void *context;
+	uint64_t nbytes;
 };
 
 struct sync_engine {
@@ -434,93 +781,11 @@ static bool _sync_issue(struct io_engine *ioe, enum dir d, int di,
 		free(io);
 		return false;
 	}
-	if (off != (off_t) where) {
-		log_warn("Device seek failed for offset %llu", (unsigned long long)where);
-		free(io);
-		return false;
-	}
-
-	/*
-	 * If bcache block goes past where lvm wants to write, then clamp it.
-	 */
-	if ((d == DIR_WRITE) && _last_byte_offset && (di == _last_byte_di)) {
-		uint64_t offset = where;
-		uint64_t nbytes = len;
-		sector_t limit_nbytes = 0;
-		sector_t extra_nbytes = 0;
-		sector_t orig_nbytes = 0;
-
-		if (offset > _last_byte_offset) {
-			log_error("Limit write at %llu len %llu beyond last byte %llu",
-				  (unsigned long long)offset,
-				  (unsigned long long)nbytes,
-				  (unsigned long long)_last_byte_offset);
-			free(io);
-			return false;
-		}
-
-		if (offset + nbytes > _last_byte_offset) {
-			limit_nbytes = _last_byte_offset - offset;
-
-			if (limit_nbytes % _last_byte_sector_size) {
-				extra_nbytes = _last_byte_sector_size - (limit_nbytes % _last_byte_sector_size);
-
-				/*
-				 * adding extra_nbytes to the reduced nbytes (limit_nbytes)
-				 * should make the final write size a multiple of the
-				 * sector size.  This should never result in a final size
-				 * larger than the bcache block size (as long as the bcache
-				 * block size is a multiple of the sector size).
-				 */
-				if (limit_nbytes + extra_nbytes > nbytes) {
-					log_warn("Skip extending write at %llu len %llu limit %llu extra %llu sector_size %llu",
-						 (unsigned long long)offset,
-						 (unsigned long long)nbytes,
-						 (unsigned long long)limit_nbytes,
-						 (unsigned long long)extra_nbytes,
-						 (unsigned long long)_last_byte_sector_size);
-					extra_nbytes = 0;
-				}
-			}
-
-			orig_nbytes = nbytes;
-
-			if (extra_nbytes) {
-				log_debug("Limit write at %llu len %llu to len %llu rounded to %llu",
-					  (unsigned long long)offset,
-					  (unsigned long long)nbytes,
-					  (unsigned long long)limit_nbytes,
-					  (unsigned long long)(limit_nbytes + extra_nbytes));
-				nbytes = limit_nbytes + extra_nbytes;
-			} else {
-				log_debug("Limit write at %llu len %llu to len %llu",
-					  (unsigned long long)offset,
-					  (unsigned long long)nbytes,
-					  (unsigned long long)limit_nbytes);
-				nbytes = limit_nbytes;
-			}
-
-			/*
-			 * This shouldn't happen, the reduced+extended
-			 * nbytes value should never be larger than the
-			 * bcache block size.
-			 */
-			if (nbytes > orig_nbytes) {
-				log_error("Invalid adjusted write at %llu len %llu adjusted %llu limit %llu extra %llu sector_size %llu",
-					  (unsigned long long)offset,
-					  (unsigned long long)orig_nbytes,
-					  (unsigned long long)nbytes,
-					  (unsigned long long)limit_nbytes,
-					  (unsigned long long)extra_nbytes,
-					  (unsigned long long)_last_byte_sector_size);
-				free(io);
-				return false;
-			}
-		}
-
-		where = offset;
-		len = nbytes;
-	}
+	if (off != (off_t) where) {
+		log_warn("Device seek failed for offset %llu", (unsigned long long)where);
+		free(io);
+		return false;
+	}
 
 	while (pos < len) {
 		if (d == DIR_READ)
@@ -565,6 +830,7 @@ static bool _sync_issue(struct io_engine *ioe, enum dir d, int di,
 
 	dm_list_add(&e->complete, &io->list);
 	io->context = context;
+	io->nbytes = pos;
 
 	return true;
 }
@@ -575,7 +841,7 @@ static bool _sync_wait(struct io_engine *ioe, io_complete_fn fn)
 	struct sync_engine *e = _to_sync(ioe);
 
 	dm_list_iterate_items_safe(io, tmp, &e->complete) {
-		fn(io->context, 0);
+		fn(io->context, 0, io->nbytes);
 		dm_list_del(&io->list);
 		free(io);
 	}
@@ -599,6 +865,7 @@ struct io_engine *create_sync_io_engine(void)
         e->e.issue = _sync_issue;
         e->e.wait = _sync_wait;
         e->e.max_io = _sync_max_io;
+	e->e.register_buffers = NULL;
 
         dm_list_init(&e->complete);
         return &e->e;
@@ -610,6 +877,9 @@ struct io_engine *create_sync_io_engine(void)
 #define WRITEBACK_LOW_THRESHOLD_PERCENT 33
 #define WRITEBACK_HIGH_THRESHOLD_PERCENT 66
 
+/* Uncached ranges of at least this many blocks are read with one io */
+#define MIN_RUN_BLOCKS 4
+
 //----------------------------------------------------------------
 
 static void *_alloc_aligned(size_t len, size_t alignment)
@@ -644,18 +914,36 @@ static void _clear_flags(struct block *b, unsigned bits)
 enum block_flags {
 	BF_IO_PENDING = (1 << 0),
 	BF_DIRTY = (1 << 1),
+	BF_PREFETCH = (1 << 2),
+};
+
+/*
+ * Cache blocks are allocated in chunks, so the cache can grow on demand
+ * and give memory back when a whole chunk is free again.  The blocks of
+ * a chunk are contiguous in memory, so a run of them can be read with a
+ * single io.
+ */
+struct bcache_chunk {
+	struct dm_list list;
+	void *data;
+	struct block *blocks;
+	unsigned nr_blocks;
+	unsigned nr_free;
 };
 
 struct bcache {
 	sector_t block_sectors;
 	uint64_t nr_data_blocks;
-	uint64_t nr_cache_blocks;
+	uint64_t nr_cache_blocks;	/* currently allocated */
+	uint64_t nr_target_blocks;	/* grow to this before reusing blocks */
+	uint64_t nr_max_blocks;		/* hard ceiling */
+	unsigned grow_blocks;
 	unsigned max_io;
+	long pgsize;
 
 	struct io_engine *engine;
 
-	void *raw_data;
-	struct block *raw_blocks;
+	struct dm_list chunks;		/* the first is never released */
 
 	/*
 	 * Lists that categorise the blocks.
@@ -663,6 +951,7 @@ struct bcache {
 	unsigned nr_locked;
 	unsigned nr_dirty;
 	unsigned nr_io_pending;
+	unsigned nr_prefetch_pending;
 
 	struct dm_list free;
 	struct dm_list errored;
@@ -670,6 +959,12 @@ struct bcache {
 	struct dm_list clean;
 	struct dm_list io_pending;
 
+	/*
+	 * Prefetched blocks whose io has completed, in completion order,
+	 * linked through prefetch_list.
+	 */
+	struct dm_list completed_prefetches;
+
 	struct radix_tree *rtree;
 
 	/*
@@ -733,51 +1028,142 @@ static void _block_remove(struct block *b)
 
 //----------------------------------------------------------------
 
-static bool _init_free_list(struct bcache *cache, unsigned count, unsigned pgsize)
+/*
+ * Allocates a chunk of count blocks.  The blocks are not put on the
+ * free list.
+ */
+static struct bcache_chunk *_add_chunk(struct bcache *cache, unsigned count)
 {
 	unsigned i;
 	size_t block_size = cache->block_sectors << SECTOR_SHIFT;
-	unsigned char *data =
-		(unsigned char *) _alloc_aligned(count * block_size, pgsize);
+	struct bcache_chunk *c = malloc(sizeof(*c));
+
+	if (!c)
+		return NULL;
 
 	/* Allocate the data for each block.  We page align the data. */
-	if (!data)
-		return false;
+	if (!(c->data = _alloc_aligned(count * block_size, cache->pgsize))) {
+		free(c);
+		return NULL;
+	}
 
-	cache->raw_blocks = malloc(count * sizeof(*cache->raw_blocks));
-	if (!cache->raw_blocks) {
-		free(data);
-		return false;
+	if (!(c->blocks = malloc(count * sizeof(*c->blocks)))) {
+		free(c->data);
+		free(c);
+		return NULL;
 	}
 
-	cache->raw_data = data;
+	c->nr_blocks = count;
+	c->nr_free = 0;
 
 	for (i = 0; i < count; i++) {
-		struct block *b = cache->raw_blocks + i;
+		struct block *b = c->blocks + i;
 		b->cache = cache;
-		b->data = data + (block_size * i);
-		dm_list_add(&cache->free, &b->list);
+		b->chunk = c;
+		b->data = (unsigned char *) c->data + (block_size * i);
+		dm_list_init(&b->list);
+		dm_list_init(&b->prefetch_list);
 	}
 
+	dm_list_add(&cache->chunks, &c->list);
+	cache->nr_cache_blocks += count;
+
+	return c;
+}
+
+static void _free_chunk(struct bcache *cache, struct bcache_chunk *c)
+{
+	dm_list_del(&c->list);
+	cache->nr_cache_blocks -= c->nr_blocks;
+	free(c->data);
+	free(c->blocks);
+	free(c);
+}
+
+static void _free_block(struct block *b);
+
+/*
+ * Adds up to grow_blocks free blocks, without going over limit.
+ */
+static bool _grow(struct bcache *cache, uint64_t limit)
+{
+	struct bcache_chunk *c;
+	uint64_t count = cache->grow_blocks;
+	unsigned i;
+
+	if (cache->nr_cache_blocks >= limit)
+		return false;
+
+	if (count > limit - cache->nr_cache_blocks)
+		count = limit - cache->nr_cache_blocks;
+
+	if (!(c = _add_chunk(cache, count)))
+		return false;
+
+	for (i = 0; i < c->nr_blocks; i++)
+		_free_block(c->blocks + i);
+
+	log_debug("bcache grown to %llu blocks.", (unsigned long long) cache->nr_cache_blocks);
+
 	return true;
 }
 
-static void _exit_free_list(struct bcache *cache)
+/*
+ * Releases chunks that are entirely free, while the cache is larger
+ * than its target size.
+ */
+static void _shrink(struct bcache *cache)
+{
+	struct bcache_chunk *c, *tmp;
+	unsigned i;
+
+	dm_list_iterate_items_safe(c, tmp, &cache->chunks) {
+		if (cache->nr_cache_blocks <= cache->nr_target_blocks)
+			break;
+
+		if ((c->list.p == &cache->chunks) || (c->nr_free != c->nr_blocks))
+			continue;
+
+		for (i = 0; i < c->nr_blocks; i++)
+			dm_list_del(&c->blocks[i].list);
+
+		_free_chunk(cache, c);
+
+		log_debug("bcache shrunk to %llu blocks.", (unsigned long long) cache->nr_cache_blocks);
+	}
+}
+
+static void _exit_chunks(struct bcache *cache)
 {
-	free(cache->raw_data);
-	free(cache->raw_blocks);
+	struct bcache_chunk *c, *tmp;
+
+	dm_list_iterate_items_safe(c, tmp, &cache->chunks)
+		_free_chunk(cache, c);
 }
 
 static struct block *_alloc_block(struct bcache *cache)
 {
+	struct block *b;
+
 	if (dm_list_empty(&cache->free))
 		return NULL;
 
-	return dm_list_struct_base(_list_pop(&cache->free), struct block, list);
+	b = dm_list_struct_base(_list_pop(&cache->free), struct block, list);
+	b->chunk->nr_free--;
+
+	return b;
+}
+
+static void _forget_prefetch(struct block *b)
+{
+	dm_list_del(&b->prefetch_list);
+	dm_list_init(&b->prefetch_list);
 }
 
 static void _free_block(struct block *b)
 {
+	_forget_prefetch(b);
+	b->chunk->nr_free++;
 	dm_list_add(&b->cache->free, &b->list);
 }
 
@@ -824,14 +1210,18 @@ static void _relink(struct block *b)
  *
  *--------------------------------------------------------------*/
 
-static void _complete_io(void *context, int err)
+static void _complete_block(struct block *b, int err)
 {
-	struct block *b = context;
 	struct bcache *cache = b->cache;
 
 	b->error = err;
 	_clear_flags(b, BF_IO_PENDING);
-	cache->nr_io_pending--;
+
+	if (_test_flags(b, BF_PREFETCH)) {
+		_clear_flags(b, BF_PREFETCH);
+		cache->nr_prefetch_pending--;
+		dm_list_add(&cache->completed_prefetches, &b->prefetch_list);
+	}
 
 	/*
 	 * b is on the io_pending list, so we don't want to use unlink_block.
@@ -848,6 +1238,133 @@ static void _complete_io(void *context, int err)
 	}
 }
 
+static void _issue_low_level(struct block *b, enum dir d);
+
+/*
+ * The context is the first block of the io, which may cover a run of
+ * blocks from the same chunk.  Blocks of a run not fully covered by a
+ * short read are read again on their own, so they end up the same as a
+ * single block read near the end of the device would.
+ */
+static void _complete_io(void *context, int err, sector_t nbytes)
+{
+	struct block *b = context;
+	struct bcache *cache = b->cache;
+	unsigned i, nr = b->io_blocks;
+	sector_t covered = nr;
+
+	cache->nr_io_pending--;
+
+	if (!err && (nr > 1))
+		covered = nbytes / (cache->block_sectors << SECTOR_SHIFT);
+
+	for (i = 0; i < nr; i++)
+		if (i < covered)
+			_complete_block(b + i, err);
+		else {
+			_clear_flags(b + i, BF_IO_PENDING);
+			_issue_low_level(b + i, DIR_READ);
+		}
+}
+
+/*
+ * If bcache block goes past where lvm wants to write, then clamp the
+ * end sector of its writeback.
+ * Returns false if the write must not be issued at all.
+ */
+static bool _limit_write(struct block *b, sector_t sb, sector_t *se)
+{
+	sector_t offset = sb << SECTOR_SHIFT;
+	sector_t nbytes = (*se - sb) << SECTOR_SHIFT;
+	sector_t limit_nbytes;
+	sector_t orig_nbytes;
+	sector_t extra_nbytes = 0;
+	uint64_t last_byte = b->last_byte;
+	int sector_size = b->last_byte_sector_size;
+
+	if (last_byte) {
+		if (offset > last_byte) {
+			log_error("Limit write at %llu len %llu beyond last byte %llu",
+				  (unsigned long long)offset,
+				  (unsigned long long)nbytes,
+				  (unsigned long long)last_byte);
+			return false;
+		}
+
+		/*
+		 * If the bcache block offset+len goes beyond where lvm is
+		 * intending to write, then reduce the len being written
+		 * (which is the bcache block size) so we don't write past
+		 * the limit set by lvm.  If after applying the limit, the
+		 * resulting size is not a multiple of the sector size (512
+		 * or 4096) then extend the reduced size to be a multiple of
+		 * the sector size (we don't want to write partial sectors.)
+		 */
+		if (offset + nbytes > last_byte) {
+			limit_nbytes = last_byte - offset;
+
+			if (limit_nbytes % sector_size) {
+				extra_nbytes = sector_size - (limit_nbytes % sector_size);
+
+				/*
+				 * adding extra_nbytes to the reduced nbytes (limit_nbytes)
+				 * should make the final write size a multiple of the
+				 * sector size.  This should never result in a final size
+				 * larger than the bcache block size (as long as the bcache
+				 * block size is a multiple of the sector size).
+				 */
+				if (limit_nbytes + extra_nbytes > nbytes) {
+					log_warn("Skip extending write at %llu len %llu limit %llu extra %llu sector_size %llu",
+						 (unsigned long long)offset,
+						 (unsigned long long)nbytes,
+						 (unsigned long long)limit_nbytes,
+						 (unsigned long long)extra_nbytes,
+						 (unsigned long long)sector_size);
+					extra_nbytes = 0;
+				}
+			}
+
+			orig_nbytes = nbytes;
+
+			if (extra_nbytes) {
+				log_debug("Limit write at %llu len %llu to len %llu rounded to %llu",
+					  (unsigned long long)offset,
+					  (unsigned long long)nbytes,
+					  (unsigned long long)limit_nbytes,
+					  (unsigned long long)(limit_nbytes + extra_nbytes));
+				nbytes = limit_nbytes + extra_nbytes;
+			} else {
+				log_debug("Limit write at %llu len %llu to len %llu",
+					  (unsigned long long)offset,
+					  (unsigned long long)nbytes,
+					  (unsigned long long)limit_nbytes);
+				nbytes = limit_nbytes;
+			}
+
+			/*
+			 * This shouldn't happen, the reduced+extended
+			 * nbytes value should never be larger than the
+			 * bcache block size.
+			 */
+			if (nbytes > orig_nbytes) {
+				log_error("Invalid adjusted write at %llu len %llu adjusted %llu limit %llu extra %llu sector_size %llu",
+					  (unsigned long long)offset,
+					  (unsigned long long)orig_nbytes,
+					  (unsigned long long)nbytes,
+					  (unsigned long long)limit_nbytes,
+					  (unsigned long long)extra_nbytes,
+					  (unsigned long long)sector_size);
+				return false;
+			}
+		}
+	}
+
+	/* The engines take whole sectors */
+	*se = sb + ((nbytes + (1 << SECTOR_SHIFT) - 1) >> SECTOR_SHIFT);
+
+	return true;
+}
+
 /*
  * |b->list| should be valid (either pointing to itself, on one of the other
  * lists.
@@ -862,14 +1379,20 @@ static void _issue_low_level(struct block *b, enum dir d)
 		return;
 
 	b->io_dir = d;
+	b->io_blocks = 1;
 	_set_flags(b, BF_IO_PENDING);
 	cache->nr_io_pending++;
 
 	dm_list_move(&cache->io_pending, &b->list);
 
+	if ((d == DIR_WRITE) && !_limit_write(b, sb, &se)) {
+		_complete_io(b, -EIO, 0);
+		return;
+	}
+
 	if (!cache->engine->issue(cache->engine, d, b->di, sb, se, b->data, b)) {
 		/* FIXME: if io_submit() set an errno, return that instead of EIO? */
-		_complete_io(b, -EIO);
+		_complete_io(b, -EIO, 0);
 		return;
 	}
 }
@@ -884,6 +1407,30 @@ static inline void _issue_write(struct block *b)
 	_issue_low_level(b, DIR_WRITE);
 }
 
+/*
+ * Reads nr blocks, which are consecutive in a chunk and on disk, with a
+ * single io.
+ */
+static void _issue_read_run(struct block *b, unsigned nr)
+{
+	struct bcache *cache = b->cache;
+	sector_t sb = b->index * cache->block_sectors;
+	sector_t se = sb + nr * cache->block_sectors;
+	unsigned i;
+
+	for (i = 0; i < nr; i++) {
+		b[i].io_dir = DIR_READ;
+		_set_flags(b + i, BF_IO_PENDING);
+		dm_list_move(&cache->io_pending, &b[i].list);
+	}
+
+	b->io_blocks = nr;
+	cache->nr_io_pending++;
+
+	if (!cache->engine->issue(cache->engine, DIR_READ, b->di, sb, se, b->data, b))
+		_complete_io(b, -EIO, 0);
+}
+
 static bool _wait_io(struct bcache *cache)
 {
 	return cache->engine->wait(cache->engine, _complete_io);
@@ -948,12 +1495,30 @@ static struct block *_new_block(struct bcache *cache, int di, block_address i, b
 	struct block *b;
 
 	b = _alloc_block(cache);
+
+	/* Grow to the target size before reusing blocks */
+	if (!b && _grow(cache, cache->nr_target_blocks))
+		b = _alloc_block(cache);
+
 	while (!b) {
 		b = _find_unused_clean_block(cache);
 		if (!b) {
 			if (can_wait) {
-				if (dm_list_empty(&cache->io_pending))
-					_writeback(cache, 16);  // FIXME: magic number
+				/*
+				 * If there's no io to wait for, every block is
+				 * held, so growing is the only way forward.
+				 */
+				if (dm_list_empty(&cache->io_pending) &&
+				    !_writeback(cache, 16)) {  // FIXME: magic number
+					if (!_grow(cache, cache->nr_max_blocks)) {
+						log_debug("bcache no new blocks for di %d index %u at %llu blocks.",
+							  di, (uint32_t) i,
+							  (unsigned long long) cache->nr_cache_blocks);
+						return NULL;
+					}
+					b = _alloc_block(cache);
+					continue;
+				}
 				_wait_all(cache);
 				if (dm_list_size(&cache->errored) >= cache->max_io) {
 					log_debug("bcache no new blocks for di %d index %u with >%d errors.",
@@ -970,6 +1535,8 @@ static struct block *_new_block(struct bcache *cache, int di, block_address i, b
 
 	if (b) {
 		dm_list_init(&b->list);
+		_forget_prefetch(b);
+		b->io_blocks = 1;
 		b->flags = 0;
 		b->di = di;
 		b->index = i;
@@ -1016,11 +1583,31 @@ static void _miss(struct bcache *cache, unsigned flags)
 		cache->read_misses++;
 }
 
+/*
+ * A block dirtied again before writeback keeps the widest limit,
+ * unlimited if any of its writes was.
+ */
+static void _set_write_limit(struct block *b, int was_dirty)
+{
+	const struct last_byte *lb = &_last_byte_table[b->di];
+
+	if (!was_dirty || !lb->offset) {
+		b->last_byte = lb->offset;
+		b->last_byte_sector_size = lb->sector_size;
+	} else if (b->last_byte) {
+		if (lb->offset > b->last_byte)
+			b->last_byte = lb->offset;
+		if (lb->sector_size > b->last_byte_sector_size)
+			b->last_byte_sector_size = lb->sector_size;
+	}
+}
+
 static struct block *_lookup_or_read_block(struct bcache *cache,
 				  	   int di, block_address i,
 					   unsigned flags)
 {
 	struct block *b = _block_lookup(cache, di, i);
+	int was_dirty = 0;
 
 	if (b) {
 		// FIXME: this is insufficient.  We need to also catch a read
@@ -1038,6 +1625,7 @@ static struct block *_lookup_or_read_block(struct bcache *cache,
 			_hit(b, flags);
 
 		_unlink_block(b);
+		was_dirty = _test_flags(b, BF_DIRTY);
 
 		if (flags & GF_ZERO)
 			_zero_block(b);
@@ -1061,8 +1649,10 @@ static struct block *_lookup_or_read_block(struct bcache *cache,
 	}
 
 	if (b) {
-		if (flags & (GF_DIRTY | GF_ZERO))
+		if (flags & (GF_DIRTY | GF_ZERO)) {
+			_set_write_limit(b, was_dirty);
 			_set_flags(b, BF_DIRTY);
+		}
 
 		_link_block(b);
 		return b;
@@ -1086,8 +1676,17 @@ static void _preemptive_writeback(struct bcache *cache)
  *--------------------------------------------------------------*/
 struct bcache *bcache_create(sector_t block_sectors, unsigned nr_cache_blocks,
 			     struct io_engine *engine)
+{
+	return bcache_create_growable(block_sectors, nr_cache_blocks, nr_cache_blocks,
+				      nr_cache_blocks, engine);
+}
+
+struct bcache *bcache_create_growable(sector_t block_sectors, unsigned initial_blocks,
+				      unsigned nr_cache_blocks, unsigned max_blocks,
+				      struct io_engine *engine)
 {
 	struct bcache *cache;
+	struct bcache_chunk *c;
 	unsigned max_io = engine->max_io(engine);
 	long pgsize = sysconf(_SC_PAGESIZE);
 	int i;
@@ -1102,6 +1701,12 @@ struct bcache *bcache_create(sector_t block_sectors, unsigned nr_cache_blocks,
 		return NULL;
 	}
 
+	if (!initial_blocks || (initial_blocks > nr_cache_blocks) ||
+	    (nr_cache_blocks > max_blocks)) {
+		log_warn("bcache sizes must satisfy 0 < initial <= nr_cache_blocks <= max");
+		return NULL;
+	}
+
 	if (!block_sectors) {
 		log_warn("bcache must have a non zero block size");
 		return NULL;
@@ -1117,7 +1722,11 @@ struct bcache *bcache_create(sector_t block_sectors, unsigned nr_cache_blocks,
 		return NULL;
 
 	cache->block_sectors = block_sectors;
-	cache->nr_cache_blocks = nr_cache_blocks;
+	cache->nr_cache_blocks = 0;
+	cache->nr_target_blocks = nr_cache_blocks;
+	cache->nr_max_blocks = max_blocks;
+	cache->grow_blocks = initial_blocks;
+	cache->pgsize = pgsize;
 	cache->max_io = nr_cache_blocks < max_io ? nr_cache_blocks : max_io;
 	cache->engine = engine;
 	cache->nr_locked = 0;
@@ -1129,6 +1738,9 @@ struct bcache *bcache_create(sector_t block_sectors, unsigned nr_cache_blocks,
 	dm_list_init(&cache->dirty);
 	dm_list_init(&cache->clean);
 	dm_list_init(&cache->io_pending);
+	dm_list_init(&cache->completed_prefetches);
+	dm_list_init(&cache->chunks);
+	cache->nr_prefetch_pending = 0;
 
         cache->rtree = radix_tree_create(NULL, NULL);
 	if (!cache->rtree) {
@@ -1144,17 +1756,21 @@ struct bcache *bcache_create(sector_t block_sectors, unsigned nr_cache_blocks,
 	cache->write_misses = 0;
 	cache->prefetches = 0;
 
-	if (!_init_free_list(cache, nr_cache_blocks, pgsize)) {
+	if (!(c = _add_chunk(cache, initial_blocks))) {
 		cache->engine->destroy(cache->engine);
 		radix_tree_destroy(cache->rtree);
 		free(cache);
 		return NULL;
 	}
 
+	for (i = 0; i < (int) c->nr_blocks; i++)
+		_free_block(c->blocks + i);
+
 	_fd_table_size = FD_TABLE_INC;
 
 	if (!(_fd_table = malloc(sizeof(int) * _fd_table_size))) {
 		cache->engine->destroy(cache->engine);
+		_exit_chunks(cache);
 		radix_tree_destroy(cache->rtree);
 		free(cache);
 		return NULL;
@@ -1163,6 +1779,22 @@ struct bcache *bcache_create(sector_t block_sectors, unsigned nr_cache_blocks,
 	for (i = 0; i < _fd_table_size; i++)
 		_fd_table[i] = -1;
 
+	if (!(_last_byte_table = calloc(_fd_table_size, sizeof(*_last_byte_table)))) {
+		free(_fd_table);
+		_fd_table = NULL;
+		cache->engine->destroy(cache->engine);
+		_exit_chunks(cache);
+		radix_tree_destroy(cache->rtree);
+		free(cache);
+		return NULL;
+	}
+
+	/* Only the first chunk, which is kept for the life of the cache */
+	if (engine->register_buffers &&
+	    !engine->register_buffers(engine, c->data,
+				      (size_t) initial_blocks * block_sectors << SECTOR_SHIFT))
+		log_debug("Using unregistered buffers for bcache io.");
+
 	return cache;
 }
 
@@ -1174,12 +1806,14 @@ void bcache_destroy(struct bcache *cache)
 	if (!bcache_flush(cache))
 		stack;
 	_wait_all(cache);
-	_exit_free_list(cache);
+	_exit_chunks(cache);
 	radix_tree_destroy(cache->rtree);
 	cache->engine->destroy(cache->engine);
 	free(cache);
 	free(_fd_table);
 	_fd_table = NULL;
+	free(_last_byte_table);
+	_last_byte_table = NULL;
 	_fd_table_size = 0;
 }
 
@@ -1207,12 +1841,95 @@ void bcache_prefetch(struct bcache *cache, int di, block_address i)
 			b = _new_block(cache, di, i, false);
 			if (b) {
 				cache->prefetches++;
+				cache->nr_prefetch_pending++;
+				_set_flags(b, BF_PREFETCH);
 				_issue_read(b);
 			}
 		}
 	}
 }
 
+static bool _range_cached(struct bcache *cache, int di, block_address i, unsigned nr)
+{
+	unsigned j;
+
+	for (j = 0; j < nr; j++)
+		if (_block_lookup(cache, di, i + j))
+			return true;
+
+	return false;
+}
+
+void bcache_prefetch_blocks(struct bcache *cache, int di, block_address i, unsigned nr)
+{
+	struct bcache_chunk *c;
+	struct block *b;
+	unsigned j, nr_inserted;
+
+	/*
+	 * A large uncached range is read with a single io into a new chunk,
+	 * so it is neither split into block sized ios nor limited by the
+	 * target size of the cache.
+	 */
+	if ((nr >= MIN_RUN_BLOCKS) && (cache->nr_io_pending < cache->max_io) &&
+	    (cache->nr_cache_blocks + nr <= cache->nr_max_blocks) &&
+	    !_range_cached(cache, di, i, nr) &&
+	    (c = _add_chunk(cache, nr))) {
+		for (j = 0; j < nr; j++) {
+			b = c->blocks + j;
+			b->flags = BF_PREFETCH;
+			b->di = di;
+			b->index = i + j;
+			b->ref_count = 0;
+			b->error = 0;
+			b->io_blocks = 1;
+
+			if (!_block_insert(b)) {
+				log_error("bcache unable to insert block in radix tree (OOM?)");
+				break;
+			}
+
+			cache->prefetches++;
+			cache->nr_prefetch_pending++;
+		}
+		nr_inserted = j;
+
+		/* Blocks that could not be inserted go on the free list */
+		for (; j < nr; j++) {
+			c->blocks[j].flags = 0;
+			_free_block(c->blocks + j);
+		}
+
+		if (nr_inserted)
+			_issue_read_run(c->blocks, nr_inserted);
+		return;
+	}
+
+	for (j = 0; j < nr; j++)
+		bcache_prefetch(cache, di, i + j);
+}
+
+bool bcache_next_prefetch(struct bcache *cache, int *di, block_address *i)
+{
+	struct block *b;
+
+	while (dm_list_empty(&cache->completed_prefetches)) {
+		if (!cache->nr_prefetch_pending)
+			return false;
+
+		if (!_wait_io(cache))
+			return false;
+	}
+
+	b = dm_list_struct_base(_list_pop(&cache->completed_prefetches), struct block, prefetch_list);
+	dm_list_init(&b->prefetch_list);
+
+	*di = b->di;
+	*i = b->index;
+
+	return true;
+}
+
 //----------------------------------------------------------------
 
 static void _recycle_block(struct bcache *cache, struct block *b)
@@ -1302,6 +2019,17 @@ bool bcache_flush(struct bcache *cache)
 	return dm_list_empty(&cache->errored);
 }
 
+bool bcache_write_failed_di(struct bcache *cache, int di)
+{
+	struct block *b;
+
+	dm_list_iterate_items(b, &cache->errored)
+		if (b->di == di)
+			return true;
+
+	return false;
+}
+
 //----------------------------------------------------------------
 /*
  * You can safely call this with a NULL block.
@@ -1400,8 +2128,10 @@ bool bcache_invalidate_di(struct bcache *cache, int di)
 	it.it.visit = _invalidate_v;
 	radix_tree_iterate(cache->rtree, k.bytes, k.bytes + sizeof(k.parts.di), &it.it);
 
-	if (it.success)
+	if (it.success) {
 		radix_tree_remove_prefix(cache->rtree, k.bytes, k.bytes + sizeof(k.parts.di));
+		_shrink(cache);
+	}
 
 	return it.success;
 }
@@ -1437,30 +2167,32 @@ void bcache_abort_di(struct bcache *cache, int di)
 	it.visit = _abort_v;
 	radix_tree_iterate(cache->rtree, k.bytes, k.bytes + sizeof(k.parts.di), &it);
 	radix_tree_remove_prefix(cache->rtree, k.bytes, k.bytes + sizeof(k.parts.di));
+	_shrink(cache);
 }
 
 //----------------------------------------------------------------
 
 void bcache_set_last_byte(struct bcache *cache, int di, uint64_t offset, int sector_size)
 {
-	_last_byte_di = di;
-	_last_byte_offset = offset;
-	_last_byte_sector_size = sector_size;
-	if (!sector_size)
-		_last_byte_sector_size = 512;
+	if ((di < 0) || (di >= _fd_table_size))
+		return;
+
+	_last_byte_table[di].offset = offset;
+	_last_byte_table[di].sector_size = sector_size ? : 512;
 }
 
 void bcache_unset_last_byte(struct bcache *cache, int di)
 {
-	if (_last_byte_di == di) {
-		_last_byte_di = 0;
-		_last_byte_offset = 0;
-		_last_byte_sector_size = 0;
-	}
+	if ((di < 0) || (di >= _fd_table_size))
+		return;
+
+	_last_byte_table[di].offset = 0;
+	_last_byte_table[di].sector_size = 0;
 }
 
 int bcache_set_fd(int fd)
 {
+	struct last_byte *new_last_byte;
 	int *new_table = NULL;
 	int new_size = 0;
 	int i;
@@ -1469,6 +2201,9 @@ int bcache_set_fd(int fd)
 	for (i = 0; i < _fd_table_size; i++) {
 		if (_fd_table[i] == -1) {
 			_fd_table[i] = fd;
+			_last_byte_table[i].offset = 0;
+			_last_byte_table[i].sector_size = 0;
+			_uring_fd_changed(i, fd);
 			return i;
 		}
 	}
@@ -1489,6 +2224,16 @@ int bcache_set_fd(int fd)
 		new_table[i] = -1;
 
 	_fd_table = new_table;
+
+	if (!(new_last_byte = realloc(_last_byte_table, sizeof(*new_last_byte) * new_size))) {
+		log_error("Cannot extend bcache last byte table");
+		return -1;
+	}
+
+	memset(new_last_byte + _fd_table_size, 0,
+	       sizeof(*new_last_byte) * (new_size - _fd_table_size));
+
+	_last_byte_table = new_last_byte;
 	_fd_table_size = new_size;
 
 	goto retry;
@@ -1505,6 +2250,7 @@ void bcache_clear_fd(int di)
 	if (di >= _fd_table_size)
 		return;
 	_fd_table[di] = -1;
+	_uring_fd_changed(di, -1);
 }
 
 int bcache_change_fd(int di, int fd)
@@ -1516,6 +2262,7 @@ int bcache_change_fd(int di, int fd)
 		return 0;
 	}
 	_fd_table[di] = fd;
+	_uring_fd_changed(di, fd);
 	return 1;
 }
 
@@ -30,7 +30,11 @@ enum dir {
 typedef uint64_t block_address;
 typedef uint64_t sector_t;
 
-typedef void io_complete_fn(void *context, int io_error);
+/*
+ * nbytes is the length transferred, a read may complete short of the
+ * length issued at the end of a device.
+ */
+typedef void io_complete_fn(void *context, int io_error, sector_t nbytes);
 
 struct io_engine {
 	void (*destroy)(struct io_engine *e);
@@ -38,14 +42,20 @@ struct io_engine {
 		      sector_t sb, sector_t se, void *data, void *context);
 	bool (*wait)(struct io_engine *e, io_complete_fn fn);
 	unsigned (*max_io)(struct io_engine *e);
+
+	/* Optional, lets the engine pin the memory used for the cache blocks. */
+	bool (*register_buffers)(struct io_engine *e, void *data, size_t len);
 };
 
 struct io_engine *create_async_io_engine(void);
 struct io_engine *create_sync_io_engine(void);
+/* Returns NULL if io_uring is not supported by the build or the kernel. */
+struct io_engine *create_io_uring_engine(void);
 
 /*----------------------------------------------------------------*/
 
 struct bcache;
+struct bcache_chunk;
 struct block {
 	/* clients may only access these three fields */
 	int di;
@@ -53,12 +63,17 @@ struct block {
 	void *data;
 
 	struct bcache *cache;
+	struct bcache_chunk *chunk;
 	struct dm_list list;
+	struct dm_list prefetch_list;	/* on the completed prefetches list */
 
 	unsigned flags;
 	unsigned ref_count;
 	int error;
 	enum dir io_dir;
+	unsigned io_blocks;		/* blocks covered by an io issued for this one */
+	uint64_t last_byte;		/* writeback is clamped here, if set */
+	int last_byte_sector_size;
 };
 
 /*
@@ -66,6 +81,18 @@ struct block {
  */
 struct bcache *bcache_create(sector_t block_size, unsigned nr_cache_blocks,
 			     struct io_engine *engine);
+
+/*
+ * A growable cache allocates initial_blocks up front, then more in steps of
+ * initial_blocks as they are needed, up to nr_cache_blocks.  Past that,
+ * clean blocks are reused, and the cache only grows further (up to
+ * max_blocks) when every block is held, or to read a large range with
+ * bcache_prefetch_blocks().  Memory above nr_cache_blocks is released as
+ * blocks are invalidated.  bcache_create() is a cache of fixed size.
+ */
+struct bcache *bcache_create_growable(sector_t block_size, unsigned initial_blocks,
+				      unsigned nr_cache_blocks, unsigned max_blocks,
+				      struct io_engine *engine);
 void bcache_destroy(struct bcache *cache);
 
 enum bcache_get_flags {
@@ -104,10 +131,26 @@ unsigned bcache_max_prefetches(struct bcache *cache);
  *
  * It's slightly sub optimal, since you may not run the gets in the order that
  * they complete.  But we're talking a very small difference, and it's worth it
- * to keep callbacks out of this interface.
+ * to keep callbacks out of this interface.  When the processing is expensive,
+ * bcache_next_prefetch() gives the blocks in the order they complete.
  */
 void bcache_prefetch(struct bcache *cache, int di, block_address index);
 
+/*
+ * Returns the di and index of a prefetched block whose io has completed,
+ * in the order the io completed, waiting for io if none has yet.
+ * Returns false once every prefetch has been reported.  A block may
+ * be evicted before it is reported, or after, so callers still need
+ * bcache_get(), and must not rely on every prefetch being reported.
+ */
+bool bcache_next_prefetch(struct bcache *cache, int *di, block_address *index);
+
+/*
+ * Prefetches nr consecutive blocks.  If enough of them are wanted, and
+ * none are cached, they are read with a single io.
+ */
+void bcache_prefetch_blocks(struct bcache *cache, int di, block_address index, unsigned nr);
+
 /*
  * Returns true on success.
  */
@@ -121,6 +164,13 @@ void bcache_put(struct block *b);
  */
 bool bcache_flush(struct bcache *cache);
 
+/*
+ * Dirty blocks of many di can be left for one flush() to write back
+ * together.  After such a flush this tells whether the writeback of
+ * any block of the given di failed.
+ */
+bool bcache_write_failed_di(struct bcache *cache, int di);
+
 /*
  * Removes a block from the cache.
  * 
@@ -16,7 +16,8 @@
 #include "base/memory/zalloc.h"
 #include "lib/misc/lib.h"
 #include "lib/device/dev-type.h"
-#include "lib/datastruct/btree.h"
+#include "base/data-struct/radix-tree.h"
+#include "base/memory/container_of.h"
 #include "lib/config/config.h"
 #include "lib/commands/toolcontext.h"
 #include "device_mapper/misc/dm-ioctl.h"
@@ -29,7 +30,9 @@
 #include <dirent.h>
 
 struct dev_iter {
-	struct btree_iter *current;
+	struct device **devs;	/* snapshot of _cache.devices */
+	unsigned nr_devs;
+	unsigned current;
 	struct dev_filter *filter;
 };
 
@@ -43,8 +46,7 @@ static struct {
 	struct dm_hash_table *names;
 	struct dm_hash_table *vgid_index;
 	struct dm_hash_table *lvid_index;
-	struct btree *sysfs_only_devices; /* see comments in _get_device_for_sysfs_dev_name_using_devno */
-	struct btree *devices;
+	struct radix_tree *devices;	/* devno index, see _devno_key() */
 	struct dm_regex *preferred_names_matcher;
 	const char *dev_dir;
 
@@ -58,6 +60,82 @@ static struct {
 #define _free(x) dm_pool_free(_cache.mem, (x))
 #define _strdup(x) dm_pool_strdup(_cache.mem, (x))
 
+/*
+ * _cache.devices indexes devices by devno.  The first key byte says
+ * whether the device was found in dev_dir or is only known from sysfs
+ * (see comments in _get_device_for_sysfs_dev_name_using_devno), followed
+ * by the devno.
+ */
+#define DEVNO_KEY_DEV		0
+#define DEVNO_KEY_SYSFS_ONLY	1
+#define DEVNO_KEY_LEN		(1 + sizeof(uint64_t))
+
+static uint8_t *_devno_key(uint8_t *k, uint8_t type, dev_t devno)
+{
+	uint64_t d = (uint64_t) devno;
+	int i;
+
+	k[0] = type;
+	for (i = sizeof(d); i > 0; i--, d >>= 8)
+		k[i] = d & 0xff;
+
+	return k;
+}
+
+static struct device *_lookup_devno(uint8_t type, dev_t devno)
+{
+	uint8_t k[DEVNO_KEY_LEN];
+	union radix_value v;
+
+	_devno_key(k, type, devno);
+
+	return radix_tree_lookup(_cache.devices, k, k + sizeof(k), &v) ? v.ptr : NULL;
+}
+
+static int _insert_devno(uint8_t type, dev_t devno, struct device *dev)
+{
+	uint8_t k[DEVNO_KEY_LEN];
+	union radix_value v = { .ptr = dev };
+
+	_devno_key(k, type, devno);
+
+	return radix_tree_insert(_cache.devices, k, k + sizeof(k), v);
+}
+
+struct devno_iterator {
+	struct radix_tree_iterator it;
+	int (*fn)(struct device *dev, void *baton);
+	void *baton;
+	int r;
+};
+
+static bool _devno_visit(struct radix_tree_iterator *it,
+			 uint8_t *kb, uint8_t *ke, union radix_value v)
+{
+	struct devno_iterator *dit = container_of(it, struct devno_iterator, it);
+
+	return (dit->r = dit->fn(v.ptr, dit->baton)) > 0;
+}
+
+/*
+ * Call fn for each device found in dev_dir until it returns 0 (stop)
+ * or a negative value (stop with failure).
+ */
+static int _iterate_devs(int (*fn)(struct device *dev, void *baton), void *baton)
+{
+	uint8_t type = DEVNO_KEY_DEV;
+	struct devno_iterator dit = {
+		.it.visit = _devno_visit,
+		.fn = fn,
+		.baton = baton,
+		.r = 1,
+	};
+
+	radix_tree_iterate(_cache.devices, &type, &type + 1, &dit.it);
+
+	return dit.r;
+}
+
 static int _insert(const char *path, const struct stat *info,
 		   int rec, int check_with_udev_db);
 
@@ -452,8 +530,8 @@ static struct device *_insert_sysfs_dev(dev_t devno, const char *devname)
 		return NULL;
 	}
 
-	if (!btree_insert(_cache.sysfs_only_devices, (uint32_t) devno, dev)) {
-		log_error("Couldn't add device to binary tree of sysfs-only devices in dev cache.");
+	if (!_insert_devno(DEVNO_KEY_SYSFS_ONLY, devno, dev)) {
+		log_error("Couldn't add device to index of sysfs-only devices in dev cache.");
 		_free(dev);
 		return NULL;
 	}
@@ -483,7 +561,7 @@ static struct device *_get_device_for_sysfs_dev_name_using_devno(const char *dev
 	}
 
 	devno = MKDEV(major, minor);
-	if (!(dev = (struct device *) btree_lookup(_cache.devices, (uint32_t) devno))) {
+	if (!(dev = _lookup_devno(DEVNO_KEY_DEV, devno))) {
 		/*
 		 * If we get here, it means the device is referenced in sysfs, but it's not yet in /dev.
 		 * This may happen in some rare cases right after LVs get created - we sync with udev
@@ -493,9 +571,9 @@ static struct device *_get_device_for_sysfs_dev_name_using_devno(const char *dev
 		 * problem with devtmpfs as there's at least kernel name for device in /dev as soon
 		 * as the sysfs item exists, but we still support environments without devtmpfs or
 		 * where different directory for dev nodes is used (e.g. our test suite). So track
-		 * such devices in _cache.sysfs_only_devices hash for the vgid/lvid check to work still.
+		 * such devices as sysfs-only in _cache.devices for the vgid/lvid check to work still.
 		 */
-		if (!(dev = (struct device *) btree_lookup(_cache.sysfs_only_devices, (uint32_t) devno)) &&
+		if (!(dev = _lookup_devno(DEVNO_KEY_SYSFS_ONLY, devno)) &&
 		    !(dev = _insert_sysfs_dev(devno, devname)))
 			return_NULL;
 	}
@@ -693,7 +771,7 @@ static int _insert_dev(const char *path, dev_t d)
 	struct device *dev_by_path;
 	char *path_copy;
 
-	dev_by_devt = (struct device *) btree_lookup(_cache.devices, (uint32_t) d);
+	dev_by_devt = _lookup_devno(DEVNO_KEY_DEV, d);
 	dev_by_path = (struct device *) dm_hash_lookup(_cache.names, path);
 	dev = dev_by_devt;
 
@@ -713,14 +791,14 @@ static int _insert_dev(const char *path, dev_t d)
 		log_debug_devs("Found dev %d:%d %s - new.",
 			       (int)MAJOR(d), (int)MINOR(d), path);
 
-		if (!(dev = (struct device *) btree_lookup(_cache.sysfs_only_devices, (uint32_t) d))) {
+		if (!(dev = _lookup_devno(DEVNO_KEY_SYSFS_ONLY, d))) {
 			/* create new device */
 			if (!(dev = _dev_create(d)))
 				return_0;
 		}
 
-		if (!(btree_insert(_cache.devices, (uint32_t) d, dev))) {
-			log_error("Couldn't insert device into binary tree.");
+		if (!_insert_devno(DEVNO_KEY_DEV, d, dev)) {
+			log_error("Couldn't insert device into dev cache index.");
 			_free(dev);
 			return 0;
 		}
@@ -777,14 +855,14 @@ static int _insert_dev(const char *path, dev_t d)
 			       (int)MAJOR(d), (int)MINOR(d), path,
 			       (int)MAJOR(dev_by_path->dev), (int)MINOR(dev_by_path->dev));
 
-		if (!(dev = (struct device *) btree_lookup(_cache.sysfs_only_devices, (uint32_t) d))) {
+		if (!(dev = _lookup_devno(DEVNO_KEY_SYSFS_ONLY, d))) {
 			/* create new device */
 			if (!(dev = _dev_create(d)))
 				return_0;
 		}
 
-		if (!(btree_insert(_cache.devices, (uint32_t) d, dev))) {
-			log_error("Couldn't insert device into binary tree.");
+		if (!_insert_devno(DEVNO_KEY_DEV, d, dev)) {
+			log_error("Couldn't insert device into dev cache index.");
 			_free(dev);
 			return 0;
 		}
@@ -904,20 +982,21 @@ static int _insert_dir(const char *dir)
 	return r;
 }
 
-static int _dev_cache_iterate_devs_for_index(void)
+static int _index_dev(struct device *dev, void *baton)
 {
-	struct btree_iter *iter = btree_first(_cache.devices);
-	struct device *dev;
-	int r = 1;
+	int *r = baton;
 
-	while (iter) {
-		dev = btree_get_data(iter);
+	if (!_index_dev_by_vgid_and_lvid(dev))
+		*r = 0;
 
-		if (!_index_dev_by_vgid_and_lvid(dev))
-			r = 0;
+	return 1;
+}
 
-		iter = btree_next(iter);
-	}
+static int _dev_cache_iterate_devs_for_index(void)
+{
+	int r = 1;
+
+	(void) _iterate_devs(_index_dev, &r);
 
 	return r;
 }
@@ -951,8 +1030,8 @@ static int _dev_cache_iterate_sysfs_for_index(const char *path)
 		}
 
 		devno = MKDEV(major, minor);
-		if (!(dev = (struct device *) btree_lookup(_cache.devices, (uint32_t) devno)) &&
-		    !(dev = (struct device *) btree_lookup(_cache.sysfs_only_devices, (uint32_t) devno))) {
+		if (!(dev = _lookup_devno(DEVNO_KEY_DEV, devno)) &&
+		    !(dev = _lookup_devno(DEVNO_KEY_SYSFS_ONLY, devno))) {
 			if (!dm_device_get_name(major, minor, 1, devname, sizeof(devname)) ||
 			    !(dev = _insert_sysfs_dev(devno, devname))) {
 				partial_failure = 1;
@@ -1261,13 +1340,8 @@ int dev_cache_init(struct cmd_context *cmd)
 		return_0;
 	}
 
-	if (!(_cache.devices = btree_create(_cache.mem))) {
-		log_error("Couldn't create binary tree for dev-cache.");
-		goto bad;
-	}
-
-	if (!(_cache.sysfs_only_devices = btree_create(_cache.mem))) {
-		log_error("Couldn't create binary tree for sysfs-only devices in dev cache.");
+	if (!(_cache.devices = radix_tree_create(NULL, NULL))) {
+		log_error("Couldn't create devno index for dev-cache.");
 		goto bad;
 	}
 
@@ -1339,6 +1413,9 @@ int dev_cache_exit(void)
 	if (_cache.lvid_index)
 		dm_hash_destroy(_cache.lvid_index);
 
+	if (_cache.devices)
+		radix_tree_destroy(_cache.devices);
+
 	memset(&_cache, 0, sizeof(_cache));
 
 	return (!num_open);
@@ -1484,29 +1561,12 @@ struct device *dev_cache_get(struct cmd_context *cmd, const char *name, struct d
 	return d;
 }
 
-static struct device *_dev_cache_seek_devt(dev_t dev)
-{
-	struct device *d = NULL;
-	struct dm_hash_node *n = dm_hash_get_first(_cache.names);
-	while (n) {
-		d = dm_hash_get_data(_cache.names, n);
-		if (d->dev == dev)
-			return d;
-		n = dm_hash_get_next(_cache.names, n);
-	}
-	return NULL;
-}
-
-/*
- * TODO This is very inefficient. We probably want a hash table indexed by
- * major:minor for keys to speed up these lookups.
- */
 struct device *dev_cache_get_by_devt(struct cmd_context *cmd, dev_t dev, struct dev_filter *f, int *filtered)
 {
 	char path[PATH_MAX];
 	const char *sysfs_dir;
 	struct stat info;
-	struct device *d = _dev_cache_seek_devt(dev);
+	struct device *d = _lookup_devno(DEVNO_KEY_DEV, dev);
 	int ret;
 
 	if (filtered)
@@ -1535,7 +1595,7 @@ struct device *dev_cache_get_by_devt(struct cmd_context *cmd, dev_t dev, struct
 		log_debug_devs("Device num not found in dev_cache repeat dev_cache_scan for %d:%d",
 				(int)MAJOR(dev), (int)MINOR(dev));
 		dev_cache_scan();
-		d = _dev_cache_seek_devt(dev);
+		d = _lookup_devno(DEVNO_KEY_DEV, dev);
 	}
 
 	if (!d)
@@ -1563,16 +1623,48 @@ struct device *dev_cache_get_by_devt(struct cmd_context *cmd, dev_t dev, struct
 	return NULL;
 }
 
+static int _cmp_devno(const void *a, const void *b)
+{
+	const struct device *dev_a = *(const struct device * const *) a;
+	const struct device *dev_b = *(const struct device * const *) b;
+
+	if (dev_a->dev < dev_b->dev)
+		return -1;
+
+	return dev_a->dev > dev_b->dev;
+}
+
+static int _add_iter_dev(struct device *dev, void *baton)
+{
+	struct dev_iter *di = baton;
+
+	di->devs[di->nr_devs++] = dev;
+
+	return 1;
+}
+
 struct dev_iter *dev_iter_create(struct dev_filter *f, int unused)
 {
-	struct dev_iter *di = malloc(sizeof(*di));
+	struct dev_iter *di = zalloc(sizeof(*di));
 
 	if (!di) {
 		log_error("dev_iter allocation failed");
 		return NULL;
 	}
 
-	di->current = btree_first(_cache.devices);
+	/* Sized for all indexed devices, including sysfs-only ones */
+	if (radix_tree_size(_cache.devices) &&
+	    !(di->devs = malloc(sizeof(*di->devs) * radix_tree_size(_cache.devices)))) {
+		log_error("dev_iter allocation failed");
+		free(di);
+		return NULL;
+	}
+
+	(void) _iterate_devs(_add_iter_dev, di);
+
+	/* Callers such as the hints rely on a stable order */
+	qsort(di->devs, di->nr_devs, sizeof(*di->devs), _cmp_devno);
+
 	di->filter = f;
 	if (di->filter)
 		di->filter->use_count++;
@@ -1584,14 +1676,13 @@ void dev_iter_destroy(struct dev_iter *iter)
 {
 	if (iter->filter)
 		iter->filter->use_count--;
+	free(iter->devs);
 	free(iter);
 }
 
 static struct device *_iter_next(struct dev_iter *iter)
 {
-	struct device *d = btree_get_data(iter->current);
-	iter->current = btree_next(iter->current);
-	return d;
+	return iter->devs[iter->current++];
 }
 
 struct device *dev_iter_get(struct cmd_context *cmd, struct dev_iter *iter)
@@ -1599,7 +1690,7 @@ struct device *dev_iter_get(struct cmd_context *cmd, struct dev_iter *iter)
 	struct dev_filter *f;
 	int ret;
 
-	while (iter->current) {
+	while (iter->current < iter->nr_devs) {
 		struct device *d = _iter_next(iter);
 		ret = 1;
 
@@ -1633,19 +1724,12 @@ const char *dev_name(const struct device *dev)
 	    unknown_device_name();
 }
 
-bool dev_cache_has_md_with_end_superblock(struct dev_types *dt)
+static int _not_md_with_end_superblock(struct device *dev, void *baton)
 {
-	struct btree_iter *iter = btree_first(_cache.devices);
-	struct device *dev;
-
-	while (iter) {
-		dev = btree_get_data(iter);
-
-		if (dev_is_md_with_end_superblock(dt, dev))
-			return true;
-
-		iter = btree_next(iter);
-	}
+	return !dev_is_md_with_end_superblock(baton, dev);
+}
 
-	return false;
+bool dev_cache_has_md_with_end_superblock(struct dev_types *dt)
+{
+	return !_iterate_devs(_not_md_with_end_superblock, dt);
 }
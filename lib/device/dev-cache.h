@@ -22,6 +22,17 @@
 
 struct cmd_context;
 
+/*
+ * Relative cost of running a filter on one device.
+ * Composite filter runs cheaper filters first.
+ */
+typedef enum {
+	FILTER_COST_MEMORY,	/* checks data already in memory */
+	FILTER_COST_SYSFS,	/* reads sysfs or udev database */
+	FILTER_COST_IOCTL,	/* issues ioctls on the device */
+	FILTER_COST_READ	/* reads device content */
+} filter_cost_t;
+
 /*
  * predicate for devices.
  */
@@ -29,9 +40,11 @@ struct dev_filter {
 	int (*passes_filter) (struct cmd_context *cmd, struct dev_filter *f, struct device *dev, const char *use_filter_name);
 	void (*destroy) (struct dev_filter *f);
 	void (*wipe) (struct cmd_context *cmd, struct dev_filter *f, struct device *dev, const char *use_filter_name);
+	void (*log_stats) (struct dev_filter *f);	/* optional, logs and resets use statistics */
 	void *private;
 	unsigned use_count;
 	const char *name;
+	filter_cost_t cost;
 };
 
 int dev_cache_index_devs(void);
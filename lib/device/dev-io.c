@@ -387,7 +387,7 @@ int dev_open_flags(struct device *dev, int flags, int direct, int quiet)
 	dev->open_count++;
 
 	if (need_rw)
-		dev->flags |= DEV_OPENED_RW;
+		dev->flags |= DEV_OPENED_RW | DEV_WRITE_OPENED;
 	else
 		dev->flags &= ~DEV_OPENED_RW;
 
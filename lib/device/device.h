@@ -38,6 +38,8 @@
 #define DEV_SCAN_FOUND_LABEL	0x00010000      /* label scan read dev and found label */
 #define DEV_IS_MD_COMPONENT	0x00020000	/* device is an md component */
 #define DEV_UDEV_INFO_MISSING   0x00040000	/* we have no udev info for this device */
+#define DEV_WRITE_FAILED	0x00080000	/* batched write to the device failed */
+#define DEV_WRITE_OPENED	0x00100000	/* opened writable since last filter cache save */
 
 /*
  * Support for external device info.
@@ -18,18 +18,36 @@
 #include "lib/filters/filter.h"
 #include "lib/device/device.h"
 
+/*
+ * Filters of the composite ordered by cost, with statistics
+ * of their use.  The list ends with a NULL filter.
+ */
+struct composite_entry {
+	struct dev_filter *filter;
+	unsigned calls;
+	unsigned rejects;
+	uint64_t ns;
+};
+
 static int _and_p(struct cmd_context *cmd, struct dev_filter *f, struct device *dev, const char *use_filter_name)
 {
-	struct dev_filter **filters;
+	struct composite_entry *e;
+	uint64_t start;
 	int ret;
 
-	for (filters = (struct dev_filter **) f->private; *filters; ++filters) {
-		if (use_filter_name && strcmp((*filters)->name, use_filter_name))
+	for (e = (struct composite_entry *) f->private; e->filter; ++e) {
+		if (use_filter_name && strcmp(e->filter->name, use_filter_name))
 			continue;
-		ret = (*filters)->passes_filter(cmd, *filters, dev, use_filter_name);
 
-		if (!ret)
+		start = lvm_monotonic_ns();
+		ret = e->filter->passes_filter(cmd, e->filter, dev, use_filter_name);
+		e->ns += lvm_monotonic_ns() - start;
+		e->calls++;
+
+		if (!ret) {
+			e->rejects++;
 			return 0;	/* No 'stack': a filter, not an error. */
+		}
 	}
 
 	return 1;
@@ -48,59 +66,93 @@ static int _and_p_with_dev_ext_info(struct cmd_context *cmd, struct dev_filter *
 
 static void _composite_destroy(struct dev_filter *f)
 {
-	struct dev_filter **filters;
+	struct composite_entry *e;
 
 	if (f->use_count)
 		log_error(INTERNAL_ERROR "Destroying composite filter while in use %u times.", f->use_count);
 
-	for (filters = (struct dev_filter **) f->private; *filters; ++filters)
-		(*filters)->destroy(*filters);
+	for (e = (struct composite_entry *) f->private; e->filter; ++e)
+		e->filter->destroy(e->filter);
 
 	free(f->private);
 	free(f);
 }
 
+static void _log_stats(struct dev_filter *f)
+{
+	struct composite_entry *e;
+
+	for (e = (struct composite_entry *) f->private; e->filter; ++e) {
+		if (!e->calls)
+			continue;
+
+		log_debug_devs("Filter %s checked %u devices, rejected %u in %.6fs.",
+			       e->filter->name, e->calls, e->rejects, e->ns / 1e9);
+		e->calls = e->rejects = 0;
+		e->ns = 0;
+	}
+}
+
 static void _wipe(struct cmd_context *cmd, struct dev_filter *f, struct device *dev, const char *use_filter_name)
 {
-	struct dev_filter **filters;
+	struct composite_entry *e;
 
-	for (filters = (struct dev_filter **) f->private; *filters; ++filters) {
-		if (use_filter_name && strcmp((*filters)->name, use_filter_name))
+	for (e = (struct composite_entry *) f->private; e->filter; ++e) {
+		if (use_filter_name && strcmp(e->filter->name, use_filter_name))
 			continue;
-		if ((*filters)->wipe)
-			(*filters)->wipe(cmd, *filters, dev, use_filter_name);
+		if (e->filter->wipe)
+			e->filter->wipe(cmd, e->filter, dev, use_filter_name);
 	}
 }
 
+/*
+ * Filters only ever reject devices, so they can run in any order.
+ * Cheaper filters go first, so fewer devices reach the expensive ones.
+ * Filters of the same cost keep the order given by the caller.
+ */
 struct dev_filter *composite_filter_create(int n, int use_dev_ext_info, struct dev_filter **filters)
 {
-	struct dev_filter **filters_copy, *cft;
+	struct composite_entry *entries;
+	struct dev_filter *cft;
+	filter_cost_t cost;
+	int i, nr = 0;
 
 	if (!filters)
 		return_NULL;
 
-	if (!(filters_copy = malloc(sizeof(*filters) * (n + 1)))) {
+	if (!(entries = zalloc(sizeof(*entries) * (n + 1)))) {
 		log_error("Composite filters allocation failed.");
 		return NULL;
 	}
 
-	memcpy(filters_copy, filters, sizeof(*filters) * n);
-	filters_copy[n] = NULL;
+	for (cost = FILTER_COST_MEMORY; cost <= FILTER_COST_READ; cost++)
+		for (i = 0; i < n; i++)
+			if (filters[i]->cost == cost)
+				entries[nr++].filter = filters[i];
+
+	if (nr != n) {
+		log_error(INTERNAL_ERROR "Composite filter with unknown filter cost.");
+		free(entries);
+		return NULL;
+	}
 
 	if (!(cft = zalloc(sizeof(*cft)))) {
 		log_error("Composite filters allocation failed.");
-		free(filters_copy);
+		free(entries);
 		return NULL;
 	}
 
 	cft->passes_filter = use_dev_ext_info ? _and_p_with_dev_ext_info : _and_p;
 	cft->destroy = _composite_destroy;
 	cft->wipe = _wipe;
+	cft->log_stats = _log_stats;
 	cft->use_count = 0;
-	cft->private = filters_copy;
+	cft->private = entries;
 	cft->name = "composite";
+	cft->cost = nr ? entries[nr - 1].filter->cost : FILTER_COST_MEMORY;
 
-	log_debug_devs("Composite filter initialised.");
+	for (i = 0; i < n; i++)
+		log_debug_devs("Composite filter %d: %s.", i, entries[i].filter->name);
 
 	return cft;
 }
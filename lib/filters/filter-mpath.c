@@ -338,6 +338,7 @@ struct dev_filter *mpath_filter_create(struct dev_types *dt)
 	mp->f.use_count = 0;
 	mp->f.private = mp;
 	mp->f.name = "mpath";
+	mp->f.cost = FILTER_COST_SYSFS;
 
 	mp->mem = mem;
 	mp->dt = dt;
@@ -17,11 +17,44 @@
 #include "lib/misc/lib.h"
 #include "lib/filters/filter.h"
 #include "lib/config/config.h"
+#include "lib/commands/toolcontext.h"
+#include "lib/misc/crc.h"
+#include "lvm-version.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define FILTER_CACHE_FILE DEFAULT_RUN_DIR "/filter_cache"
+#define FILTER_CACHE_VERSION 1
+#define UDEV_DATA_DIR "/run/udev/data"
+
+/*
+ * What a saved filter result depends on besides the device content,
+ * which is covered by the udev database entry being rewritten on change.
+ */
+struct pf_ident {
+	uint64_t size;		/* sectors, from sysfs */
+	uint64_t udev_ns;	/* mtime of the udev database entry */
+	uint32_t holders;
+	uint32_t names;		/* crc of all device names */
+};
+
+struct pf_saved {
+	struct pf_ident id;
+	uint32_t filtered_flags;
+	int good;
+};
 
 struct pfilter {
 	struct dm_hash_table *devices;
 	struct dev_filter *real;
 	struct dev_types *dt;
+	struct dm_pool *saved_mem;
+	struct dm_hash_table *saved;	/* devno -> pf_saved, with devices/filter_cache */
+	uint32_t config_hash;
+	unsigned saved_checked:1;
+	unsigned saved_dirty:1;
 };
 
 /*
@@ -64,6 +97,302 @@ static int _init_hash(struct pfilter *pf)
 	return 1;
 }
 
+/*
+ * Filter results can also be saved in FILTER_CACHE_FILE for later commands.
+ * A saved result is used only while the device identity recorded with it
+ * still matches, and the file is ignored when the devices configuration
+ * changes.  Devices whose filter results can change without a udev event
+ * (dm and md devices, e.g. by suspend) are never saved, and neither are
+ * devices this command opened for writing, since it may have changed what
+ * the signature, partition and md filters would find.
+ */
+
+static int _config_hash_line(const char *line, void *baton)
+{
+	uint32_t *hash = baton;
+
+	*hash = calc_crc(*hash, (const uint8_t *)line, strlen(line));
+
+	return 1;
+}
+
+static uint32_t _config_hash(struct cmd_context *cmd)
+{
+	uint32_t hash = calc_crc(INITIAL_CRC, (const uint8_t *)LVM_VERSION, strlen(LVM_VERSION));
+	const struct dm_config_node *cn;
+	struct dm_config_tree *cft;
+
+	for (cft = cmd->cft; cft; cft = cft->cascade)
+		if ((cn = dm_config_find_node(cft->root, "devices")))
+			(void) dm_config_write_one_node(cn, _config_hash_line, &hash);
+
+	return hash;
+}
+
+/* The device may have been changed by this command. */
+static int _dev_written(const struct device *dev)
+{
+	return (dev->flags & (DEV_WRITE_OPENED | DEV_BCACHE_WRITE)) ? 1 : 0;
+}
+
+static int _dev_ident(struct pfilter *pf, struct device *dev, struct pf_ident *id)
+{
+	int major = (int)MAJOR(dev->dev), minor = (int)MINOR(dev->dev);
+	unsigned long long size;
+	char path[PATH_MAX];
+	struct dm_str_list *sl;
+	struct dirent *dirent;
+	struct stat buf;
+	DIR *dr;
+	FILE *fp;
+	int r;
+
+	if (dm_is_dm_major(major) || (major == pf->dt->md_major))
+		return 0;
+
+	if (_dev_written(dev))
+		return 0;
+
+	if ((dm_snprintf(path, sizeof(path), UDEV_DATA_DIR "/b%d:%d", major, minor) < 0) ||
+	    stat(path, &buf))
+		return 0;
+
+	id->udev_ns = (uint64_t) buf.st_mtim.tv_sec * 1000000000 + buf.st_mtim.tv_nsec;
+
+	if (dm_snprintf(path, sizeof(path), "%sdev/block/%d:%d/size", dm_sysfs_dir(), major, minor) < 0)
+		return 0;
+
+	if (!(fp = fopen(path, "r")))
+		return 0;
+
+	r = (fscanf(fp, "%llu", &size) == 1);
+
+	if (fclose(fp))
+		log_sys_debug("fclose", path);
+
+	if (!r)
+		return 0;
+
+	id->size = size;
+	id->holders = 0;
+
+	if (dm_snprintf(path, sizeof(path), "%sdev/block/%d:%d/holders", dm_sysfs_dir(), major, minor) < 0)
+		return 0;
+
+	if ((dr = opendir(path))) {
+		while ((dirent = readdir(dr)))
+			if (dirent->d_name[0] != '.')
+				id->holders++;
+		if (closedir(dr))
+			log_sys_debug("closedir", path);
+	}
+
+	id->names = INITIAL_CRC;
+	dm_list_iterate_items(sl, &dev->aliases)
+		id->names = calc_crc(id->names, (const uint8_t *)sl->str, strlen(sl->str) + 1);
+
+	return 1;
+}
+
+static void _saved_insert(struct pfilter *pf, dev_t devno, const struct pf_ident *id,
+			  uint32_t filtered_flags, int good)
+{
+	struct pf_saved *ps;
+
+	if (!(ps = dm_hash_lookup_binary(pf->saved, &devno, sizeof(devno)))) {
+		if (!(ps = dm_pool_zalloc(pf->saved_mem, sizeof(*ps))) ||
+		    !dm_hash_insert_binary(pf->saved, &devno, sizeof(devno), ps)) {
+			log_debug_devs("Failed to save filter result for %d:%d.",
+				       (int)MAJOR(devno), (int)MINOR(devno));
+			return;
+		}
+	}
+
+	ps->id = *id;
+	ps->filtered_flags = filtered_flags;
+	ps->good = good;
+}
+
+static void _saved_load(struct cmd_context *cmd, struct pfilter *pf)
+{
+	char line[256];
+	unsigned major, minor, filtered_flags, version, hash;
+	unsigned long long size, udev_ns;
+	struct pf_ident id;
+	char result;
+	FILE *fp;
+
+	pf->saved_checked = 1;
+
+	if (!find_config_tree_bool(cmd, devices_filter_cache_CFG, NULL))
+		return;
+
+	if (!(pf->saved_mem = dm_pool_create("filter_cache", 1024)) ||
+	    !(pf->saved = dm_hash_create(128))) {
+		log_debug_devs("Failed to create filter cache.");
+		if (pf->saved_mem)
+			dm_pool_destroy(pf->saved_mem);
+		pf->saved_mem = NULL;
+		return;
+	}
+
+	pf->config_hash = _config_hash(cmd);
+
+	if (!(fp = fopen(FILTER_CACHE_FILE, "r"))) {
+		if (errno != ENOENT)
+			log_sys_debug("fopen", FILTER_CACHE_FILE);
+		pf->saved_dirty = 1;
+		return;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#')
+			continue;
+
+		if (sscanf(line, "filter_cache_version: %u", &version) == 1) {
+			if (version != FILTER_CACHE_VERSION)
+				break;
+			continue;
+		}
+
+		if (sscanf(line, "config_hash: %x", &hash) == 1) {
+			if (hash != pf->config_hash) {
+				log_debug_devs("Ignoring filter cache with different configuration.");
+				break;
+			}
+			continue;
+		}
+
+		if (sscanf(line, "%u:%u %llu %llu %u %x %c %x", &major, &minor, &size, &udev_ns,
+			   &id.holders, &id.names, &result, &filtered_flags) != 8)
+			continue;
+
+		id.size = size;
+		id.udev_ns = udev_ns;
+		_saved_insert(pf, MKDEV(major, minor), &id, filtered_flags, (result == 'G'));
+	}
+
+	if (fclose(fp))
+		log_sys_debug("fclose", FILTER_CACHE_FILE);
+
+	if (!dm_hash_get_num_entries(pf->saved))
+		pf->saved_dirty = 1;
+}
+
+/* Returns the saved result for the device if its identity is unchanged. */
+static struct pf_saved *_saved_lookup(struct pfilter *pf, struct device *dev)
+{
+	struct pf_saved *ps;
+	struct pf_ident id;
+
+	if (!(ps = dm_hash_lookup_binary(pf->saved, &dev->dev, sizeof(dev->dev))))
+		return NULL;
+
+	if (!_dev_ident(pf, dev, &id) ||
+	    (id.size != ps->id.size) || (id.udev_ns != ps->id.udev_ns) ||
+	    (id.holders != ps->id.holders) || (id.names != ps->id.names)) {
+		log_debug_devs("%s: filter cache file entry changed", dev_name(dev));
+		dm_hash_remove_binary(pf->saved, &dev->dev, sizeof(dev->dev));
+		pf->saved_dirty = 1;
+		return NULL;
+	}
+
+	return ps;
+}
+
+static void _saved_update(struct pfilter *pf, struct device *dev, int good)
+{
+	struct pf_ident id;
+
+	if (!_dev_ident(pf, dev, &id))
+		return;
+
+	_saved_insert(pf, dev->dev, &id, dev->filtered_flags, good);
+	pf->saved_dirty = 1;
+}
+
+static void _saved_write(struct cmd_context *cmd, struct pfilter *pf)
+{
+	char tmp[PATH_MAX];
+	struct dm_hash_node *n;
+	struct pf_saved *ps;
+	const dev_t *devno;
+	time_t t;
+	FILE *fp;
+
+	if (dm_snprintf(tmp, sizeof(tmp), FILTER_CACHE_FILE ".%d", getpid()) < 0)
+		return;
+
+	if (!dm_create_dir(DEFAULT_RUN_DIR))
+		return;
+
+	if (!(fp = fopen(tmp, "w"))) {
+		log_sys_debug("fopen", tmp);
+		return;
+	}
+
+	t = time(NULL);
+	fprintf(fp, "# Created by %s pid %d %s", cmd->name, getpid(), ctime(&t));
+	fprintf(fp, "filter_cache_version: %u\n", FILTER_CACHE_VERSION);
+	fprintf(fp, "config_hash: %x\n", pf->config_hash);
+
+	dm_hash_iterate(n, pf->saved) {
+		ps = dm_hash_get_data(pf->saved, n);
+		devno = (const dev_t *) dm_hash_get_key(pf->saved, n);
+		fprintf(fp, "%d:%d %llu %llu %u %x %c %x\n",
+			(int)MAJOR(*devno), (int)MINOR(*devno),
+			(unsigned long long) ps->id.size, (unsigned long long) ps->id.udev_ns,
+			ps->id.holders, ps->id.names, ps->good ? 'G' : 'B', ps->filtered_flags);
+	}
+
+	if (fclose(fp)) {
+		log_sys_debug("fclose", tmp);
+		goto bad;
+	}
+
+	if (rename(tmp, FILTER_CACHE_FILE)) {
+		log_sys_debug("rename", FILTER_CACHE_FILE);
+		goto bad;
+	}
+
+	log_debug_devs("Saved %u filter results in " FILTER_CACHE_FILE ".",
+		       dm_hash_get_num_entries(pf->saved));
+	pf->saved_dirty = 0;
+	return;
+bad:
+	if (unlink(tmp))
+		log_sys_debug("unlink", tmp);
+}
+
+void persistent_filter_save(struct cmd_context *cmd, struct dev_filter *f)
+{
+	struct pfilter *pf = (struct pfilter *) f->private;
+	struct dev_iter *iter;
+	struct device *dev;
+
+	if (!pf->saved)
+		return;
+
+	/* Drop results the writes of this command may have changed. */
+	if (!(iter = dev_iter_create(NULL, 0)))
+		return;
+
+	while ((dev = dev_iter_get(cmd, iter))) {
+		if (!_dev_written(dev))
+			continue;
+		if (dm_hash_lookup_binary(pf->saved, &dev->dev, sizeof(dev->dev))) {
+			dm_hash_remove_binary(pf->saved, &dev->dev, sizeof(dev->dev));
+			pf->saved_dirty = 1;
+		}
+		dev->flags &= ~DEV_WRITE_OPENED;
+	}
+
+	dev_iter_destroy(iter);
+
+	if (pf->saved_dirty)
+		_saved_write(cmd, pf);
+}
+
 static void _persistent_filter_wipe(struct cmd_context *cmd, struct dev_filter *f, struct device *dev, const char *use_filter_name)
 {
 	struct pfilter *pf = (struct pfilter *) f->private;
@@ -74,15 +403,46 @@ static void _persistent_filter_wipe(struct cmd_context *cmd, struct dev_filter *
 	} else {
 		dm_list_iterate_items(sl, &dev->aliases)
 			dm_hash_remove(pf->devices, sl->str);
+
+		/* The caller wants the filters checked again. */
+		if (pf->saved &&
+		    dm_hash_lookup_binary(pf->saved, &dev->dev, sizeof(dev->dev))) {
+			dm_hash_remove_binary(pf->saved, &dev->dev, sizeof(dev->dev));
+			pf->saved_dirty = 1;
+		}
 	}
 }
 
+/*
+ * Forget the result kept in memory for dev after nodata filtering, which
+ * is not the complete result.  A result saved in the filter cache file is
+ * complete, so it is kept.
+ */
+void persistent_filter_forget(struct dev_filter *f, struct device *dev)
+{
+	struct pfilter *pf = (struct pfilter *) f->private;
+	struct dm_str_list *sl;
+
+	dm_list_iterate_items(sl, &dev->aliases)
+		dm_hash_remove(pf->devices, sl->str);
+}
+
+static void _persistent_log_stats(struct dev_filter *f)
+{
+	struct pfilter *pf = (struct pfilter *) f->private;
+
+	if (pf->real->log_stats)
+		pf->real->log_stats(pf->real);
+}
+
 static int _lookup_p(struct cmd_context *cmd, struct dev_filter *f, struct device *dev, const char *use_filter_name)
 {
 	struct pfilter *pf = (struct pfilter *) f->private;
+	struct pf_saved *ps;
 	void *l;
 	struct dm_str_list *sl;
 	int pass = 1;
+	int use_saved;
 
 	if (use_filter_name && strcmp(f->name, use_filter_name))
 		return pf->real->passes_filter(cmd, pf->real, dev, use_filter_name);
@@ -109,6 +469,25 @@ static int _lookup_p(struct cmd_context *cmd, struct dev_filter *f, struct devic
 
 	/* Uncached, check filters and cache the result */
 	if (!l) {
+		if (!pf->saved_checked)
+			_saved_load(cmd, pf);
+
+		/*
+		 * The internal filter depends on the command, and results
+		 * saved without the full md check may miss md components
+		 * with an end superblock.
+		 */
+		use_saved = pf->saved && !internal_filtering() && !cmd->use_full_md_check;
+
+		if (use_saved && (ps = _saved_lookup(pf, dev))) {
+			log_debug_devs("%s: filter cache file using %s result",
+				       dev_name(dev), ps->good ? "good" : "bad");
+			dev->filtered_flags = ps->filtered_flags;
+			pass = ps->good;
+			l = pass ? PF_GOOD_DEVICE : PF_BAD_DEVICE;
+			goto cache;
+		}
+
 		dev->flags &= ~DEV_FILTER_AFTER_SCAN;
 
 		pass = pf->real->passes_filter(cmd, pf->real, dev, use_filter_name);
@@ -139,6 +518,10 @@ static int _lookup_p(struct cmd_context *cmd, struct dev_filter *f, struct devic
 
 		log_debug_devs("filter caching %s %s", pass ? "good" : "bad", dev_name(dev));
 
+		/* Results of nodata filtering are final only when bad. */
+		if (use_saved && (!pass || !cmd->filter_nodata_only))
+			_saved_update(pf, dev, pass);
+ cache:
 		dm_list_iterate_items(sl, &dev->aliases)
 			if (!dm_hash_insert(pf->devices, sl->str, l)) {
 				log_error("Failed to hash alias to filter.");
@@ -157,6 +540,10 @@ static void _persistent_destroy(struct dev_filter *f)
 		log_error(INTERNAL_ERROR "Destroying persistent filter while in use %u times.", f->use_count);
 
 	dm_hash_destroy(pf->devices);
+	if (pf->saved)
+		dm_hash_destroy(pf->saved);
+	if (pf->saved_mem)
+		dm_pool_destroy(pf->saved_mem);
 	pf->real->destroy(pf->real);
 	free(pf);
 	free(f);
@@ -191,7 +578,9 @@ struct dev_filter *persistent_filter_create(struct dev_types *dt, struct dev_fil
 	f->use_count = 0;
 	f->private = pf;
 	f->wipe = _persistent_filter_wipe;
+	f->log_stats = _persistent_log_stats;
 	f->name = "persistent";
+	f->cost = real->cost;
 
 	log_debug_devs("Persistent filter initialised.");
 
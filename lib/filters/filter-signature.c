@@ -91,6 +91,7 @@ struct dev_filter *signature_filter_create(struct dev_types *dt)
 	f->use_count = 0;
 	f->private = dt;
 	f->name = "signature";
+	f->cost = FILTER_COST_READ;
 
 	log_debug_devs("signature filter initialised.");
 
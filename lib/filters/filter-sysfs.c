@@ -327,6 +327,8 @@ struct dev_filter *sysfs_filter_create(void)
 	f->use_count = 0;
 	f->private = ds;
 	f->name = "sysfs";
+	/* sysfs is scanned once, devices are then looked up in memory */
+	f->cost = FILTER_COST_MEMORY;
 
 	log_debug_devs("Sysfs filter initialised.");
 
@@ -193,6 +193,7 @@ struct dev_filter *usable_filter_create(struct cmd_context *cmd, struct dev_type
 	f->destroy = _usable_filter_destroy;
 	f->use_count = 0;
 	f->name = "usable";
+	f->cost = FILTER_COST_IOCTL;
 
 	if (!(data = zalloc(sizeof(struct filter_data)))) {
 		log_error("Usable device filter mode allocation failed");
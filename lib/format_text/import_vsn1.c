@@ -601,10 +601,10 @@ static int _read_lvnames(struct cmd_context *cmd,
 	if (!(lv = alloc_lv(mem)))
 		return_0;
 
-	if (!link_lv_to_vg(vg, lv))
+	if (!(lv->name = dm_pool_strdup(mem, lvn->key)))
 		return_0;
 
-	if (!(lv->name = dm_pool_strdup(mem, lvn->key)))
+	if (!link_lv_to_vg(vg, lv))
 		return_0;
 
 	log_debug_metadata("Importing logical volume %s.", display_lvname(lv));
@@ -805,6 +805,7 @@ static int _read_historical_lvnames(struct cmd_context *cmd,
 
 	glvl->glv = glv;
 	dm_list_add(&vg->historical_lvs, &glvl->list);
+	vg_index_historical_lv(vg, glvl);
 
 	return 1;
 bad:
@@ -939,6 +940,7 @@ static int _read_lvsegs(struct cmd_context *cmd,
 			struct dm_hash_table *lv_hash)
 {
 	struct logical_volume *lv;
+	struct lv_list *lvl;
 
 	if (!(lv = dm_hash_lookup(lv_hash, lvn->key))) {
 		log_error("Lost logical volume reference %s", lvn->key);
@@ -959,6 +961,10 @@ static int _read_lvsegs(struct cmd_context *cmd,
 
 	memcpy(&lv->lvid.id[0], &lv->vg->id, sizeof(lv->lvid.id[0]));
 
+	/* Index again now the id is known */
+	if ((lvl = find_lv_in_vg(vg, lv->name)))
+		vg_index_lv(vg, lvl);
+
 	if (!_read_segments(cmd, fmt, fid, mem, lv, lvn, pv_hash))
 		return_0;
 
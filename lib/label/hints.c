@@ -62,6 +62,18 @@
  * (It's much more complicated to create hints based on making specific
  * changes to existing hints based on what the command has changed.)
  *
+ * The exception are the common commands that only create or remove
+ * PVs, or add PVs to, remove PVs from, rename or remove VGs: pvcreate,
+ * pvremove, vgcreate, vgextend, vgreduce, vgremove, vgrename.  These
+ * call begin_hint_update() in place of clear_hint_file().  If the
+ * existing hints are valid, they are kept in memory, and each PV
+ * label or VG metadata written by the command updates the hint for
+ * that device.  When the command succeeds, finish_hint_update()
+ * writes the updated hints, so the next command does not need to
+ * scan all devices.  In any other case (hints not valid at the start,
+ * the command failed, duplicate PVs seen, or the list of devices
+ * changed), the hint file is cleared as clear_hint_file() would do.
+ *
  * For 3, these commands are a combination of: uncommon commands that
  * don't need optimization, commands where the purpose is to read all
  * devices, commands dealing with global state where it's important to
@@ -176,6 +188,18 @@ static char _hint_line[HINT_LINE_LEN];
 
 static int _hints_fd = -1;
 
+/* Hints being updated by the command, see begin_hint_update(). */
+static DM_LIST_INIT(_update_hints);
+static int _update_hints_active;
+static int _update_hints_changes;
+static int _update_hints_failed;
+static uint32_t _update_devs_hash;
+
+/* How often commands could use hints, for debugging. */
+static unsigned _hints_hits;
+static unsigned _hints_misses;
+static unsigned _hints_invalid;
+
 #define NONBLOCK 1
 
 #define NEWHINTS_NONE     0
@@ -362,6 +386,14 @@ static void _unlock_hints(struct cmd_context *cmd)
 
 void hints_exit(struct cmd_context *cmd)
 {
+	/* The command did not get to finish its update. */
+	if (_update_hints_active)
+		finish_hint_update(cmd, 0);
+
+	if (_hints_hits || _hints_misses)
+		log_debug("Hints used %u times, not used %u times, invalid %u times.",
+			  _hints_hits, _hints_misses, _hints_invalid);
+
 	free_hints(&cmd->hints);
 	if (_hints_fd == -1)
 		return;
@@ -389,6 +421,17 @@ static struct hint *_find_hint_name(struct dm_list *hints, const char *name)
 	return NULL;
 }
 
+static struct hint *_find_hint_devt(struct dm_list *hints, dev_t devt)
+{
+	struct hint *hint;
+
+	dm_list_iterate_items(hint, hints) {
+		if (hint->devt == devt)
+			return hint;
+	}
+	return NULL;
+}
+
 /*
  * Decide if a given device name should be included in the hint hash.
  * If it is, then the hash changes if the device is added or removed
@@ -450,6 +493,32 @@ static int _dev_in_hint_hash(struct cmd_context *cmd, struct device *dev)
 	return 1;
 }
 
+/*
+ * Calculate the hash of devices that may be scanned.
+ */
+static int _calc_devs_hash(struct cmd_context *cmd, uint32_t *hash, uint32_t *count)
+{
+	char devpath[PATH_MAX];
+	struct dev_iter *iter;
+	struct device *dev;
+
+	*hash = INITIAL_CRC;
+	*count = 0;
+
+	if (!(iter = dev_iter_create(NULL, 0)))
+		return 0;
+	while ((dev = dev_iter_get(cmd, iter))) {
+		if (!_dev_in_hint_hash(cmd, dev))
+			continue;
+		(void) dm_strncpy(devpath, dev_name(dev), sizeof(devpath));
+		*hash = calc_crc(*hash, (const uint8_t *)devpath, strlen(devpath));
+		(*count)++;
+	}
+	dev_iter_destroy(iter);
+
+	return 1;
+}
+
 /*
  * Hints were used to reduce devs that were scanned.  After the reduced
  * scanning is done, this is called to check if the hints may have been
@@ -559,6 +628,8 @@ int validate_hints(struct cmd_context *cmd, struct dm_list *hints)
 
 out:
 	if (!ret) {
+		_hints_invalid++;
+
 		/*
 		 * Force next cmd to recreate hints.  If we can't
 		 * create newhints, the next cmd should get here
@@ -656,21 +727,22 @@ static void _filter_to_str(struct cmd_context *cmd, int filter_cfg, char **strp)
  * Return 0: the hints can't be used
  *
  * recreate is set if hint file should be refreshed/recreated
+ *
+ * When devs_hash is set, the hash of devices read from the file is returned
+ * there for the caller to check once devices are scanned.
  */
-static int _read_hint_file(struct cmd_context *cmd, struct dm_list *hints, int *needs_refresh)
+static int _read_hint_file(struct cmd_context *cmd, struct dm_list *hints, int *needs_refresh,
+			   uint32_t *devs_hash)
 {
-	char devpath[PATH_MAX];
 	FILE *fp;
-	struct dev_iter *iter;
 	struct hint hint;
 	struct hint *alloc_hint;
-	struct device *dev;
 	char *split[HINT_LINE_WORDS];
 	char *name, *pvid, *devn, *vgname, *p, *filter_str = NULL;
 	uint32_t read_hash = 0;
-	uint32_t calc_hash = INITIAL_CRC;
+	uint32_t calc_hash;
 	uint32_t read_count = 0;
-	uint32_t calc_count = 0;
+	uint32_t calc_count;
 	int found = 0;
 	int keylen;
 	int hv_major, hv_minor;
@@ -821,19 +893,16 @@ static int _read_hint_file(struct cmd_context *cmd, struct dm_list *hints, int *
 	if (*needs_refresh)
 		return 1;
 
+	if (devs_hash) {
+		*devs_hash = read_hash;
+		return 1;
+	}
+
 	/*
 	 * Calculate and compare hash of devices that may be scanned.
 	 */
-	if (!(iter = dev_iter_create(NULL, 0)))
+	if (!_calc_devs_hash(cmd, &calc_hash, &calc_count))
 		return 0;
-	while ((dev = dev_iter_get(cmd, iter))) {
-		if (!_dev_in_hint_hash(cmd, dev))
-			continue;
-		(void) dm_strncpy(devpath, dev_name(dev), sizeof(devpath));
-		calc_hash = calc_crc(calc_hash, (const uint8_t *)devpath, strlen(devpath));
-		calc_count++;
-	}
-	dev_iter_destroy(iter);
 
 	if (read_hash && (read_hash != calc_hash)) {
 		/* The count is just informational. */
@@ -868,9 +937,9 @@ static int _read_hint_file(struct cmd_context *cmd, struct dm_list *hints, int *
  * recreated.
  *
  * (This hash detection depends on the two commands iterating through dev names
- * in the same order, which happens because the devs are inserted into the
- * btree using devno.  If the btree implementation changes, then we need
- * to sort the dev names here before iterating through them.)
+ * in the same order, which happens because dev_cache iterates devs in devno
+ * order.  If that changes, then we need to sort the dev names here before
+ * iterating through them.)
  *
  * N.B. the config setting pv_min_size should technically be included in
  * the hint file like the filter and scan_lvs setting, since increasing
@@ -878,6 +947,23 @@ static int _read_hint_file(struct cmd_context *cmd, struct dm_list *hints, int *
  * It is left out since it is not often changed, but could be easily added.
  */
 
+static void _write_hint_settings(struct cmd_context *cmd, FILE *fp)
+{
+	char *filter_str = NULL;
+
+	fprintf(fp, "hints_version: %d.%d\n", HINTS_VERSION_MAJOR, HINTS_VERSION_MINOR);
+
+	_filter_to_str(cmd, devices_global_filter_CFG, &filter_str);
+	fprintf(fp, "global_filter:%s\n", filter_str ?: "-");
+	free(filter_str);
+
+	_filter_to_str(cmd, devices_filter_CFG, &filter_str);
+	fprintf(fp, "filter:%s\n", filter_str ?: "-");
+	free(filter_str);
+
+	fprintf(fp, "scan_lvs:%d\n", cmd->scan_lvs);
+}
+
 int write_hint_file(struct cmd_context *cmd, int newhints)
 {
 	char devpath[PATH_MAX];
@@ -886,7 +972,6 @@ int write_hint_file(struct cmd_context *cmd, int newhints)
 	struct dev_iter *iter;
 	struct device *dev;
 	const char *vgname;
-	char *filter_str = NULL;
 	uint32_t hash = INITIAL_CRC;
 	uint32_t count = 0;
 	time_t t;
@@ -935,17 +1020,7 @@ int write_hint_file(struct cmd_context *cmd, int newhints)
 	}
 
 	fprintf(fp, "# Created by %s pid %d %s", cmd->name, getpid(), ctime(&t));
-	fprintf(fp, "hints_version: %d.%d\n", HINTS_VERSION_MAJOR, HINTS_VERSION_MINOR);
-
-	_filter_to_str(cmd, devices_global_filter_CFG, &filter_str);
-	fprintf(fp, "global_filter:%s\n", filter_str ?: "-");
-	free(filter_str);
-
-	_filter_to_str(cmd, devices_filter_CFG, &filter_str);
-	fprintf(fp, "filter:%s\n", filter_str ?: "-");
-	free(filter_str);
-
-	fprintf(fp, "scan_lvs:%d\n", cmd->scan_lvs);
+	_write_hint_settings(cmd, fp);
 
 	/* 
 	 * iterate through all devs and write a line for each
@@ -1117,6 +1192,168 @@ void clear_hint_file(struct cmd_context *cmd)
 		stack;
 }
 
+/*
+ * Used in place of clear_hint_file() by commands whose changes to PVs and
+ * VG names are all made through pv_write(), label_remove() and vg_commit().
+ * These record each change in the hints read here, and finish_hint_update()
+ * writes them when the command is done.  Other commands are still blocked
+ * from using the hints while this command runs (by the ex lock and the
+ * newhints file), and if the command does not finish, the newhints file
+ * makes the next command recreate the hints.
+ */
+void begin_hint_update(struct cmd_context *cmd)
+{
+	int needs_refresh = 0;
+	int locked;
+
+	/* No commands are using hints. */
+	if (!cmd->enable_hints)
+		return;
+
+	log_debug("begin_hint_update");
+
+	/* limit potential delay blocking on hints lock next */
+	if (!_touch_nohints())
+		stack;
+
+	/* Without the lock the hint file can only be cleared. */
+	if (!(locked = _lock_hints(cmd, LOCK_EX, 0)))
+		stack;
+
+	_unlink_nohints();
+
+	if (locked && !_update_hints_active && !_newhints_exists() &&
+	    _read_hint_file(cmd, &_update_hints, &needs_refresh, &_update_devs_hash) &&
+	    !needs_refresh && !dm_list_empty(&_update_hints)) {
+		_update_hints_active = 1;
+		_update_hints_changes = 0;
+		_update_hints_failed = 0;
+	} else {
+		log_debug("Hints not updated, clearing hint file.");
+		_update_hints_active = 0;
+		free_hints(&_update_hints);
+		if (!_clear_hints(cmd))
+			stack;
+	}
+
+	if (!_touch_newhints())
+		stack;
+}
+
+/*
+ * Record that dev has a PV with the given pvid (ID_LEN chars), and is
+ * used by VG vgname, or by no VG if vgname is NULL.
+ */
+void hint_update_pv(struct device *dev, const char *pvid, const char *vgname)
+{
+	struct hint *hint;
+
+	if (!_update_hints_active)
+		return;
+
+	if (!(hint = _find_hint_devt(&_update_hints, dev->dev))) {
+		if (!(hint = zalloc(sizeof(*hint)))) {
+			_update_hints_failed = 1;
+			return;
+		}
+		hint->devt = dev->dev;
+		dm_list_add(&_update_hints, &hint->list);
+	}
+
+	(void) dm_strncpy(hint->name, dev_name(dev), sizeof(hint->name));
+	memcpy(hint->pvid, pvid, ID_LEN);
+	hint->pvid[ID_LEN] = '\0';
+	(void) dm_strncpy(hint->vgname, vgname ?: "-", sizeof(hint->vgname));
+
+	log_debug("update hint %s %s %s", hint->name, hint->pvid, hint->vgname);
+	_update_hints_changes++;
+}
+
+/* Record that dev no longer has a PV. */
+void hint_remove_pv(struct device *dev)
+{
+	struct hint *hint;
+
+	if (!_update_hints_active)
+		return;
+
+	if ((hint = _find_hint_devt(&_update_hints, dev->dev))) {
+		log_debug("remove hint %s %s", hint->name, hint->pvid);
+		dm_list_del(&hint->list);
+		free(hint);
+		_update_hints_changes++;
+	}
+}
+
+/*
+ * Write the hints updated by the command if it succeeded, otherwise clear
+ * the hint file so the next command recreates it.  The hints lock is kept
+ * until hints_exit().
+ */
+void finish_hint_update(struct cmd_context *cmd, int success)
+{
+	struct hint *hint;
+	uint32_t hash, count;
+	time_t t;
+	FILE *fp;
+
+	if (!_update_hints_active)
+		return;
+
+	_update_hints_active = 0;
+
+	if (!success)
+		log_debug("Hints not updated after command failure.");
+	else if (_update_hints_failed) {
+		log_debug("Hints not updated after allocation failure.");
+		success = 0;
+	} else if (lvmcache_has_duplicate_devs() || lvmcache_found_duplicate_vgnames()) {
+		log_debug("Hints not updated with duplicate pvs or vg names.");
+		success = 0;
+	} else if (!_calc_devs_hash(cmd, &hash, &count) || (hash != _update_devs_hash)) {
+		log_debug("Hints not updated with changed devices.");
+		success = 0;
+	}
+
+	if (!success) {
+		if (!_clear_hints(cmd))
+			stack;
+		goto out;
+	}
+
+	if (!(fp = fopen(_hints_file, "w"))) {
+		log_debug("finish_hint_update open errno %d %s", errno, _hints_file);
+		goto out;
+	}
+
+	t = time(NULL);
+
+	fprintf(fp, "# Updated by %s pid %d %s", cmd->name, getpid(), ctime(&t));
+	_write_hint_settings(cmd, fp);
+
+	dm_list_iterate_items(hint, &_update_hints)
+		fprintf(fp, "scan:%s pvid:%s devn:%d:%d vg:%s\n",
+			hint->name, hint->pvid,
+			major(hint->devt), minor(hint->devt),
+			hint->vgname[0] ? hint->vgname : "-");
+
+	fprintf(fp, "devs_hash: %u %u\n", hash, count);
+
+	if (fflush(fp))
+		log_debug("finish_hint_update flush errno %d %s", errno, _hints_file);
+
+	if (fclose(fp)) {
+		log_debug("finish_hint_update close errno %d %s", errno, _hints_file);
+		goto out;
+	}
+
+	log_debug("Updated hint file with %d changes.", _update_hints_changes);
+
+	_unlink_newhints();
+ out:
+	free_hints(&_update_hints);
+}
+
 /*
  * This is only used at the start of pvscan --cache [-aay] to
  * set up for recreating the hint file.
@@ -1162,6 +1399,30 @@ void invalidate_hints(struct cmd_context *cmd)
 		stack;
 }
 
+/*
+ * The hint file is cleared or rewritten whenever some command changes
+ * which devices are PVs or which VG names are used, so its stat changes
+ * with that global state.  This is used to tell if a scan kept from a
+ * previous command in the same process is still valid.  Returns 0 if
+ * the hint file cannot be used for this (hints disabled, or hints are
+ * being changed or need to be recreated.)
+ */
+int get_hint_file_stat(struct cmd_context *cmd, struct stat *buf)
+{
+	if (!cmd->enable_hints)
+		return 0;
+
+	if (_nohints_exists() || _newhints_exists())
+		return 0;
+
+	if (stat(_hints_file, buf)) {
+		log_debug("hint_file_stat errno %d %s", errno, _hints_file);
+		return 0;
+	}
+
+	return 1;
+}
+
 /*
  * Currently, all the commands using hints (ALLOW_HINTS) take an optional or
  * required first position arg of a VG name or LV name.  If some other command
@@ -1243,8 +1504,8 @@ check:
  * Returns 1: use hints that are returned in hints list.
  */
 
-int get_hints(struct cmd_context *cmd, struct dm_list *hints_out, int *newhints,
-	      struct dm_list *devs_in, struct dm_list *devs_out)
+static int _get_hints(struct cmd_context *cmd, struct dm_list *hints_out, int *newhints,
+		      struct dm_list *devs_in, struct dm_list *devs_out)
 {
 	struct dm_list hints_list;
 	int needs_refresh = 0;
@@ -1330,7 +1591,7 @@ int get_hints(struct cmd_context *cmd, struct dm_list *hints_out, int *newhints,
 	/*
 	 * couln't read file for some reason, not normal, just skip using hints
 	 */
-	if (!_read_hint_file(cmd, &hints_list, &needs_refresh)) {
+	if (!_read_hint_file(cmd, &hints_list, &needs_refresh, NULL)) {
 		log_debug("get_hints: read fail");
 		free_hints(&hints_list);
 		_unlock_hints(cmd);
@@ -1395,3 +1656,18 @@ int get_hints(struct cmd_context *cmd, struct dm_list *hints_out, int *newhints,
 	return 1;
 }
 
+int get_hints(struct cmd_context *cmd, struct dm_list *hints_out, int *newhints,
+	      struct dm_list *devs_in, struct dm_list *devs_out)
+{
+	int ret = _get_hints(cmd, hints_out, newhints, devs_in, devs_out);
+
+	if (cmd->enable_hints && cmd->use_hints) {
+		if (ret)
+			_hints_hits++;
+		else
+			_hints_misses++;
+	}
+
+	return ret;
+}
+
@@ -30,6 +30,14 @@ int write_hint_file(struct cmd_context *cmd, int newhints);
 
 void clear_hint_file(struct cmd_context *cmd);
 
+void begin_hint_update(struct cmd_context *cmd);
+
+void hint_update_pv(struct device *dev, const char *pvid, const char *vgname);
+
+void hint_remove_pv(struct device *dev);
+
+void finish_hint_update(struct cmd_context *cmd, int success);
+
 void invalidate_hints(struct cmd_context *cmd);
 
 int get_hints(struct cmd_context *cmd, struct dm_list *hints, int *newhints,
@@ -41,5 +49,8 @@ void hints_exit(struct cmd_context *cmd);
 
 void pvscan_recreate_hints_begin(struct cmd_context *cmd);
 
+struct stat;
+int get_hint_file_stat(struct cmd_context *cmd, struct stat *buf);
+
 #endif
 
@@ -23,6 +23,7 @@
 #include "lib/commands/toolcontext.h"
 #include "lib/activate/activate.h"
 #include "lib/label/hints.h"
+#include "lib/filters/filter.h"
 #include "lib/metadata/metadata.h"
 #include "lib/format_text/layout.h"
 
@@ -166,6 +167,7 @@ int label_remove(struct device *dev)
 				info = lvmcache_info_from_pvid(dev->pvid, dev, 0);
 				if (info)
 					lvmcache_del(info);
+				hint_remove_pv(dev);
 			}
 		}
 	}
@@ -598,6 +600,9 @@ static int _scan_dev_close(struct device *dev)
 	if (!(dev->flags & DEV_IN_BCACHE))
 		log_error("scan_dev_close %s no DEV_IN_BCACHE set", dev_name(dev));
 
+	if (dev->flags & DEV_BCACHE_WRITE)
+		dev->flags |= DEV_WRITE_OPENED;
+
 	dev->flags &= ~DEV_IN_BCACHE;
 	dev->flags &= ~DEV_BCACHE_EXCL;
 	dev->flags &= ~DEV_BCACHE_WRITE;
@@ -657,6 +662,21 @@ static void _invalidate_di(struct bcache *cache, int di)
 		bcache_abort_di(cache, di);
 }
 
+/* Find the dev waiting for the given prefetched block, if any. */
+static struct device_list *_find_wait_dev(struct dm_list *wait_devs, int di, block_address block)
+{
+	struct device_list *devl;
+
+	if (block)
+		return NULL;
+
+	dm_list_iterate_items(devl, wait_devs)
+		if (devl->dev->bcache_di == di)
+			return devl;
+
+	return NULL;
+}
+
 /*
  * Read or reread label/metadata from selected devs.
  *
@@ -680,10 +700,14 @@ static int _scan_list(struct cmd_context *cmd, struct dev_filter *f,
 	int scan_read_errors = 0;
 	int scan_process_errors = 0;
 	int scan_failed_count = 0;
-	int rem_prefetches;
-	int submit_count;
+	unsigned max_prefetches;
+	unsigned nr_waiting = 0;
+	int submit_count = 0;
 	int is_lvm_device;
 	int ret;
+	int di;
+	block_address block;
+	uint64_t start, submit_ns = 0, wait_ns = 0, process_ns = 0;
 
 	dm_list_init(&wait_devs);
 	dm_list_init(&done_devs);
@@ -692,58 +716,81 @@ static int _scan_list(struct cmd_context *cmd, struct dev_filter *f,
 	log_debug_devs("Scanning %d devices for VG info", dm_list_size(devs));
 
  scan_more:
-	rem_prefetches = bcache_max_prefetches(scan_bcache);
-	submit_count = 0;
-
-	dm_list_iterate_items_safe(devl, devl2, devs) {
+	max_prefetches = bcache_max_prefetches(scan_bcache);
 
+	while (!dm_list_empty(devs) || !dm_list_empty(&wait_devs)) {
 		/*
-		 * If we prefetch more devs than blocks in the cache, then the
-		 * cache will wait for earlier reads to complete, toss the
-		 * results, and reuse those blocks before we've had a chance to
-		 * use them.  So, prefetch as many as are available, wait for
-		 * and process them, then repeat.
+		 * Keep the device queue full by topping up the reads in flight
+		 * each time one is processed.  If we prefetch more devs than
+		 * blocks in the cache, then the cache will toss the results of
+		 * earlier reads, and reuse those blocks before we've had a
+		 * chance to use them.  So the number of devs prefetched but
+		 * not yet processed is kept within the prefetch limit.
 		 */
-		if (!rem_prefetches)
-			break;
+		start = lvm_monotonic_ns();
 
-		if (!_in_bcache(devl->dev)) {
-			if (!_scan_dev_open(devl->dev)) {
-				log_debug_devs("Scan failed to open %s.", dev_name(devl->dev));
-				dm_list_del(&devl->list);
-				dm_list_add(&reopen_devs, &devl->list);
-				continue;
+		dm_list_iterate_items_safe(devl, devl2, devs) {
+			if (nr_waiting >= max_prefetches)
+				break;
+
+			if (!_in_bcache(devl->dev)) {
+				if (!_scan_dev_open(devl->dev)) {
+					log_debug_devs("Scan failed to open %s.", dev_name(devl->dev));
+					dm_list_del(&devl->list);
+					dm_list_add(&reopen_devs, &devl->list);
+					continue;
+				}
 			}
+
+			bcache_prefetch(scan_bcache, devl->dev->bcache_di, 0);
+
+			nr_waiting++;
+			submit_count++;
+
+			dm_list_del(&devl->list);
+			dm_list_add(&wait_devs, &devl->list);
 		}
 
-		bcache_prefetch(scan_bcache, devl->dev->bcache_di, 0);
+		submit_ns += lvm_monotonic_ns() - start;
 
-		rem_prefetches--;
-		submit_count++;
+		if (dm_list_empty(&wait_devs))
+			break;
 
-		dm_list_del(&devl->list);
-		dm_list_add(&wait_devs, &devl->list);
-	}
+		/*
+		 * Process devs in the order their reads complete, so a slow
+		 * device does not hold up the others.  A dev whose prefetch
+		 * was not issued, or whose block was evicted, is read by
+		 * bcache_get() below.
+		 */
+		start = lvm_monotonic_ns();
+
+		devl = NULL;
+		while (!devl && bcache_next_prefetch(scan_bcache, &di, &block))
+			devl = _find_wait_dev(&wait_devs, di, block);
 
-	log_debug_devs("Scanning submitted %d reads", submit_count);
+		if (!devl)
+			devl = dm_list_item(dm_list_first(&wait_devs), struct device_list);
 
-	dm_list_iterate_items_safe(devl, devl2, &wait_devs) {
 		bb = NULL;
 		is_lvm_device = 0;
 
 		if (!bcache_get(scan_bcache, devl->dev->bcache_di, 0, 0, &bb)) {
+			wait_ns += lvm_monotonic_ns() - start;
 			log_debug_devs("Scan failed to read %s.", dev_name(devl->dev));
 			scan_read_errors++;
 			scan_failed_count++;
 			lvmcache_del_dev(devl->dev);
 		} else {
+			wait_ns += lvm_monotonic_ns() - start;
 			log_debug_devs("Processing data from device %s %d:%d di %d block %p",
 				       dev_name(devl->dev),
 				       (int)MAJOR(devl->dev->dev),
 				       (int)MINOR(devl->dev->dev),
 				       devl->dev->bcache_di, (void *)bb);
 
+			start = lvm_monotonic_ns();
 			ret = _process_block(cmd, f, devl->dev, bb, 0, 0, &is_lvm_device);
+			process_ns += lvm_monotonic_ns() - start;
 
 			if (!ret && is_lvm_device) {
 				log_debug_devs("Scan failed to process %s", dev_name(devl->dev));
@@ -768,13 +815,12 @@ static int _scan_list(struct cmd_context *cmd, struct dev_filter *f,
 			_scan_dev_close(devl->dev);
 		}
 
+		nr_waiting--;
+
 		dm_list_del(&devl->list);
 		dm_list_add(&done_devs, &devl->list);
 	}
 
-	if (!dm_list_empty(devs))
-		goto scan_more;
-
 	/*
 	 * We're done scanning all the devs.  If we failed to open any of them
 	 * the first time through, refresh device paths and retry.  We failed
@@ -801,6 +847,7 @@ static int _scan_list(struct cmd_context *cmd, struct dev_filter *f,
 					 
 				dm_list_del(&devl->list);
 				lvmcache_del_dev(devl->dev);
+				devl->dev->flags &= ~DEV_SCAN_FOUND_LABEL;
 				scan_failed_count++;
 			}
 		}
@@ -822,6 +869,8 @@ static int _scan_list(struct cmd_context *cmd, struct dev_filter *f,
 out:
 	log_debug_devs("Scanned devices: read errors %d process errors %d failed %d",
 			scan_read_errors, scan_process_errors, scan_failed_count);
+	log_debug_devs("Scanned devices: %d reads, submit %.3fs wait %.3fs process %.3fs",
+		       submit_count, submit_ns / 1e9, wait_ns / 1e9, process_ns / 1e9);
 
 	if (failed)
 		*failed = scan_failed_count;
@@ -832,15 +881,17 @@ out:
 }
 
 /*
- * We don't know ahead of time if we will find some VG metadata 
- * that is larger than the total size of the bcache, which would
- * prevent us from reading/writing the VG since we do not dynamically
- * increase the bcache size when we find it's too small.  In these
- * cases the user would need to set io_memory_size to be larger
- * than the max VG metadata size (lvm does not impose any limit on
- * the metadata size.)
+ * bcache starts small and grows as blocks are needed, up to the size
+ * given by io_memory_size.  Beyond that it reuses blocks, and only
+ * grows further (up to the larger of io_memory_size and
+ * MAX_BCACHE_BLOCKS) when all blocks are held or to read large
+ * metadata, so big VGs can be read and written without setting
+ * io_memory_size.  Metadata larger than that ceiling still needs
+ * io_memory_size to be raised (lvm does not impose any limit on the
+ * metadata size.)
  */
 
+#define INITIAL_BCACHE_BLOCKS 8 /* 1MB (8 * 128KB) */
 #define MIN_BCACHE_BLOCKS 32    /* 4MB (32 * 128KB) */
 #define MAX_BCACHE_BLOCKS 4096  /* 512MB (4096 * 128KB) */
 
@@ -849,9 +900,9 @@ static int _setup_bcache(void)
 	struct io_engine *ioe = NULL;
 	int iomem_kb = io_memory_size();
 	int block_size_kb = (BCACHE_BLOCK_SIZE_IN_SECTORS * 512) / 1024;
-	int cache_blocks;
+	int cache_blocks, max_blocks;
 
-	cache_blocks = iomem_kb / block_size_kb;
+	cache_blocks = max_blocks = iomem_kb / block_size_kb;
 
 	if (cache_blocks < MIN_BCACHE_BLOCKS)
 		cache_blocks = MIN_BCACHE_BLOCKS;
@@ -859,9 +910,17 @@ static int _setup_bcache(void)
 	if (cache_blocks > MAX_BCACHE_BLOCKS)
 		cache_blocks = MAX_BCACHE_BLOCKS;
 
-	_current_bcache_size_bytes = cache_blocks * BCACHE_BLOCK_SIZE_IN_SECTORS * 512;
+	if (max_blocks < MAX_BCACHE_BLOCKS)
+		max_blocks = MAX_BCACHE_BLOCKS;
+
+	_current_bcache_size_bytes = (uint64_t) max_blocks * BCACHE_BLOCK_SIZE_IN_SECTORS * 512;
 
-	if (use_aio()) {
+	if (use_aio() && use_io_uring()) {
+		if (!(ioe = create_io_uring_engine()))
+			log_warn("Failed to set up io_uring, using async io.");
+	}
+
+	if (use_aio() && !ioe) {
 		if (!(ioe = create_async_io_engine())) {
 			log_warn("Failed to set up async io, using sync io.");
 			init_use_aio(0);
@@ -875,7 +934,8 @@ static int _setup_bcache(void)
 		}
 	}
 
-	if (!(scan_bcache = bcache_create(BCACHE_BLOCK_SIZE_IN_SECTORS, cache_blocks, ioe))) {
+	if (!(scan_bcache = bcache_create_growable(BCACHE_BLOCK_SIZE_IN_SECTORS, INITIAL_BCACHE_BLOCKS,
+						   cache_blocks, max_blocks, ioe))) {
 		log_error("Failed to create bcache with %d cache blocks.", cache_blocks);
 		return 0;
 	}
@@ -1059,6 +1119,13 @@ int label_scan(struct cmd_context *cmd)
 		cmd->use_full_md_check = 1;
 	}
 
+	/*
+	 * lvmcache content may be kept from the previous command run by
+	 * this process (devices/session_scan_cache.)
+	 */
+	if (lvmcache_use_kept_scan(cmd))
+		return 1;
+
 	/*
 	 * Create a list of all devices in dev-cache (all found on the system.)
 	 * Do not apply filters and do not read any (the filter arg is NULL).
@@ -1088,7 +1155,7 @@ int label_scan(struct cmd_context *cmd)
 	 * checked without reading data from the device.)
 	 *
 	 * The result of checking nodata filters is saved by the "persistent
-	 * filter", and this result needs to be cleared (wiped) so that the
+	 * filter", and this result needs to be forgotten so that the
 	 * complete set of filters (including those that require data) can be
 	 * checked in _process_block, where headers have been read.
 	 */
@@ -1111,9 +1178,9 @@ int label_scan(struct cmd_context *cmd)
 	cmd->filter_nodata_only = 0;
 
 	dm_list_iterate_items(devl, &all_devs)
-		cmd->filter->wipe(cmd, cmd->filter, devl->dev, NULL);
+		persistent_filter_forget(cmd->filter, devl->dev);
 	dm_list_iterate_items(devl, &filtered_devs)
-		cmd->filter->wipe(cmd, cmd->filter, devl->dev, NULL);
+		persistent_filter_forget(cmd->filter, devl->dev);
 
 	/*
 	 * In some common cases we can avoid scanning all devices
@@ -1151,23 +1218,14 @@ int label_scan(struct cmd_context *cmd)
 	_scan_list(cmd, cmd->filter, &scan_devs, 0, NULL);
 
 	/*
-	 * Metadata could be larger than total size of bcache, and bcache
-	 * cannot currently be resized during the command.  If this is the
-	 * case (or within reach), warn that io_memory_size needs to be
-	 * set larger.
+	 * Metadata could be larger than the most bcache is allowed to grow
+	 * to.  If this is the case (or within reach), warn that
+	 * io_memory_size needs to be set larger.
 	 *
 	 * Even if bcache out of space did not cause a failure during scan, it
 	 * may cause a failure during the next vg_read phase or during vg_write.
 	 *
-	 * If there was an error during scan, we could recreate bcache here
-	 * with a larger size and then restart label_scan.  But, this does not
-	 * address the problem of writing new metadata that excedes the bcache
-	 * size and failing, which would often be hit first, i.e. we'll fail
-	 * to write new metadata exceding the max size before we have a chance
-	 * to read any metadata with that size, unless we find an existing vg
-	 * that has been previously created with the larger size.
-	 *
-	 * If the largest metadata is within 1MB of the bcache size, then start
+	 * If the largest metadata is within 1MB of the bcache limit, then start
 	 * warning.
 	 */
 	max_metadata_size_bytes = lvmcache_max_metadata_size();
@@ -1620,6 +1678,74 @@ bool dev_read_bytes(struct device *dev, uint64_t start, size_t len, void *data)
 
 }
 
+/*
+ * Devices with writes waiting for the flush in dev_write_batch_end().
+ */
+static struct dm_list _write_batch_devs;
+static int _write_batch;
+
+void dev_write_batch_begin(void)
+{
+	if (_write_batch) {
+		log_error(INTERNAL_ERROR "Write batch already started.");
+		return;
+	}
+
+	dm_list_init(&_write_batch_devs);
+	_write_batch = 1;
+}
+
+static int _write_batch_add(struct device *dev)
+{
+	struct device_list *devl;
+
+	dm_list_iterate_items(devl, &_write_batch_devs)
+		if (devl->dev == dev)
+			return 1;
+
+	if (!(devl = malloc(sizeof(*devl))))
+		return 0;
+
+	dev->flags &= ~DEV_WRITE_FAILED;
+	devl->dev = dev;
+	dm_list_add(&_write_batch_devs, &devl->list);
+
+	return 1;
+}
+
+bool dev_write_batch_end(void)
+{
+	struct device_list *devl, *devl2;
+	unsigned count = 0;
+	bool r = true;
+
+	if (!_write_batch)
+		return true;
+
+	_write_batch = 0;
+
+	if (dm_list_empty(&_write_batch_devs))
+		return true;
+
+	if (!bcache_flush(scan_bcache))
+		r = false;
+
+	dm_list_iterate_items_safe(devl, devl2, &_write_batch_devs) {
+		if (!r && bcache_write_failed_di(scan_bcache, devl->dev->bcache_di)) {
+			log_error("Error writing device %s.", dev_name(devl->dev));
+			devl->dev->flags |= DEV_WRITE_FAILED;
+			label_scan_invalidate(devl->dev);
+		}
+		dm_list_del(&devl->list);
+		free(devl);
+		count++;
+	}
+
+	log_debug("Flushed batched writes to %u devices.", count);
+
+	return r;
+}
+
 bool dev_write_bytes(struct device *dev, uint64_t start, size_t len, void *data)
 {
 	if (test_mode())
@@ -1631,8 +1757,9 @@ bool dev_write_bytes(struct device *dev, uint64_t start, size_t len, void *data)
 		return false;
 	}
 
-	if (_in_bcache(dev) && !(dev->flags & DEV_BCACHE_WRITE)) {
-		/* FIXME: avoid tossing out bcache blocks just to replace fd. */
+	/* Switching to a writable fd keeps the blocks already in bcache. */
+	if (_in_bcache(dev) && !(dev->flags & DEV_BCACHE_WRITE) &&
+	    !label_scan_reopen_rw(dev)) {
 		log_debug("close and reopen to write %s", dev_name(dev));
 		_invalidate_di(scan_bcache, dev->bcache_di);
 		_scan_dev_close(dev);
@@ -1659,6 +1786,10 @@ bool dev_write_bytes(struct device *dev, uint64_t start, size_t len, void *data)
 		return false;
 	}
 
+	/* Written back by dev_write_batch_end() */
+	if (_write_batch && _write_batch_add(dev))
+		return true;
+
 	if (!bcache_flush(scan_bcache)) {
 		log_error("Error writing device %s at %llu length %u.",
 			  dev_name(dev), (unsigned long long)start, (uint32_t)len);
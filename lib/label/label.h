@@ -134,4 +134,12 @@ bool dev_invalidate_bytes(struct device *dev, uint64_t start, size_t len);
 void dev_set_last_byte(struct device *dev, uint64_t offset);
 void dev_unset_last_byte(struct device *dev);
 
+/*
+ * dev_write_bytes() between these calls leaves the data in bcache and
+ * all of it is written back concurrently by one flush at the end.
+ * Devices whose writes failed then have DEV_WRITE_FAILED set.
+ */
+void dev_write_batch_begin(void);
+bool dev_write_batch_end(void);
+
 #endif
@@ -1743,6 +1743,7 @@ int historical_glv_remove(struct generic_logical_volume *glv)
 		}
 	}
 
+	vg_unindex_historical_lv(hlv->vg, glvl);
 	dm_list_move(&hlv->vg->removed_historical_lvs, &glvl->list);
 	return 1;
 }
@@ -34,6 +34,7 @@
 #include "lib/config/defaults.h"
 #include "lib/locking/lvmlockd.h"
 #include "lib/notify/lvmnotify.h"
+#include "lib/label/hints.h"
 
 #include <time.h>
 #include <math.h>
@@ -271,6 +272,7 @@ void add_pvl_to_vgs(struct volume_group *vg, struct pv_list *pvl)
 	vg->pv_count++;
 	pvl->pv->vg = vg;
 	pv_set_fid(pvl->pv, vg->fid);
+	vg_index_pv(vg, pvl);
 }
 
 void del_pvl_from_vgs(struct volume_group *vg, struct pv_list *pvl)
@@ -278,6 +280,7 @@ void del_pvl_from_vgs(struct volume_group *vg, struct pv_list *pvl)
 	struct lvmcache_info *info;
 
 	vg->pv_count--;
+	vg_unindex_pv(vg, pvl);
 	dm_list_del(&pvl->list);
 
 	pvl->pv->vg = vg->fid->fmt->orphan_vg; /* orphan */
@@ -985,26 +988,13 @@ static void _vg_move_cached_precommitted_to_committed(struct volume_group *vg)
 
 /*
  * Update content of precommitted VG
- *
- * TODO: Optimize in the future, since lvmetad needs similar
- *       config tree processing in lvmetad_vg_update().
  */
 static int _vg_update_embedded_copy(struct volume_group *vg, struct volume_group **vg_embedded)
 {
-	struct dm_config_tree *cft;
-
 	_vg_wipe_cached_precommitted(vg);
 
-	/* Copy the VG using an export followed by import */
-	if (!(cft = export_vg_to_config_tree(vg)))
-		return_0;
-
-	if (!(*vg_embedded = import_vg_from_config_tree(vg->cmd, vg->fid, cft))) {
-		dm_config_destroy(cft);
+	if (!(*vg_embedded = vg_copy(vg)))
 		return_0;
-	}
-
-	dm_config_destroy(cft);
 
 	return 1;
 }
@@ -1634,13 +1624,28 @@ struct pv_list *find_pv_in_vg_by_uuid(const struct volume_group *vg,
 {
 	struct pv_list *pvl;
 
+	if (vg->pv_ids &&
+	    (pvl = dm_hash_lookup_binary(vg->pv_ids, id, sizeof(*id))) &&
+	    (pvl->pv->vg == vg) && id_equal(&pvl->pv->id, id))
+		return pvl;
+
 	dm_list_iterate_items(pvl, &vg->pvs)
-		if (id_equal(&pvl->pv->id, id))
+		if (id_equal(&pvl->pv->id, id)) {
+			vg_index_pv((struct volume_group *) vg, pvl);
 			return pvl;
+		}
 
 	return NULL;
 }
 
+/* Index entry still refers to a live LV of this VG with the given name? */
+static int _lvl_matches(const struct volume_group *vg, const struct lv_list *lvl,
+			const char *lv_name)
+{
+	return (lvl->lv->vg == vg) && !(lvl->lv->status & LV_REMOVED) &&
+		lvl->lv->name && !strcmp(lvl->lv->name, lv_name);
+}
+
 struct lv_list *find_lv_in_vg(const struct volume_group *vg,
 			      const char *lv_name)
 {
@@ -1653,9 +1658,16 @@ struct lv_list *find_lv_in_vg(const struct volume_group *vg,
 	else
 		ptr = lv_name;
 
+	if (vg->lv_names &&
+	    (lvl = dm_hash_lookup(vg->lv_names, ptr)) && _lvl_matches(vg, lvl, ptr))
+		return lvl;
+
+	/* Not indexed yet or renamed since */
 	dm_list_iterate_items(lvl, &vg->lvs)
-		if (!strcmp(lvl->lv->name, ptr))
+		if (!strcmp(lvl->lv->name, ptr)) {
+			vg_index_lv((struct volume_group *) vg, lvl);
 			return lvl;
+		}
 
 	return NULL;
 }
@@ -1675,11 +1687,20 @@ struct lv_list *find_lv_in_lv_list(const struct dm_list *ll,
 struct logical_volume *find_lv_in_vg_by_lvid(struct volume_group *vg,
 					     const union lvid *lvid)
 {
+	struct logical_volume *lv;
 	struct lv_list *lvl;
 
+	if (vg->lv_ids &&
+	    (lv = dm_hash_lookup_binary(vg->lv_ids, &lvid->id[1], sizeof(lvid->id[1]))) &&
+	    (lv->vg == vg) && !(lv->status & LV_REMOVED) &&
+	    !strncmp(lv->lvid.s, lvid->s, sizeof(*lvid)))
+		return lv;
+
 	dm_list_iterate_items(lvl, &vg->lvs)
-		if (!strncmp(lvl->lv->lvid.s, lvid->s, sizeof(*lvid)))
+		if (!strncmp(lvl->lv->lvid.s, lvid->s, sizeof(*lvid))) {
+			vg_index_lv(vg, lvl);
 			return lvl->lv;
+		}
 
 	return NULL;
 }
@@ -1707,8 +1728,19 @@ struct generic_logical_volume *find_historical_glv(const struct volume_group *vg
 	else
 		ptr = historical_lv_name;
 
+	if (!check_removed_list && vg->historical_lv_names &&
+	    (glvl = dm_hash_lookup(vg->historical_lv_names, ptr)) &&
+	    (glvl->glv->historical->vg == vg) &&
+	    !strcmp(glvl->glv->historical->name, ptr)) {
+		if (glvl_found)
+			*glvl_found = glvl;
+		return glvl->glv;
+	}
+
 	dm_list_iterate_items(glvl, list) {
 		if (!strcmp(glvl->glv->historical->name, ptr)) {
+			if (!check_removed_list)
+				vg_index_historical_lv((struct volume_group *) vg, glvl);
 			if (glvl_found)
 				*glvl_found = glvl;
 			return glvl->glv;
@@ -2147,6 +2179,7 @@ static int _lv_validate_references_single(struct logical_volume *lv, void *data)
 	struct validate_hash *vhash = data;
 	struct lv_segment *lvseg;
 	struct physical_volume *pv;
+	struct pv_list *pvl;
 	unsigned s;
 	int r = 1;
 
@@ -2164,8 +2197,9 @@ static int _lv_validate_references_single(struct logical_volume *lv, void *data)
 				continue;
 			pv = seg_pv(lvseg, s);
 			/* look up the reference in vg->pvs */
-			if (pv != dm_hash_lookup_binary(vhash->pvid, &pv->id,
-							sizeof(pv->id))) {
+			if (!(pvl = dm_hash_lookup_binary(vhash->pvid, &pv->id,
+							  sizeof(pv->id))) ||
+			    (pv != pvl->pv)) {
 				log_error(INTERNAL_ERROR
 					  "Referenced PV %s not listed in VG %s.",
 					  pv_dev_name(pv), vg->name);
@@ -2246,6 +2280,14 @@ static int _validate_lv_lock_args(struct logical_volume *lv)
 	return r;
 }
 
+static void _swap_hash(struct dm_hash_table **a, struct dm_hash_table **b)
+{
+	struct dm_hash_table *t = *a;
+
+	*a = *b;
+	*b = t;
+}
+
 int vg_validate(struct volume_group *vg)
 {
 	struct pv_list *pvl;
@@ -2330,7 +2372,7 @@ int vg_validate(struct volume_group *vg)
 			}
 
 		if (!dm_hash_insert_binary(vhash.pvid, &pvl->pv->id,
-					   sizeof(pvl->pv->id), pvl->pv)) {
+					   sizeof(pvl->pv->id), pvl)) {
 			log_error("Failed to hash pvid.");
 			r = 0;
 			break;
@@ -2741,7 +2783,7 @@ int vg_validate(struct volume_group *vg)
 			continue;
 		}
 
-                if (!dm_hash_insert(vhash.historical_lvname, hlv->name, hlv)) {
+                if (!dm_hash_insert(vhash.historical_lvname, hlv->name, glvl)) {
                         log_error("Failed to hash historical LV name");
                         r = 0;
                         break;
@@ -2767,6 +2809,13 @@ int vg_validate(struct volume_group *vg)
 		}
 	}
 
+	/* The tables now describe the whole VG, keep them as its lookup indexes */
+	if (r) {
+		_swap_hash(&vg->lv_names, &vhash.lvname);
+		_swap_hash(&vg->lv_ids, &vhash.lvid);
+		_swap_hash(&vg->pv_ids, &vhash.pvid);
+		_swap_hash(&vg->historical_lv_names, &vhash.historical_lvname);
+	}
 out:
 	if (vhash.lvid)
 		dm_hash_destroy(vhash.lvid);
@@ -2923,6 +2972,34 @@ static void _wipe_outdated_pvs(struct cmd_context *cmd, struct volume_group *vg)
 	lvmcache_del_outdated_devs(cmd, vg->name, (const char *)&vg->id);
 }
 
+/*
+ * Flush the writes of one phase queued to all mda devices and clear
+ * MDA_WRITE_QUEUED.  Returns the number of mdas that failed to write.
+ */
+static int _vg_flush_mdas(struct volume_group *vg, int mark_failed)
+{
+	struct metadata_area *mda;
+	struct device *dev;
+	int ok = dev_write_batch_end();
+	int failed = 0;
+
+	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
+		if (!(mda->status & MDA_WRITE_QUEUED))
+			continue;
+
+		mda->status &= ~MDA_WRITE_QUEUED;
+
+		if (ok || !(dev = mda_get_device(mda)) || !(dev->flags & DEV_WRITE_FAILED))
+			continue;
+
+		failed++;
+		if (mark_failed)
+			mda->status |= MDA_FAILED;
+	}
+
+	return failed;
+}
+
 /*
  * After vg_write() returns success,
  * caller MUST call either vg_commit() or vg_revert()
@@ -2934,7 +3011,7 @@ int vg_write(struct volume_group *vg)
 	struct metadata_area *mda;
 	struct lv_list *lvl;
 	struct device *mda_dev;
-	int revert = 0, wrote = 0;
+	int revert = 0, wrote = 0, failed;
 
 	if (vg_is_shared(vg)) {
 		dm_list_iterate_items(lvl, &vg->lvs) {
@@ -3025,7 +3102,8 @@ int vg_write(struct volume_group *vg)
 		dm_list_del(&pvl->list);
 	}
 
-	/* Write to each copy of the metadata area */
+	/* Write to each copy of the metadata area, flushed together below */
+	dev_write_batch_begin();
 	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
 		mda_dev = mda_get_device(mda);
 
@@ -3064,8 +3142,18 @@ int vg_write(struct volume_group *vg)
 				revert = 1;
 				break;
 			}
-		} else
+		} else {
+			mda->status |= MDA_WRITE_QUEUED;
 			++ wrote;
+		}
+	}
+
+	if ((failed = _vg_flush_mdas(vg, vg->cmd->handles_missing_pvs))) {
+		if (vg->cmd->handles_missing_pvs) {
+			log_warn("WARNING: Failed to write %d MDA(s) of VG %s.", failed, vg->name);
+			wrote -= failed;
+		} else
+			revert = 1;
 	}
 
 	if (revert || !wrote) {
@@ -3084,24 +3172,36 @@ int vg_write(struct volume_group *vg)
 		return 0;
 	}
 
-	/* Now pre-commit each copy of the new metadata */
+	/*
+	 * Now pre-commit each copy of the new metadata.
+	 * The metadata written above is already on disk.
+	 */
+	dev_write_batch_begin();
 	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
 		if (mda->status & MDA_FAILED)
 			continue;
 		if (mda->ops->vg_precommit &&
 		    !mda->ops->vg_precommit(vg->fid, vg, mda)) {
 			stack;
-			/* Revert */
-			dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
-				if (mda->status & MDA_FAILED)
-					continue;
-				if (mda->ops->vg_revert &&
-				    !mda->ops->vg_revert(vg->fid, vg, mda)) {
-					stack;
-				}
+			revert = 1;
+			break;
+		}
+		mda->status |= MDA_WRITE_QUEUED;
+	}
+
+	if (_vg_flush_mdas(vg, 0))
+		revert = 1;
+
+	if (revert) {
+		dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
+			if (mda->status & MDA_FAILED)
+				continue;
+			if (mda->ops->vg_revert &&
+			    !mda->ops->vg_revert(vg->fid, vg, mda)) {
+				stack;
 			}
-			return 0;
 		}
+		return 0;
 	}
 
 	if (!_vg_update_embedded_copy(vg, &vg->vg_precommitted)) /* prepare precommited */
@@ -3116,9 +3216,7 @@ static int _vg_commit_mdas(struct volume_group *vg)
 {
 	struct metadata_area *mda, *tmda;
 	struct dm_list ignored;
-	int failed = 0;
 	int good = 0;
-	int cache_updated = 0;
 
 	/* Rearrange the metadata_areas_in_use so ignored mdas come first. */
 	dm_list_init(&ignored);
@@ -3129,26 +3227,28 @@ static int _vg_commit_mdas(struct volume_group *vg)
 	dm_list_iterate_items_safe(mda, tmda, &ignored)
 		dm_list_move(&vg->fid->metadata_areas_in_use, &mda->list);
 
-	/* Commit to each copy of the metadata area */
+	/* Commit to each copy of the metadata area, flushed together */
+	dev_write_batch_begin();
 	dm_list_iterate_items(mda, &vg->fid->metadata_areas_in_use) {
 		if (mda->status & MDA_FAILED)
 			continue;
-		failed = 0;
 		if (mda->ops->vg_commit &&
 		    !mda->ops->vg_commit(vg->fid, vg, mda)) {
 			stack;
-			failed = 1;
-		} else
+		} else {
+			mda->status |= MDA_WRITE_QUEUED;
 			good++;
-
-		/* Update cache first time we succeed */
-		if (!failed && !cache_updated) {
-			lvmcache_update_vg_from_write(vg);
-			cache_updated = 1;
 		}
 	}
-	if (good)
+
+	good -= _vg_flush_mdas(vg, 0);
+
+	/* Update cache once the commit succeeded */
+	if (good) {
+		lvmcache_update_vg_from_write(vg);
 		return 1;
+	}
+
 	return 0;
 }
 
@@ -3168,8 +3268,11 @@ int vg_commit(struct volume_group *vg)
 		 * The volume_group structure could be reused later.
 		 */
 		vg->old_name = NULL;
-	        dm_list_iterate_items(pvl, &vg->pvs)
+	        dm_list_iterate_items(pvl, &vg->pvs) {
 			pvl->pv->status &= ~PV_MOVED_VG;
+			if (pvl->pv->dev)
+				hint_update_pv(pvl->pv->dev, (const char *)&pvl->pv->id, vg->name);
+		}
 
 		/* This *is* the original now that it's commited. */
 		_vg_move_cached_precommitted_to_committed(vg);
@@ -3675,6 +3778,10 @@ int pv_write(struct cmd_context *cmd,
 
 	pv->status &= ~UNLABELLED_PV;
 
+	if (pv->dev)
+		hint_update_pv(pv->dev, (const char *)&pv->id,
+			       is_orphan_vg(pv->vg_name) ? NULL : pv->vg_name);
+
 	return 1;
 }
 
@@ -5220,8 +5327,6 @@ struct volume_group *vg_read(struct cmd_context *cmd, const char *vg_name, const
 	 * FIXME: be specific about exactly when this works correctly.
 	 */
 	if (writing) {
-		struct dm_config_tree *cft;
-
 		if (dm_pool_locked(vg->vgmem)) {
 			/* FIXME: can this happen? */
 			log_warn("WARNING: vg_read no vg copy: pool locked.");
@@ -5242,15 +5347,8 @@ struct volume_group *vg_read(struct cmd_context *cmd, const char *vg_name, const
 			vg->vg_precommitted = NULL;
 		}
 
-		if (!(cft = export_vg_to_config_tree(vg))) {
-			log_warn("WARNING: vg_read no vg copy: copy export failed.");
-			goto out;
-		}
-
-		if (!(vg->vg_committed = import_vg_from_config_tree(cmd, vg->fid, cft)))
-			log_warn("WARNING: vg_read no vg copy: copy import failed.");
-
-		dm_config_destroy(cft);
+		if (!(vg->vg_committed = vg_copy(vg)))
+			log_warn("WARNING: vg_read no vg copy: copy failed.");
 	} else {
 		if (vg->vg_precommitted)
 			log_error(INTERNAL_ERROR "vg_read vg %p vg_precommitted %p", (void *)vg, (void *)vg->vg_precommitted);
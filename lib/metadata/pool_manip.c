@@ -211,6 +211,7 @@ static struct generic_logical_volume *_create_historical_glv(struct lv_segment *
 	}
 
 	dm_list_add(&seg_to_remove->lv->vg->historical_lvs, &historical_glvl->list);
+	vg_index_historical_lv(seg_to_remove->lv->vg, historical_glvl);
 	return historical_glvl->glv;
 bad:
 	log_error("Failed to create historical LV representation for removed logical "
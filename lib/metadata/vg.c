@@ -19,6 +19,19 @@
 #include "lib/activate/activate.h"
 #include "lib/commands/toolcontext.h"
 #include "lib/format_text/archiver.h"
+#include "lib/datastruct/str_list.h"
+
+static void _destroy_indexes(struct volume_group *vg)
+{
+	if (vg->lv_names)
+		dm_hash_destroy(vg->lv_names);
+	if (vg->lv_ids)
+		dm_hash_destroy(vg->lv_ids);
+	if (vg->pv_ids)
+		dm_hash_destroy(vg->pv_ids);
+	if (vg->historical_lv_names)
+		dm_hash_destroy(vg->historical_lv_names);
+}
 
 struct volume_group *alloc_vg(const char *pool_name, struct cmd_context *cmd,
 			      const char *vg_name)
@@ -52,6 +65,17 @@ struct volume_group *alloc_vg(const char *pool_name, struct cmd_context *cmd,
 		return NULL;
 	}
 
+	if (!(vg->lv_names = dm_hash_create(64)) ||
+	    !(vg->lv_ids = dm_hash_create(64)) ||
+	    !(vg->pv_ids = dm_hash_create(16)) ||
+	    !(vg->historical_lv_names = dm_hash_create(16))) {
+		log_error("Failed to allocate VG lookup hashtables.");
+		_destroy_indexes(vg);
+		dm_hash_destroy(vg->hostnames);
+		dm_pool_destroy(vgmem);
+		return NULL;
+	}
+
 	dm_list_init(&vg->pvs);
 	dm_list_init(&vg->pv_write_list);
 	dm_list_init(&vg->lvs);
@@ -78,6 +102,7 @@ static void _free_vg(struct volume_group *vg)
 
 	log_debug_mem("Freeing VG %s at %p.", vg->name ? : "<no name>", (void *)vg);
 
+	_destroy_indexes(vg);
 	dm_hash_destroy(vg->hostnames);
 	dm_pool_destroy(vg->vgmem);
 }
@@ -104,6 +129,550 @@ void free_orphan_vg(struct volume_group *vg)
 	_free_vg(vg);
 }
 
+/*
+ * Status bits that are never written to metadata.  A VG copy must not
+ * carry them, so it matches what a reparse of the exported text would give.
+ */
+#define VG_COPY_DROP_VG_STATUS	(PARTIAL_VG | PRECOMMITTED | ARCHIVED_VG)
+#define VG_COPY_DROP_PV_STATUS	(PV_MOVED_VG | UNLABELLED_PV)
+#define VG_COPY_DROP_LV_STATUS	(LV_NOSCAN | LV_TEMPORARY | POSTORDER_FLAG | PARTIAL_LV)
+
+/*
+ * Pointer translation table from objects of the source VG
+ * to their counterparts in the copy.
+ */
+static int _copy_map_add(struct dm_hash_table *map, const void *old, void *new)
+{
+	if (!dm_hash_insert_binary(map, &old, sizeof(old), new)) {
+		log_error("Failed to map object for VG copy.");
+		return 0;
+	}
+
+	return 1;
+}
+
+static int _copy_map_find(struct dm_hash_table *map, const void *old, void **new)
+{
+	if (!old) {
+		*new = NULL;
+		return 1;
+	}
+
+	if (!(*new = dm_hash_lookup_binary(map, &old, sizeof(old)))) {
+		log_error(INTERNAL_ERROR "VG copy references object %p outside the VG.", old);
+		return 0;
+	}
+
+	return 1;
+}
+
+#define _copy_map(map, old, new) _copy_map_find((map), (old), (void **) &(new))
+
+static int _copy_str(struct dm_pool *mem, const char *old, const char **new)
+{
+	if (!old) {
+		*new = NULL;
+		return 1;
+	}
+
+	if (!(*new = dm_pool_strdup(mem, old))) {
+		log_error("Failed to copy string for VG copy.");
+		return 0;
+	}
+
+	return 1;
+}
+
+static int _copy_glv_list(struct dm_pool *mem, struct dm_hash_table *map,
+			  struct dm_list *new, struct dm_list *old)
+{
+	struct glv_list *glvl, *new_glvl;
+
+	dm_list_init(new);
+
+	dm_list_iterate_items(glvl, old) {
+		if (!(new_glvl = dm_pool_zalloc(mem, sizeof(*new_glvl))))
+			return_0;
+		if (!_copy_map(map, glvl->glv, new_glvl->glv))
+			return_0;
+		dm_list_add(new, &new_glvl->list);
+	}
+
+	return 1;
+}
+
+static int _copy_areas(struct dm_pool *mem, struct dm_hash_table *map,
+		       struct lv_segment_area **new, const struct lv_segment_area *old,
+		       uint32_t area_count)
+{
+	uint32_t s;
+
+	if (!old) {
+		*new = NULL;
+		return 1;
+	}
+
+	if (!(*new = dm_pool_alloc(mem, area_count * sizeof(**new))))
+		return_0;
+
+	for (s = 0; s < area_count; s++) {
+		(*new)[s] = old[s];
+		switch (old[s].type) {
+		case AREA_PV:
+			if (!_copy_map(map, old[s].u.pv.pvseg, (*new)[s].u.pv.pvseg))
+				return_0;
+			break;
+		case AREA_LV:
+			if (!_copy_map(map, old[s].u.lv.lv, (*new)[s].u.lv.lv))
+				return_0;
+			break;
+		case AREA_UNASSIGNED:
+			break;
+		}
+	}
+
+	return 1;
+}
+
+static struct lv_segment *_copy_lv_segment(struct dm_pool *mem, struct dm_hash_table *map,
+					   struct logical_volume *lv,
+					   const struct lv_segment *old)
+{
+	struct lv_segment *seg;
+	struct lv_thin_message *tmsg, *new_tmsg;
+
+	if (!(seg = dm_pool_alloc(mem, sizeof(*seg))))
+		return_NULL;
+
+	*seg = *old;
+	seg->lv = lv;
+	seg->pvmove_source_seg = NULL;	/* Resolved once all segments exist */
+	dm_list_init(&seg->origin_list);
+	dm_list_init(&seg->tags);
+	dm_list_init(&seg->thin_messages);
+
+	if (!str_list_dup(mem, &seg->tags, &old->tags))
+		return_NULL;
+
+	if (!_copy_map(map, old->origin, seg->origin) ||
+	    !_copy_map(map, old->indirect_origin, seg->indirect_origin) ||
+	    !_copy_map(map, old->merge_lv, seg->merge_lv) ||
+	    !_copy_map(map, old->cow, seg->cow) ||
+	    !_copy_map(map, old->log_lv, seg->log_lv) ||
+	    !_copy_map(map, old->metadata_lv, seg->metadata_lv) ||
+	    !_copy_map(map, old->external_lv, seg->external_lv) ||
+	    !_copy_map(map, old->pool_lv, seg->pool_lv) ||
+	    !_copy_map(map, old->writecache, seg->writecache) ||
+	    !_copy_map(map, old->integrity_meta_dev, seg->integrity_meta_dev))
+		return_NULL;
+
+	if (!_copy_areas(mem, map, &seg->areas, old->areas, old->area_count) ||
+	    !_copy_areas(mem, map, &seg->meta_areas, old->meta_areas, old->area_count))
+		return_NULL;
+
+	dm_list_iterate_items(tmsg, &old->thin_messages) {
+		if (!(new_tmsg = dm_pool_alloc(mem, sizeof(*new_tmsg))))
+			return_NULL;
+		*new_tmsg = *tmsg;
+		switch (tmsg->type) {
+		case DM_THIN_MESSAGE_CREATE_SNAP:
+		case DM_THIN_MESSAGE_CREATE_THIN:
+			if (!_copy_map(map, tmsg->u.lv, new_tmsg->u.lv))
+				return_NULL;
+			break;
+		default:
+			break;
+		}
+		dm_list_add(&seg->thin_messages, &new_tmsg->list);
+	}
+
+	if (old->metadata_id) {
+		if (!(seg->metadata_id = dm_pool_alloc(mem, sizeof(*seg->metadata_id))))
+			return_NULL;
+		*seg->metadata_id = *old->metadata_id;
+	}
+
+	if (old->data_id) {
+		if (!(seg->data_id = dm_pool_alloc(mem, sizeof(*seg->data_id))))
+			return_NULL;
+		*seg->data_id = *old->data_id;
+	}
+
+	if (!_copy_str(mem, old->policy_name, &seg->policy_name))
+		return_NULL;
+
+	if (old->policy_settings &&
+	    !(seg->policy_settings = dm_config_clone_node_with_mem(mem, old->policy_settings, 0)))
+		return_NULL;
+
+	/* Only unknown segment types keep their original config nodes here */
+	if (old->segtype_private &&
+	    !(seg->segtype_private = dm_config_clone_node_with_mem(mem, old->segtype_private, 1)))
+		return_NULL;
+
+	if (!_copy_str(mem, old->writecache_settings.new_key,
+		       (const char **) &seg->writecache_settings.new_key) ||
+	    !_copy_str(mem, old->writecache_settings.new_val,
+		       (const char **) &seg->writecache_settings.new_val) ||
+	    !_copy_str(mem, old->integrity_settings.internal_hash,
+		       &seg->integrity_settings.internal_hash))
+		return_NULL;
+
+	return seg;
+}
+
+static int _copy_pv(struct volume_group *vg, struct dm_hash_table *map,
+		    const struct physical_volume *old)
+{
+	struct dm_pool *mem = vg->vgmem;
+	struct physical_volume *pv;
+	struct pv_segment *peg, *new_peg;
+	struct pv_list *pvl;
+
+	if (!(pv = dm_pool_alloc(mem, sizeof(*pv))) ||
+	    !(pvl = dm_pool_zalloc(mem, sizeof(*pvl))))
+		return_0;
+
+	*pv = *old;
+	pv->vg = vg;
+	pv->fid = NULL;			/* Set with vg_set_fid() */
+	pv->status &= ~VG_COPY_DROP_PV_STATUS;
+	dm_list_init(&pv->segments);
+	dm_list_init(&pv->tags);
+
+	pv->vg_name = vg->name;
+
+	if (!_copy_str(mem, old->device_hint, &pv->device_hint) ||
+	    !str_list_dup(mem, &pv->tags, &old->tags))
+		return_0;
+
+	/* Owning LV segments are filled in once they are copied */
+	dm_list_iterate_items(peg, &old->segments) {
+		if (!(new_peg = dm_pool_alloc(mem, sizeof(*new_peg))))
+			return_0;
+		*new_peg = *peg;
+		new_peg->pv = pv;
+		new_peg->lvseg = NULL;
+		dm_list_add(&pv->segments, &new_peg->list);
+		if (!_copy_map_add(map, peg, new_peg))
+			return_0;
+	}
+
+	pvl->pv = pv;
+	dm_list_add(&vg->pvs, &pvl->list);
+	vg_index_pv(vg, pvl);
+
+	return _copy_map_add(map, old, pv);
+}
+
+static int _copy_lv(struct volume_group *vg, struct dm_hash_table *map,
+		    const struct logical_volume *old)
+{
+	struct dm_pool *mem = vg->vgmem;
+	struct logical_volume *lv;
+	const char *hn;
+
+	if (!(lv = alloc_lv(mem)))
+		return_0;
+
+	lv->lvid = old->lvid;
+	lv->status = old->status & ~VG_COPY_DROP_LV_STATUS;
+	lv->alloc = old->alloc;
+	lv->profile = old->profile;
+	lv->read_ahead = old->read_ahead;
+	lv->major = old->major;
+	lv->minor = old->minor;
+	lv->size = old->size;
+	lv->le_count = old->le_count;
+	lv->origin_count = old->origin_count;
+	lv->external_count = old->external_count;
+	lv->timestamp = old->timestamp;
+
+	if (!_copy_str(mem, old->name, &lv->name) ||
+	    !_copy_str(mem, old->lock_args, &lv->lock_args) ||
+	    !str_list_dup(mem, &lv->tags, &old->tags))
+		return_0;
+
+	if (!link_lv_to_vg(vg, lv))
+		return_0;
+
+	if (old->hostname) {
+		if (!(hn = dm_hash_lookup(vg->hostnames, old->hostname))) {
+			if (!(hn = dm_pool_strdup(mem, old->hostname)) ||
+			    !dm_hash_insert(vg->hostnames, hn, (void *) hn))
+				return_0;
+		}
+		lv->hostname = hn;
+	}
+
+	if (old->this_glv) {
+		if (!(lv->this_glv = dm_pool_zalloc(mem, sizeof(*lv->this_glv))))
+			return_0;
+		lv->this_glv->live = lv;
+		if (!_copy_map_add(map, old->this_glv, lv->this_glv))
+			return_0;
+	}
+
+	return _copy_map_add(map, old, lv);
+}
+
+static int _copy_historical_lv(struct volume_group *vg, struct dm_hash_table *map,
+			       const struct generic_logical_volume *old)
+{
+	struct dm_pool *mem = vg->vgmem;
+	struct historical_logical_volume *hlv;
+	struct glv_list *glvl;
+
+	if (!(hlv = dm_pool_alloc(mem, sizeof(*hlv))) ||
+	    !(glvl = dm_pool_zalloc(mem, sizeof(*glvl))) ||
+	    !(glvl->glv = dm_pool_zalloc(mem, sizeof(*glvl->glv))))
+		return_0;
+
+	*hlv = *old->historical;
+	hlv->vg = vg;
+	hlv->indirect_origin = NULL;	/* Resolved once all glvs exist */
+	dm_list_init(&hlv->indirect_glvs);
+
+	if (!_copy_str(mem, old->historical->name, &hlv->name))
+		return_0;
+
+	glvl->glv->is_historical = 1;
+	glvl->glv->historical = hlv;
+	dm_list_add(&vg->historical_lvs, &glvl->list);
+	vg_index_historical_lv(vg, glvl);
+
+	return _copy_map_add(map, old, glvl->glv);
+}
+
+/*
+ * Structural deep copy of a VG into its own memory pool.
+ *
+ * The result is equivalent to exporting the VG to text and importing it
+ * again, without the cost of formatting and parsing the metadata.
+ * Runtime-only state (removed LVs/PVs, pending PV writes, transient
+ * status bits) is not copied.
+ */
+struct volume_group *vg_copy(struct volume_group *vg)
+{
+	struct volume_group *new_vg;
+	struct dm_hash_table *map = NULL;
+	struct pv_list *pvl;
+	struct lv_list *lvl;
+	struct glv_list *glvl;
+	struct lv_segment *seg, *new_seg;
+	struct seg_list *sl, *new_sl;
+	struct pv_segment *peg, *new_peg;
+	struct logical_volume *lv;
+	struct historical_logical_volume *hlv;
+	struct generic_logical_volume *glv;
+	unsigned objects = 0;
+
+	if (!(new_vg = alloc_vg("vg_copy", vg->cmd, vg->name)))
+		return_NULL;
+
+	dm_list_iterate_items(pvl, &vg->pvs)
+		objects += 1 + dm_list_size(&pvl->pv->segments);
+	dm_list_iterate_items(lvl, &vg->lvs)
+		objects += 2 + dm_list_size(&lvl->lv->segments);
+	objects += dm_list_size(&vg->historical_lvs);
+
+	if (!(map = dm_hash_create(objects + 16))) {
+		log_error("Failed to allocate VG copy map.");
+		goto bad;
+	}
+
+	new_vg->original_fmt = vg->original_fmt;
+	new_vg->vginfo = vg->vginfo;
+	new_vg->seqno = vg->seqno;
+	new_vg->alloc = vg->alloc;
+	new_vg->profile = vg->profile;
+	new_vg->status = vg->status & ~VG_COPY_DROP_VG_STATUS;
+	new_vg->id = vg->id;
+	new_vg->extent_size = vg->extent_size;
+	new_vg->extent_count = vg->extent_count;
+	new_vg->free_count = vg->free_count;
+	new_vg->max_lv = vg->max_lv;
+	new_vg->max_pv = vg->max_pv;
+	new_vg->pv_count = vg->pv_count;
+	new_vg->mda_copies = vg->mda_copies;
+
+	if (!_copy_str(new_vg->vgmem, vg->system_id, &new_vg->system_id) ||
+	    !_copy_str(new_vg->vgmem, vg->lock_type, &new_vg->lock_type) ||
+	    !_copy_str(new_vg->vgmem, vg->lock_args, &new_vg->lock_args) ||
+	    !str_list_dup(new_vg->vgmem, &new_vg->tags, &vg->tags))
+		goto_bad;
+
+	/* Objects first, so every reference between them can be translated */
+	dm_list_iterate_items(pvl, &vg->pvs)
+		if (!_copy_pv(new_vg, map, pvl->pv))
+			goto_bad;
+
+	dm_list_iterate_items(lvl, &vg->lvs)
+		if (!_copy_lv(new_vg, map, lvl->lv))
+			goto_bad;
+
+	dm_list_iterate_items(glvl, &vg->historical_lvs)
+		if (!_copy_historical_lv(new_vg, map, glvl->glv))
+			goto_bad;
+
+	dm_list_iterate_items(lvl, &vg->lvs) {
+		if (!_copy_map(map, lvl->lv, lv))
+			goto_bad;
+		dm_list_iterate_items(seg, &lvl->lv->segments) {
+			if (!(new_seg = _copy_lv_segment(new_vg->vgmem, map, lv, seg)))
+				goto_bad;
+			dm_list_add(&lv->segments, &new_seg->list);
+			if (!_copy_map_add(map, seg, new_seg))
+				goto_bad;
+		}
+	}
+
+	/* Back references and cross links between the copied objects */
+	dm_list_iterate_items(pvl, &vg->pvs)
+		dm_list_iterate_items(peg, &pvl->pv->segments)
+			if (peg->lvseg &&
+			    (!_copy_map(map, peg, new_peg) ||
+			     !_copy_map(map, peg->lvseg, new_peg->lvseg)))
+				goto_bad;
+
+	dm_list_iterate_items(lvl, &vg->lvs) {
+		if (!_copy_map(map, lvl->lv, lv) ||
+		    !_copy_map(map, lvl->lv->snapshot, lv->snapshot))
+			goto_bad;
+
+		dm_list_iterate_items(seg, &lvl->lv->segments)
+			if (seg->pvmove_source_seg) {
+				if (!_copy_map(map, seg, new_seg) ||
+				    !_copy_map(map, seg->pvmove_source_seg, new_seg->pvmove_source_seg))
+					goto_bad;
+			}
+
+		dm_list_iterate_items_gen(seg, &lvl->lv->snapshot_segs, origin_list) {
+			if (!_copy_map(map, seg, new_seg))
+				goto_bad;
+			dm_list_add(&lv->snapshot_segs, &new_seg->origin_list);
+		}
+
+		dm_list_iterate_items(sl, &lvl->lv->segs_using_this_lv) {
+			if (!(new_sl = dm_pool_zalloc(new_vg->vgmem, sizeof(*new_sl))))
+				goto_bad;
+			new_sl->count = sl->count;
+			if (!_copy_map(map, sl->seg, new_sl->seg))
+				goto_bad;
+			dm_list_add(&lv->segs_using_this_lv, &new_sl->list);
+		}
+
+		if (!_copy_glv_list(new_vg->vgmem, map, &lv->indirect_glvs,
+				    &lvl->lv->indirect_glvs))
+			goto_bad;
+	}
+
+	dm_list_iterate_items(glvl, &vg->historical_lvs) {
+		if (!_copy_map(map, glvl->glv, glv))
+			goto_bad;
+		hlv = glv->historical;
+		if (!_copy_map(map, glvl->glv->historical->indirect_origin, hlv->indirect_origin) ||
+		    !_copy_glv_list(new_vg->vgmem, map, &hlv->indirect_glvs,
+				    &glvl->glv->historical->indirect_glvs))
+			goto_bad;
+	}
+
+	if (!_copy_map(map, vg->pool_metadata_spare_lv, new_vg->pool_metadata_spare_lv) ||
+	    !_copy_map(map, vg->sanlock_lv, new_vg->sanlock_lv))
+		goto_bad;
+
+	dm_hash_destroy(map);
+	map = NULL;
+
+	/* Same normalisation as import does after reading the metadata */
+	dm_list_iterate_items(lvl, &new_vg->lvs)
+		if (!lv_merge_segments(lvl->lv))
+			goto_bad;
+
+	if (!vg_mark_partial_lvs(new_vg, 1))
+		goto_bad;
+
+	if (vg->fid)
+		vg_set_fid(new_vg, vg->fid);
+
+	return new_vg;
+
+bad:
+	if (map)
+		dm_hash_destroy(map);
+	release_vg(new_vg);
+
+	return NULL;
+}
+
+/*
+ * Maintenance of the VG lookup indexes.  The indexes only speed up
+ * lookups, so a failed insert is not an error: the lookup falls back
+ * to scanning the list.
+ */
+static const struct id _zero_id;
+
+void vg_index_lv(struct volume_group *vg, struct lv_list *lvl)
+{
+	struct logical_volume *lv = lvl->lv;
+
+	if (!vg->lv_names || !vg->lv_ids)
+		return;	/* Static VG without indexes */
+
+	if (lv->name && !dm_hash_insert(vg->lv_names, lv->name, lvl))
+		log_debug_metadata("Failed to index LV name %s.", lv->name);
+
+	if (!id_equal(&lv->lvid.id[1], &_zero_id) &&
+	    !dm_hash_insert_binary(vg->lv_ids, &lv->lvid.id[1], sizeof(lv->lvid.id[1]), lv))
+		log_debug_metadata("Failed to index LV id of %s.", lv->name);
+}
+
+void vg_unindex_lv(struct volume_group *vg, struct lv_list *lvl)
+{
+	struct logical_volume *lv = lvl->lv;
+
+	if (!vg->lv_names || !vg->lv_ids)
+		return;
+
+	if (lv->name && dm_hash_lookup(vg->lv_names, lv->name) == lvl)
+		dm_hash_remove(vg->lv_names, lv->name);
+
+	if (dm_hash_lookup_binary(vg->lv_ids, &lv->lvid.id[1], sizeof(lv->lvid.id[1])) == lv)
+		dm_hash_remove_binary(vg->lv_ids, &lv->lvid.id[1], sizeof(lv->lvid.id[1]));
+}
+
+void vg_index_pv(struct volume_group *vg, struct pv_list *pvl)
+{
+	if (vg->pv_ids &&
+	    !dm_hash_insert_binary(vg->pv_ids, &pvl->pv->id, sizeof(pvl->pv->id), pvl))
+		log_debug_metadata("Failed to index PV id.");
+}
+
+void vg_unindex_pv(struct volume_group *vg, struct pv_list *pvl)
+{
+	if (vg->pv_ids &&
+	    dm_hash_lookup_binary(vg->pv_ids, &pvl->pv->id, sizeof(pvl->pv->id)) == pvl)
+		dm_hash_remove_binary(vg->pv_ids, &pvl->pv->id, sizeof(pvl->pv->id));
+}
+
+void vg_index_historical_lv(struct volume_group *vg, struct glv_list *glvl)
+{
+	const char *name = glvl->glv->historical->name;
+
+	if (name && vg->historical_lv_names &&
+	    !dm_hash_insert(vg->historical_lv_names, name, glvl))
+		log_debug_metadata("Failed to index historical LV name %s.", name);
+}
+
+void vg_unindex_historical_lv(struct volume_group *vg, struct glv_list *glvl)
+{
+	const char *name = glvl->glv->historical->name;
+
+	if (name && vg->historical_lv_names &&
+	    dm_hash_lookup(vg->historical_lv_names, name) == glvl)
+		dm_hash_remove(vg->historical_lv_names, name);
+}
+
 int link_lv_to_vg(struct volume_group *vg, struct logical_volume *lv)
 {
 	struct lv_list *lvl;
@@ -118,6 +687,7 @@ int link_lv_to_vg(struct volume_group *vg, struct logical_volume *lv)
 	lv->vg = vg;
 	dm_list_add(&vg->lvs, &lvl->list);
 	lv->status &= ~LV_REMOVED;
+	vg_index_lv(vg, lvl);
 
 	return 1;
 }
@@ -129,6 +699,7 @@ int unlink_lv_from_vg(struct logical_volume *lv)
 	if (!(lvl = find_lv_in_vg(lv->vg, lv->name)))
 		return_0;
 
+	vg_unindex_lv(lv->vg, lvl);
 	dm_list_move(&lv->vg->removed_lvs, &lvl->list);
 	lv->status |= LV_REMOVED;
 
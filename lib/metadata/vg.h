@@ -126,6 +126,19 @@ struct volume_group {
 	uint32_t mda_copies; /* target number of mdas for this VG */
 
 	struct dm_hash_table *hostnames; /* map of creation hostnames */
+
+	/*
+	 * Lookup indexes for find_lv_in_vg(), find_lv_in_vg_by_lvid(),
+	 * find_pv_in_vg_by_uuid() and find_historical_glv().
+	 * Entries are added as objects are linked into the VG and the whole
+	 * set is replaced by the tables vg_validate() builds.  Names and ids
+	 * may still be changed by direct assignment, so every hit is checked
+	 * against the object and a miss falls back to scanning the list.
+	 */
+	struct dm_hash_table *lv_names;		/* name -> struct lv_list */
+	struct dm_hash_table *lv_ids;		/* lvid.id[1] -> struct logical_volume */
+	struct dm_hash_table *pv_ids;		/* pv id -> struct pv_list */
+	struct dm_hash_table *historical_lv_names; /* name -> struct glv_list */
 	struct logical_volume *pool_metadata_spare_lv; /* one per VG */
 	struct logical_volume *sanlock_lv; /* one per VG */
 };
@@ -133,6 +146,25 @@ struct volume_group {
 struct volume_group *alloc_vg(const char *pool_name, struct cmd_context *cmd,
 			      const char *vg_name);
 
+/*
+ * Deep copy of a VG into a new memory pool, equivalent to
+ * an export and reimport of its metadata.  Free with release_vg().
+ */
+struct volume_group *vg_copy(struct volume_group *vg);
+
+/*
+ * Maintain the VG lookup indexes.
+ */
+struct lv_list;
+struct pv_list;
+struct glv_list;
+void vg_index_lv(struct volume_group *vg, struct lv_list *lvl);
+void vg_unindex_lv(struct volume_group *vg, struct lv_list *lvl);
+void vg_index_pv(struct volume_group *vg, struct pv_list *pvl);
+void vg_unindex_pv(struct volume_group *vg, struct pv_list *pvl);
+void vg_index_historical_lv(struct volume_group *vg, struct glv_list *glvl);
+void vg_unindex_historical_lv(struct volume_group *vg, struct glv_list *glvl);
+
 /*
  * release_vg() must be called on every struct volume_group allocated
  * by vg_create() or vg_read_internal() to free it when no longer required.
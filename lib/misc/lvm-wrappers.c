@@ -16,6 +16,7 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
 
 #ifdef UDEV_SYNC_SUPPORT
 #include <libudev.h>
@@ -99,6 +100,16 @@ int lvm_getpagesize(void)
 	return getpagesize();
 }
 
+uint64_t lvm_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 int read_urandom(void *buf, size_t len)
 {
 	int fd;
@@ -23,6 +23,11 @@ int udev_is_running(void);
 
 int lvm_getpagesize(void);
 
+/*
+ * Return monotonic clock time in nanoseconds, 0 on failure.
+ */
+uint64_t lvm_monotonic_ns(void);
+
 /*
  * Read 'len' bytes of entropy from /dev/urandom and store in 'buf'.
  */
@@ -4453,6 +4453,37 @@ int report_object(void *handle, int selection_only, const struct volume_group *v
 		  : dm_report_object(handle, &obj);
 }
 
+/*
+ * Check selection for LV or segment with metadata-only fields
+ * before LV device info and status is acquired.
+ */
+int report_object_preselect(void *handle, int selection_only,
+			    const struct logical_volume *lv,
+			    const struct lv_segment *seg, int *selected)
+{
+	struct selection_handle *sh = selection_only ? (struct selection_handle *) handle : NULL;
+	struct lv_with_info_and_seg_status status = {
+		.seg_status.type = SEG_STATUS_NONE,
+		.lv = lv
+	};
+	struct lvm_report_object obj = {
+		.vg = lv->vg,
+		.lvdm = &status,
+		.seg = (struct lv_segment *) seg
+	};
+
+	return dm_report_object_preselect(sh ? sh->selection_rh : handle, &obj,
+					  LVSINFO | LVSSTATUS | LVSINFOSTATUS, selected);
+}
+
+/* The preselected LV or segment is not reported after all. */
+void report_object_preselect_discard(void *handle, int selection_only)
+{
+	struct selection_handle *sh = selection_only ? (struct selection_handle *) handle : NULL;
+
+	dm_report_object_preselect_discard(sh ? sh->selection_rh : handle);
+}
+
 static int _report_devtype_single(void *handle, const dev_known_type_t *devtype)
 {
 	return dm_report_object(handle, (void *)devtype);
@@ -105,6 +105,10 @@ int report_object(void *handle, int selection_only, const struct volume_group *v
 		  const struct lv_segment *seg, const struct pv_segment *pvseg,
 		  const struct lv_with_info_and_seg_status *lvdm,
 		  const struct label *label);
+int report_object_preselect(void *handle, int selection_only,
+			    const struct logical_volume *lv,
+			    const struct lv_segment *seg, int *selected);
+void report_object_preselect_discard(void *handle, int selection_only);
 int report_devtypes(void *handle);
 int report_cmdlog(void *handle, const char *type, const char *context,
 		  const char *object_type_name, const char *object_name,
@@ -0,0 +1,88 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check devices/filter_cache saves results only for devices it can validate
+
+SKIP_WITH_LVMPOLLD=1
+SKIP_WITH_LVMLOCKD=1
+
+RUNDIR="/run"
+test -d "$RUNDIR" || RUNDIR="/var/run"
+FILTER_CACHE="$RUNDIR/lvm/filter_cache"
+
+. lib/inittest
+
+aux prepare_devs 2
+
+aux lvmconf 'devices/filter_cache = 1'
+
+rm -f "$FILTER_CACHE"
+
+pvcreate "$dev1"
+pvs 2>&1 | tee out
+grep "$dev1" out
+test -f "$FILTER_CACHE"
+grep "^config_hash:" "$FILTER_CACHE"
+
+# Test devices are dm devices, whose results are never saved
+MAJOR1=$((0x$(stat -L --printf=%t "$dev1")))
+MINOR1=$((0x$(stat -L --printf=%T "$dev1")))
+not grep "^$MAJOR1:$MINOR1 " "$FILTER_CACHE"
+
+pvs -vvvv 2>&1 | tee out
+not grep "$dev1: filter cache file using" out
+
+# Saved results are dropped with a different devices configuration
+aux lvmconf 'devices/pv_min_size = 2048'
+pvs -vvvv 2>&1 | tee out
+grep "Ignoring filter cache with different configuration" out
+
+# A loop device with a udev database entry has its result saved
+dd if=/dev/zero of=loopa bs=1M count=8 2> /dev/null
+LOOP=$(losetup -f loopa --show)
+aux extend_filter "a|$LOOP|"
+aux lvmconf 'devices/scan = "/dev"'
+aux udev_wait
+LMAJOR=$((0x$(stat -L --printf=%t "$LOOP")))
+LMINOR=$((0x$(stat -L --printf=%T "$LOOP")))
+
+if test -e "/run/udev/data/b$LMAJOR:$LMINOR" ; then
+	pvs
+	grep "^$LMAJOR:$LMINOR .* G " "$FILTER_CACHE"
+	pvs -vvvv 2>&1 | tee out
+	grep "$LOOP: filter cache file using good result" out
+
+	# A changed udev database entry invalidates the saved result
+	udevadm trigger --action=change "$LOOP"
+	aux udev_wait
+	pvs -vvvv 2>&1 | tee out
+	grep "$LOOP: filter cache file entry changed" out
+	grep "^$LMAJOR:$LMINOR " "$FILTER_CACHE"
+
+	# pvcreate checks the filters again, with the full md check,
+	# and drops the result of the device it wrote
+	pvcreate -vvvv "$LOOP" 2>&1 | tee out
+	sed -n '/Scanning and filtering device args/,$p' out > out2
+	not grep "$LOOP: filter cache file using" out2
+	not grep "^$LMAJOR:$LMINOR " "$FILTER_CACHE"
+	pvremove "$LOOP"
+fi
+
+losetup -d "$LOOP"
+rm loopa
+
+aux lvmconf 'devices/filter_cache = 0'
+rm -f "$FILTER_CACHE"
+pvs
+not test -f "$FILTER_CACHE"
+
+pvremove "$dev1"
@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check device filters run cheapest first and report their statistics
+
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+aux prepare_devs 2
+
+pvcreate "$dev1"
+
+pvs -vvvv 2>&1 | tee out
+
+# Filters reading the device come after those using only memory
+grep "Composite filter 0: sysfs" out
+test "$(grep -n "Composite filter .*: regex" out | cut -d: -f1)" -lt \
+     "$(grep -n "Composite filter .*: signature" out | cut -d: -f1)"
+
+grep "Filter regex checked" out
+grep "Filter signature checked" out
+
+pvremove "$dev1"
@@ -68,7 +68,7 @@ fi
 #
 # vg2 uses dev3,dev4
 #
-# Test common commands that cause hints to be refreshed:
+# Test common commands that update hints with their changes:
 # pvcreate/vgcreate/vgextend/vgreduce/vgremove/pvremove
 #
 
@@ -76,9 +76,10 @@ not pvs "$dev3"
 not grep "$dev3" $HINTS
 cp $HINTS $PREV
 pvcreate "$dev3"
-grep "# Created empty" $HINTS
-cat $NEWHINTS
-# next cmd recreates hints
+grep "# Updated by pvcreate" $HINTS
+grep "$dev3" $HINTS
+not cat $NEWHINTS
+# next cmd uses updated hints
 pvs "$dev3"
 grep "$dev3" $HINTS
 not diff $HINTS $PREV
@@ -87,9 +88,9 @@ not cat $NEWHINTS
 not vgs $vg2
 cp $HINTS $PREV
 vgcreate $vg2 "$dev3"
-grep "# Created empty" $HINTS
-cat $NEWHINTS
-# next cmd recreates hints
+grep "# Updated by vgcreate" $HINTS
+grep "$dev3.*vg:$vg2" $HINTS
+not cat $NEWHINTS
 vgs $vg2
 grep $vg2 $HINTS
 not diff $HINTS $PREV
@@ -97,9 +98,9 @@ not cat $NEWHINTS
 
 cp $HINTS $PREV
 vgextend $vg2 "$dev4"
-grep "# Created empty" $HINTS
-cat $NEWHINTS
-# next cmd recreates hints
+grep "# Updated by vgextend" $HINTS
+grep "$dev4.*vg:$vg2" $HINTS
+not cat $NEWHINTS
 vgs $vg2
 grep "$dev4" $HINTS
 not diff $HINTS $PREV
@@ -107,9 +108,9 @@ not cat $NEWHINTS
 
 cp $HINTS $PREV
 vgreduce $vg2 "$dev4"
-grep "# Created empty" $HINTS
-cat $NEWHINTS
-# next cmd recreates hints
+grep "# Updated by vgreduce" $HINTS
+grep "$dev4.*vg:-" $HINTS
+not cat $NEWHINTS
 vgs $vg2
 grep "$dev4" $HINTS
 not diff $HINTS $PREV
@@ -117,9 +118,8 @@ not cat $NEWHINTS
 
 cp $HINTS $PREV
 vgremove $vg2
-grep "# Created empty" $HINTS
-cat $NEWHINTS
-# next cmd recreates hints
+grep "# Updated by vgremove" $HINTS
+not cat $NEWHINTS
 not vgs $vg2
 not grep $vg2 $HINTS
 not diff $HINTS $PREV
@@ -127,9 +127,8 @@ not cat $NEWHINTS
 
 cp $HINTS $PREV
 pvremove "$dev3" "$dev4"
-grep "# Created empty" $HINTS
-cat $NEWHINTS
-# next cmd recreates hints
+grep "# Updated by pvremove" $HINTS
+not cat $NEWHINTS
 not pvs "$dev3"
 not pvs "$dev4"
 not grep "$dev3" $HINTS
@@ -137,6 +136,20 @@ not grep "$dev4" $HINTS
 not diff $HINTS $PREV
 not cat $NEWHINTS
 
+# updated hints are the same as hints created by a full scan
+grep scan: $HINTS | sort > scan1
+rm $HINTS
+pvs
+grep scan: $HINTS | sort > scan2
+diff scan1 scan2
+
+# a failed command clears hints
+not vgcreate $vg1 "$dev3"
+grep "# Created empty" $HINTS
+cat $NEWHINTS
+pvs
+not cat $NEWHINTS
+
 #
 # Test that adding a new device and removing a device
 # causes hints to be recreated.
@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+test_description='Scan and update metadata with each io engine'
+
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+aux prepare_devs 8
+get_devs
+
+vgcreate $SHARED $vg "${DEVICES[@]}"
+lvcreate -l1 -n $lv1 $vg
+
+for engine in sync aio io_uring ; do
+	aux lvmconf "devices/io_engine = \"$engine\""
+
+	# An engine that is not supported falls back, results are the same
+	start=$(date +%s%N)
+	for i in $(seq 1 10); do
+		pvs -o+pv_uuid > "pvs.$engine"
+	done
+	end=$(date +%s%N)
+	echo "io_engine $engine: 10 scans in $(( (end - start) / 1000000 ))ms"
+done
+
+diff pvs.sync pvs.aio
+diff pvs.sync pvs.io_uring
+
+for engine in sync aio io_uring ; do
+	aux lvmconf "devices/io_engine = \"$engine\""
+
+	lvcreate -l1 -n "lv_$engine" $vg
+	check lv_exists $vg "lv_$engine"
+	vgck $vg
+done
+
+aux lvmconf 'devices/io_engine = "io_uring"' 'global/use_aio = 0'
+pvs
+
+not pvs --config 'devices/io_engine = "unknown"'
+
+vgremove -ff $vg
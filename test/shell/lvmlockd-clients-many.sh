@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+test_description='Check lvmlockd with many concurrently connected commands'
+
+. lib/inittest
+
+[ -z "$LVM_TEST_LVMLOCKD" ] && skip;
+
+# Number of commands running at once
+NUM_CLIENTS=200
+NUM_LVS=20
+
+aux prepare_devs 1
+
+vgcreate --shared $vg "$dev1"
+
+for i in $(seq 1 $NUM_LVS); do
+	lvcreate -an -l1 -n lv$i $vg
+done
+
+run_all() {
+	local pids=()
+	local pid
+
+	for i in $(seq 1 $NUM_CLIENTS); do
+		"$@" &
+		pids+=( $! )
+	done
+
+	for pid in "${pids[@]}"; do
+		wait "$pid" || die "Command $* failed."
+	done
+}
+
+# Many readers holding the vg lock shared at once
+START=$(date +%s)
+run_all lvs $vg
+END=$(date +%s)
+echo "$NUM_CLIENTS concurrent lvs: $(( END - START )) seconds"
+
+# Many LV lock requests at once, each LV from a separate command
+pids=()
+for i in $(seq 1 $NUM_LVS); do
+	lvchange -ay $vg/lv$i &
+	pids+=( $! )
+done
+for pid in "${pids[@]}"; do
+	wait "$pid" || die "lvchange -ay failed."
+done
+
+for i in $(seq 1 $NUM_LVS); do
+	check active $vg lv$i
+done
+
+vgchange -an $vg
+
+# Locks are released for commands that have exited
+lvchange -ay $vg/lv1
+lvchange -an $vg/lv1
+
+vgremove -ff $vg
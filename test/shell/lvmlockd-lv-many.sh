@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+test_description='Check lvmlockd with many LV locks in one lockspace'
+
+. lib/inittest
+
+[ -z "$LVM_TEST_LVMLOCKD" ] && skip;
+
+# 100 LVs activated and deactivated 50 times gives 10k lock/unlock cycles.
+NUM_LVS=100
+NUM_LOOPS=50
+
+aux prepare_devs 1 200
+
+vgcreate --shared -s 128K $vg "$dev1"
+
+for i in $(seq 1 $NUM_LVS); do
+	lvcreate -an -l1 -n lv$i $vg
+done
+
+START=$(date +%s)
+
+for i in $(seq 1 $NUM_LOOPS); do
+	vgchange -ay $vg
+	vgchange -an $vg
+done
+
+END=$(date +%s)
+echo "$NUM_LVS LVs, $NUM_LOOPS activation cycles: $(( END - START )) seconds"
+
+# Locks are still granted and released correctly for single LVs.
+lvchange -ay $vg/lv1
+check active $vg lv1
+check inactive $vg lv2
+lvchange -an $vg/lv1
+check inactive $vg lv1
+
+vgremove -ff $vg
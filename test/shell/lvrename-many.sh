@@ -0,0 +1,78 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check LV name and id lookups stay consistent in a VG with many LVs
+
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+# Number of LVs to create
+TEST_DEVS=1000
+test "$(aux total_mem)" -gt 524288 || TEST_DEVS=256
+
+aux prepare_pvs 1 400
+get_devs
+
+vgcreate $SHARED -s 128K "$vg" "${DEVICES[@]}"
+
+vgcfgbackup -f data $vg
+
+# Generate a lot of devices (size of 1 extent)
+awk -v TEST_DEVS=$TEST_DEVS '/^\t\}/ {
+    printf("\t}\n\tlogical_volumes {\n");
+    cnt=0;
+    for (i = 0; i < TEST_DEVS; i++) {
+	printf("\t\tlvol%06d  {\n", i);
+	printf("\t\t\tid = \"%06d-1111-2222-3333-2222-1111-%06d\"\n", i, i);
+	print "\t\t\tstatus = [\"READ\", \"WRITE\", \"VISIBLE\"]";
+	print "\t\t\tsegment_count = 1";
+	print "\t\t\tsegment1 {";
+	print "\t\t\t\tstart_extent = 0";
+	print "\t\t\t\textent_count = 1";
+	print "\t\t\t\ttype = \"striped\"";
+	print "\t\t\t\tstripe_count = 1";
+	print "\t\t\t\tstripes = [";
+	print "\t\t\t\t\t\"pv0\", " cnt++;
+	printf("\t\t\t\t]\n\t\t\t}\n\t\t}\n");
+      }
+  }
+  {print}
+' data >data_new
+
+vgcfgrestore -f data_new $vg
+
+check lv_field $vg/lvol000000 lv_name "lvol000000"
+check lv_field $vg/lvol000099 lv_uuid "000099-1111-2222-3333-2222-1111-000099"
+
+# Renamed LV is found under the new name only
+lvrename $vg lvol000010 renamed
+check lv_field $vg/renamed lv_uuid "000010-1111-2222-3333-2222-1111-000010"
+not lvs $vg/lvol000010
+
+# Old name can be reused
+lvcreate -l1 -n lvol000010 $vg
+check lv_exists $vg lvol000010 renamed
+
+# Swap names through a temporary one
+lvrename $vg lvol000020 tmp
+lvrename $vg lvol000021 lvol000020
+lvrename $vg tmp lvol000021
+check lv_field $vg/lvol000020 lv_uuid "000021-1111-2222-3333-2222-1111-000021"
+check lv_field $vg/lvol000021 lv_uuid "000020-1111-2222-3333-2222-1111-000020"
+
+lvremove -f $vg/renamed $vg/lvol000030
+not lvs $vg/renamed
+not lvs $vg/lvol000030
+test "$(get vg_field $vg lv_count)" -eq "$(( TEST_DEVS - 1 ))"
+
+vgremove -ff $vg
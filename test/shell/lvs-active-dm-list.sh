@@ -0,0 +1,42 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check lv_active follows LV changes within one lvm shell session
+
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+aux have_readline || skip
+
+aux prepare_vg 2
+
+# The dm device list (or the per device fallback on kernels not
+# listing uuids) must not be kept from the previous command
+cat <<EOF | lvm 2>&1 | tee out
+lvcreate -l1 -n $lv1 $vg
+lvs --noheadings -o name,lv_active --nameprefixes $vg
+lvchange -an $vg/$lv1
+lvs --noheadings -o name,lv_active --nameprefixes $vg
+lvcreate -l1 -n $lv2 $vg
+lvs --noheadings -o name,lv_active --nameprefixes $vg
+lvremove -f $vg/$lv2
+lvs --noheadings -o name,lv_active --nameprefixes $vg
+EOF
+
+test "$(grep -c "LVM2_LV_NAME='$lv1' LVM2_LV_ACTIVE='active'" out)" -eq 1
+test "$(grep -c "LVM2_LV_NAME='$lv1' LVM2_LV_ACTIVE=''" out)" -eq 3
+test "$(grep -c "LVM2_LV_NAME='$lv2'" out)" -eq 1
+check lv_field $vg/$lv1 lv_active ""
+not dmsetup info "$vg-$lv2"
+
+vgremove -ff $vg
@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check metadata of all PVs is written with one flush per commit phase
+
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+aux prepare_devs 8
+get_devs
+
+pvcreate --metadatacopies 2 "$dev1" "$dev2"
+vgcreate $SHARED $vg "${DEVICES[@]}"
+
+lvcreate -an -Zn -l1 -n $lv1 $vg -vvvv 2>&1 | tee out
+test "$(grep -c "Flushed batched writes to 8 devices" out)" -ge 3
+
+vgck $vg
+check lv_exists $vg $lv1
+
+# Data next to the metadata areas is not overwritten
+dd if=/dev/urandom of=data bs=512 count=64
+lvcreate -Zn -l1 -n $lv2 $vg "$dev1"
+dd if=data of="$DM_DEV_DIR/$vg/$lv2" bs=512 count=64 oflag=direct
+lvchange --addtag tag $vg/$lv1
+dd if="$DM_DEV_DIR/$vg/$lv2" of=data2 bs=512 count=64 iflag=direct
+cmp data data2
+
+vgremove -ff $vg
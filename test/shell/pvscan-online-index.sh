@@ -0,0 +1,83 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check pvs_online index stays in sync with the pvid online files
+
+SKIP_WITH_LVMPOLLD=1
+SKIP_WITH_LVMLOCKD=1
+
+RUNDIR="/run"
+test -d "$RUNDIR" || RUNDIR="/var/run"
+PVS_ONLINE_DIR="$RUNDIR/lvm/pvs_online"
+VGS_ONLINE_DIR="$RUNDIR/lvm/vgs_online"
+PVS_LOOKUP_DIR="$RUNDIR/lvm/pvs_lookup"
+PVS_ONLINE_INDEX="$RUNDIR/lvm/pvs_online.idx"
+
+# FIXME: kills logic for running system
+_clear_online_files() {
+	# wait till udev is finished
+	aux udev_wait
+	rm -f "$PVS_ONLINE_DIR"/*
+	rm -f "$VGS_ONLINE_DIR"/*
+	rm -f "$PVS_LOOKUP_DIR"/*
+}
+
+. lib/inittest
+
+aux prepare_devs 4
+
+vgcreate $vg1 "$dev1" "$dev2" "$dev3" "$dev4"
+lvcreate -n $lv1 -l 4 -a n $vg1
+
+PVID1=$(pvs "$dev1" --noheading -o uuid | tr -d - | awk '{print $1}')
+MAJOR1=$((0x$(stat -L --printf=%t "$dev1")))
+MINOR1=$((0x$(stat -L --printf=%T "$dev1")))
+
+test -d "$PVS_ONLINE_DIR" || mkdir -p "$PVS_ONLINE_DIR"
+test -d "$VGS_ONLINE_DIR" || mkdir -p "$VGS_ONLINE_DIR"
+test -d "$PVS_LOOKUP_DIR" || mkdir -p "$PVS_LOOKUP_DIR"
+_clear_online_files
+
+pvscan --cache -aay "$dev1" 2>&1 | tee out
+grep "incomplete (need 3)" out
+test -f "$PVS_ONLINE_INDEX"
+pvscan --cache -aay "$dev2"
+pvscan --cache -aay "$dev3" 2>&1 | tee out
+grep "incomplete (need 1)" out
+check lv_field $vg1/$lv1 lv_active ""
+pvscan --cache -aay "$dev4" 2>&1 | tee out
+grep "is complete" out
+check lv_field $vg1/$lv1 lv_active "active"
+lvchange -an $vg1
+
+# Index must follow online files removed by hand
+_clear_online_files
+pvscan --cache -aay "$dev1" 2>&1 | tee out
+grep "incomplete (need 3)" out
+check lv_field $vg1/$lv1 lv_active ""
+
+# Removed device is found by its device number
+pvscan --cache -aay "$dev2" "$dev3" "$dev4"
+check lv_field $vg1/$lv1 lv_active "active"
+lvchange -an $vg1
+ls "$PVS_ONLINE_DIR/$PVID1"
+aux disable_dev "$dev1"
+pvscan --cache -aay --major $MAJOR1 --minor $MINOR1
+not ls "$PVS_ONLINE_DIR/$PVID1"
+not ls "$VGS_ONLINE_DIR/$vg1"
+aux enable_dev "$dev1"
+pvscan --cache -aay "$dev1" 2>&1 | tee out
+grep "is complete" out
+check lv_field $vg1/$lv1 lv_active "active"
+
+vgchange -an $vg1
+vgremove -ff $vg1
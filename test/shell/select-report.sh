@@ -219,5 +219,10 @@ sel lv '(lv_name=vol1 || lv_name=vol2) && lv_size < 8m' vol2
 sel lv '(lv_name=vol1 && lv_size=8m) && vg_tags=vg_tag2' vol1
 # negation of clause grouped by ( )
 sel lv '!(lv_name=vol1 || lv_name=vol2)' abc xyz orig snap
+# metadata fields combined with fields needing LV device info and status
+sel lv 'lv_name=xyz && lv_kernel_minor=254' xyz
+sel lv 'vg_tags=vg_tag1 && lv_attr=~^s' snap
+sel lv 'lv_name=vol1 || lv_kernel_minor=254' vol1 xyz
+sel lv '!(vg_tags=vg_tag1 && lv_kernel_minor=254)' vol1 vol2 abc orig snap
 
 vgremove -ff $vg1 $vg2 $vg3
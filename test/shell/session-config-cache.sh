@@ -0,0 +1,42 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check --config and profiles override config values cached by lvm shell
+
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+aux have_readline || skip
+
+aux prepare_vg 1
+lvcreate -l1 -an -n $lv1 $vg
+
+aux profileconf sep 'report/separator = "##"' \
+		    'report/aligned = 0' \
+		    'report/headings = 0'
+
+# Each override follows a command which cached the default value
+cat <<EOF | lvm 2>&1 | tee out
+lvs -o vg_name,lv_name $vg
+lvs --config 'report/separator="::" report/aligned=0 report/headings=0' -o vg_name,lv_name $vg
+lvs -o vg_name,lv_name $vg
+lvs --commandprofile sep -o vg_name,lv_name $vg
+lvs -o vg_name,lv_name $vg
+EOF
+
+test "$(grep -cE "VG +LV" out)" -eq 3
+test "$(grep -cE "$vg +$lv1" out)" -eq 3
+test "$(grep -c "$vg::$lv1" out)" -eq 1
+test "$(grep -c "$vg##$lv1" out)" -eq 1
+
+vgremove -ff $vg
@@ -0,0 +1,66 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check lvm shell keeps scan results between commands with session_scan_cache
+
+SKIP_WITH_LVMPOLLD=1
+
+# hints are currently disabled with lvmlockd
+SKIP_WITH_LVMLOCKD=1
+
+. lib/inittest
+
+aux have_readline || skip
+
+aux lvmconf 'devices/scan_lvs = 0' \
+	    'devices/hints = "all"' \
+	    'devices/session_scan_cache = 1'
+
+aux prepare_devs 3
+
+vgcreate $SHARED $vg1 "$dev1" "$dev2"
+lvcreate -l1 -an -n $lv1 $vg1
+# create hints
+pvs
+
+cat <<EOF | lvm 2>&1 | tee out
+lvs -vvvv $vg1
+lvs -vvvv $vg1
+EOF
+grep "Using scan kept from previous command" out
+
+# Changes made by another command are seen
+cat <<EOF > cmds
+lvs -vvvv $vg1
+lvs -o name $vg1
+EOF
+(sleep 2 ; lvcreate -l1 -an -n $lv2 $vg1) &
+(cat cmds ; sleep 4 ; echo "lvs -o name $vg1") | lvm 2>&1 | tee out
+wait
+grep $lv2 out
+
+# New PV created by another command is seen
+(echo "pvs" ; sleep 2 ; echo "pvs") | lvm 2>&1 | tee out &
+sleep 1
+pvcreate "$dev3"
+wait
+grep "$dev3" out
+
+# Scan not kept without hints
+aux lvmconf 'devices/hints = "none"'
+cat <<EOF | lvm 2>&1 | tee out
+lvs -vvvv $vg1
+lvs -vvvv $vg1
+EOF
+not grep "Using scan kept from previous command" out
+
+vgremove -ff $vg1
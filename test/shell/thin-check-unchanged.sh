@@ -0,0 +1,61 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check thin_check is skipped for pool metadata unchanged since last check
+
+SKIP_WITH_LVMLOCKD=1
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+aux have_thin 1 0 0 || skip
+test -x "$LVM_TEST_THIN_CHECK_CMD" || skip
+
+RUNDIR="/run"
+test -d "$RUNDIR" || RUNDIR="/var/run"
+
+aux lvmconf 'global/pool_check_skip_unchanged = 1'
+
+aux prepare_vg 2
+
+lvcreate -T -L8M -V10M -n $lv1 $vg/pool
+# Deactivation runs the check
+lvchange -an $vg
+
+lvchange -ay -vvvv $vg/$lv1 2>&1 | tee out
+grep "unchanged since last check" out
+
+# Metadata changed by the kernel is checked on deactivation
+lvcreate -V10M -n $lv2 $vg/pool
+lvchange -an $vg
+lvchange -ay -vvvv $vg/$lv1 2>&1 | tee out
+grep "unchanged since last check" out
+lvchange -an $vg
+
+# Changed or missing fingerprint is never trusted
+CHECKED="$RUNDIR/lvm/pool_check"
+test -n "$(ls "$CHECKED")"
+for i in "$CHECKED"/* ; do echo "0 0 0 0" > "$i" ; done
+lvchange -ay -vvvv $vg/$lv1 2>&1 | tee out
+not grep "unchanged since last check" out
+lvchange -an $vg
+
+rm -f "$CHECKED"/*
+lvchange -ay -vvvv $vg/$lv1 2>&1 | tee out
+not grep "unchanged since last check" out
+lvchange -an $vg
+
+aux lvmconf 'global/pool_check_skip_unchanged = 0'
+lvchange -ay -vvvv $vg/$lv1 2>&1 | tee out
+not grep "unchanged since last check" out
+
+vgremove -ff $vg
@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+#
+# This copyrighted material is made available to anyone wishing to use,
+# modify, copy, or redistribute it subject to the terms and conditions
+# of the GNU General Public License v.2.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Check vgchange activates simple LVs of a VG in one tree
+
+SKIP_WITH_LVMPOLLD=1
+
+. lib/inittest
+
+aux prepare_vg 3
+
+lvcreate -an -l2 -n $lv1 $vg
+lvcreate -an -l2 -i2 -n $lv2 $vg
+lvcreate -an -l2 -n $lv3 $vg "$dev3"
+lvcreate -l1 -s -n snap $vg/$lv3
+lvchange -an $vg
+
+vgchange -ay -v $vg 2>&1 | tee out
+# origin with its snapshot is activated on its own
+grep "Activated 2 LVs in VG $vg" out
+
+check active $vg $lv1
+check active $vg $lv2
+check active $vg $lv3
+check active $vg snap
+
+# Already active LVs are skipped
+vgchange -ay -v $vg 2>&1 | tee out
+not grep "LVs in VG $vg" out
+
+vgchange -an $vg
+check inactive $vg $lv1
+check inactive $vg $lv2
+
+vgremove -ff $vg
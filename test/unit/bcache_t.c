@@ -48,8 +48,10 @@ struct mock_call {
 	enum dir d;
 	int di;
 	block_address b;
+	unsigned nr;
 	bool issue_r;
 	bool wait_r;
+	sector_t wait_nbytes;	/* 0 completes the whole io */
 };
 
 struct mock_io {
@@ -60,6 +62,7 @@ struct mock_io {
 	void *data;
 	void *context;
 	bool r;
+	sector_t nbytes;
 };
 
 static const char *_show_method(enum method m)
@@ -94,8 +97,41 @@ static void _expect_read(struct mock_engine *e, int di, block_address b)
 	mc->d = DIR_READ;
 	mc->di = di;
 	mc->b = b;
+	mc->nr = 1;
 	mc->issue_r = true;
 	mc->wait_r = true;
+	mc->wait_nbytes = 0;
+	dm_list_add(&e->expected_calls, &mc->list);
+}
+
+static void _expect_read_run(struct mock_engine *e, int di, block_address b, unsigned nr)
+{
+	struct mock_call *mc = malloc(sizeof(*mc));
+	mc->m = E_ISSUE;
+	mc->match_args = true;
+	mc->d = DIR_READ;
+	mc->di = di;
+	mc->b = b;
+	mc->nr = nr;
+	mc->issue_r = true;
+	mc->wait_r = true;
+	mc->wait_nbytes = 0;
+	dm_list_add(&e->expected_calls, &mc->list);
+}
+
+static void _expect_read_run_short(struct mock_engine *e, int di, block_address b,
+				   unsigned nr, sector_t nbytes)
+{
+	struct mock_call *mc = malloc(sizeof(*mc));
+	mc->m = E_ISSUE;
+	mc->match_args = true;
+	mc->d = DIR_READ;
+	mc->di = di;
+	mc->b = b;
+	mc->nr = nr;
+	mc->issue_r = true;
+	mc->wait_r = true;
+	mc->wait_nbytes = nbytes;
 	dm_list_add(&e->expected_calls, &mc->list);
 }
 
@@ -106,6 +142,7 @@ static void _expect_read_any(struct mock_engine *e)
 	mc->match_args = false;
 	mc->issue_r = true;
 	mc->wait_r = true;
+	mc->wait_nbytes = 0;
 	dm_list_add(&e->expected_calls, &mc->list);
 }
 
@@ -117,8 +154,10 @@ static void _expect_write(struct mock_engine *e, int di, block_address b)
 	mc->d = DIR_WRITE;
 	mc->di = di;
 	mc->b = b;
+	mc->nr = 1;
 	mc->issue_r = true;
 	mc->wait_r = true;
+	mc->wait_nbytes = 0;
 	dm_list_add(&e->expected_calls, &mc->list);
 }
 
@@ -130,8 +169,10 @@ static void _expect_read_bad_issue(struct mock_engine *e, int di, block_address
 	mc->d = DIR_READ;
 	mc->di = di;
 	mc->b = b;
+	mc->nr = 1;
 	mc->issue_r = false;
 	mc->wait_r = true;
+	mc->wait_nbytes = 0;
 	dm_list_add(&e->expected_calls, &mc->list);
 }
 
@@ -143,8 +184,10 @@ static void _expect_write_bad_issue(struct mock_engine *e, int di, block_address
 	mc->d = DIR_WRITE;
 	mc->di = di;
 	mc->b = b;
+	mc->nr = 1;
 	mc->issue_r = false;
 	mc->wait_r = true;
+	mc->wait_nbytes = 0;
 	dm_list_add(&e->expected_calls, &mc->list);
 }
 
@@ -156,8 +199,10 @@ static void _expect_read_bad_wait(struct mock_engine *e, int di, block_address b
 	mc->d = DIR_READ;
 	mc->di = di;
 	mc->b = b;
+	mc->nr = 1;
 	mc->issue_r = true;
 	mc->wait_r = false;
+	mc->wait_nbytes = 0;
 	dm_list_add(&e->expected_calls, &mc->list);
 }
 
@@ -169,8 +214,10 @@ static void _expect_write_bad_wait(struct mock_engine *e, int di, block_address
 	mc->d = DIR_WRITE;
 	mc->di = di;
 	mc->b = b;
+	mc->nr = 1;
 	mc->issue_r = true;
 	mc->wait_r = false;
+	mc->wait_nbytes = 0;
 	dm_list_add(&e->expected_calls, &mc->list);
 }
 
@@ -231,6 +278,7 @@ static bool _mock_issue(struct io_engine *e, enum dir d, int di,
 	      		sector_t sb, sector_t se, void *data, void *context)
 {
 	bool r, wait_r;
+	sector_t wait_nbytes;
 	struct mock_io *io;
 	struct mock_call *mc;
 	struct mock_engine *me = _to_mock(e);
@@ -240,10 +288,11 @@ static bool _mock_issue(struct io_engine *e, enum dir d, int di,
 		T_ASSERT(d == mc->d);
 		T_ASSERT(di == mc->di);
 		T_ASSERT(sb == mc->b * me->block_size);
-		T_ASSERT(se == (mc->b + 1) * me->block_size);
+		T_ASSERT(se == (mc->b + mc->nr) * me->block_size);
 	}
 	r = mc->issue_r;
 	wait_r = mc->wait_r;
+	wait_nbytes = mc->wait_nbytes;
 	free(mc);
 
 	if (r) {
@@ -257,6 +306,7 @@ static bool _mock_issue(struct io_engine *e, enum dir d, int di,
 		io->data = data;
 		io->context = context;
 		io->r = wait_r;
+		io->nbytes = wait_nbytes ? : (se - sb) << 9;
 
 		dm_list_add(&me->issued_io, &io->list);
 	}
@@ -275,7 +325,7 @@ static bool _mock_wait(struct io_engine *e, io_complete_fn fn)
 	T_ASSERT(!dm_list_empty(&me->issued_io));
 	io = dm_list_item(me->issued_io.n, struct mock_io);
 	dm_list_del(&io->list);
-	fn(io->context, io->r ? 0 : -EIO);
+	fn(io->context, io->r ? 0 : -EIO, io->r ? io->nbytes : 0);
 	free(io);
 
 	return true;
@@ -296,6 +346,7 @@ static struct mock_engine *_mock_create(unsigned max_io, sector_t block_size)
 	m->e.issue = _mock_issue;
 	m->e.wait = _mock_wait;
 	m->e.max_io = _mock_max_io;
+	m->e.register_buffers = NULL;
 
 	m->max_io = max_io;
 	m->block_size = block_size;
@@ -355,6 +406,29 @@ static void _large_fixture_exit(void *context)
 	_fixture_exit(context);
 }
 
+#define GROW_INITIAL 4
+#define GROW_TARGET 8
+#define GROW_MAX 16
+
+static void *_growable_fixture_init(void)
+{
+	struct fixture *f = malloc(sizeof(*f));
+
+	f->me = _mock_create(16, 128);
+	T_ASSERT(f->me);
+
+	_expect(f->me, E_MAX_IO);
+	f->cache = bcache_create_growable(128, GROW_INITIAL, GROW_TARGET, GROW_MAX, &f->me->e);
+	T_ASSERT(f->cache);
+
+	return f;
+}
+
+static void _growable_fixture_exit(void *context)
+{
+	_fixture_exit(context);
+}
+
 /*----------------------------------------------------------------
  * Tests
  *--------------------------------------------------------------*/
@@ -534,6 +608,66 @@ static void test_too_many_prefetches_does_not_trigger_a_wait(void *context)
 		_expect(me, E_WAIT);
 }
 
+static void test_next_prefetch_in_completion_order(void *context)
+{
+	struct fixture *f = context;
+	struct mock_engine *me = f->me;
+	struct bcache *cache = f->cache;
+
+	int di, expected;
+	block_address i;
+	struct block *b;
+
+	for (i = 0; i < 4; i++) {
+		_expect_read(me, i, 0);
+		bcache_prefetch(cache, i, 0);
+	}
+	_no_outstanding_expectations(me);
+
+	// The mock completes io in issue order, so this completes 0, 1 and 2
+	_expect(me, E_WAIT);
+	_expect(me, E_WAIT);
+	_expect(me, E_WAIT);
+	T_ASSERT(bcache_get(cache, 2, 0, 0, &b));
+	bcache_put(b);
+	_no_outstanding_expectations(me);
+
+	// Already completed, so no waits
+	for (expected = 0; expected < 3; expected++) {
+		T_ASSERT(bcache_next_prefetch(cache, &di, &i));
+		T_ASSERT_EQUAL(di, expected);
+		T_ASSERT_EQUAL(i, 0);
+	}
+
+	_expect(me, E_WAIT);
+	T_ASSERT(bcache_next_prefetch(cache, &di, &i));
+	T_ASSERT_EQUAL(di, 3);
+	T_ASSERT(!bcache_next_prefetch(cache, &di, &i));
+}
+
+static void test_next_prefetch_skips_invalidated(void *context)
+{
+	struct fixture *f = context;
+	struct mock_engine *me = f->me;
+	struct bcache *cache = f->cache;
+
+	int di;
+	block_address i;
+
+	_expect_read(me, 0, 0);
+	bcache_prefetch(cache, 0, 0);
+	_expect_read(me, 1, 0);
+	bcache_prefetch(cache, 1, 0);
+
+	_expect(me, E_WAIT);
+	_expect(me, E_WAIT);
+	T_ASSERT(bcache_invalidate_di(cache, 0));
+
+	T_ASSERT(bcache_next_prefetch(cache, &di, &i));
+	T_ASSERT_EQUAL(di, 1);
+	T_ASSERT(!bcache_next_prefetch(cache, &di, &i));
+}
+
 static void test_dirty_data_gets_written_back(void *context)
 {
 	struct fixture *f = context;
@@ -892,6 +1026,166 @@ static void test_abort_only_specific_di(void *context)
 	T_ASSERT(bcache_flush(cache));
 }
 
+//----------------------------------------------------------------
+// Growable caches
+
+static void _get_blocks(struct fixture *f, int di, unsigned nr, struct block **blocks)
+{
+	unsigned i;
+
+	for (i = 0; i < nr; i++) {
+		_expect_read(f->me, di, i);
+		_expect(f->me, E_WAIT);
+		T_ASSERT(bcache_get(f->cache, di, i, 0, blocks + i));
+	}
+}
+
+static void _put_blocks(unsigned nr, struct block **blocks)
+{
+	unsigned i;
+
+	for (i = 0; i < nr; i++)
+		bcache_put(blocks[i]);
+}
+
+static void test_grows_to_target(void *context)
+{
+	struct fixture *f = context;
+	struct block *blocks[GROW_TARGET], *b;
+
+	T_ASSERT_EQUAL(bcache_nr_cache_blocks(f->cache), GROW_INITIAL);
+
+	_get_blocks(f, 0, GROW_TARGET, blocks);
+	_put_blocks(GROW_TARGET, blocks);
+	T_ASSERT_EQUAL(bcache_nr_cache_blocks(f->cache), GROW_TARGET);
+
+	// Past the target unused clean blocks are reused
+	_expect_read(f->me, 0, GROW_TARGET);
+	_expect(f->me, E_WAIT);
+	T_ASSERT(bcache_get(f->cache, 0, GROW_TARGET, 0, &b));
+	bcache_put(b);
+	T_ASSERT_EQUAL(bcache_nr_cache_blocks(f->cache), GROW_TARGET);
+}
+
+static void test_grows_to_max_when_held(void *context)
+{
+	struct fixture *f = context;
+	struct block *blocks[GROW_MAX], *b;
+
+	_get_blocks(f, 0, GROW_MAX, blocks);
+	T_ASSERT_EQUAL(bcache_nr_cache_blocks(f->cache), GROW_MAX);
+
+	// No block can be reused and the cache cannot grow
+	T_ASSERT(!bcache_get(f->cache, 0, GROW_MAX, 0, &b));
+
+	_put_blocks(GROW_MAX, blocks);
+}
+
+static void test_shrinks_after_invalidate(void *context)
+{
+	struct fixture *f = context;
+	struct block *blocks[GROW_MAX];
+
+	_get_blocks(f, 0, GROW_MAX, blocks);
+	_put_blocks(GROW_MAX, blocks);
+	T_ASSERT_EQUAL(bcache_nr_cache_blocks(f->cache), GROW_MAX);
+
+	T_ASSERT(bcache_invalidate_di(f->cache, 0));
+	T_ASSERT_EQUAL(bcache_nr_cache_blocks(f->cache), GROW_TARGET);
+}
+
+static void test_prefetch_run_single_io(void *context)
+{
+	struct fixture *f = context;
+	struct block *b;
+	unsigned i, nr = 6;
+
+	_expect_read_run(f->me, 0, 2, nr);
+	bcache_prefetch_blocks(f->cache, 0, 2, nr);
+	_no_outstanding_expectations(f->me);
+	T_ASSERT_EQUAL(bcache_nr_cache_blocks(f->cache), GROW_INITIAL + nr);
+
+	// One wait completes every block of the run
+	_expect(f->me, E_WAIT);
+	for (i = 2; i < 2 + nr; i++) {
+		T_ASSERT(bcache_get(f->cache, 0, i, 0, &b));
+		bcache_put(b);
+	}
+}
+
+static void test_prefetch_run_short(void *context)
+{
+	struct fixture *f = context;
+	struct block *b;
+
+	// The device ends half way through the third block of the run
+	_expect_read_run_short(f->me, 0, 2, 4, (2 * 128 + 64) << SECTOR_SHIFT);
+	bcache_prefetch_blocks(f->cache, 0, 2, 4);
+	_no_outstanding_expectations(f->me);
+
+	// Blocks the run did not fully cover are read again on their own
+	_expect(f->me, E_WAIT);
+	_expect_read(f->me, 0, 4);
+	_expect_read_bad_wait(f->me, 0, 5);
+	T_ASSERT(bcache_get(f->cache, 0, 2, 0, &b));
+	bcache_put(b);
+	T_ASSERT(bcache_get(f->cache, 0, 3, 0, &b));
+	bcache_put(b);
+	_no_outstanding_expectations(f->me);
+
+	_expect(f->me, E_WAIT);
+	T_ASSERT(bcache_get(f->cache, 0, 4, 0, &b));
+	bcache_put(b);
+
+	_expect(f->me, E_WAIT);
+	T_ASSERT(!bcache_get(f->cache, 0, 5, 0, &b));
+}
+
+static void test_prefetch_run_partly_cached(void *context)
+{
+	struct fixture *f = context;
+	struct block *b;
+	unsigned i;
+
+	_expect_read(f->me, 0, 1);
+	_expect(f->me, E_WAIT);
+	T_ASSERT(bcache_get(f->cache, 0, 1, 0, &b));
+	bcache_put(b);
+
+	// Block 1 is cached, so the others are prefetched one at a time
+	for (i = 0; i < 5; i++)
+		if (i != 1)
+			_expect_read(f->me, 0, i);
+	bcache_prefetch_blocks(f->cache, 0, 0, 5);
+	_no_outstanding_expectations(f->me);
+
+	for (i = 0; i < 4; i++)
+		_expect(f->me, E_WAIT);
+	for (i = 0; i < 5; i++) {
+		T_ASSERT(bcache_get(f->cache, 0, i, 0, &b));
+		bcache_put(b);
+	}
+}
+
+static void test_prefetch_run_too_large(void *context)
+{
+	struct fixture *f = context;
+	struct block *b;
+	unsigned i;
+
+	// Larger than the cache may grow, so prefetched block by block
+	for (i = 0; i < GROW_TARGET; i++)
+		_expect_read(f->me, 0, i);
+	bcache_prefetch_blocks(f->cache, 0, 0, GROW_MAX);
+	_no_outstanding_expectations(f->me);
+
+	for (i = 0; i < GROW_TARGET; i++) {
+		_expect(f->me, E_WAIT);
+		T_ASSERT(bcache_get(f->cache, 0, i, 0, &b));
+		bcache_put(b);
+	}
+}
+
 //----------------------------------------------------------------
 // Chasing a bug reported by dct
 
@@ -966,6 +1260,8 @@ static struct test_suite *_small_tests(void)
 	T("blocks-get-evicted", "block get evicted with many reads", test_block_gets_evicted_with_many_reads);
 	T("prefetch-reads", "prefetch issues a read", test_prefetch_issues_a_read);
 	T("prefetch-never-waits", "too many prefetches does not trigger a wait", test_too_many_prefetches_does_not_trigger_a_wait);
+	T("next-prefetch-completion-order", "next_prefetch reports blocks in completion order", test_next_prefetch_in_completion_order);
+	T("next-prefetch-skips-invalidated", "next_prefetch does not report invalidated blocks", test_next_prefetch_skips_invalidated);
 	T("writeback-occurs", "dirty data gets written back", test_dirty_data_gets_written_back);
 	T("zero-flag-dirties", "zeroed data counts as dirty", test_zeroed_data_counts_as_dirty);
 	T("read-multiple-files", "read from multiple files", test_multiple_files);
@@ -1005,9 +1301,29 @@ static struct test_suite *_large_tests(void)
 	return ts;
 }
 
+static struct test_suite *_growable_tests(void)
+{
+	struct test_suite *ts = test_suite_create(_growable_fixture_init, _growable_fixture_exit);
+	if (!ts) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	T("grows-to-target", "cache grows to its target size before reusing blocks", test_grows_to_target);
+	T("grows-to-max-when-held", "cache grows up to its maximum when blocks are held", test_grows_to_max_when_held);
+	T("shrinks-after-invalidate", "cache shrinks back to its target size", test_shrinks_after_invalidate);
+	T("prefetch-run", "a large uncached range is read with one io", test_prefetch_run_single_io);
+	T("prefetch-run-short", "blocks missed by a short run read are read again", test_prefetch_run_short);
+	T("prefetch-run-partly-cached", "a partly cached range is read block by block", test_prefetch_run_partly_cached);
+	T("prefetch-run-too-large", "a range larger than the cache is read block by block", test_prefetch_run_too_large);
+
+	return ts;
+}
+
 void bcache_tests(struct dm_list *all_tests)
 {
         dm_list_add(all_tests, &_tiny_tests()->list);
 	dm_list_add(all_tests, &_small_tests()->list);
 	dm_list_add(all_tests, &_large_tests()->list);
+	dm_list_add(all_tests, &_growable_tests()->list);
 }
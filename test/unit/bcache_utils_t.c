@@ -378,6 +378,26 @@ static void _test_set_many_boundaries(void *fixture)
 
 #define T(path, desc, fn) register_test(ts, "/base/device/bcache/utils/async/" path, desc, fn)
 
+//----------------------------------------------------------------
+
+// The limit set while writing still applies when the block is flushed later.
+static void _test_last_byte_later_flush(void *fixture)
+{
+	struct fixture *f = fixture;
+	uint8_t pat = _random_pattern();
+
+	bcache_set_last_byte(f->cache, f->di, byte(0, 1024), 512);
+	_do_write(f, byte(0, 512), byte(0, 2048), pat);
+	bcache_unset_last_byte(f->cache, f->di);
+
+	T_ASSERT(bcache_flush(f->cache));
+	_reopen(f);
+
+	_verify(f, byte(0, 0), byte(0, 512), INIT_PATTERN);
+	_verify(f, byte(0, 512), byte(0, 1024), pat);
+	_verify(f, byte(0, 1024), byte(1, 0), INIT_PATTERN);
+}
+
 static struct test_suite *_async_tests(void)
 {
         struct test_suite *ts = test_suite_create(_async_init, _fix_exit);
@@ -407,6 +427,8 @@ static struct test_suite *_async_tests(void)
         T("set-within-single-block", "set within single block", _test_set_within_single_block);
         T("set-cross-one-boundary", "set across one boundary", _test_set_cross_one_boundary);
         T("set-many-boundaries", "set many boundaries", _test_set_many_boundaries);
+
+        T("last-byte-later-flush", "clamp write to last byte at a later flush", _test_last_byte_later_flush);
 #undef T
 
         return ts;
@@ -442,6 +464,8 @@ static struct test_suite *_sync_tests(void)
         T("set-within-single-block", "set within single block", _test_set_within_single_block);
         T("set-cross-one-boundary", "set across one boundary", _test_set_cross_one_boundary);
         T("set-many-boundaries", "set many boundaries", _test_set_many_boundaries);
+
+        T("last-byte-later-flush", "clamp write to last byte at a later flush", _test_last_byte_later_flush);
 #undef T
 
         return ts;
@@ -149,6 +149,115 @@ static void test_cascade(void *fixture)
 	dm_config_destroy(t2);
 }
 
+static void test_merge_sections(void *fixture)
+{
+	struct dm_config_tree *tree = dm_config_from_string(
+		"a { x = 1 }\n"
+		"b { y = 2 }\n"
+		"a { z = 3 }\n"
+		"a/w = 4\n"
+		"b/c/d = 5\n");
+	const struct dm_config_node *cn;
+	unsigned count = 0;
+
+	T_ASSERT(tree);
+
+	/* Repeated sections are merged into the first one */
+	for (cn = tree->root; cn; cn = cn->sib)
+		count++;
+	T_ASSERT_EQUAL(count, 2);
+
+	T_ASSERT_EQUAL(dm_config_find_int(tree->root, "a/x", 0), 1);
+	T_ASSERT_EQUAL(dm_config_find_int(tree->root, "a/z", 0), 3);
+	T_ASSERT_EQUAL(dm_config_find_int(tree->root, "a/w", 0), 4);
+	T_ASSERT_EQUAL(dm_config_find_int(tree->root, "b/y", 0), 2);
+	T_ASSERT_EQUAL(dm_config_find_int(tree->root, "b/c/d", 0), 5);
+
+	dm_config_destroy(tree);
+}
+
+/*
+ * Synthetic VG metadata with nr_lvs linear LVs, each in its own section
+ * under logical_volumes, to check that parsing scales with section count.
+ */
+static char *_gen_metadata(unsigned nr_lvs)
+{
+	static const char *_lv_fmt =
+		"lvol%u {\n"
+		"id = \"abcdef-%u\"\n"
+		"status = [\"READ\", \"WRITE\", \"VISIBLE\"]\n"
+		"segment_count = 1\n"
+		"segment1 {\n"
+		"start_extent = 0\n"
+		"extent_count = 1\n"
+		"type = \"striped\"\n"
+		"stripe_count = 1\n"
+		"stripes = [\"pv0\", %u]\n"
+		"}\n"
+		"}\n";
+	size_t size = 256 + (size_t) nr_lvs * 256, len;
+	char *buf, *pos;
+	unsigned i;
+
+	if (!(buf = malloc(size)))
+		return NULL;
+
+	pos = buf;
+	pos += sprintf(pos, "vg {\nid = \"vg-id\"\nseqno = 1\n"
+		       "physical_volumes {\npv0 {\nid = \"pv-id\"\n}\n}\n"
+		       "logical_volumes {\n");
+
+	for (i = 0; i < nr_lvs; i++) {
+		len = snprintf(pos, size - (pos - buf), _lv_fmt, i, i, i);
+		pos += len;
+	}
+
+	sprintf(pos, "}\n}\n");
+
+	return buf;
+}
+
+static void _test_parse_many_lvs(unsigned nr_lvs)
+{
+	struct dm_config_tree *tree;
+	const struct dm_config_node *lvs, *cn;
+	char *buf, path[64];
+	unsigned i, count = 0;
+
+	T_ASSERT((buf = _gen_metadata(nr_lvs)));
+	T_ASSERT((tree = dm_config_create()));
+
+	T_ASSERT(dm_config_parse(tree, buf, buf + strlen(buf)));
+
+	T_ASSERT((lvs = dm_config_find_node(tree->root, "vg/logical_volumes")));
+	for (cn = lvs->child; cn; cn = cn->sib)
+		count++;
+	T_ASSERT_EQUAL(count, nr_lvs);
+
+	for (i = 0; i < nr_lvs; i += nr_lvs / 16) {
+		snprintf(path, sizeof(path), "lvol%u/segment1/extent_count", i);
+		T_ASSERT_EQUAL(dm_config_find_int(lvs->child, path, 0), 1);
+	}
+
+	dm_config_destroy(tree);
+	free(buf);
+}
+
+static void test_parse_1k_lvs(void *fixture)
+{
+	_test_parse_many_lvs(1000);
+}
+
+static void test_parse_10k_lvs(void *fixture)
+{
+	_test_parse_many_lvs(10000);
+}
+
+static void test_parse_50k_lvs(void *fixture)
+{
+	_test_parse_many_lvs(50000);
+}
+
 #define T(path, desc, fn) register_test(ts, "/metadata/config/" path, desc, fn)
 
 void config_tests(struct dm_list *all_tests)
@@ -162,6 +271,10 @@ void config_tests(struct dm_list *all_tests)
 	T("parse", "parsing various", test_parse);
 	T("clone", "duplicating a config tree", test_clone);
 	T("cascade", "cascade", test_cascade);
+	T("merge-sections", "repeated sections are merged", test_merge_sections);
+	T("parse-1k-lvs", "parsing metadata with 1k LVs", test_parse_1k_lvs);
+	T("parse-10k-lvs", "parsing metadata with 10k LVs", test_parse_10k_lvs);
+	T("parse-50k-lvs", "parsing metadata with 50k LVs", test_parse_50k_lvs);
 
 	dm_list_add(all_tests, &ts->list);
 };
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU General Public License v.2.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "units.h"
+#include "lib/misc/crc.h"
+
+//----------------------------------------------------------------
+
+#define BUF_SIZE (1024 * 1024)
+
+static void *_buf_init(void)
+{
+	uint8_t *buf = malloc(BUF_SIZE + 64);
+	unsigned i;
+
+	T_ASSERT(buf);
+
+	srand(1234);
+	for (i = 0; i < BUF_SIZE + 64; i++)
+		buf[i] = rand();
+
+	return buf;
+}
+
+static void _buf_exit(void *fixture)
+{
+	free(fixture);
+}
+
+/* One bit at a time, straight from the definition */
+static uint32_t _crc_ref(uint32_t crc, const uint8_t *buf, uint32_t size)
+{
+	unsigned i;
+
+	while (size--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+	}
+
+	return crc;
+}
+
+//----------------------------------------------------------------
+
+static void test_known_values(void *fixture)
+{
+	const uint8_t *check = (const uint8_t *) "123456789";
+
+	/* The standard CRC-32 check value is with pre and post inversion */
+	T_ASSERT_EQUAL(~calc_crc(0xffffffff, check, 9), 0xcbf43926);
+	T_ASSERT_EQUAL(calc_crc(INITIAL_CRC, check, 0), INITIAL_CRC);
+	T_ASSERT_EQUAL(calc_crc(INITIAL_CRC, check, 9), _crc_ref(INITIAL_CRC, check, 9));
+}
+
+static void test_sizes_and_alignments(void *fixture)
+{
+	const uint8_t *buf = fixture;
+	uint32_t size, offset;
+
+	/* Every size either side of the vector and slicing thresholds */
+	for (offset = 0; offset < 16; offset++)
+		for (size = 0; size < 600; size++)
+			T_ASSERT_EQUAL(calc_crc(INITIAL_CRC, buf + offset, size),
+				       _crc_ref(INITIAL_CRC, buf + offset, size));
+}
+
+static void test_large_buffer(void *fixture)
+{
+	const uint8_t *buf = fixture;
+
+	T_ASSERT_EQUAL(calc_crc(INITIAL_CRC, buf + 3, BUF_SIZE - 7),
+		       _crc_ref(INITIAL_CRC, buf + 3, BUF_SIZE - 7));
+}
+
+static void test_incremental(void *fixture)
+{
+	const uint8_t *buf = fixture;
+	uint32_t crc, split;
+
+	/* The result for a buffer is the same however it is split */
+	for (split = 0; split < 4096; split += 61) {
+		crc = calc_crc(INITIAL_CRC, buf, split);
+		crc = calc_crc(crc, buf + split, 4096 - split);
+		T_ASSERT_EQUAL(crc, calc_crc(INITIAL_CRC, buf, 4096));
+	}
+}
+
+//----------------------------------------------------------------
+
+#define T(path, desc, fn) register_test(ts, "/lib/misc/crc/" path, desc, fn)
+
+void crc_tests(struct dm_list *all_tests)
+{
+	struct test_suite *ts = test_suite_create(_buf_init, _buf_exit);
+	if (!ts) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	T("known-values", "check values of the crc", test_known_values);
+	T("sizes-and-alignments", "match the bitwise crc for small buffers", test_sizes_and_alignments);
+	T("large-buffer", "match the bitwise crc for a large buffer", test_large_buffer);
+	T("incremental", "crc of a buffer in pieces", test_incremental);
+
+	dm_list_add(all_tests, &ts->list);
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU General Public License v.2.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "units.h"
+#include "device_mapper/all.h"
+
+//----------------------------------------------------------------
+
+static void *_hash_init(void)
+{
+	struct dm_hash_table *t = dm_hash_create(0);
+	T_ASSERT(t);
+	return t;
+}
+
+static void _hash_exit(void *fixture)
+{
+	dm_hash_destroy(fixture);
+}
+
+static void _key(char *buf, size_t len, unsigned i)
+{
+	snprintf(buf, len, "key-%u", i);
+}
+
+static void *_val(unsigned i)
+{
+	return (void *) (uintptr_t) (i + 1);
+}
+
+//----------------------------------------------------------------
+
+static void test_create_destroy(void *fixture)
+{
+	T_ASSERT_EQUAL(dm_hash_get_num_entries(fixture), 0);
+	T_ASSERT(!dm_hash_get_first(fixture));
+}
+
+static void test_insert_lookup_remove(void *fixture)
+{
+	struct dm_hash_table *t = fixture;
+	char key[32];
+	unsigned i, nr = 100000;
+
+	for (i = 0; i < nr; i++) {
+		_key(key, sizeof(key), i);
+		T_ASSERT(dm_hash_insert(t, key, _val(i)));
+	}
+	T_ASSERT_EQUAL(dm_hash_get_num_entries(t), nr);
+
+	/* Replacing a value does not add an entry */
+	T_ASSERT(dm_hash_insert(t, "key-0", _val(0)));
+	T_ASSERT_EQUAL(dm_hash_get_num_entries(t), nr);
+
+	for (i = 0; i < nr; i++) {
+		_key(key, sizeof(key), i);
+		T_ASSERT_EQUAL(dm_hash_lookup(t, key), _val(i));
+	}
+	T_ASSERT(!dm_hash_lookup(t, "key-missing"));
+
+	for (i = 0; i < nr; i += 2) {
+		_key(key, sizeof(key), i);
+		dm_hash_remove(t, key);
+	}
+	T_ASSERT_EQUAL(dm_hash_get_num_entries(t), nr / 2);
+
+	for (i = 0; i < nr; i++) {
+		_key(key, sizeof(key), i);
+		if (i % 2)
+			T_ASSERT_EQUAL(dm_hash_lookup(t, key), _val(i));
+		else
+			T_ASSERT(!dm_hash_lookup(t, key));
+	}
+}
+
+static void test_binary_keys(void *fixture)
+{
+	struct dm_hash_table *t = fixture;
+	char buf[32] = { 0 };
+	uint64_t k;
+
+	/* Keys with lengths that are and are not a multiple of a word */
+	for (k = 0; k < 10000; k++) {
+		memcpy(buf, &k, sizeof(k));
+		T_ASSERT(dm_hash_insert_binary(t, buf, sizeof(k) + (k % 17), _val(k)));
+	}
+
+	for (k = 0; k < 10000; k++) {
+		memcpy(buf, &k, sizeof(k));
+		T_ASSERT_EQUAL(dm_hash_lookup_binary(t, buf, sizeof(k) + (k % 17)), _val(k));
+		/* A different length is a different key */
+		T_ASSERT(!dm_hash_lookup_binary(t, buf, sizeof(k) + (k % 17) + 1));
+	}
+}
+
+static void test_allow_multiple(void *fixture)
+{
+	struct dm_hash_table *t = fixture;
+	char key[32];
+	unsigned i, vals[] = { 1, 2, 3 };
+	int count;
+
+	/* Enough other keys to grow the table between the inserts */
+	for (i = 0; i < 3000; i++) {
+		_key(key, sizeof(key), i);
+		T_ASSERT(dm_hash_insert(t, key, _val(i)));
+		if (!(i % 1000))
+			T_ASSERT(dm_hash_insert_allow_multiple(t, "dup", &vals[i / 1000], sizeof(vals[0])));
+	}
+
+	T_ASSERT(dm_hash_lookup_with_count(t, "dup", &count));
+	T_ASSERT_EQUAL(count, 3);
+
+	for (i = 0; i < 3; i++)
+		T_ASSERT_EQUAL(dm_hash_lookup_with_val(t, "dup", &vals[i], sizeof(vals[0])), &vals[i]);
+
+	dm_hash_remove_with_val(t, "dup", &vals[1], sizeof(vals[0]));
+	T_ASSERT(!dm_hash_lookup_with_val(t, "dup", &vals[1], sizeof(vals[0])));
+	T_ASSERT(dm_hash_lookup_with_count(t, "dup", &count));
+	T_ASSERT_EQUAL(count, 2);
+}
+
+static void test_iterate_insertion_order(void *fixture)
+{
+	struct dm_hash_table *t = fixture;
+	struct dm_hash_node *n;
+	char key[32];
+	unsigned i = 0, nr = 1000;
+
+	T_ASSERT(dm_hash_insert(t, "key-0", _val(0)));
+
+	/* Entries added while iterating are visited, despite the table growing */
+	dm_hash_iterate(n, t) {
+		_key(key, sizeof(key), i);
+		T_ASSERT(!strcmp(dm_hash_get_key(t, n), key));
+		T_ASSERT_EQUAL(dm_hash_get_data(t, n), _val(i));
+		if (++i < nr) {
+			_key(key, sizeof(key), i);
+			T_ASSERT(dm_hash_insert(t, key, _val(i)));
+		}
+	}
+
+	T_ASSERT_EQUAL(i, nr);
+}
+
+static void test_wipe(void *fixture)
+{
+	struct dm_hash_table *t = fixture;
+	char key[32];
+	unsigned i;
+
+	for (i = 0; i < 1000; i++) {
+		_key(key, sizeof(key), i);
+		T_ASSERT(dm_hash_insert(t, key, _val(i)));
+	}
+
+	dm_hash_wipe(t);
+	T_ASSERT_EQUAL(dm_hash_get_num_entries(t), 0);
+	T_ASSERT(!dm_hash_get_first(t));
+	T_ASSERT(!dm_hash_lookup(t, "key-1"));
+
+	T_ASSERT(dm_hash_insert(t, "key-1", _val(1)));
+	T_ASSERT_EQUAL(dm_hash_lookup(t, "key-1"), _val(1));
+}
+
+static void test_size_hint(void *fixture)
+{
+	struct dm_hash_table *t;
+	char key[32];
+	unsigned i, nr = 10000;
+
+	T_ASSERT(t = dm_hash_create(nr));
+
+	for (i = 0; i < nr; i++) {
+		_key(key, sizeof(key), i);
+		T_ASSERT(dm_hash_insert(t, key, _val(i)));
+	}
+	T_ASSERT_EQUAL(dm_hash_get_num_entries(t), nr);
+
+	for (i = 0; i < nr; i++) {
+		_key(key, sizeof(key), i);
+		T_ASSERT_EQUAL(dm_hash_lookup(t, key), _val(i));
+	}
+
+	dm_hash_destroy(t);
+}
+
+//----------------------------------------------------------------
+
+#define T(path, desc, fn) register_test(ts, "/base/data-struct/hash/" path, desc, fn)
+
+void hash_tests(struct dm_list *all_tests)
+{
+	struct test_suite *ts = test_suite_create(_hash_init, _hash_exit);
+	if (!ts) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	T("create-destroy", "create and destroy an empty table", test_create_destroy);
+	T("insert-lookup-remove", "insert, lookup and remove while growing", test_insert_lookup_remove);
+	T("binary-keys", "binary keys of various lengths", test_binary_keys);
+	T("allow-multiple", "multiple entries with the same key", test_allow_multiple);
+	T("iterate-insertion-order", "iteration is in insertion order", test_iterate_insertion_order);
+	T("wipe", "wipe a grown table", test_wipe);
+	T("size-hint", "table sized up front", test_size_hint);
+
+	dm_list_add(all_tests, &ts->list);
+}
@@ -76,12 +76,12 @@ static void _print_buffer(const char *name, uint8_t *buffer, size_t count)
 	}
 }
 
-static void *_fix_init(void)
+static void *_fix_init_engine(struct io_engine *e)
 {
         struct fixture *f = malloc(sizeof(*f));
 
         T_ASSERT(f);
-        f->e = create_async_io_engine();
+        f->e = e;
         T_ASSERT(f->e);
 	if (posix_memalign((void **) &f->data, 4096, SECTOR_SIZE * BLOCK_SIZE_SECTORS))
         	test_fail("posix_memalign failed");
@@ -98,6 +98,16 @@ static void *_fix_init(void)
         return f;
 }
 
+static void *_fix_init(void)
+{
+	return _fix_init_engine(create_async_io_engine());
+}
+
+static void *_uring_fix_init(void)
+{
+	return _fix_init_engine(create_io_uring_engine());
+}
+
 static void _fix_exit(void *fixture)
 {
         struct fixture *f = fixture;
@@ -127,7 +137,7 @@ static void _io_init(struct io *io)
 	io->error = 0;
 }
 
-static void _complete_io(void *context, int io_error)
+static void _complete_io(void *context, int io_error, sector_t nbytes)
 {
 	struct io *io = context;
 	io->completed = true;
@@ -168,6 +178,37 @@ static void _test_write(void *fixture)
 	T_ASSERT(!io.error);
 }
 
+/*
+ * The engine must not look at the context, nor apply a write limit
+ * set for the di; clamping writeback is done by bcache.
+ */
+static void _test_write_non_block_context(void *fixture)
+{
+	struct fixture *f = fixture;
+	struct io io;
+	uint8_t buf[SECTOR_SIZE * BLOCK_SIZE_SECTORS];
+	struct bcache *cache = bcache_create(8, BLOCK_SIZE_SECTORS, f->e);
+	T_ASSERT(cache);
+
+	f->di = bcache_set_fd(f->fd);
+	bcache_set_last_byte(cache, f->di, SECTOR_SIZE, SECTOR_SIZE);
+
+	_fill_buffer(f->data, 45, SECTOR_SIZE * BLOCK_SIZE_SECTORS);
+	_io_init(&io);
+	T_ASSERT(f->e->issue(f->e, DIR_WRITE, f->di, 0, BLOCK_SIZE_SECTORS, f->data, &io));
+	T_ASSERT(f->e->wait(f->e, _complete_io));
+	T_ASSERT(io.completed);
+	T_ASSERT(!io.error);
+
+	bcache_unset_last_byte(cache, f->di);
+
+	T_ASSERT(pread(f->fd, buf, sizeof(buf), 0) == sizeof(buf));
+	_check_buffer(buf, 45, sizeof(buf));
+
+	bcache_destroy(cache);
+	f->e = NULL;   // already destroyed
+}
+
 static void _test_write_bytes(void *fixture)
 {
 	struct fixture *f = fixture;
@@ -193,6 +234,40 @@ static void _test_write_bytes(void *fixture)
 	f->e = NULL;   // already destroyed
 }
 
+//----------------------------------------------------------------
+// Reads a file through bcache the way label scanning does, prefetching
+// every block before waiting for any of them.
+
+#define PREFETCH_BLOCKS 4096
+
+static void _test_prefetch(void *fixture)
+{
+	struct fixture *f = fixture;
+	struct bcache *cache = bcache_create(BLOCK_SIZE_SECTORS, 1024, f->e);
+	struct block *b;
+	uint64_t i;
+
+	T_ASSERT(cache);
+	T_ASSERT(!ftruncate(f->fd, (off_t) PREFETCH_BLOCKS * BLOCK_SIZE_SECTORS * SECTOR_SIZE));
+
+	f->di = bcache_set_fd(f->fd);
+
+	for (i = 0; i < PREFETCH_BLOCKS; i += 1024) {
+		uint64_t j;
+
+		for (j = i; j < i + 1024; j++)
+			bcache_prefetch(cache, f->di, j);
+
+		for (j = i; j < i + 1024; j++) {
+			T_ASSERT(bcache_get(cache, f->di, j, 0, &b));
+			bcache_put(b);
+		}
+	}
+
+	bcache_destroy(cache);
+	f->e = NULL;   // already destroyed
+}
+
 //----------------------------------------------------------------
 
 #define T(path, desc, fn) register_test(ts, "/base/device/bcache/io-engine/" path, desc, fn)
@@ -208,13 +283,44 @@ static struct test_suite *_tests(void)
         T("create-destroy", "simple create/destroy", _test_create);
         T("read", "read sanity check", _test_read);
         T("write", "write sanity check", _test_write);
+        T("write-non-block-context", "engine ignores the write limit of the di", _test_write_non_block_context);
+        T("bcache-write-bytes", "test the utility fns", _test_write_bytes);
+        T("prefetch", "read a file through bcache", _test_prefetch);
+
+        return ts;
+}
+
+#undef T
+#define T(path, desc, fn) register_test(ts, "/base/device/bcache/io-engine/io-uring/" path, desc, fn)
+
+static struct test_suite *_uring_tests(void)
+{
+        struct test_suite *ts = test_suite_create(_uring_fix_init, _fix_exit);
+        if (!ts) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+        }
+
+        T("create-destroy", "simple create/destroy", _test_create);
+        T("read", "read sanity check", _test_read);
+        T("write", "write sanity check", _test_write);
+        T("write-non-block-context", "engine ignores the write limit of the di", _test_write_non_block_context);
         T("bcache-write-bytes", "test the utility fns", _test_write_bytes);
+        T("prefetch", "read a file through bcache", _test_prefetch);
 
         return ts;
 }
 
 void io_engine_tests(struct dm_list *all_tests)
 {
+	struct io_engine *e;
+
 	dm_list_add(all_tests, &_tests()->list);
+
+	/* Only when both the build and the running kernel support io_uring */
+	if ((e = create_io_uring_engine())) {
+		e->destroy(e);
+		dm_list_add(all_tests, &_uring_tests()->list);
+	}
 }
 
@@ -809,6 +809,71 @@ static void test_bcache_scenario3(void *fixture)
 }
 
 //----------------------------------------------------------------
+//----------------------------------------------------------------
+// dev-cache indexes devices by a type byte followed by the devno,
+// relying on lookups and iteration of the keys of one type.
+
+#define NR_DEVNOS 20000
+
+static void _devno_key(uint8_t *k, uint8_t type, uint64_t devno)
+{
+	int i;
+
+	k[0] = type;
+	for (i = sizeof(devno); i > 0; i--, devno >>= 8)
+		k[i] = devno & 0xff;
+}
+
+static uint64_t _gen_devno(unsigned i)
+{
+	// spread over sd, dm and high minor numbers
+	static const unsigned _majors[] = { 8, 65, 253, 259 };
+	unsigned major = _majors[i % 4], minor = (i / 4) * 16;
+
+	return ((uint64_t) major << 20) | minor;
+}
+
+
+static void test_devno_index(void *fixture)
+{
+	struct radix_tree *rt = fixture;
+	struct visitor vt = { .it.visit = _visit };
+	union radix_value v;
+	uint8_t k[9], type = 0;
+	unsigned i, j;
+
+	// insert in a scrambled order, with every tenth devno also
+	// present under the second type
+	for (i = 0; i < NR_DEVNOS; i++) {
+		j = (i * 7919) % NR_DEVNOS;
+		v.n = _gen_devno(j);
+		_devno_key(k, 0, v.n);
+		T_ASSERT(radix_tree_insert(rt, k, k + sizeof(k), v));
+		if (!(j % 10)) {
+			_devno_key(k, 1, v.n);
+			T_ASSERT(radix_tree_insert(rt, k, k + sizeof(k), v));
+		}
+	}
+
+	T_ASSERT(radix_tree_is_well_formed(rt));
+	T_ASSERT_EQUAL(radix_tree_size(rt), NR_DEVNOS + NR_DEVNOS / 10);
+
+	for (i = 0; i < NR_DEVNOS; i++) {
+		_devno_key(k, 0, _gen_devno(i));
+		T_ASSERT(radix_tree_lookup(rt, k, k + sizeof(k), &v));
+		T_ASSERT_EQUAL(v.n, _gen_devno(i));
+
+		_devno_key(k, 1, _gen_devno(i));
+		T_ASSERT_EQUAL(radix_tree_lookup(rt, k, k + sizeof(k), &v), !(i % 10));
+	}
+
+	_devno_key(k, 0, _gen_devno(NR_DEVNOS));
+	T_ASSERT(!radix_tree_lookup(rt, k, k + sizeof(k), &v));
+
+	radix_tree_iterate(rt, &type, &type + 1, &vt.it);
+	T_ASSERT_EQUAL(vt.count, NR_DEVNOS);
+}
+
 #define T(path, desc, fn) register_test(ts, "/base/data-struct/radix-tree/" path, desc, fn)
 
 void radix_tree_tests(struct dm_list *all_tests)
@@ -844,6 +909,7 @@ void radix_tree_tests(struct dm_list *all_tests)
 	T("bcache-scenario", "A specific series of keys from a bcache scenario", test_bcache_scenario);
 	T("bcache-scenario-2", "A second series of keys from a bcache scenario", test_bcache_scenario2);
 	T("bcache-scenario-3", "A third series of keys from a bcache scenario", test_bcache_scenario3);
+	T("devno-index", "index 20k devnos in two namespaces", test_devno_index);
 
 	dm_list_add(all_tests, &ts->list);
 }
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2020 Red Hat, Inc. All rights reserved.
+ *
+ * This file is part of LVM2.
+ *
+ * This copyrighted material is made available to anyone wishing to use,
+ * modify, copy, or redistribute it subject to the terms and conditions
+ * of the GNU General Public License v.2.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "lib/misc/lib.h"
+#include "lib/commands/toolcontext.h"
+#include "lib/metadata/metadata.h"
+#include "lib/format_text/import-export.h"
+#include "lib/datastruct/str_list.h"
+#include "units.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------
+
+#define VG_ID "ox9yim-Tcfi-pZGn-zPbD-FDyF-Km51-zfFoWb"
+
+/*
+ * Linear LV with tags split over two PVs, a striped LV
+ * and a thin pool with a thin LV.
+ */
+static const char *_vg_text =
+	"vgc {\n"
+	"	id = \"" VG_ID "\"\n"
+	"	seqno = 7\n"
+	"	format = \"lvm2\"\n"
+	"	status = [\"RESIZEABLE\", \"READ\", \"WRITE\"]\n"
+	"	flags = []\n"
+	"	tags = [\"vgtag\"]\n"
+	"	extent_size = 8192\n"
+	"	max_lv = 0\n"
+	"	max_pv = 0\n"
+	"	metadata_copies = 0\n"
+	"	physical_volumes {\n"
+	"		pv0 {\n"
+	"			id = \"SrHAE5-6yUh-Qqg0-eyN1-ygQd-vpSf-F5PH5n\"\n"
+	"			device = \"/dev/unit-test-pv0\"\n"
+	"			status = [\"ALLOCATABLE\"]\n"
+	"			flags = []\n"
+	"			tags = [\"pvtag\"]\n"
+	"			dev_size = 409600\n"
+	"			pe_start = 2048\n"
+	"			pe_count = 49\n"
+	"		}\n"
+	"		pv1 {\n"
+	"			id = \"LZjMeI-8cFS-mj83-LDUL-4CsJ-w24B-ikWMgI\"\n"
+	"			device = \"/dev/unit-test-pv1\"\n"
+	"			status = [\"ALLOCATABLE\"]\n"
+	"			flags = []\n"
+	"			dev_size = 409600\n"
+	"			pe_start = 2048\n"
+	"			pe_count = 49\n"
+	"		}\n"
+	"	}\n"
+	"	logical_volumes {\n"
+	"		lin {\n"
+	"			id = \"SuSw8P-1FGN-mtjw-HsGQ-eZ52-G6SI-owp6as\"\n"
+	"			status = [\"READ\", \"WRITE\", \"VISIBLE\"]\n"
+	"			flags = []\n"
+	"			tags = [\"lvtag1\", \"lvtag2\"]\n"
+	"			creation_time = 1600000000\n"
+	"			creation_host = \"unit\"\n"
+	"			segment_count = 2\n"
+	"			segment1 {\n"
+	"				start_extent = 0\n"
+	"				extent_count = 2\n"
+	"				type = \"striped\"\n"
+	"				stripe_count = 1\n"
+	"				stripes = [\"pv0\", 0]\n"
+	"			}\n"
+	"			segment2 {\n"
+	"				start_extent = 2\n"
+	"				extent_count = 3\n"
+	"				type = \"striped\"\n"
+	"				stripe_count = 1\n"
+	"				stripes = [\"pv1\", 0]\n"
+	"			}\n"
+	"		}\n"
+	"		str {\n"
+	"			id = \"vorcBq-yt1T-5AlQ-zhk7-Q2bm-Xkth-aYWyv1\"\n"
+	"			status = [\"READ\", \"WRITE\", \"VISIBLE\"]\n"
+	"			flags = []\n"
+	"			creation_time = 1600000001\n"
+	"			creation_host = \"unit\"\n"
+	"			segment_count = 1\n"
+	"			segment1 {\n"
+	"				start_extent = 0\n"
+	"				extent_count = 4\n"
+	"				type = \"striped\"\n"
+	"				stripe_count = 2\n"
+	"				stripe_size = 128\n"
+	"				stripes = [\"pv0\", 2, \"pv1\", 3]\n"
+	"			}\n"
+	"		}\n"
+	"		pool {\n"
+	"			id = \"kKB5oi-AKCA-AfLe-sTgc-fQgW-HHxj-Z7GFTj\"\n"
+	"			status = [\"READ\", \"WRITE\", \"VISIBLE\"]\n"
+	"			flags = []\n"
+	"			creation_time = 1600000002\n"
+	"			creation_host = \"unit\"\n"
+	"			segment_count = 1\n"
+	"			segment1 {\n"
+	"				start_extent = 0\n"
+	"				extent_count = 2\n"
+	"				type = \"thin-pool\"\n"
+	"				metadata = \"pool_tmeta\"\n"
+	"				pool = \"pool_tdata\"\n"
+	"				transaction_id = 1\n"
+	"				chunk_size = 128\n"
+	"				discards = \"passdown\"\n"
+	"				zero_new_blocks = 1\n"
+	"			}\n"
+	"		}\n"
+	"		thin {\n"
+	"			id = \"Memb6i-vyQK-hVtw-u9xa-P1Fn-d4Nc-493WZ0\"\n"
+	"			status = [\"READ\", \"WRITE\", \"VISIBLE\"]\n"
+	"			flags = []\n"
+	"			tags = [\"thintag\"]\n"
+	"			creation_time = 1600000003\n"
+	"			creation_host = \"unit\"\n"
+	"			segment_count = 1\n"
+	"			segment1 {\n"
+	"				start_extent = 0\n"
+	"				extent_count = 3\n"
+	"				type = \"thin\"\n"
+	"				thin_pool = \"pool\"\n"
+	"				transaction_id = 0\n"
+	"				device_id = 1\n"
+	"			}\n"
+	"		}\n"
+	"		pool_tmeta {\n"
+	"			id = \"LllvBC-hfmM-oFZE-Yjyh-gLUC-PiUC-GUfT7E\"\n"
+	"			status = [\"READ\", \"WRITE\"]\n"
+	"			flags = []\n"
+	"			creation_time = 1600000002\n"
+	"			creation_host = \"unit\"\n"
+	"			segment_count = 1\n"
+	"			segment1 {\n"
+	"				start_extent = 0\n"
+	"				extent_count = 1\n"
+	"				type = \"striped\"\n"
+	"				stripe_count = 1\n"
+	"				stripes = [\"pv1\", 5]\n"
+	"			}\n"
+	"		}\n"
+	"		pool_tdata {\n"
+	"			id = \"Kz0xDo-dmdC-hgnU-aTMN-6bPx-1BHf-9VWMG0\"\n"
+	"			status = [\"READ\", \"WRITE\"]\n"
+	"			flags = []\n"
+	"			creation_time = 1600000002\n"
+	"			creation_host = \"unit\"\n"
+	"			segment_count = 1\n"
+	"			segment1 {\n"
+	"				start_extent = 0\n"
+	"				extent_count = 2\n"
+	"				type = \"striped\"\n"
+	"				stripe_count = 1\n"
+	"				stripes = [\"pv0\", 4]\n"
+	"			}\n"
+	"		}\n"
+	"	}\n"
+	"}\n"
+	"contents = \"Text Format Volume Group\"\n"
+	"version = 1\n"
+	"description = \"\"\n"
+	"creation_host = \"unit\"\n"
+	"creation_time = 1600000000\n";
+
+struct fixture {
+	char dir[64];
+	struct cmd_context *cmd;
+};
+
+static void *_fix_init(void)
+{
+	struct fixture *f = malloc(sizeof(*f));
+
+	T_ASSERT(f);
+
+	/* Empty system dir, the built-in configuration is used. */
+	snprintf(f->dir, sizeof(f->dir), "/tmp/unit-test-vg-copy-XXXXXX");
+	T_ASSERT(mkdtemp(f->dir));
+
+	f->cmd = create_toolcontext(0, f->dir, 0, 0, 0, 0);
+	T_ASSERT(f->cmd);
+
+	return f;
+}
+
+static void _fix_exit(void *fixture)
+{
+	struct fixture *f = fixture;
+
+	destroy_toolcontext(f->cmd);
+	rmdir(f->dir);
+	free(f);
+}
+
+static struct volume_group *_import_vg(struct cmd_context *cmd)
+{
+	struct format_instance_ctx fic = {
+		.type = FMT_INSTANCE_MDAS,
+		.context.vg_ref.vg_name = "vgc",
+		.context.vg_ref.vg_id = VG_ID
+	};
+	struct format_instance *fid;
+	struct dm_config_tree *cft;
+	struct volume_group *vg;
+
+	T_ASSERT(fid = cmd->fmt->ops->create_instance(cmd->fmt, &fic));
+	T_ASSERT(cft = dm_config_from_string(_vg_text));
+	T_ASSERT(vg = import_vg_from_config_tree(cmd, fid, cft));
+	dm_config_destroy(cft);
+
+	return vg;
+}
+
+/* Export VG text without the lines that change with time. */
+static char *_export_vg(struct volume_group *vg)
+{
+	char *buf = NULL, *line, *next;
+
+	T_ASSERT(text_vg_export_raw(vg, "", &buf, NULL));
+
+	for (line = buf; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (!strncmp(line, "creation_time", 13))
+			memmove(line, next ? next + 1 : "", next ? strlen(next + 1) + 1 : 1);
+		else
+			next = next ? next + 1 : NULL;
+	}
+
+	return buf;
+}
+
+static void _test_copy_exports_same(void *fixture)
+{
+	struct fixture *f = fixture;
+	struct volume_group *vg, *copy;
+	char *orig_text, *copy_text;
+
+	vg = _import_vg(f->cmd);
+	T_ASSERT_EQUAL(dm_list_size(&vg->lvs), 6);
+
+	T_ASSERT(copy = vg_copy(vg));
+	T_ASSERT(copy != vg);
+
+	orig_text = _export_vg(vg);
+	copy_text = _export_vg(copy);
+
+	if (strcmp(orig_text, copy_text))
+		test_fail("VG copy exports differently:\n%s\n---\n%s", orig_text, copy_text);
+
+	free(orig_text);
+	free(copy_text);
+	release_vg(copy);
+	release_vg(vg);
+}
+
+static void _test_copy_is_independent(void *fixture)
+{
+	struct fixture *f = fixture;
+	struct volume_group *vg, *copy;
+	struct logical_volume *lv, *copy_lv;
+	char *copy_text, *copy_text2;
+
+	vg = _import_vg(f->cmd);
+	T_ASSERT(copy = vg_copy(vg));
+	copy_text = _export_vg(copy);
+
+	T_ASSERT(lv = find_lv(vg, "lin"));
+	T_ASSERT(copy_lv = find_lv(copy, "lin"));
+	T_ASSERT(lv != copy_lv);
+	T_ASSERT(first_seg(lv) != first_seg(copy_lv));
+	T_ASSERT(seg_pv(first_seg(lv), 0) != seg_pv(first_seg(copy_lv), 0));
+	T_ASSERT(copy_lv->vg == copy);
+
+	/* Changes to the original do not show in the copy. */
+	T_ASSERT(str_list_add(vg->vgmem, &lv->tags, "newtag"));
+	vg->seqno++;
+
+	copy_text2 = _export_vg(copy);
+	T_ASSERT(!strcmp(copy_text, copy_text2));
+
+	free(copy_text);
+	free(copy_text2);
+	release_vg(copy);
+	release_vg(vg);
+}
+
+//----------------------------------------------------------------
+
+#define T(path, desc, fn) register_test(ts, "/metadata/vg-copy/" path, desc, fn)
+
+static struct test_suite *_tests(void)
+{
+	struct test_suite *ts = test_suite_create(_fix_init, _fix_exit);
+	if (!ts) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	};
+
+	T("exports-same", "VG copy exports to the same text as the original", _test_copy_exports_same);
+	T("independent", "VG copy does not share objects with the original", _test_copy_is_independent);
+
+	return ts;
+}
+
+void vg_copy_tests(struct dm_list *all_tests)
+{
+	dm_list_add(all_tests, &_tests()->list);
+}
+
+//----------------------------------------------------------------
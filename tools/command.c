@@ -272,6 +272,23 @@ struct opt_name *opt_names_alpha[ARG_COUNT + 1];
 
 struct command lvm_all;
 
+/*
+ * Buffers filled while parsing command-lines.in, one for each entry
+ * in commands[] and the last one for lvm_all.  The arrays in struct
+ * command point into them.
+ */
+
+struct command_args {
+	struct opt_arg required_opt_args[CMD_RO_ARGS];
+	struct opt_arg optional_opt_args[CMD_OO_ARGS];
+	struct pos_arg required_pos_args[CMD_RP_ARGS];
+	struct pos_arg optional_pos_args[CMD_OP_ARGS];
+	struct opt_arg ignore_opt_args[CMD_IO_ARGS];
+	struct cmd_rule rules[CMD_MAX_RULES];
+};
+
+static struct command_args _command_args[COMMAND_COUNT + 1];
+
 /* saves OO_FOO lines (groups of optional options) to include in multiple defs */
 
 static int _oo_line_count;
@@ -300,6 +317,25 @@ static struct oo_line _oo_lines[MAX_OO_LINES];
 
 static void __add_optional_opt_line(struct cmd_context *cmdtool, struct command *cmd, int argc, char *argv[]);
 
+static struct command_args *_cmd_args(struct command *cmd)
+{
+	return &_command_args[(cmd == &lvm_all) ? COMMAND_COUNT : cmd->command_index];
+}
+
+static void _init_cmd_args(struct command *cmd)
+{
+	struct command_args *args = _cmd_args(cmd);
+
+	memset(args, 0, sizeof(*args));
+
+	cmd->required_opt_args = args->required_opt_args;
+	cmd->optional_opt_args = args->optional_opt_args;
+	cmd->required_pos_args = args->required_pos_args;
+	cmd->optional_pos_args = args->optional_pos_args;
+	cmd->ignore_opt_args = args->ignore_opt_args;
+	cmd->rules = args->rules;
+}
+
 /*
  * modifies buf, replacing the sep characters with \0
  * argv pointers point to positions in buf
@@ -891,11 +927,11 @@ static void _add_opt_arg(struct command *cmd, char *str,
 
 skip:
 	if (required > 0)
-		cmd->required_opt_args[cmd->ro_count++].opt = opt;
+		_cmd_args(cmd)->required_opt_args[cmd->ro_count++].opt = opt;
 	else if (!required)
-		cmd->optional_opt_args[cmd->oo_count++].opt = opt;
+		_cmd_args(cmd)->optional_opt_args[cmd->oo_count++].opt = opt;
 	else if (required < 0)
-		cmd->ignore_opt_args[cmd->io_count++].opt = opt;
+		_cmd_args(cmd)->ignore_opt_args[cmd->io_count++].opt = opt;
 
 	*takes_arg = opt_names[opt].val_enum ? 1 : 0;
 }
@@ -925,11 +961,11 @@ static void _update_prev_opt_arg(struct cmd_context *cmdtool, struct command *cm
 	_set_opt_def(cmdtool, cmd, str, &def);
 
 	if (required > 0)
-		cmd->required_opt_args[cmd->ro_count-1].def = def;
+		_cmd_args(cmd)->required_opt_args[cmd->ro_count-1].def = def;
 	else if (!required)
-		cmd->optional_opt_args[cmd->oo_count-1].def = def;
+		_cmd_args(cmd)->optional_opt_args[cmd->oo_count-1].def = def;
 	else if (required < 0)
-		cmd->ignore_opt_args[cmd->io_count-1].def = def;
+		_cmd_args(cmd)->ignore_opt_args[cmd->io_count-1].def = def;
 }
 
 /*
@@ -946,12 +982,12 @@ static void _add_pos_arg(struct command *cmd, char *str, int required)
 	_set_pos_def(cmd, str, &def);
 
 	if (required) {
-		cmd->required_pos_args[cmd->rp_count].pos = cmd->pos_count++;
-		cmd->required_pos_args[cmd->rp_count].def = def;
+		_cmd_args(cmd)->required_pos_args[cmd->rp_count].pos = cmd->pos_count++;
+		_cmd_args(cmd)->required_pos_args[cmd->rp_count].def = def;
 		cmd->rp_count++;
 	} else {
-		cmd->optional_pos_args[cmd->op_count].pos = cmd->pos_count++;;
-		cmd->optional_pos_args[cmd->op_count].def = def;
+		_cmd_args(cmd)->optional_pos_args[cmd->op_count].pos = cmd->pos_count++;;
+		_cmd_args(cmd)->optional_pos_args[cmd->op_count].def = def;
 		cmd->op_count++;
 	}
 }
@@ -965,9 +1001,9 @@ static void _update_prev_pos_arg(struct command *cmd, char *str, int required)
 	/* a previous pos_arg.def is modified here */
 
 	if (required)
-		def = &cmd->required_pos_args[cmd->rp_count-1].def;
+		def = &_cmd_args(cmd)->required_pos_args[cmd->rp_count-1].def;
 	else
-		def = &cmd->optional_pos_args[cmd->op_count-1].def;
+		def = &_cmd_args(cmd)->optional_pos_args[cmd->op_count-1].def;
 
 	if (!strcmp(str, "..."))
 		def->flags |= ARG_DEF_FLAG_MAY_REPEAT;
@@ -1172,6 +1208,7 @@ static void _add_rule(struct cmd_context *cmdtool, struct command *cmd, char *li
 {
 	struct cmd_rule *rule;
 	char *line_argv[MAX_LINE_ARGC];
+	int *opts = NULL, *check_opts = NULL;
 	char *arg;
 	int line_argc;
 	int i, lvt_enum, lvp_enum;
@@ -1183,7 +1220,7 @@ static void _add_rule(struct cmd_context *cmdtool, struct command *cmd, char *li
 		return;
 	}
 
-	rule = &cmd->rules[cmd->rule_count++];
+	rule = &_cmd_args(cmd)->rules[cmd->rule_count++];
 
 	_split_line(line, &line_argc, line_argv, ' ');
 
@@ -1206,28 +1243,30 @@ static void _add_rule(struct cmd_context *cmdtool, struct command *cmd, char *li
 		}
 
 		else if (!strncmp(arg, "--", 2)) {
-			if (!rule->opts) {
-				if (!(rule->opts = dm_pool_alloc(cmdtool->libmem, MAX_RULE_OPTS * sizeof(int)))) {
+			if (!opts) {
+				if (!(opts = dm_pool_alloc(cmdtool->libmem, MAX_RULE_OPTS * sizeof(int)))) {
 					log_error("Parsing command defs: no mem.");
 					cmd->cmd_flags |= CMD_FLAG_PARSE_ERROR;
 					return;
 				}
-				memset(rule->opts, 0, MAX_RULE_OPTS * sizeof(int));
+				memset(opts, 0, MAX_RULE_OPTS * sizeof(int));
+				rule->opts = opts;
 			}
 
-			if (!rule->check_opts) {
-				if (!(rule->check_opts = dm_pool_alloc(cmdtool->libmem, MAX_RULE_OPTS * sizeof(int)))) {
+			if (!check_opts) {
+				if (!(check_opts = dm_pool_alloc(cmdtool->libmem, MAX_RULE_OPTS * sizeof(int)))) {
 					log_error("Parsing command defs: no mem.");
 					cmd->cmd_flags |= CMD_FLAG_PARSE_ERROR;
 					return;
 				}
-				memset(rule->check_opts, 0, MAX_RULE_OPTS * sizeof(int));
+				memset(check_opts, 0, MAX_RULE_OPTS * sizeof(int));
+				rule->check_opts = check_opts;
 			}
 
 			if (check)
-				rule->check_opts[rule->check_opts_count++] = _opt_str_to_num(cmd, arg);
+				check_opts[rule->check_opts_count++] = _opt_str_to_num(cmd, arg);
 			else
-				rule->opts[rule->opts_count++] = _opt_str_to_num(cmd, arg);
+				opts[rule->opts_count++] = _opt_str_to_num(cmd, arg);
 		}
 
 		else if (!strncmp(arg, "LV_", 3)) {
@@ -1447,6 +1486,7 @@ int define_commands(struct cmd_context *cmdtool, const char *run_name)
 			cmd = &commands[cmd_count];
 			cmd->command_index = cmd_count;
 			cmd_count++;
+			_init_cmd_args(cmd);
 			cmd->name = dm_pool_strdup(cmdtool->libmem, name);
 
 			if (!cmd->name) {
@@ -1577,6 +1617,8 @@ int define_commands(struct cmd_context *cmdtool, const char *run_name)
 			return 0;
 	}
 
+	memset(&lvm_all, 0, sizeof(lvm_all));
+	_init_cmd_args(&lvm_all);
 	_include_optional_opt_args(cmdtool, &lvm_all, "OO_ALL");
 
 	for (i = 0; i < _oo_line_count; i++) {
@@ -1748,7 +1790,7 @@ static void _print_val_usage(struct command *cmd, int opt_enum, int val_enum)
 		printf("%s", val_names[val_enum].usage);
 }
 
-static void _print_usage_def(struct command *cmd, int opt_enum, struct arg_def *def)
+static void _print_usage_def(struct command *cmd, int opt_enum, const struct arg_def *def)
 {
 	int val_enum;
 	int lvt_enum;
@@ -2340,7 +2382,7 @@ static void _print_val_man(struct command_name *cname, int opt_enum, int val_enu
 	printf("\\fB%s\\fP", str);
 }
 
-static void _print_def_man(struct command_name *cname, int opt_enum, struct arg_def *def, int usage)
+static void _print_def_man(struct command_name *cname, int opt_enum, const struct arg_def *def, int usage)
 {
 	int val_enum;
 	int lvt_enum;
@@ -3558,6 +3600,264 @@ static void _print_man_secondary(char *name)
 	}
 }
 
+/*
+ * Print commands[] and lvm_all as C tables for command-defs.h,
+ * so lvm does not need to parse command-lines.in at run time.
+ */
+
+static void _print_c_string(const char *str)
+{
+	putchar('"');
+	for (; *str; str++) {
+		if ((*str == '"') || (*str == '\\'))
+			putchar('\\');
+		putchar(*str);
+	}
+	putchar('"');
+}
+
+#define _print_c_bits(bits, count, table, enum_name) \
+do { \
+	int _i, _first = 1; \
+	for (_i = 0; _i < (count); _i++) \
+		if ((bits) & (1ULL << _i)) { \
+			printf("%s(1ULL << %s)", _first ? "" : " | ", (table)[_i].enum_name); \
+			_first = 0; \
+		} \
+} while (0)
+
+static void _print_c_arg_def(const struct arg_def *def)
+{
+	const char *sep = "";
+
+	printf("{ ");
+
+	if (def->val_bits) {
+		printf(".val_bits = ");
+		_print_c_bits(def->val_bits, VAL_COUNT, val_names, enum_name);
+		sep = ", ";
+	}
+
+	if (def->lvt_bits) {
+		printf("%s.lvt_bits = ", sep);
+		_print_c_bits(def->lvt_bits, LVT_COUNT, lv_types, enum_name);
+		sep = ", ";
+	}
+
+	if (def->num) {
+		printf("%s.num = %llu", sep, (unsigned long long) def->num);
+		sep = ", ";
+	}
+
+	if (def->str) {
+		printf("%s.str = ", sep);
+		_print_c_string(def->str);
+		sep = ", ";
+	}
+
+	if (def->flags) {
+		printf("%s.flags = %u", sep, def->flags);
+		sep = ", ";
+	}
+
+	printf("%s }", *sep ? "" : "0");
+}
+
+static void _print_c_opt_args(const char *prefix, const char *suffix,
+			      const struct opt_arg *args, int count)
+{
+	int i;
+
+	if (!count)
+		return;
+
+	printf("static const struct opt_arg %s_%s[%d] = {\n", prefix, suffix, count);
+	for (i = 0; i < count; i++) {
+		printf("\t{ %s, ", opt_names[args[i].opt].name);
+		_print_c_arg_def(&args[i].def);
+		printf(" },\n");
+	}
+	printf("};\n\n");
+}
+
+static void _print_c_pos_args(const char *prefix, const char *suffix,
+			      const struct pos_arg *args, int count)
+{
+	int i;
+
+	if (!count)
+		return;
+
+	printf("static const struct pos_arg %s_%s[%d] = {\n", prefix, suffix, count);
+	for (i = 0; i < count; i++) {
+		printf("\t{ %d, ", args[i].pos);
+		_print_c_arg_def(&args[i].def);
+		printf(" },\n");
+	}
+	printf("};\n\n");
+}
+
+static void _print_c_opt_list(const char *prefix, int r, const char *suffix,
+			      const int *opts, int count)
+{
+	int i;
+
+	if (!opts)
+		return;
+
+	printf("static const int %s_rule%d_%s[%d] = {", prefix, r, suffix, count ? count : 1);
+	for (i = 0; i < count; i++)
+		printf("%s %s", i ? "," : "", opt_names[opts[i]].name);
+	printf(count ? " };\n" : " 0 };\n");
+}
+
+static void _print_c_rules(const char *prefix, const struct command *cmd)
+{
+	const struct cmd_rule *rule;
+	int r;
+
+	if (!cmd->rule_count)
+		return;
+
+	for (r = 0; r < cmd->rule_count; r++) {
+		rule = &cmd->rules[r];
+		_print_c_opt_list(prefix, r, "opts", rule->opts, rule->opts_count);
+		_print_c_opt_list(prefix, r, "check_opts", rule->check_opts, rule->check_opts_count);
+	}
+
+	printf("\nstatic const struct cmd_rule %s_rules[%d] = {\n", prefix, cmd->rule_count);
+	for (r = 0; r < cmd->rule_count; r++) {
+		rule = &cmd->rules[r];
+		printf("\t{\n");
+		if (rule->opts)
+			printf("\t\t.opts = %s_rule%d_opts,\n", prefix, r);
+		if (rule->lvt_bits) {
+			printf("\t\t.lvt_bits = ");
+			_print_c_bits(rule->lvt_bits, LVT_COUNT, lv_types, enum_name);
+			printf(",\n");
+		}
+		if (rule->lvp_bits) {
+			printf("\t\t.lvp_bits = ");
+			_print_c_bits(rule->lvp_bits, LVP_COUNT, lv_props, enum_name);
+			printf(",\n");
+		}
+		if (rule->check_opts)
+			printf("\t\t.check_opts = %s_rule%d_check_opts,\n", prefix, r);
+		if (rule->check_lvt_bits) {
+			printf("\t\t.check_lvt_bits = ");
+			_print_c_bits(rule->check_lvt_bits, LVT_COUNT, lv_types, enum_name);
+			printf(",\n");
+		}
+		if (rule->check_lvp_bits) {
+			printf("\t\t.check_lvp_bits = ");
+			_print_c_bits(rule->check_lvp_bits, LVP_COUNT, lv_props, enum_name);
+			printf(",\n");
+		}
+		printf("\t\t.rule = %u,\n", rule->rule);
+		printf("\t\t.opts_count = %d,\n", rule->opts_count);
+		printf("\t\t.check_opts_count = %d,\n", rule->check_opts_count);
+		printf("\t},\n");
+	}
+	printf("};\n\n");
+}
+
+static void _print_c_command_args(const char *prefix, const struct command *cmd)
+{
+	_print_c_opt_args(prefix, "ro", cmd->required_opt_args, cmd->ro_count + cmd->any_ro_count);
+	_print_c_opt_args(prefix, "oo", cmd->optional_opt_args, cmd->oo_count);
+	_print_c_pos_args(prefix, "rp", cmd->required_pos_args, cmd->rp_count);
+	_print_c_pos_args(prefix, "op", cmd->optional_pos_args, cmd->op_count);
+	_print_c_opt_args(prefix, "io", cmd->ignore_opt_args, cmd->io_count);
+	_print_c_rules(prefix, cmd);
+}
+
+static void _print_c_command(const char *prefix, const struct command *cmd)
+{
+	int cmd_enum;
+
+	printf("\t{\n");
+
+	if (cmd->name) {
+		printf("\t\t.name = ");
+		_print_c_string(cmd->name);
+		printf(",\n");
+	}
+
+	if (cmd->desc) {
+		printf("\t\t.desc = ");
+		_print_c_string(cmd->desc);
+		printf(",\n");
+	}
+
+	if (cmd->command_id) {
+		printf("\t\t.command_id = ");
+		_print_c_string(cmd->command_id);
+		printf(",\n");
+		if ((cmd_enum = command_id_to_enum(cmd->command_id)))
+			printf("\t\t.command_enum = %s,\n", cmd_names[cmd_enum].enum_name);
+	}
+
+	printf("\t\t.command_index = %d,\n", cmd->command_index);
+	printf("\t\t.cmd_flags = %u,\n", cmd->cmd_flags);
+
+	if (cmd->ro_count + cmd->any_ro_count)
+		printf("\t\t.required_opt_args = %s_ro,\n", prefix);
+	if (cmd->oo_count)
+		printf("\t\t.optional_opt_args = %s_oo,\n", prefix);
+	if (cmd->rp_count)
+		printf("\t\t.required_pos_args = %s_rp,\n", prefix);
+	if (cmd->op_count)
+		printf("\t\t.optional_pos_args = %s_op,\n", prefix);
+	if (cmd->io_count)
+		printf("\t\t.ignore_opt_args = %s_io,\n", prefix);
+	if (cmd->rule_count)
+		printf("\t\t.rules = %s_rules,\n", prefix);
+
+	printf("\t\t.any_ro_count = %d,\n", cmd->any_ro_count);
+	printf("\t\t.ro_count = %d,\n", cmd->ro_count);
+	printf("\t\t.oo_count = %d,\n", cmd->oo_count);
+	printf("\t\t.rp_count = %d,\n", cmd->rp_count);
+	printf("\t\t.op_count = %d,\n", cmd->op_count);
+	printf("\t\t.io_count = %d,\n", cmd->io_count);
+	printf("\t\t.rule_count = %d,\n", cmd->rule_count);
+	printf("\t}");
+}
+
+static int _print_command_defs(void)
+{
+	char prefix[32];
+	int i;
+
+	for (i = 0; i < COMMAND_COUNT; i++)
+		if (!commands[i].name || !commands[i].command_id) {
+			log_error("Command definition %d is incomplete.", i);
+			return 0;
+		}
+
+	printf("#define COMMAND_DEFS_GENERATED\n\n");
+
+	for (i = 0; i < COMMAND_COUNT; i++) {
+		(void) snprintf(prefix, sizeof(prefix), "_cmd%d", i);
+		_print_c_command_args(prefix, &commands[i]);
+	}
+
+	_print_c_command_args("_lvm_all", &lvm_all);
+
+	printf("static const struct command _command_defs[COMMAND_COUNT] = {\n");
+	for (i = 0; i < COMMAND_COUNT; i++) {
+		(void) snprintf(prefix, sizeof(prefix), "_cmd%d", i);
+		_print_c_command(prefix, &commands[i]);
+		printf(",\n");
+	}
+	printf("};\n\n");
+
+	printf("static const struct command _lvm_all_def =\n");
+	_print_c_command("_lvm_all", &lvm_all);
+	printf(";\n");
+
+	return 1;
+}
+
 #define	STDOUT_BUF_SIZE	 (MAX_MAN_DESC + 4 * 1024)
 
 int main(int argc, char *argv[])
@@ -3568,12 +3868,14 @@ int main(int argc, char *argv[])
 	char *stdout_buf;
 	int primary = 0;
 	int secondary = 0;
+	int command_defs = 0;
 	int r = 0;
 	size_t sz = STDOUT_BUF_SIZE;
 
 	static struct option long_options[] = {
 		{"primary", no_argument, 0, 'p' },
 		{"secondary", no_argument, 0, 's' },
+		{"command-defs", no_argument, 0, 'c' },
 		{0, 0, 0, 0 }
 	};
 
@@ -3588,7 +3890,7 @@ int main(int argc, char *argv[])
 		int c;
 		int option_index = 0;
 
-		c = getopt_long(argc, argv, "ps", long_options, &option_index);
+		c = getopt_long(argc, argv, "psc", long_options, &option_index);
 		if (c == -1)
 			break;
 
@@ -3601,11 +3903,21 @@ int main(int argc, char *argv[])
 		case 's':
 			secondary = 1;
 			break;
+		case 'c':
+			command_defs = 1;
+			break;
 		}
 	}
 
+	if (command_defs) {
+		if (define_commands(&cmdtool, NULL))
+			r = _print_command_defs();
+		goto out_free;
+	}
+
 	if (!primary && !secondary) {
 		log_error("Usage: %s --primary|--secondary <command> [/path/to/description-file].", argv[0]);
+		log_error("       %s --command-defs", argv[0]);
 		goto out_free;
 	}
 
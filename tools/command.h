@@ -134,11 +134,11 @@ struct pos_arg {
 #define RULE_REQUIRE 2
 
 struct cmd_rule {
-	int *opts;			/* if any option in this list is set, the check may apply */
+	const int *opts;		/* if any option in this list is set, the check may apply */
 	uint64_t lvt_bits;		/* if LV has one of these types (lvt_enum_to_bit), the check may apply */
 	uint64_t lvp_bits;		/* if LV has all of these properties (lvp_enum_to_bit), the check may apply */
 
-	int *check_opts;		/* used options must [not] be in this list */
+	const int *check_opts;		/* used options must [not] be in this list */
 	uint64_t check_lvt_bits;	/* LV must [not] have one of these type */
 	uint64_t check_lvp_bits;	/* LV must [not] have all of these properties */
 
@@ -193,22 +193,28 @@ struct command {
 
 	/* definitions of opt/pos args */
 
+	/*
+	 * Arrays of the sizes given by the counts below; they point
+	 * either into the generated command-defs.h tables or into
+	 * the buffers filled when parsing command-lines.in.
+	 */
+
 	/* required args following an --opt */
-	struct opt_arg required_opt_args[CMD_RO_ARGS];
+	const struct opt_arg *required_opt_args;
 
 	/* optional args following an --opt */
-	struct opt_arg optional_opt_args[CMD_OO_ARGS];
+	const struct opt_arg *optional_opt_args;
 
 	/* required positional args */
-	struct pos_arg required_pos_args[CMD_RP_ARGS];
+	const struct pos_arg *required_pos_args;
 
 	/* optional positional args */
-	struct pos_arg optional_pos_args[CMD_OP_ARGS];
+	const struct pos_arg *optional_pos_args;
 
 	/* unused opt args, are ignored instead of causing an error */
-	struct opt_arg ignore_opt_args[CMD_IO_ARGS];
+	const struct opt_arg *ignore_opt_args;
 
-	struct cmd_rule rules[CMD_MAX_RULES];
+	const struct cmd_rule *rules;
 
 	int any_ro_count;
 
@@ -17,6 +17,7 @@
 
 #include "lvm2cmdline.h"
 #include "lib/label/label.h"
+#include "lib/filters/filter.h"
 #include "lvm-version.h"
 #include "lib/locking/lvmlockd.h"
 
@@ -79,6 +80,19 @@ extern struct command_name command_names[MAX_COMMAND_NAMES];
  */
 struct command commands[COMMAND_COUNT];
 
+/*
+ * Options common to all commands (OO_ALL in command-lines.in)
+ */
+extern struct command lvm_all;
+
+/*
+ * Contains _command_defs[] and _lvm_all_def generated from
+ * command-lines.in by man-generator at build time.  When the
+ * generator cannot be run (e.g. cross-compiling), it is empty
+ * and command-lines.in is parsed at run time instead.
+ */
+#include "command-defs.h"
+
 static struct cmdline_context _cmdline;
 
 /*
@@ -1317,6 +1331,11 @@ int lvm_register_commands(struct cmd_context *cmd, const char *run_name)
 	if (_cmdline.commands)
 		return 1;
 
+#ifdef COMMAND_DEFS_GENERATED
+	/* commands[] array resolved from command-lines.in at build time */
+	memcpy(&commands, &_command_defs, sizeof(commands));
+	lvm_all = _lvm_all_def;
+#else
 	memset(&commands, 0, sizeof(commands));
 
 	/*
@@ -1327,12 +1346,14 @@ int lvm_register_commands(struct cmd_context *cmd, const char *run_name)
 		log_error(INTERNAL_ERROR "Failed to parse command definitions.");
 		return 0;
 	}
+#endif
 
 	_cmdline.commands = commands;
 	_cmdline.num_commands = COMMAND_COUNT;
 
 	for (i = 0; i < COMMAND_COUNT; i++) {
-		commands[i].command_enum = command_id_to_enum(commands[i].command_id);
+		if (!commands[i].command_enum)
+			commands[i].command_enum = command_id_to_enum(commands[i].command_id);
 
 		if (!commands[i].command_enum) {
 			log_error(INTERNAL_ERROR "Failed to find command id %s.", commands[i].command_id);
@@ -1940,7 +1961,7 @@ out:
 	 */
 
 	for (i = 0; i < commands[best_i].rule_count; i++) {
-		struct cmd_rule *rule;
+		const struct cmd_rule *rule;
 		rule = &commands[best_i].rules[i];
 
 		/*
@@ -3134,6 +3155,15 @@ int lvm_run_command(struct cmd_context *cmd, int argc, char **argv)
 		/* The old style command-name function is used */
 		ret = cmd->command->fn(cmd, argc, argv);
 
+	/* Before the global lock is released. */
+	finish_hint_update(cmd, ret == ECMD_PROCESSED);
+
+	if (cmd->filter) {
+		if (cmd->filter->log_stats)
+			cmd->filter->log_stats(cmd->filter);
+		persistent_filter_save(cmd, cmd->filter);
+	}
+
 	lvmlockd_disconnect();
 	fin_locking(cmd);
 
@@ -3143,7 +3173,8 @@ int lvm_run_command(struct cmd_context *cmd, int argc, char **argv)
       out:
 
 	hints_exit(cmd);
-	lvmcache_destroy(cmd, 1, 1);
+	if ((ret != ECMD_PROCESSED) || !lvmcache_keep_scan(cmd))
+		lvmcache_destroy(cmd, 1, 1);
 	label_scan_destroy(cmd);
 
 	if ((config_string_cft = remove_config_tree_by_source(cmd, CONFIG_STRING)))
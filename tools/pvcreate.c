@@ -140,7 +140,7 @@ int pvcreate(struct cmd_context *cmd, int argc, char **argv)
 	if (!lock_global(cmd, "ex"))
 		return_ECMD_FAILED;
 
-	clear_hint_file(cmd);
+	begin_hint_update(cmd);
 
 	lvmcache_label_scan(cmd);
 
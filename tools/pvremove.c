@@ -43,7 +43,7 @@ int pvremove(struct cmd_context *cmd, int argc, char **argv)
 			return_ECMD_FAILED;
 	}
 
-	clear_hint_file(cmd);
+	begin_hint_update(cmd);
 
 	lvmcache_label_scan(cmd);
 
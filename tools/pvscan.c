@@ -18,8 +18,11 @@
 #include "lib/cache/lvmcache.h"
 #include "lib/metadata/metadata.h"
 #include "lib/label/hints.h"
+#include "lib/filters/filter.h"
 
 #include <dirent.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 
 struct pvscan_params {
 	int new_pvs_found;
@@ -45,6 +48,7 @@ static struct volume_group *saved_vg;
 static const char *_pvs_online_dir = DEFAULT_RUN_DIR "/pvs_online";
 static const char *_vgs_online_dir = DEFAULT_RUN_DIR "/vgs_online";
 static const char *_pvs_lookup_dir = DEFAULT_RUN_DIR "/pvs_lookup";
+static const char *_pvs_online_index = DEFAULT_RUN_DIR "/pvs_online.idx";
 
 static int _pvscan_display_pv(struct cmd_context *cmd,
 				  struct physical_volume *pv,
@@ -276,6 +280,574 @@ static void _online_vg_file_remove(const char *vgname)
 		log_sys_debug("unlink", path);
 }
 
+/*
+ * pvs_online index
+ *
+ * The pvid online files are a simple view of the online state, but
+ * finding the PVID for a major:minor, or checking all PVs of a VG, needs
+ * a file operation per PV.  When thousands of PVs appear together, every
+ * pvscan doing that makes the whole autoactivation quadratic.
+ *
+ * The same state is kept in an index file that each pvscan maps into
+ * memory: open-addressed tables of PVs (by PVID), VGs (by name) and
+ * device numbers.  Each VG keeps the count of its PVs from the metadata
+ * and a count of those online.  The pvid online files are still created
+ * and removed, so other users of them, or an unusable index (full, failed
+ * to map), still work.  Both are changed together under a flock on the
+ * index, which also records the state of the pvs_online directory after
+ * each change.  When the directory was changed by anything else, the
+ * index is rebuilt from the files.
+ */
+
+#define ONLINE_INDEX_MAGIC	0x584f5650	/* "PVOX" */
+#define ONLINE_INDEX_VERSION	1
+#define ONLINE_INDEX_PVS	16384		/* power of 2 */
+#define ONLINE_INDEX_VGS	2048		/* power of 2 */
+#define ONLINE_INDEX_DEV_DELETED UINT32_MAX
+
+#define ONLINE_INDEX_PV_USED	0x00000001
+#define ONLINE_INDEX_PV_ONLINE	0x00000002
+
+struct online_index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t pv_slots;
+	uint32_t vg_slots;
+	uint32_t pv_used;
+	uint32_t vg_used;
+	uint32_t invalid;	/* table full, use files only */
+	uint32_t unused;
+	uint64_t dir_size;	/* pvs_online dir after last change */
+	int64_t dir_mtime_sec;
+	int64_t dir_mtime_nsec;
+};
+
+struct online_index_pv {
+	char pvid[ID_LEN];
+	uint32_t major;
+	uint32_t minor;
+	uint32_t vg;		/* vg slot + 1, 0 if unknown */
+	uint32_t flags;
+};
+
+struct online_index_vg {
+	char name[NAME_LEN];
+	uint32_t pv_count;	/* 0 until known from metadata */
+	uint32_t pvs_online;
+	uint32_t used;
+	uint32_t unused;
+};
+
+struct online_index {
+	int fd;
+	size_t size;
+	struct online_index_header *hdr;
+	struct online_index_pv *pvs;
+	struct online_index_vg *vgs;
+	uint32_t *devs;		/* pv slot + 1 */
+};
+
+static struct online_index _oix = { .fd = -1 };
+
+static uint32_t _oix_hash(const char *buf, size_t len)
+{
+	uint32_t h = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < len && buf[i]; i++)
+		h = (h ^ (unsigned char) buf[i]) * 16777619U;
+
+	return h;
+}
+
+static uint32_t _oix_devno_hash(uint32_t major, uint32_t minor)
+{
+	return (major * 2654435761U) ^ (minor * 40503U);
+}
+
+static struct online_index_pv *_oix_pv_find(const char *pvid, int create)
+{
+	uint32_t i, n = _oix_hash(pvid, ID_LEN);
+	struct online_index_pv *pv;
+
+	for (i = 0; i < ONLINE_INDEX_PVS; i++) {
+		pv = &_oix.pvs[(n + i) & (ONLINE_INDEX_PVS - 1)];
+
+		if (!(pv->flags & ONLINE_INDEX_PV_USED))
+			break;
+
+		if (!memcmp(pv->pvid, pvid, ID_LEN))
+			return pv;
+	}
+
+	if (!create)
+		return NULL;
+
+	if ((i == ONLINE_INDEX_PVS) ||
+	    (_oix.hdr->pv_used >= ONLINE_INDEX_PVS / 4 * 3)) {
+		log_debug("pvs_online index is full.");
+		_oix.hdr->invalid = 1;
+		return NULL;
+	}
+
+	memcpy(pv->pvid, pvid, ID_LEN);
+	pv->flags = ONLINE_INDEX_PV_USED;
+	_oix.hdr->pv_used++;
+
+	return pv;
+}
+
+static struct online_index_vg *_oix_vg_find(const char *vgname, int create)
+{
+	uint32_t i, n = _oix_hash(vgname, NAME_LEN);
+	struct online_index_vg *vg;
+
+	for (i = 0; i < ONLINE_INDEX_VGS; i++) {
+		vg = &_oix.vgs[(n + i) & (ONLINE_INDEX_VGS - 1)];
+
+		if (!vg->used)
+			break;
+
+		if (!strncmp(vg->name, vgname, NAME_LEN))
+			return vg;
+	}
+
+	if (!create)
+		return NULL;
+
+	if ((strlen(vgname) >= NAME_LEN) ||
+	    (i == ONLINE_INDEX_VGS) ||
+	    (_oix.hdr->vg_used >= ONLINE_INDEX_VGS / 4 * 3)) {
+		log_debug("pvs_online index is full.");
+		_oix.hdr->invalid = 1;
+		return NULL;
+	}
+
+	strcpy(vg->name, vgname);
+	vg->used = 1;
+	_oix.hdr->vg_used++;
+
+	return vg;
+}
+
+/* Returns the dev table entry for major:minor, or the free one to use. */
+static uint32_t *_oix_dev_entry(uint32_t major, uint32_t minor, int create)
+{
+	uint32_t i, n = _oix_devno_hash(major, minor);
+	uint32_t *dev, *deleted = NULL;
+	struct online_index_pv *pv;
+
+	for (i = 0; i < ONLINE_INDEX_PVS; i++) {
+		dev = &_oix.devs[(n + i) & (ONLINE_INDEX_PVS - 1)];
+
+		if (!*dev)
+			break;
+
+		if (*dev == ONLINE_INDEX_DEV_DELETED) {
+			if (!deleted)
+				deleted = dev;
+			continue;
+		}
+
+		pv = &_oix.pvs[*dev - 1];
+		if ((pv->major == major) && (pv->minor == minor))
+			return dev;
+	}
+
+	if (!create)
+		return NULL;
+
+	if (deleted)
+		return deleted;
+
+	if (i == ONLINE_INDEX_PVS) {
+		_oix.hdr->invalid = 1;
+		return NULL;
+	}
+
+	return dev;
+}
+
+static void _oix_pv_set_vg(struct online_index_pv *pv, struct online_index_vg *vg)
+{
+	uint32_t vg_slot = vg ? (uint32_t) (vg - _oix.vgs) + 1 : 0;
+
+	if (pv->vg == vg_slot)
+		return;
+
+	if ((pv->flags & ONLINE_INDEX_PV_ONLINE) && pv->vg &&
+	    _oix.vgs[pv->vg - 1].pvs_online)
+		_oix.vgs[pv->vg - 1].pvs_online--;
+
+	pv->vg = vg_slot;
+
+	if ((pv->flags & ONLINE_INDEX_PV_ONLINE) && vg)
+		vg->pvs_online++;
+}
+
+static void _oix_pv_set_offline(struct online_index_pv *pv)
+{
+	uint32_t *dev;
+
+	if (!(pv->flags & ONLINE_INDEX_PV_ONLINE))
+		return;
+
+	if ((dev = _oix_dev_entry(pv->major, pv->minor, 0)))
+		*dev = ONLINE_INDEX_DEV_DELETED;
+
+	if (pv->vg && _oix.vgs[pv->vg - 1].pvs_online)
+		_oix.vgs[pv->vg - 1].pvs_online--;
+
+	pv->flags &= ~ONLINE_INDEX_PV_ONLINE;
+}
+
+static int _oix_pv_set_online(const char *pvid, uint32_t major, uint32_t minor,
+			      const char *vgname)
+{
+	struct online_index_pv *pv;
+	struct online_index_vg *vg = NULL;
+	uint32_t *dev;
+
+	if (!(pv = _oix_pv_find(pvid, 1)))
+		return 0;
+
+	if (vgname && !(vg = _oix_vg_find(vgname, 1)))
+		return 0;
+
+	if (pv->flags & ONLINE_INDEX_PV_ONLINE) {
+		if ((pv->major != major) || (pv->minor != minor))
+			return 1; /* duplicate, first one stays */
+	} else {
+		if (!(dev = _oix_dev_entry(major, minor, 1)))
+			return 0;
+
+		pv->major = major;
+		pv->minor = minor;
+		pv->flags |= ONLINE_INDEX_PV_ONLINE;
+		*dev = (uint32_t) (pv - _oix.pvs) + 1;
+
+		if (pv->vg)
+			_oix.vgs[pv->vg - 1].pvs_online++;
+	}
+
+	if (vg)
+		_oix_pv_set_vg(pv, vg);
+
+	return 1;
+}
+
+static void _oix_init(void)
+{
+	memset(_oix.hdr, 0, _oix.size);
+
+	_oix.hdr->magic = ONLINE_INDEX_MAGIC;
+	_oix.hdr->version = ONLINE_INDEX_VERSION;
+	_oix.hdr->pv_slots = ONLINE_INDEX_PVS;
+	_oix.hdr->vg_slots = ONLINE_INDEX_VGS;
+}
+
+/* Index any pvid online files created without it. */
+static void _oix_import_files(void)
+{
+	char path[PATH_MAX];
+	char file_vgname[NAME_LEN];
+	DIR *dir;
+	struct dirent *de;
+	int file_major, file_minor;
+
+	if (!(dir = opendir(_pvs_online_dir)))
+		return;
+
+	while ((de = readdir(dir))) {
+		if ((de->d_name[0] == '.') || (strlen(de->d_name) != ID_LEN))
+			continue;
+
+		if (dm_snprintf(path, sizeof(path), "%s/%s", _pvs_online_dir, de->d_name) < 0)
+			continue;
+
+		file_major = 0;
+		file_minor = 0;
+		memset(file_vgname, 0, sizeof(file_vgname));
+
+		if (!_online_pvid_file_read(path, &file_major, &file_minor, file_vgname))
+			continue;
+
+		if (!_oix_pv_set_online(de->d_name, (uint32_t) file_major, (uint32_t) file_minor,
+					file_vgname[0] ? file_vgname : NULL))
+			break;
+	}
+
+	if (closedir(dir))
+		log_sys_debug("closedir", _pvs_online_dir);
+}
+
+/* Remember pvs_online dir state after own change, with index locked. */
+static void _oix_stamp_dir(void)
+{
+	struct stat st;
+
+	if (stat(_pvs_online_dir, &st)) {
+		log_sys_debug("stat", _pvs_online_dir);
+		memset(&st, 0, sizeof(st));
+	}
+
+	_oix.hdr->dir_size = (uint64_t) st.st_size;
+	_oix.hdr->dir_mtime_sec = (int64_t) st.st_mtim.tv_sec;
+	_oix.hdr->dir_mtime_nsec = (int64_t) st.st_mtim.tv_nsec;
+}
+
+static int _oix_dir_changed(void)
+{
+	struct stat st;
+
+	if (stat(_pvs_online_dir, &st))
+		return 1;
+
+	return ((_oix.hdr->dir_size != (uint64_t) st.st_size) ||
+		(_oix.hdr->dir_mtime_sec != (int64_t) st.st_mtim.tv_sec) ||
+		(_oix.hdr->dir_mtime_nsec != (int64_t) st.st_mtim.tv_nsec));
+}
+
+static int _online_index_lock(void)
+{
+	if (!_oix.hdr)
+		return 0;
+
+	if (flock(_oix.fd, LOCK_EX)) {
+		log_sys_debug("flock", _pvs_online_index);
+		return 0;
+	}
+
+	if (_oix_dir_changed()) {
+		log_debug("Rebuilding pvs_online index from %s.", _pvs_online_dir);
+		_oix_init();
+		_oix_import_files();
+		_oix_stamp_dir();
+	}
+
+	if (_oix.hdr->invalid) {
+		if (flock(_oix.fd, LOCK_UN))
+			log_sys_debug("flock", _pvs_online_index);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void _online_index_unlock(void)
+{
+	if (flock(_oix.fd, LOCK_UN))
+		log_sys_debug("flock", _pvs_online_index);
+}
+
+static void _online_index_close(void)
+{
+	if (_oix.hdr && munmap(_oix.hdr, _oix.size))
+		log_sys_debug("munmap", _pvs_online_index);
+
+	if ((_oix.fd >= 0) && close(_oix.fd))
+		log_sys_debug("close", _pvs_online_index);
+
+	_oix.hdr = NULL;
+	_oix.fd = -1;
+}
+
+/* Without the index, pvscan uses the pvid online files only. */
+static void _online_index_open(void)
+{
+	struct stat st;
+	void *map;
+
+	_oix.size = sizeof(struct online_index_header) +
+		    ONLINE_INDEX_PVS * sizeof(struct online_index_pv) +
+		    ONLINE_INDEX_VGS * sizeof(struct online_index_vg) +
+		    ONLINE_INDEX_PVS * sizeof(uint32_t);
+
+	if ((_oix.fd = open(_pvs_online_index, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR)) < 0) {
+		log_debug("Failed to open %s: %d", _pvs_online_index, errno);
+		return;
+	}
+
+	if (flock(_oix.fd, LOCK_EX)) {
+		log_sys_debug("flock", _pvs_online_index);
+		goto bad;
+	}
+
+	if (fstat(_oix.fd, &st)) {
+		log_sys_debug("fstat", _pvs_online_index);
+		goto bad;
+	}
+
+	/* tmpfs file is sparse, only used pages take memory */
+	if (((size_t) st.st_size != _oix.size) && ftruncate(_oix.fd, 0)) {
+		log_sys_debug("ftruncate", _pvs_online_index);
+		goto bad;
+	}
+
+	if (ftruncate(_oix.fd, _oix.size)) {
+		log_sys_debug("ftruncate", _pvs_online_index);
+		goto bad;
+	}
+
+	if ((map = mmap(NULL, _oix.size, PROT_READ | PROT_WRITE, MAP_SHARED, _oix.fd, 0)) == MAP_FAILED) {
+		log_sys_debug("mmap", _pvs_online_index);
+		goto bad;
+	}
+
+	_oix.hdr = map;
+	_oix.pvs = (struct online_index_pv *) (_oix.hdr + 1);
+	_oix.vgs = (struct online_index_vg *) (_oix.pvs + ONLINE_INDEX_PVS);
+	_oix.devs = (uint32_t *) (_oix.vgs + ONLINE_INDEX_VGS);
+
+	/* Files get imported with the first lock */
+	if ((_oix.hdr->magic != ONLINE_INDEX_MAGIC) ||
+	    (_oix.hdr->version != ONLINE_INDEX_VERSION) ||
+	    (_oix.hdr->pv_slots != ONLINE_INDEX_PVS) ||
+	    (_oix.hdr->vg_slots != ONLINE_INDEX_VGS)) {
+		log_debug("Creating pvs_online index.");
+		_oix_init();
+	}
+
+	_online_index_unlock();
+
+	return;
+bad:
+	_online_index_close();
+}
+
+/*
+ * Returns 0 if the devno is not online, or 1 with pvid and
+ * vgname (possibly empty) of the devno set offline.
+ */
+static int _oix_pv_offline_devno(int major, int minor, char *pvid, char *vgname)
+{
+	struct online_index_pv *pv;
+	uint32_t *dev;
+
+	if (!(dev = _oix_dev_entry((uint32_t) major, (uint32_t) minor, 0)))
+		return 0;
+
+	pv = &_oix.pvs[*dev - 1];
+
+	memcpy(pvid, pv->pvid, ID_LEN);
+	pvid[ID_LEN] = '\0';
+
+	if (pv->vg)
+		memcpy(vgname, _oix.vgs[pv->vg - 1].name, NAME_LEN);
+
+	_oix_pv_set_offline(pv);
+
+	return 1;
+}
+
+/* Record all PVs of the VG from its metadata. */
+static void _online_index_vg_pvs(struct volume_group *vg)
+{
+	struct online_index_vg *ivg;
+	struct online_index_pv *ipv;
+	struct pv_list *pvl;
+
+	if (!_online_index_lock())
+		return;
+
+	if (!(ivg = _oix_vg_find(vg->name, 1)))
+		goto out;
+
+	ivg->pv_count = dm_list_size(&vg->pvs);
+
+	dm_list_iterate_items(pvl, &vg->pvs) {
+		if (!(ipv = _oix_pv_find((const char *)&pvl->pv->id.uuid, 1)))
+			goto out;
+		_oix_pv_set_vg(ipv, ivg);
+	}
+out:
+	_online_index_unlock();
+}
+
+/*
+ * Count online PVs of the VG the PV belongs to, if known to the index.
+ * Returns -1 if the index can't be used.
+ */
+static int _online_index_count_vg_pvs(struct cmd_context *cmd, const char *pvid,
+				      int *pvs_online, int *pvs_offline,
+				      const char **vgname_out)
+{
+	struct online_index_pv *pv;
+	struct online_index_vg *vg;
+	int r = 0;
+
+	if (!_online_index_lock())
+		return -1;
+
+	if (!(pv = _oix_pv_find(pvid, 0)) || !pv->vg)
+		goto out;
+
+	vg = &_oix.vgs[pv->vg - 1];
+	if (!vg->pv_count)
+		goto out;
+
+	if (!(*vgname_out = dm_pool_strdup(cmd->mem, vg->name)))
+		goto_out;
+
+	*pvs_online = (int) vg->pvs_online;
+	*pvs_offline = (vg->pv_count > vg->pvs_online) ? (int) (vg->pv_count - vg->pvs_online) : 0;
+	r = 1;
+out:
+	_online_index_unlock();
+
+	return r;
+}
+
+/*
+ * Get the device number and VG name of an online PV.
+ * Returns -1 if the index can't be used.
+ */
+static int _online_index_pv_devno(const char *pvid, int *major, int *minor, char *vgname)
+{
+	struct online_index_pv *pv;
+	int r = 0;
+
+	if (!_online_index_lock())
+		return -1;
+
+	if ((pv = _oix_pv_find(pvid, 0)) && (pv->flags & ONLINE_INDEX_PV_ONLINE)) {
+		*major = (int) pv->major;
+		*minor = (int) pv->minor;
+		if (pv->vg)
+			memcpy(vgname, _oix.vgs[pv->vg - 1].name, NAME_LEN);
+		r = 1;
+	}
+
+	_online_index_unlock();
+
+	return r;
+}
+
+/*
+ * Check the PVs of the VG from its metadata.
+ * Returns -1 if the index can't be used.
+ */
+static int _online_index_count_pvs(struct volume_group *vg, int *pvs_online, int *pvs_offline)
+{
+	struct online_index_pv *pv;
+	struct pv_list *pvl;
+
+	if (!_online_index_lock())
+		return -1;
+
+	dm_list_iterate_items(pvl, &vg->pvs) {
+		if ((pv = _oix_pv_find((const char *)&pvl->pv->id.uuid, 0)) &&
+		    (pv->flags & ONLINE_INDEX_PV_ONLINE))
+			(*pvs_online)++;
+		else
+			(*pvs_offline)++;
+	}
+
+	_online_index_unlock();
+
+	return 1;
+}
+
 /*
  * When a device goes offline we only know its major:minor, not its PVID.
  * Since the dev isn't around, we can't read it to get its PVID, so we have to
@@ -290,10 +862,32 @@ static void _online_pvid_file_remove_devno(int major, int minor)
 	char file_vgname[NAME_LEN];
 	DIR *dir;
 	struct dirent *de;
+	char pvid[ID_LEN + 1];
 	int file_major = 0, file_minor = 0;
+	int rv;
 
 	log_debug("Remove pv online devno %d:%d", major, minor);
 
+	memset(file_vgname, 0, sizeof(file_vgname));
+
+	if (_online_index_lock()) {
+		if ((rv = _oix_pv_offline_devno(major, minor, pvid, file_vgname)) &&
+		    (dm_snprintf(path, sizeof(path), "%s/%s", _pvs_online_dir, pvid) >= 0)) {
+			log_debug("Unlink pv online %s", path);
+			if (unlink(path))
+				log_sys_debug("unlink", path);
+			_oix_stamp_dir();
+		}
+
+		_online_index_unlock();
+
+		if (rv && file_vgname[0]) {
+			_online_vg_file_remove(file_vgname);
+			_lookup_file_remove(file_vgname);
+		}
+		return;
+	}
+
 	if (!(dir = opendir(_pvs_online_dir)))
 		return;
 
@@ -347,7 +941,7 @@ static void _online_files_remove(const char *dirpath)
 		log_sys_debug("closedir", dirpath);
 }
 
-static int _online_pvid_file_create(struct device *dev, const char *vgname)
+static int _online_pvid_file_write(struct device *dev, const char *vgname)
 {
 	char path[PATH_MAX];
 	char buf[MAX_PVID_FILE_SIZE];
@@ -449,6 +1043,22 @@ check_duplicate:
 	return 0;
 }
 
+static int _online_pvid_file_create(struct device *dev, const char *vgname)
+{
+	int locked = _online_index_lock();
+	int r = _online_pvid_file_write(dev, vgname);
+
+	if (locked) {
+		if (r && !_oix_pv_set_online(dev->pvid, (uint32_t) MAJOR(dev->dev),
+					     (uint32_t) MINOR(dev->dev), vgname))
+			log_debug("pvs_online index not updated for %s.", dev_name(dev));
+		_oix_stamp_dir();
+		_online_index_unlock();
+	}
+
+	return r;
+}
+
 static int _online_pvid_file_exists(const char *pvid)
 {
 	char path[PATH_MAX];
@@ -503,6 +1113,8 @@ static int _write_lookup_file(struct cmd_context *cmd, struct volume_group *vg)
 	if (close(fd))
 		log_sys_debug("close", path);
 
+	_online_index_vg_pvs(vg);
+
 	return 1;
 }
 
@@ -596,6 +1208,11 @@ static int _count_pvid_files_from_lookup_file(struct cmd_context *cmd, struct de
 	*pvs_online = 0;
 	*pvs_offline = 0;
 
+	if (_online_index_count_vg_pvs(cmd, dev->pvid, pvs_online, pvs_offline, vgname_out) > 0) {
+		log_debug("counted pvs online for %s from index", *vgname_out);
+		return 1;
+	}
+
 	if (!(dir = opendir(_pvs_lookup_dir)))
 		goto_bad;
 
@@ -709,6 +1326,9 @@ static void _count_pvid_files(struct volume_group *vg, int *pvs_online, int *pvs
 	*pvs_online = 0;
 	*pvs_offline = 0;
 
+	if (_online_index_count_pvs(vg, pvs_online, pvs_offline) >= 0)
+		return;
+
 	dm_list_iterate_items(pvl, &vg->pvs) {
 		if (_online_pvid_file_exists((const char *)&pvl->pv->id.uuid))
 			(*pvs_online)++;
@@ -825,14 +1445,16 @@ static int _get_devs_from_saved_vg(struct cmd_context *cmd, const char *vgname,
 	dm_list_iterate_items(pvl, &vg->pvs) {
 		pvid = (const char *)&pvl->pv->id.uuid;
 
-		memset(path, 0, sizeof(path));
-		snprintf(path, sizeof(path), "%s/%s", _pvs_online_dir, pvid);
-
 		file_major = 0;
 		file_minor = 0;
 		memset(file_vgname, 0, sizeof(file_vgname));
 
-		_online_pvid_file_read(path, &file_major, &file_minor, file_vgname);
+		if (_online_index_pv_devno(pvid, &file_major, &file_minor, file_vgname) < 0) {
+			memset(path, 0, sizeof(path));
+			snprintf(path, sizeof(path), "%s/%s", _pvs_online_dir, pvid);
+
+			_online_pvid_file_read(path, &file_major, &file_minor, file_vgname);
+		}
 
 		if (file_vgname[0] && strcmp(vgname, file_vgname)) {
 			log_error("Wrong VG found for %d:%d PVID %s: %s vs %s",
@@ -1020,7 +1642,7 @@ static int _pvscan_aa(struct cmd_context *cmd, struct pvscan_aa_params *pp,
 	struct processing_handle *handle = NULL;
 	struct dm_str_list *sl, *sl2;
 	int no_quick = 0;
-	int ret;
+	int ret = ECMD_PROCESSED;
 
 	if (!(handle = init_processing_handle(cmd, NULL))) {
 		log_error("Failed to initialize processing handle.");
@@ -1507,7 +2129,7 @@ static int _pvscan_cache_args(struct cmd_context *cmd, int argc, char **argv,
 	 * be checked by passes_filter below.
 	 */
 	dm_list_iterate_items(devl, &pvscan_devs)
-		cmd->filter->wipe(cmd, cmd->filter, devl->dev, NULL);
+		persistent_filter_forget(cmd->filter, devl->dev);
 
 	/*
 	 * Read header from each dev.
@@ -1586,21 +2208,29 @@ int pvscan_cache_cmd(struct cmd_context *cmd, int argc, char **argv)
 	do_all = !argc && !devno_args;
 
 	_online_dir_setup();
+	_online_index_open();
 
 	if (do_all) {
-		if (!_pvscan_cache_all(cmd, argc, argv, &complete_vgnames))
-			return ECMD_FAILED;
+		if (!_pvscan_cache_all(cmd, argc, argv, &complete_vgnames)) {
+			ret = ECMD_FAILED;
+			goto out;
+		}
 	} else {
-		if (!_pvscan_cache_args(cmd, argc, argv, &complete_vgnames))
-			return ECMD_FAILED;
+		if (!_pvscan_cache_args(cmd, argc, argv, &complete_vgnames)) {
+			ret = ECMD_FAILED;
+			goto out;
+		}
 	}
 
-	if (!do_activate)
-		return ECMD_PROCESSED;
+	if (!do_activate) {
+		ret = ECMD_PROCESSED;
+		goto out;
+	}
 
 	if (dm_list_empty(&complete_vgnames)) {
 		log_debug("No VGs to autoactivate.");
-		return ECMD_PROCESSED;
+		ret = ECMD_PROCESSED;
+		goto out;
 	}
 
 	/*
@@ -1615,6 +2245,9 @@ int pvscan_cache_cmd(struct cmd_context *cmd, int argc, char **argv)
 
 	if (!sync_local_dev_names(cmd))
 		stack;
+out:
+	_online_index_close();
+
 	return ret;
 }
 
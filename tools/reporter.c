@@ -150,6 +150,27 @@ static int _check_merging_origin(const struct logical_volume *lv,
 	return 1;
 }
 
+/*
+ * Skip getting LV device info and status for LVs whose metadata-only
+ * fields already make them fail the selection.
+ */
+static int _lv_preselected(struct processing_handle *handle,
+			   const struct logical_volume *lv,
+			   const struct lv_segment *seg,
+			   int *selected)
+{
+	struct selection_handle *sh = handle->selection_handle;
+
+	if (!report_object_preselect(sh ? : handle->custom_handle, sh != NULL,
+				     lv, seg, selected))
+		return_0;
+
+	if (sh && !*selected)
+		sh->selected = 0;
+
+	return 1;
+}
+
 static int _do_lvs_with_info_and_status_single(struct cmd_context *cmd,
 					       const struct logical_volume *lv,
 					       int do_info, int do_status,
@@ -160,11 +181,17 @@ static int _do_lvs_with_info_and_status_single(struct cmd_context *cmd,
 		.seg_status.type = SEG_STATUS_NONE
 	};
 	int r = ECMD_FAILED;
-	int merged;
+	int merged, selected;
 
 	if (lv_is_merging_origin(lv))
 		/* Status is need to know which LV should be shown */
 		do_status = 1;
+	else if (do_info || do_status) {
+		if (!_lv_preselected(handle, lv, NULL, &selected))
+			return_ECMD_FAILED;
+		if (!selected)
+			return ECMD_PROCESSED;
+	}
 
 	if (!_do_info_and_status(cmd, first_seg(lv), &status, do_info, do_status))
 		goto_out;
@@ -182,6 +209,9 @@ static int _do_lvs_with_info_and_status_single(struct cmd_context *cmd,
 
 	r = ECMD_PROCESSED;
 out:
+	if (r != ECMD_PROCESSED)
+		report_object_preselect_discard(sh ? : handle->custom_handle, sh != NULL);
+
 	if (status.seg_status.mem)
 		dm_pool_destroy(status.seg_status.mem);
 
@@ -222,11 +252,17 @@ static int _do_segs_with_info_and_status_single(struct cmd_context *cmd,
 		.seg_status.type = SEG_STATUS_NONE
 	};
 	int r = ECMD_FAILED;
-	int merged;
+	int merged, selected;
 
 	if (lv_is_merging_origin(seg->lv))
 		/* Status is need to know which LV should be shown */
 		do_status = 1;
+	else if (do_info || do_status) {
+		if (!_lv_preselected(handle, seg->lv, seg, &selected))
+			return_ECMD_FAILED;
+		if (!selected)
+			return ECMD_PROCESSED;
+	}
 
 	if (!_do_info_and_status(cmd, seg, &status, do_info, do_status))
 		goto_out;
@@ -244,6 +280,9 @@ static int _do_segs_with_info_and_status_single(struct cmd_context *cmd,
 
 	r = ECMD_PROCESSED;
 out:
+	if (r != ECMD_PROCESSED)
+		report_object_preselect_discard(sh ? : handle->custom_handle, sh != NULL);
+
 	if (status.seg_status.mem)
 		dm_pool_destroy(status.seg_status.mem);
 
@@ -2289,7 +2289,7 @@ static struct lv_segment _historical_lv_segment = {
 	.origin_list = DM_LIST_HEAD_INIT(_historical_lv_segment.origin_list),
 };
 
-int opt_in_list_is_set(struct cmd_context *cmd, int *opts, int count,
+int opt_in_list_is_set(struct cmd_context *cmd, const int *opts, int count,
 		       int *match_count, int *unmatch_count)
 {
 	int match = 0;
@@ -2311,7 +2311,7 @@ int opt_in_list_is_set(struct cmd_context *cmd, int *opts, int count,
 	return match ? 1 : 0;
 }
       
-void opt_array_to_str(struct cmd_context *cmd, int *opts, int count,
+void opt_array_to_str(struct cmd_context *cmd, const int *opts, int count,
 		      char *buf, int len)
 {
 	int pos = 0;
@@ -2701,7 +2701,7 @@ static int _check_lv_types(struct cmd_context *cmd, struct logical_volume *lv, i
 static int _check_lv_rules(struct cmd_context *cmd, struct logical_volume *lv)
 {
 	char buf[64];
-	struct cmd_rule *rule;
+	const struct cmd_rule *rule;
 	struct lv_type *lvtype = NULL;
 	uint64_t lv_props_match_bits = 0, lv_props_unmatch_bits = 0;
 	uint64_t lv_types_match_bits = 0, lv_types_unmatch_bits = 0;
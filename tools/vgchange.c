@@ -84,11 +84,18 @@ static int _activate_lvs_in_vg(struct cmd_context *cmd, struct volume_group *vg,
 	struct lv_list *lvl;
 	struct logical_volume *lv;
 	int count = 0, expected_count = 0, r = 1;
+	unsigned queued, batch_activated;
+
+	/* Simple LVs get activated together in one tree after the loop */
+	if (is_change_activating(activate) && !activation_batch_begin(cmd, vg))
+		return_0;
 
 	sigint_allow();
 	dm_list_iterate_items(lvl, &vg->lvs) {
-		if (sigint_caught())
+		if (sigint_caught()) {
+			activation_batch_discard();
 			return_0;
+		}
 
 		lv = lvl->lv;
 
@@ -119,15 +126,26 @@ static int _activate_lvs_in_vg(struct cmd_context *cmd, struct volume_group *vg,
 
 		expected_count++;
 
+		queued = activation_batch_size();
+
 		if (!lv_change_activate(cmd, lv, activate)) {
 			stack;
 			r = 0;
 			continue;
 		}
 
-		count++;
+		/* Queued LVs are counted once the batch is activated */
+		if (activation_batch_size() == queued)
+			count++;
+	}
+
+	if (!activation_batch_end(cmd, &batch_activated)) {
+		stack;
+		r = 0;
 	}
 
+	count += batch_activated;
+
 	sigint_restore();
 
 	if (expected_count)
@@ -63,7 +63,7 @@ int vgcreate(struct cmd_context *cmd, int argc, char **argv)
 	if (!lockd_global_create(cmd, "ex", vp_new.lock_type))
 		return_ECMD_FAILED;
 
-	clear_hint_file(cmd);
+	begin_hint_update(cmd);
 
 	/*
 	 * Check if the VG name already exists.  This should be done before
@@ -224,7 +224,7 @@ int vgreduce(struct cmd_context *cmd, int argc, char **argv)
 	if (!lock_global(cmd, "ex"))
 		return_ECMD_FAILED;
 
-	clear_hint_file(cmd);
+	begin_hint_update(cmd);
 
 	if (!(handle = init_processing_handle(cmd, NULL))) {
 		log_error("Failed to initialize processing handle.");
@@ -94,7 +94,7 @@ int vgremove(struct cmd_context *cmd, int argc, char **argv)
 	if (!lock_global(cmd, "ex"))
 		return_ECMD_FAILED;
 
-	clear_hint_file(cmd);
+	begin_hint_update(cmd);
 
 	cmd->wipe_outdated_pvs = 1;
 
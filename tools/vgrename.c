@@ -194,7 +194,7 @@ int vgrename(struct cmd_context *cmd, int argc, char **argv)
 	if (!lock_global(cmd, "ex"))
 		return_ECMD_FAILED;
 
-	clear_hint_file(cmd);
+	begin_hint_update(cmd);
 
 	/*
 	 * Special case where vg_name_old may be a UUID: